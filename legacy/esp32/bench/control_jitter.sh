@@ -0,0 +1,35 @@
+#!/bin/bash
+# Control loop jitter under synthetic HTTP load.
+# Scrapes the `latency_lateness_seconds` histograms of the control tasks before and after hammering
+# /api/status and /api/history, and prints the lateness distribution accumulated during the load.
+# Run it against the firmware before and after a change to compare.
+#   bench/control_jitter.sh <host> [seconds=60] [concurrency=4]
+set -e
+HOST="${1:?usage: $0 <host> [seconds] [concurrency]}"
+SECONDS_RUN="${2:-60}"
+CONCURRENCY="${3:-4}"
+TASKS='name="(pwm_output_[0-9]+|ambient|powermonitor)"'
+
+scrape() {
+    curl -sf "http://$HOST/api/metrics" | grep -E "^latency_lateness_seconds_(bucket|count|sum) \{.*kind=\"task\",$TASKS" || true
+}
+
+before="$(mktemp)"; after="$(mktemp)"
+trap 'rm -f "$before" "$after"; kill $(jobs -p) 2>/dev/null || true' EXIT
+
+scrape > "$before"
+deadline=$(( $(date +%s) + SECONDS_RUN ))
+for _ in $(seq "$CONCURRENCY"); do
+    ( while [ "$(date +%s)" -lt "$deadline" ]; do
+        curl -sf -o /dev/null "http://$HOST/api/status" || true
+        curl -sf -o /dev/null "http://$HOST/api/history" || true
+    done ) &
+done
+wait
+scrape > "$after"
+
+# Prints the per series difference: cumulative buckets, count and sum over the load window.
+awk '
+    NR == FNR { value[$1 " " $2] = $3; next }
+    { key = $1 " " $2; printf "%s %s %g\n", $1, $2, $3 - value[key] }
+' "$before" "$after"
@@ -0,0 +1,345 @@
+// Host microbenchmarks of the firmware hot paths: time and heap allocations per operation.
+// The firmware core runs against lib/native_shims, built and run with `bench/native.sh firmware_bench`.
+// Pass the output of a previous run to print the change of each benchmark, i.e. to compare two commits.
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <native.h>
+#include <native_devices.h>
+#include "metricsresponse.h"
+#include "history.h"
+#include "pwm_output.h"
+#include "powermonitor.h"
+#include "status_events.h"
+#include "ambient/ambient.h"
+#include "i2c_wire.h"
+
+float lipoBatteryCharge(uint8_t cells, float voltage);
+
+namespace {
+size_t allocations = 0;
+size_t allocatedBytes = 0;
+}
+
+// Heap allocations are counted at malloc, linked with -Wl,--wrap (see bench/native.sh), so that the C allocations of
+// ArduinoJson and HeapAccounting are counted along with operator new, which is replaced to allocate through malloc.
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    allocations++;
+    allocatedBytes += size;
+    return __real_malloc(size);
+}
+void *__wrap_calloc(size_t count, size_t size) {
+    allocations++;
+    allocatedBytes += count * size;
+    return __real_calloc(count, size);
+}
+void *__wrap_realloc(void *ptr, size_t size) {
+    allocations++;
+    allocatedBytes += size;
+    return __real_realloc(ptr, size);
+}
+}
+
+// Kept out of line: once inlined at a new or delete expression, GCC would pair the malloc and free calls with the
+// operator new of that expression and report them as mismatched.
+[[gnu::noinline]] void *operator new(size_t size) {
+    if(void *ptr = std::malloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+[[gnu::noinline]] void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+[[gnu::noinline]] void operator delete(void *ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+using APB::MetricsResponse;
+using Labels = MetricsResponse::Labels;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+// TCP_MSS on the ESP32, the usual chunk size for AsyncWebServer responses.
+constexpr size_t CHUNK_SIZE = 1436;
+// Each benchmark runs for at least this long, several times, keeping the fastest run.
+constexpr auto MIN_RUN_TIME = std::chrono::milliseconds{100};
+constexpr int RUNS = 5;
+
+template<typename T> void keep(const T &value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+struct Result {
+    double nanoseconds;
+    double allocations;
+    double bytes;
+};
+
+// Times `iterations` calls of `op`. When given, `prepare` runs before each call, outside of the measurement.
+template<typename Op> Result run(size_t iterations, Op &op, const std::function<void()> &prepare) {
+    const size_t startAllocations = allocations;
+    const size_t startBytes = allocatedBytes;
+    Clock::duration elapsed{};
+    if(prepare) {
+        size_t allocationsPrepare = 0, bytesPrepare = 0;
+        for(size_t i = 0; i < iterations; i++) {
+            const size_t before = allocations, beforeBytes = allocatedBytes;
+            prepare();
+            allocationsPrepare += allocations - before;
+            bytesPrepare += allocatedBytes - beforeBytes;
+            const auto start = Clock::now();
+            op();
+            elapsed += Clock::now() - start;
+        }
+        return {
+            std::chrono::duration<double, std::nano>(elapsed).count() / iterations,
+            static_cast<double>(allocations - startAllocations - allocationsPrepare) / iterations,
+            static_cast<double>(allocatedBytes - startBytes - bytesPrepare) / iterations,
+        };
+    }
+    const auto start = Clock::now();
+    for(size_t i = 0; i < iterations; i++) {
+        op();
+    }
+    elapsed = Clock::now() - start;
+    return {
+        std::chrono::duration<double, std::nano>(elapsed).count() / iterations,
+        static_cast<double>(allocations - startAllocations) / iterations,
+        static_cast<double>(allocatedBytes - startBytes) / iterations,
+    };
+}
+
+class Suite {
+public:
+    Suite(const char *baselinePath) {
+        if(baselinePath) {
+            loadBaseline(baselinePath);
+        }
+        printf("%-36s %12s %10s %10s%s\n", "benchmark", "ns/op", "allocs/op", "bytes/op", baseline.empty() ? "" : "     change");
+    }
+
+    template<typename Op> void add(const std::string &name, Op op, const std::function<void()> &prepare = {}) {
+        // Warm up, then scale the iterations to the minimum run time
+        size_t iterations = 1;
+        while(true) {
+            const auto start = Clock::now();
+            run(iterations, op, prepare);
+            if(Clock::now() - start >= MIN_RUN_TIME / 10) {
+                break;
+            }
+            iterations *= 4;
+        }
+        iterations *= 10;
+        Result best = run(iterations, op, prepare);
+        for(int i = 1; i < RUNS; i++) {
+            const Result result = run(iterations, op, prepare);
+            best.nanoseconds = std::min(best.nanoseconds, result.nanoseconds);
+        }
+        printf("%-36s %12.1f %10.2f %10.1f", name.c_str(), best.nanoseconds, best.allocations, best.bytes);
+        const auto previous = baseline.find(name);
+        if(previous != baseline.end() && previous->second > 0) {
+            printf(" %+10.1f%%", 100 * (best.nanoseconds / previous->second - 1));
+        }
+        printf("\n");
+    }
+private:
+    std::map<std::string, double> baseline;
+
+    void loadBaseline(const char *path) {
+        std::ifstream file{path};
+        std::string line;
+        std::getline(file, line);
+        while(std::getline(file, line)) {
+            std::istringstream fields{line};
+            std::string name;
+            double nanoseconds;
+            if(fields >> name >> nanoseconds) {
+                baseline[name] = nanoseconds;
+            }
+        }
+    }
+};
+
+// The /api/metrics sample set of a box with 6 outputs
+struct Scrape {
+    static constexpr size_t PWM_OUTPUTS = 6;
+    Labels fixedLabels;
+    std::array<Labels, PWM_OUTPUTS> outputLabels;
+    size_t recordsSent = 0;
+
+    Scrape() {
+        fixedLabels.add("source", "AstroPowerBox-bench");
+        for(size_t index = 0; index < PWM_OUTPUTS; index++) {
+            outputLabels[index].add("index", static_cast<int>(index)).add("mode", index < 2 ? "dewpoint" : "fixed");
+        }
+    }
+
+    void write(MetricsResponse &metrics) const {
+        metrics
+            .gauge("powermonitor", 12.3, Labels().unit("V").field("voltage"))
+            .gauge("powermonitor", 1.2, Labels().unit("A").field("current"), nullptr, false)
+            .gauge("powermonitor", 14.8, Labels().unit("W").field("power"), nullptr, false)
+            .gauge("ambient", 8.5, Labels().unit("°C").field("temperature"))
+            .gauge("ambient", 80.1, Labels().unit("%").field("humidity"), nullptr, false)
+            .gauge("ambient", 5.2, Labels().unit("°C").field("dewpoint"), nullptr, false);
+        const char *fields[] = { "maxDuty", "duty", "active", "temperature" };
+        for(const char *field: fields) {
+            for(size_t index = 0; index < PWM_OUTPUTS; index++) {
+                metrics.gauge("pwmOutput", 0.5, Labels(outputLabels[index]).field(field), nullptr, index == 0 && field == fields[0]);
+            }
+        }
+        for(size_t index = 0; index < 2; index++) {
+            metrics.gauge("pwmOutput_dewpoint_offset", 3, Labels(outputLabels[index]).field("dewpoint_offset").unit("°C"), nullptr, index == 0);
+        }
+        metrics.gauge("heap", 180000, Labels().field("free"));
+        metrics.gauge("heap", 320000, Labels().field("size"), nullptr, false);
+        metrics.gauge("heap", 150000, Labels().field("min_free"), nullptr, false);
+        metrics.gauge("heap", 110000, Labels().field("max_alloc"), nullptr, false);
+        metrics.gauge("uptime", 12345.6);
+    }
+
+    size_t run(uint8_t *buffer) {
+        size_t total = 0;
+        recordsSent = 0;
+        while(true) {
+            MetricsResponse metrics{buffer, CHUNK_SIZE, fixedLabels, recordsSent};
+            write(metrics);
+            recordsSent = metrics.records();
+            if(metrics.written() == 0) {
+                return total;
+            }
+            total += metrics.written();
+        }
+    }
+};
+
+// Whole /api/history response, in chunks of `chunkSize` like AsyncWebServer chunked responses
+size_t serialiseHistory(std::vector<uint8_t> &buffer) {
+    APB::History::JsonSerialiser serialiser{APB::History::Instance};
+    size_t index = 0;
+    while(const int written = serialiser.write(buffer.data(), buffer.size(), index)) {
+        index += written;
+    }
+    return index;
+}
+
+// Simulated box: an SHT4x, the INA219 and a thermistor on every output, with noisy readings.
+struct Box {
+    Native::SHT4xDevice sht4x;
+    Native::INA219Device ina219{APB_POWER_SHUNT_OHMS};
+    std::mt19937 random{42};
+    std::normal_distribution<float> noise{0, 0.05};
+    Scheduler sensors;
+    Scheduler control;
+    Scheduler events;
+    AsyncWebServer webServer;
+    APB::StatusEvents statusEvents{"/api/events"};
+    std::array<AsyncWebServerRequest, 3> requests;
+
+    void setup() {
+        static const uint8_t thermistorPins[] = {1, 4, 7};
+        sht4x.temperature = 8;
+        sht4x.humidity = 85;
+        ina219.current = 2.5;
+        Native::attachI2CDevice(0x44, &sht4x);
+        Native::attachI2CDevice(APB_INA1219_ADDRESS, &ina219);
+        for(uint8_t pin: thermistorPins) {
+            // About 10°C, close to the dewpoint targets
+            Native::setAnalogRead(pin, [this]() { return static_cast<uint16_t>(2560 + 40 * noise(random)); });
+        }
+        APB::I2C::begin();
+        APB::Ambient::Instance.setup(sensors);
+        APB::PowerMonitor::Instance.setup(sensors);
+        for(uint8_t index = 0; index < APB::PWMOutputs::Instance.size(); index++) {
+            APB::PWMOutputs::Instance[index].setup(index, control);
+        }
+        JsonDocument dewpoint;
+        deserializeJson(dewpoint, R"({"mode":"dewpoint","dewpoint_offset":3,"max_duty":1,"min_duty":0.1,"ramp_offset":2})");
+        APB::PWMOutputs::Instance[0].setState(dewpoint.as<JsonObject>());
+        JsonDocument target;
+        deserializeJson(target, R"({"mode":"target_temperature","target_temperature":12,"max_duty":0.8})");
+        APB::PWMOutputs::Instance[1].setState(target.as<JsonObject>());
+        APB::History::Instance.setup(sensors);
+        statusEvents.setup(webServer, events);
+        // A dashboard, a client of the power topic only, and an INDI client at a slower rate
+        requests[1].params.emplace("topics", AsyncWebParameter{"power"});
+        requests[2].params.emplace("interval", AsyncWebParameter{"5000"});
+        AsyncEventSource *eventSource = static_cast<AsyncEventSource*>(webServer.handlersList().front());
+        for(auto &request: requests) {
+            eventSource->connect(request);
+        }
+    }
+
+    // One second of sensor readings and control steps
+    void step() {
+        sht4x.temperature += noise(random);
+        sht4x.humidity = std::clamp(sht4x.humidity + noise(random), 0.f, 100.f);
+        ina219.current = std::max(0.f, ina219.current + noise(random));
+        Native::advance(1000);
+        sensors.execute();
+        control.execute();
+    }
+
+    void fillHistory() {
+        for(int i = 0; i < 300; i++) {
+            step();
+            APB::History::Instance.add();
+        }
+    }
+};
+}
+
+int main(int argc, char **argv) {
+    Suite suite{argc > 1 ? argv[1] : nullptr};
+    static Box box;
+    box.setup();
+    box.fillHistory();
+
+    for(size_t chunkSize: {256, 536, 1436, 4096}) {
+        std::vector<uint8_t> buffer(chunkSize);
+        suite.add("history_serialise/chunk=" + std::to_string(chunkSize), [&buffer]() { keep(serialiseHistory(buffer)); });
+    }
+    {
+        JsonDocument doc;
+        const APB::History::Entry entry = APB::History::Instance.entries().back();
+        suite.add("history_entry_populate", [&]() { entry.populate(doc.to<JsonObject>()); keep(doc); });
+    }
+    {
+        static uint8_t buffer[CHUNK_SIZE];
+        Scrape scrape;
+        suite.add("metrics_scrape", [&]() { keep(scrape.run(buffer)); });
+    }
+    {
+        volatile float temperature = 8.5, humidity = 80.1;
+        suite.add("ambient_dewpoint", [&]() { keep(APB::Ambient::calculateDewpoint(temperature, humidity)); });
+    }
+    {
+        float voltage = 10;
+        suite.add("lipo_battery_charge", [&]() {
+            voltage = voltage > 12.8 ? 10 : voltage + 0.01;
+            keep(lipoBatteryCharge(3, voltage));
+        });
+    }
+    // Thermistor conversion and control step of every output, as run by the control task
+    suite.add("pwm_output_control_step", []() {
+        Native::advance(APB_PWM_OUTPUT_SAMPLING_MAX_MS);
+        box.control.execute();
+    });
+    // One SSE publication for the three clients, keyframes and deltas, after a second of fresh readings
+    suite.add("sse_status_event", []() { box.events.execute(); }, []() { box.step(); });
+    return 0;
+}
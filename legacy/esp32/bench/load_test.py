@@ -0,0 +1,490 @@
+#!/usr/bin/env python3
+"""HTTP load test of the firmware web server, with a realistic mix of clients.
+
+Dashboards subscribe to /api/events and poll /api/status and /api/history, scrapers poll /api/metrics, INDI clients
+subscribe to /api/events at a slower rate, and a controller re-applies the current state of a PWM output with
+/api/pwmOutput POSTs, so a real box keeps running as configured. While the load runs, the box's own /api/metrics
+are sampled to relate the client side latencies to its heap and control loop lateness.
+
+    bench/load_test.py <host> [--seconds 60] [--dashboards 2] [--scrapers 1] [--indi 1] [--speedup 1]
+    bench/load_test.py --stand-in --seconds 10 --speedup 10
+
+--stand-in runs against a local imitation of the firmware API (same routes and payload shapes, with a simulated heap
+and control task), so the tool itself can run in CI. Only the Python standard library is required.
+Exits with 1 when the error rate exceeds --max-error-rate, or an events subscriber got no events.
+"""
+import argparse
+import http.client
+import json
+import math
+import random
+import re
+import sys
+import threading
+import time
+from collections import defaultdict
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+# Control tasks whose scheduling lateness is reported, as in bench/control_jitter.sh
+CONTROL_TASKS = re.compile(r'name="(pwm_output_[0-9]+|ambient|powermonitor)"')
+METRIC_LINE = re.compile(r'^(\w+) \{([^}]*)\} (\S+)$')
+
+
+class Stats:
+    """Request latencies and errors by route, thread safe."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.latencies = defaultdict(list)
+        self.errors = defaultdict(int)
+        self.bytes = defaultdict(int)
+        # (time, latency) of every request, for the timeline
+        self.samples = []
+
+    def add(self, route, started, latency, size):
+        with self.lock:
+            self.latencies[route].append(latency)
+            self.bytes[route] += size
+            self.samples.append((started, latency))
+
+    def error(self, route):
+        with self.lock:
+            self.errors[route] += 1
+
+
+def percentile(values, fraction):
+    if not values:
+        return math.nan
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(fraction * len(ordered)))]
+
+
+class Target:
+    def __init__(self, host, port, timeout):
+        self.host = host
+        self.port = port
+        self.timeout = timeout
+
+    def connection(self):
+        return http.client.HTTPConnection(self.host, self.port, timeout=self.timeout)
+
+    def request(self, method, path, body=None):
+        """Returns the status and body, on a new connection like the browsers on the ESP32, that closes them."""
+        connection = self.connection()
+        try:
+            headers = {'Content-Type': 'application/json'} if body is not None else {}
+            connection.request(method, path, body=body, headers=headers)
+            response = connection.getresponse()
+            return response.status, response.read()
+        finally:
+            connection.close()
+
+
+class LoadTest:
+    def __init__(self, target, args):
+        self.target = target
+        self.args = args
+        self.stats = Stats()
+        self.stop = threading.Event()
+        self.events = {}
+        self.events_lock = threading.Lock()
+
+    def period(self, seconds):
+        return seconds / self.args.speedup
+
+    def timed(self, route, method='GET', path=None, body=None):
+        started = time.monotonic()
+        try:
+            status, payload = self.target.request(method, path or route, body)
+        except (OSError, http.client.HTTPException):
+            self.stats.error(route)
+            return None
+        latency = time.monotonic() - started
+        if status >= 400:
+            self.stats.error(route)
+            return None
+        self.stats.add(route, started, latency, len(payload))
+        return payload
+
+    def every(self, seconds, action, jitter=True):
+        # Clients don't start in lockstep
+        if jitter and self.stop.wait(random.uniform(0, self.period(seconds))):
+            return
+        while not self.stop.is_set():
+            action()
+            if self.stop.wait(self.period(seconds)):
+                return
+
+    def dashboard(self, name):
+        threading.Thread(target=self.subscriber, args=(name, '/api/events'), daemon=True).start()
+        self.timed('/api/history')
+        threads = [
+            threading.Thread(target=self.every, args=(60, lambda: self.timed('/api/history')), daemon=True),
+            threading.Thread(target=self.every, args=(10, lambda: self.timed('/api/status')), daemon=True),
+        ]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+
+    def indi(self, name):
+        self.subscriber(name, '/api/events?topics=pwmOutputs,ambient,power&interval=5000')
+
+    def scraper(self):
+        self.every(15, lambda: self.timed('/api/metrics'))
+
+    def controller(self):
+        payload = self.timed('/api/pwmOutputs')
+        if payload is None:
+            return
+        state = dict(json.loads(payload)[self.args.pwm_index], index=self.args.pwm_index)
+        body = json.dumps({key: value for key, value in state.items() if key in (
+            'index', 'mode', 'max_duty', 'min_duty', 'ramp_offset', 'target_temperature', 'dewpoint_offset', 'apply_at_startup')})
+        self.every(30, lambda: self.timed('/api/pwmOutput', 'POST', body=body))
+
+    def subscriber(self, name, path):
+        """Server sent events client, reconnecting like EventSource. Records the gaps between events."""
+        record = {'events': 0, 'reconnects': -1, 'max_gap': 0.0, 'bytes': 0}
+        with self.events_lock:
+            self.events[name] = record
+        while not self.stop.is_set():
+            record['reconnects'] += 1
+            connection = self.target.connection()
+            try:
+                connection.request('GET', path, headers={'Accept': 'text/event-stream'})
+                response = connection.getresponse()
+                if response.status != 200:
+                    self.stats.error('/api/events')
+                    self.stop.wait(1)
+                    continue
+                last = time.monotonic()
+                while not self.stop.is_set():
+                    line = response.fp.readline()
+                    if not line:
+                        break
+                    record['bytes'] += len(line)
+                    if line.startswith(b'data:'):
+                        now = time.monotonic()
+                        record['events'] += 1
+                        if record['events'] > 1:
+                            record['max_gap'] = max(record['max_gap'], now - last)
+                        last = now
+            except (OSError, http.client.HTTPException):
+                if not self.stop.is_set():
+                    self.stats.error('/api/events')
+                    self.stop.wait(1)
+            finally:
+                connection.close()
+
+    def run(self):
+        clients = []
+        for index in range(self.args.dashboards):
+            clients.append(threading.Thread(target=self.dashboard, args=(f'dashboard_{index}',), daemon=True))
+        for index in range(self.args.indi):
+            clients.append(threading.Thread(target=self.indi, args=(f'indi_{index}',), daemon=True))
+        for _ in range(self.args.scrapers):
+            clients.append(threading.Thread(target=self.scraper, daemon=True))
+        if self.args.commands:
+            clients.append(threading.Thread(target=self.controller, daemon=True))
+        monitor = Monitor(self.target, self.args.monitor_interval)
+        monitor.sample()
+        started = time.monotonic()
+        for client in clients:
+            client.start()
+        while not self.stop.wait(self.args.monitor_interval):
+            monitor.sample()
+            if time.monotonic() - started >= self.args.seconds:
+                break
+        self.stop.set()
+        elapsed = time.monotonic() - started
+        for client in clients:
+            client.join(self.target.timeout)
+        return elapsed, monitor
+
+
+class Monitor:
+    """Samples the box's heap gauges and control task lateness histograms from /api/metrics, outside of the load stats."""
+
+    def __init__(self, target, interval):
+        self.target = target
+        self.interval = interval
+        self.samples = []
+
+    def sample(self):
+        try:
+            status, payload = self.target.request('GET', '/api/metrics')
+        except (OSError, http.client.HTTPException):
+            return
+        if status != 200:
+            return
+        heap = {}
+        lateness = defaultdict(float)
+        for line in payload.decode(errors='replace').splitlines():
+            match = METRIC_LINE.match(line)
+            if not match:
+                continue
+            name, labels, value = match.groups()
+            if name == 'heap':
+                field = re.search(r'field="(\w+)"', labels)
+                if field:
+                    heap[field.group(1)] = float(value)
+            elif name.startswith('latency_lateness_seconds_') and 'kind="task"' in labels and CONTROL_TASKS.search(labels):
+                bound = re.search(r'le="([^"]+)"', labels)
+                key = (name, bound.group(1) if bound else None)
+                lateness[key] += float(value)
+        self.samples.append((time.monotonic(), heap, lateness))
+
+    def lateness(self):
+        """Lateness of the control tasks during the load: (count, p50, p99, max bucket), from the histogram differences."""
+        if len(self.samples) < 2:
+            return None
+        before, after = self.samples[0][2], self.samples[-1][2]
+        buckets = sorted(((float(bound), after[(name, bound)] - before.get((name, bound), 0))
+            for name, bound in after if name == 'latency_lateness_seconds_bucket'), key=lambda bucket: bucket[0])
+        # Buckets of all the tasks summed by upper bound, cumulative
+        merged = defaultdict(float)
+        for bound, count in buckets:
+            merged[bound] += count
+        bounds = sorted(merged)
+        if not bounds or merged[bounds[-1]] == 0:
+            return None
+        total = merged[bounds[-1]]
+
+        def quantile(fraction):
+            return next(bound for bound in bounds if merged[bound] >= fraction * total)
+        return total, quantile(0.5), quantile(0.99), next((bound for bound in bounds if merged[bound] == total), bounds[-1])
+
+
+def report(test, elapsed, monitor):
+    stats = test.stats
+    print(f'{"route":<20} {"requests":>9} {"errors":>7} {"req/s":>8} {"p50_ms":>9} {"p99_ms":>9} {"max_ms":>9} {"kB/s":>8}')
+    total_requests = total_errors = 0
+    for route in sorted(set(stats.latencies) | set(stats.errors)):
+        latencies = stats.latencies[route]
+        errors = stats.errors[route]
+        total_requests += len(latencies) + errors
+        total_errors += errors
+        print(f'{route:<20} {len(latencies):>9} {errors:>7} {len(latencies) / elapsed:>8.2f} {percentile(latencies, 0.5) * 1000:>9.1f} '
+              f'{percentile(latencies, 0.99) * 1000:>9.1f} {max(latencies, default=math.nan) * 1000:>9.1f} {stats.bytes[route] / elapsed / 1024:>8.1f}')
+    print()
+    print(f'{"subscriber":<20} {"events":>9} {"events/s":>9} {"max_gap_s":>10} {"reconnects":>11}')
+    silent = 0
+    for name, record in sorted(test.events.items()):
+        silent += record['events'] == 0
+        print(f'{name:<20} {record["events"]:>9} {record["events"] / elapsed:>9.2f} {record["max_gap"]:>10.2f} {max(0, record["reconnects"]):>11}')
+    print()
+    heaps = [heap for _, heap, _ in monitor.samples if heap]
+    if heaps:
+        first, last = heaps[0], heaps[-1]
+        low = min(heap.get('free', math.nan) for heap in heaps)
+        fragmentation = max(1 - heap['max_alloc'] / heap['free'] for heap in heaps if heap.get('free') and 'max_alloc' in heap)
+        print(f'heap free: {first.get("free", math.nan):.0f} -> {last.get("free", math.nan):.0f}, lowest {low:.0f}; '
+              f'min_free: {first.get("min_free", math.nan):.0f} -> {last.get("min_free", math.nan):.0f}; '
+              f'max_alloc lowest {min(heap.get("max_alloc", math.nan) for heap in heaps):.0f}, fragmentation up to {fragmentation:.0%}')
+    else:
+        print('heap: /api/metrics not available')
+    lateness = monitor.lateness()
+    if lateness:
+        count, p50, p99, highest = lateness
+        print(f'control task lateness: {count:.0f} runs, p50 <= {p50 * 1000:g}ms, p99 <= {p99 * 1000:g}ms, max <= {highest * 1000:g}ms')
+    if test.args.timeline:
+        print()
+        print(f'{"seconds":>8} {"req/s":>8} {"p99_ms":>9} {"heap_free":>10} {"max_alloc":>10}')
+        started = monitor.samples[0][0]
+        previous = started
+        for at, heap, _ in monitor.samples[1:]:
+            window = [latency for sent, latency in stats.samples if previous <= sent < at]
+            print(f'{at - started:>8.1f} {len(window) / max(at - previous, 1e-9):>8.2f} {percentile(window, 0.99) * 1000:>9.1f} '
+                  f'{heap.get("free", math.nan):>10.0f} {heap.get("max_alloc", math.nan):>10.0f}')
+            previous = at
+    error_rate = total_errors / total_requests if total_requests else 0
+    print(f'\n{total_requests} requests in {elapsed:.1f}s, error rate {error_rate:.2%}')
+    return error_rate <= test.args.max_error_rate and silent == 0
+
+
+class StandIn(ThreadingHTTPServer):
+    """Local imitation of the firmware API: same routes and payload shapes, with a heap shrinking with the open connections,
+    and a control task getting later with the requests in flight, so that the whole report can be exercised without a box."""
+    daemon_threads = True
+    HEAP_SIZE = 320_000
+
+    def __init__(self):
+        super().__init__(('127.0.0.1', 0), StandInHandler)
+        self.lock = threading.Lock()
+        self.started = time.monotonic()
+        self.in_flight = 0
+        self.subscribers = 0
+        self.min_free = self.free()
+        self.pwm_outputs = [{'mode': 'dewpoint', 'max_duty': 1, 'min_duty': 0.1, 'ramp_offset': 2, 'dewpoint_offset': 3, 'duty': 0.4,
+                             'active': True, 'has_temperature': True, 'temperature': 9.5, 'apply_at_startup': False, 'type': 'heater'}]
+        self.pwm_outputs += [{'mode': 'off', 'max_duty': 0, 'duty': 0, 'active': False, 'has_temperature': True, 'temperature': 8.0,
+                              'apply_at_startup': False, 'type': 'heater'} for _ in range(2)]
+        self.bounds = [0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 1]
+        self.lateness = [0] * (len(self.bounds) + 1)
+        self.lateness_sum = 0.0
+        self.stopped = threading.Event()
+        threading.Thread(target=self.control_task, daemon=True).start()
+
+    def free(self):
+        # Event streams hold their request too
+        return 180_000 - 6_000 * (self.in_flight - self.subscribers) - 2_500 * self.subscribers
+
+    def update_heap(self, in_flight=0, subscribers=0):
+        with self.lock:
+            self.in_flight += in_flight
+            self.subscribers += subscribers
+            self.min_free = min(self.min_free, self.free())
+
+    def control_task(self):
+        while not self.stopped.wait(0.1):
+            lateness = random.uniform(0.00005, 0.0002) + 0.002 * (self.in_flight - self.subscribers)
+            with self.lock:
+                self.lateness[next((index for index, bound in enumerate(self.bounds) if lateness <= bound), len(self.bounds))] += 1
+                self.lateness_sum += lateness
+
+    def uptime(self):
+        return time.monotonic() - self.started
+
+    def status(self):
+        return {'ambient': {'temperature': 8.5, 'humidity': 80.1, 'dewpoint': 5.2}, 'power': {'busVoltage': 12.3, 'current': 1.2, 'power': 14.8},
+                'pwmOutputs': self.pwm_outputs, 'app': {'uptime': self.uptime()}}
+
+    def metrics(self):
+        labels = 'source="stand-in"'
+        with self.lock:
+            free, min_free = self.free(), self.min_free
+            buckets, lateness_sum = list(self.lateness), self.lateness_sum
+        lines = [f'heap {{{labels},field="free"}} {free}', f'heap {{{labels},field="size"}} {self.HEAP_SIZE}',
+                 f'heap {{{labels},field="min_free"}} {min_free}', f'heap {{{labels},field="max_alloc"}} {int(free * 0.6)}',
+                 f'uptime {{{labels}}} {self.uptime():f}']
+        series = f'{labels},kind="task",name="pwm_output_0"'
+        cumulative = 0
+        for bound, count in zip(self.bounds + ['+Inf'], buckets):
+            cumulative += count
+            lines.append(f'latency_lateness_seconds_bucket {{{series},le="{bound}"}} {cumulative}')
+        lines.append(f'latency_lateness_seconds_sum {{{series}}} {lateness_sum:f}')
+        lines.append(f'latency_lateness_seconds_count {{{series}}} {cumulative}')
+        return '\n'.join(lines) + '\n'
+
+
+class StandInHandler(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+
+    def log_message(self, *args):
+        pass
+
+    def send(self, body, content_type='application/json', status=200):
+        payload = body if isinstance(body, bytes) else body.encode()
+        self.send_response(status)
+        self.send_header('Content-Type', content_type)
+        self.send_header('Content-Length', str(len(payload)))
+        self.send_header('Connection', 'close')
+        self.end_headers()
+        self.wfile.write(payload)
+        self.close_connection = True
+
+    def handle_one_request(self):
+        self.server.update_heap(in_flight=1)
+        try:
+            super().handle_one_request()
+        finally:
+            self.server.update_heap(in_flight=-1)
+
+    def do_GET(self):
+        server = self.server
+        path = self.path.split('?')[0]
+        if path == '/api/status':
+            self.send(json.dumps({'status': 'ok', 'uptime': server.uptime(), 'has_power_monitor': True, 'has_ambient_sensor': True,
+                                  'has_serial': False, 'pdVoltageRequested': 12}))
+        elif path == '/api/history':
+            entry = {'ambientTemperature': 8.5, 'ambientHumidity': 80.1, 'ambientDewpoint': 5.2, 'busVoltage': 12.3, 'power': 14.8, 'current': 1.2,
+                     'pwmOutputs': [{'duty': 102, 'temperature': 9.5}] * len(server.pwm_outputs)}
+            self.send(json.dumps({'now': int(server.uptime()), 'entries': [dict(entry, uptime=index * 10) for index in range(300)]}))
+        elif path == '/api/metrics':
+            self.send(server.metrics(), 'text/plain; version=0.0.4')
+        elif path == '/api/pwmOutputs':
+            self.send(json.dumps(server.pwm_outputs))
+        elif path == '/api/events':
+            self.events()
+        else:
+            self.send(json.dumps({'error': 'not found'}), status=404)
+
+    def do_POST(self):
+        server = self.server
+        if self.path != '/api/pwmOutput':
+            self.send(json.dumps({'error': 'not found'}), status=404)
+            return
+        try:
+            command = json.loads(self.rfile.read(int(self.headers.get('Content-Length', 0))))
+            index = int(command['index'])
+            server.pwm_outputs[index].update({key: value for key, value in command.items() if key != 'index'})
+        except (ValueError, KeyError, IndexError, TypeError):
+            self.send(json.dumps({'error': 'invalid command'}), status=400)
+            return
+        self.send(json.dumps(server.pwm_outputs))
+
+    def events(self):
+        """Status keyframes and deltas every `interval` milliseconds, like APB::StatusEvents."""
+        query = dict(parameter.partition('=')[::2] for parameter in self.path.partition('?')[2].split('&') if parameter)
+        try:
+            interval = min(max(int(query.get('interval', 1000)), 1000), 60000) / 1000
+        except ValueError:
+            interval = 1
+        self.send_response(200)
+        self.send_header('Content-Type', 'text/event-stream')
+        self.send_header('Cache-Control', 'no-cache')
+        self.end_headers()
+        self.close_connection = True
+        self.server.update_heap(subscribers=1)
+        try:
+            sent = 0
+            while not self.server.stopped.is_set():
+                status = self.server.status()
+                event, data = ('status', status) if sent % 30 == 0 else ('delta', {'app': status['app']})
+                self.wfile.write(f'id: {int(self.server.uptime() * 1000)}\nevent: {event}\nretry: 5000\ndata: {json.dumps(data)}\n\n'.encode())
+                self.wfile.flush()
+                sent += 1
+                self.server.stopped.wait(interval)
+        except OSError:
+            pass
+        finally:
+            self.server.update_heap(subscribers=-1)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('host', nargs='?', help='box address, host[:port]')
+    parser.add_argument('--stand-in', action='store_true', help='run against a local imitation of the firmware API')
+    parser.add_argument('--seconds', type=float, default=60)
+    parser.add_argument('--dashboards', type=int, default=2, help='web UI clients: events, status and history')
+    parser.add_argument('--scrapers', type=int, default=1, help='/api/metrics scrapers')
+    parser.add_argument('--indi', type=int, default=1, help='INDI clients: events every 5s')
+    parser.add_argument('--commands', type=int, default=1, choices=(0, 1), help='re-apply the state of a PWM output with POSTs')
+    parser.add_argument('--pwm-index', type=int, default=0, help='PWM output whose state is re-applied')
+    parser.add_argument('--speedup', type=float, default=1, help='divides the polling periods of all the clients')
+    parser.add_argument('--monitor-interval', type=float, default=5, help='seconds between samples of the box metrics')
+    parser.add_argument('--timeout', type=float, default=10, help='seconds before a request fails')
+    parser.add_argument('--max-error-rate', type=float, default=0.01)
+    parser.add_argument('--timeline', action='store_true', help='print request rate, latency and heap for every monitor sample')
+    args = parser.parse_args()
+    if bool(args.host) == args.stand_in:
+        parser.error('either a host or --stand-in is required')
+
+    stand_in = None
+    if args.stand_in:
+        stand_in = StandIn()
+        threading.Thread(target=stand_in.serve_forever, daemon=True).start()
+        host, port = stand_in.server_address
+    else:
+        host, _, port = args.host.partition(':')
+        port = int(port or 80)
+    test = LoadTest(Target(host, port, args.timeout), args)
+    elapsed, monitor = test.run()
+    if stand_in:
+        stand_in.stopped.set()
+        stand_in.shutdown()
+    return 0 if report(test, elapsed, monitor) else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
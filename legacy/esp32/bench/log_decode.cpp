@@ -0,0 +1,29 @@
+// Formats a binary log from a box, see src/binary_log.h, on the host.
+// Download it with `curl -o box.binlog http://<box>/api/logs/binary`, then run `bench/native.sh log_decode box.binlog`.
+// The decoder must be built from the same firmware sources as the box, as the log only holds format ids.
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include "binary_log.h"
+
+using APB::BinaryLog;
+
+int main(int argc, char **argv) {
+    if(argc < 2) {
+        fprintf(stderr, "usage: %s <log file>\n", argv[0]);
+        return 1;
+    }
+    std::ifstream stream{argv[1], std::ios::binary};
+    const std::vector<uint8_t> bytes{std::istreambuf_iterator<char>{stream}, std::istreambuf_iterator<char>{}};
+    size_t lines = 0;
+    if(!BinaryLog::decode(bytes.data(), bytes.size(), [&lines](const char *line) { fputs(line, stdout); lines++; })) {
+        fprintf(stderr, "%s: not a binary log of this firmware version\n", argv[1]);
+        return 1;
+    }
+    BinaryLog::Header header;
+    memcpy(&header, bytes.data(), sizeof(header));
+    fprintf(stderr, "%zu records up to %.1fs, %u dropped\n", lines, header.timestamp / 1000.0, header.dropped);
+    return 0;
+}
@@ -0,0 +1,28 @@
+#!/bin/bash
+# Builds a host program in bench/ with the sources and flags of the `native` environment, with optimisations, and runs it.
+#   bench/native.sh firmware_bench [previous run]: microbenchmarks of the firmware hot paths. Save a run, and pass it
+#     to a later one to print the change of every benchmark, i.e. `bench/native.sh firmware_bench > before.txt`
+#   bench/native.sh thermal_sim [hours]: control quality of the PWM output modes on a simulated dew heater
+#   bench/native.sh trace_replay <trace file> [--steps]: replays a control trace from /api/trace
+#   bench/native.sh log_decode <log file>: formats a binary log from /api/logs/binary
+set -e
+PROGRAM="${1:?usage: $0 <firmware_bench|thermal_sim|trace_replay|log_decode> [arguments]}"
+shift
+cd "$(dirname "$0")/.."
+ARDUINOJSON=.pio/libdeps/native/ArduinoJson/src
+[ -d "$ARDUINOJSON" ] || pio pkg install -e native >&2
+
+native_env() {
+    sed -n '/^\[env:native\]/,/^\[/p' platformio.ini
+}
+FLAGS="$(native_env | grep -E '^\s+-[DI]' | tr -d '\t' | tr '\n' ' ')"
+SOURCES="$(native_env | grep -oP '^\s+\+<\K[^>]+' | sed 's|^|src/|' | tr '\n' ' ')"
+
+# The benchmarks count the heap allocations of the firmware code, C ones included
+LDFLAGS=""
+[ "$PROGRAM" = firmware_bench ] && LDFLAGS="-Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc"
+
+mkdir -p .pio
+g++ -O2 -std=gnu++2a $FLAGS -Ilib/native_shims/include -I"$ARDUINOJSON" \
+    $SOURCES lib/native_shims/src/*.cpp "bench/$PROGRAM.cpp" $LDFLAGS -o ".pio/$PROGRAM"
+".pio/$PROGRAM" "$@"
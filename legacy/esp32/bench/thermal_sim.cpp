@@ -0,0 +1,52 @@
+// Control quality of the PWM output modes on a simulated dew heater, see bench/thermal_simulation.h.
+// Scores each scenario on overshoot, settling time and RMS error against its setpoint, energy used,
+// and how close the lens got to the dewpoint. Build and run with `bench/native.sh thermal_sim [hours]`.
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "thermal_simulation.h"
+
+using APB::Simulation::Scenario;
+
+namespace {
+// Heater and lens of a small refractor, in a light breeze
+constexpr Native::ThermalPlant::Parameters Refractor{};
+constexpr Native::ThermalPlant::Parameters Windy{10, 30, 400, 5};
+constexpr Native::ThermalPlant::Parameters Weak{5, 30, 400, 1};
+
+const std::vector<Scenario> scenarios{
+    {"off", R"({"mode":"off"})", Refractor},
+    {"fixed duty=0.3", R"({"mode":"fixed","max_duty":0.3})", Refractor},
+    {"target=15", R"({"mode":"target_temperature","target_temperature":15,"max_duty":1})", Refractor},
+    {"target=15 ramp=2", R"({"mode":"target_temperature","target_temperature":15,"max_duty":1,"ramp_offset":2})", Refractor},
+    {"target=15 ramp=2 min=0.2", R"({"mode":"target_temperature","target_temperature":15,"max_duty":1,"ramp_offset":2,"min_duty":0.2})", Refractor},
+    {"dewpoint+2", R"({"mode":"dewpoint","dewpoint_offset":2,"max_duty":1})", Refractor},
+    {"dewpoint+2 ramp=1", R"({"mode":"dewpoint","dewpoint_offset":2,"max_duty":1,"ramp_offset":1})", Refractor},
+    {"dewpoint+2 ramp=5", R"({"mode":"dewpoint","dewpoint_offset":2,"max_duty":1,"ramp_offset":5})", Refractor},
+    {"dewpoint+2 ramp=2 min=0.1", R"({"mode":"dewpoint","dewpoint_offset":2,"max_duty":1,"ramp_offset":2,"min_duty":0.1})", Refractor},
+    {"dewpoint+5", R"({"mode":"dewpoint","dewpoint_offset":5,"max_duty":1})", Refractor},
+    {"dewpoint+5 ramp=2", R"({"mode":"dewpoint","dewpoint_offset":5,"max_duty":1,"ramp_offset":2})", Refractor},
+    {"windy dewpoint+2", R"({"mode":"dewpoint","dewpoint_offset":2,"max_duty":1})", Windy},
+    {"windy dewpoint+2 ramp=2", R"({"mode":"dewpoint","dewpoint_offset":2,"max_duty":1,"ramp_offset":2})", Windy},
+    {"weak heater dewpoint+5 max=0.5", R"({"mode":"dewpoint","dewpoint_offset":5,"max_duty":0.5})", Weak},
+};
+}
+
+int main(int argc, char **argv) {
+    const float hours = argc > 1 ? std::atof(argv[1]) : 4;
+    APB::Simulation::Simulator simulator;
+    printf("%-32s %9s %10s %7s %9s %10s %7s\n", "scenario", "overshoot", "settling_s", "rms", "energy_Wh", "dew_margin", "dew_s");
+    for(Scenario scenario: scenarios) {
+        scenario.night.hours = hours;
+        const auto result = simulator.run(scenario);
+        const auto &score = result.score;
+        // No setpoint for the off and fixed modes
+        if(!score.hasSetpoint()) {
+            printf("%-32s %9s %10s %7s", scenario.name, "-", "-", "-");
+        } else {
+            printf("%-32s %9.2f %10.0f %7.2f", scenario.name, score.overshoot(), score.settlingSeconds(), score.rmsError());
+        }
+        printf(" %9.2f %10.2f %7.0f\n", result.energyWattHours, score.minDewMargin(), score.dewSeconds());
+    }
+    return 0;
+}
@@ -0,0 +1,116 @@
+#pragma once
+// Closed loop simulation of a PWM output driving a dew heater through a night, faster than real time.
+// The real Ambient and PWMOutput code runs against simulated sensors: an SHT4x following the night profile,
+// and the thermistor of a Native::ThermalPlant heated by the PWM pin. Used by bench/thermal_sim.cpp and test_thermal_control.
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <native.h>
+#include <native_devices.h>
+#include <native_thermal.h>
+#include "ambient/ambient.h"
+#include "pwm_output.h"
+#include "i2c_wire.h"
+
+namespace APB::Simulation {
+
+// Linear ambient drift over the night, i.e. cooling down while the humidity rises
+struct Night {
+    float hours = 4;
+    float startTemperature = 8;
+    float endTemperature = 2;
+    float startHumidity = 85;
+    float endHumidity = 95;
+
+    float temperature(float seconds) const { return interpolate(startTemperature, endTemperature, seconds); }
+    float humidity(float seconds) const { return interpolate(startHumidity, endHumidity, seconds); }
+    float dewpoint(float seconds) const { return Ambient::calculateDewpoint(temperature(seconds), humidity(seconds)); }
+private:
+    float interpolate(float start, float end, float seconds) const {
+        return start + (end - start) * std::min(1.f, seconds / (hours * 3600));
+    }
+};
+
+struct Scenario {
+    const char *name;
+    // Output state, as posted to /api/pwmOutput
+    const char *state;
+    Native::ThermalPlant::Parameters plant;
+    Night night;
+};
+
+struct Result {
+    Native::ControlScore score;
+    float energyWattHours;
+};
+
+// Output 0 of the S2 mini pinout, with the firmware thermistor configuration
+class Simulator {
+public:
+    static constexpr uint8_t HeaterPin = 5;
+    static constexpr uint8_t ThermistorPin = 1;
+    static constexpr float StepSeconds = 0.1;
+
+    // Sets up the firmware singletons, once per process
+    Simulator() {
+        Native::attachI2CDevice(0x44, &sht4x);
+        I2C::begin();
+        Ambient::Instance.setup(scheduler);
+        PWMOutputs::Instance[0].setup(0, scheduler);
+    }
+
+    Result run(const Scenario &scenario) {
+        Native::ThermalPlant plant{scenario.plant, {
+            ThermistorPin,
+            APB_PWM_OUTPUT_TEMPERATURE_SENSOR_THERMISTOR_NOMINAL,
+            APB_PWM_OUTPUT_TEMPERATURE_SENSOR_THERMISTOR_REFERENCE,
+            APB_PWM_OUTPUT_TEMPERATURE_SENSOR_THERMISTOR_B_VALUE,
+            APB_PWM_OUTPUT_TEMPERATURE_SENSOR_THERMISTOR_NOMINAL_TEMP,
+            12,
+        }, HeaterPin};
+        const Night &night = scenario.night;
+        setState(R"({"mode":"off"})");
+        plant.reset(night.temperature(0));
+        setAmbient(night, 0);
+        // Sensors and control loop settle on the initial conditions
+        for(int second = 0; second < 60; second++) {
+            Native::advance(1000);
+            scheduler.execute();
+        }
+        JsonDocument state;
+        deserializeJson(state, scenario.state);
+        // NaN when the scenario doesn't set them, so that the setpoint is NaN in the modes with neither
+        const float target = state["target_temperature"] | std::numeric_limits<float>::quiet_NaN();
+        const float dewpointOffset = state["dewpoint_offset"] | std::numeric_limits<float>::quiet_NaN();
+        PWMOutputs::Instance[0].setState(state.as<JsonObject>());
+
+        Result result;
+        const float duration = night.hours * 3600;
+        for(float elapsed = 0; elapsed < duration; elapsed += StepSeconds) {
+            setAmbient(night, elapsed);
+            plant.step(StepSeconds, night.temperature(elapsed));
+            Native::advanceMicros(StepSeconds * 1'000'000);
+            scheduler.execute();
+            const float dewpoint = night.dewpoint(elapsed);
+            const float setpoint = std::isnan(target) ? dewpoint + dewpointOffset : target;
+            result.score.add(StepSeconds, elapsed, setpoint, plant.strapTemperature(), plant.lensTemperature(), dewpoint);
+        }
+        result.energyWattHours = plant.energyWattHours();
+        return result;
+    }
+private:
+    Native::SHT4xDevice sht4x;
+    Scheduler scheduler;
+
+    void setAmbient(const Night &night, float seconds) {
+        sht4x.temperature = night.temperature(seconds);
+        sht4x.humidity = night.humidity(seconds);
+    }
+
+    void setState(const char *json) {
+        JsonDocument doc;
+        deserializeJson(doc, json);
+        PWMOutputs::Instance[0].setState(doc.as<JsonObject>());
+    }
+};
+}
@@ -0,0 +1,60 @@
+// Replays a control trace from a box on the host, see bench/trace_replay.h, and compares the control steps with the recorded ones.
+// Download the trace with `curl -o box.trace http://<box>/api/trace`, then run `bench/native.sh trace_replay box.trace [--steps]`.
+// Firmware warnings and errors, i.e. lost sensors, are printed as they happen during the replay; --steps prints every control step.
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <ArduinoLog.h>
+#include "trace_replay.h"
+
+using APB::Simulation::TraceFile;
+using APB::Simulation::TraceReplay;
+
+namespace {
+class StandardOutput : public Print {
+public:
+    size_t write(uint8_t c) override { return fwrite(&c, 1, 1, stdout); }
+    size_t write(const uint8_t *buffer, size_t size) override { return fwrite(buffer, 1, size, stdout); }
+};
+}
+
+int main(int argc, char **argv) {
+    if(argc < 2) {
+        fprintf(stderr, "usage: %s <trace file> [--steps]\n", argv[0]);
+        return 1;
+    }
+    const bool printSteps = argc > 2 && strcmp(argv[2], "--steps") == 0;
+    std::ifstream stream{argv[1], std::ios::binary};
+    const std::vector<uint8_t> bytes{std::istreambuf_iterator<char>{stream}, std::istreambuf_iterator<char>{}};
+    const auto file = TraceFile::parse(bytes);
+    if(!file) {
+        fprintf(stderr, "%s: not a trace of this firmware version\n", argv[1]);
+        return 1;
+    }
+    if(file->records.empty()) {
+        printf("Empty trace\n");
+        return 0;
+    }
+    printf("%zu records from %.1fs to %.1fs, %u dropped, %zu ambient sensors\n", file->records.size(),
+        file->records.front().timestamp / 1000.0, file->records.back().timestamp / 1000.0, file->header.dropped, file->ambientSensors());
+
+    static StandardOutput output;
+    static TraceReplay replay{file->ambientSensors()};
+    Log.begin(LOG_LEVEL_WARNING, &output);
+    const auto result = replay.run(file->records);
+
+    if(printSteps) {
+        printf("%10s %6s %12s %12s %12s %12s %18s\n", "seconds", "output", "recorded_pwm", "replayed_pwm", "recorded_°C", "replayed_°C", "replayed_mode");
+        for(const auto &step: result.steps) {
+            printf("%10.1f %6d %12d %12d %12.2f %12.2f %18s\n", step.timestamp / 1000.0, step.index, step.recordedPWM, step.replayedPWM,
+                step.recordedTemperature, step.replayedTemperature.value_or(NAN), TraceReplay::modeName(step.replayedMode));
+        }
+    }
+    printf("%zu control steps, %zu mismatches", result.steps.size(), result.mismatches);
+    if(result.firstMismatch) {
+        printf(", first at %.1fs", *result.firstMismatch / 1000.0);
+    }
+    printf("\n");
+    return result.mismatches > 0 ? 2 : 0;
+}
@@ -0,0 +1,245 @@
+#pragma once
+// Replay of a control trace downloaded from /api/trace (see src/trace.h) against the firmware Ambient and PWMOutput code,
+// on the virtual clock. The recorded ambient readings drive simulated SHT4x sensors, the thermistor ADC readings the analog
+// inputs, and the commands go through PWMOutput::setState. Used by bench/trace_replay.cpp and test_trace.
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <optional>
+#include <vector>
+#include <native.h>
+#include <native_devices.h>
+#include "ambient/ambient.h"
+#include "pwm_output.h"
+#include "i2c_wire.h"
+#include "trace.h"
+
+namespace APB::Simulation {
+
+struct TraceFile {
+    Trace::Header header;
+    std::vector<Trace::Record> records;
+
+    // Parses a download, nothing if the header doesn't match this build
+    static std::optional<TraceFile> parse(const std::vector<uint8_t> &bytes) {
+        TraceFile file;
+        if(bytes.size() < sizeof(Trace::Header)) {
+            return {};
+        }
+        memcpy(&file.header, bytes.data(), sizeof(Trace::Header));
+        if(memcmp(file.header.magic, Trace::Header{}.magic, 4) != 0 || file.header.version != Trace::Header{}.version || file.header.recordSize != sizeof(Trace::Record)) {
+            return {};
+        }
+        file.records.resize((bytes.size() - sizeof(Trace::Header)) / sizeof(Trace::Record));
+        memcpy(file.records.data(), bytes.data() + sizeof(Trace::Header), file.records.size() * sizeof(Trace::Record));
+        // Commands evicted from the ring come first, with older timestamps
+        std::stable_sort(file.records.begin(), file.records.end(), [](const auto &a, const auto &b) { return a.timestamp < b.timestamp; });
+        return file;
+    }
+
+    size_t ambientSensors() const {
+        size_t sensors = 0;
+        for(const auto &record: records) {
+            if(record.type == Trace::Type::Ambient) {
+                sensors = std::max<size_t>(sensors, record.index + 1);
+            }
+        }
+        return sensors;
+    }
+};
+
+class TraceReplay {
+public:
+    // Recorded and replayed control step of an output, at the recorded time
+    struct Step {
+        uint32_t timestamp;
+        uint8_t index;
+        uint16_t recordedPWM;
+        float recordedTemperature;
+        uint16_t replayedPWM;
+        std::optional<float> replayedTemperature;
+        PWMOutput::Mode replayedMode;
+    };
+    struct Result {
+        std::vector<Step> steps;
+        size_t mismatches = 0;
+        std::optional<uint32_t> firstMismatch;
+    };
+    // Steps further apart than this are reported as mismatches
+    static constexpr int PWMTolerance = 3;
+    static constexpr float TemperatureTolerance = 0.5;
+
+    // Sets up the firmware singletons with `ambientSensors` sensors, once per process
+    TraceReplay(size_t ambientSensors) {
+        static const uint8_t addresses[] = APB_AMBIENT_SENSOR_ADDRESSES;
+        for(size_t sensor = 0; sensor < std::min(ambientSensors, std::size(addresses)); sensor++) {
+            Native::attachI2CDevice(addresses[sensor], &sht4x[sensor]);
+        }
+        I2C::begin();
+        Ambient::Instance.setup(scheduler);
+        for(uint8_t index = 0; index < PWMOutputs::Instance.size(); index++) {
+            PWMOutputs::Instance[index].setup(index, scheduler);
+        }
+        PWMOutputs::samples.subscribe([this](const PWMOutputs::Sample &sample) { replayed[sample.index].push_back({static_cast<uint32_t>(millis()), sample}); });
+    }
+
+    static const char *modeName(PWMOutput::Mode mode) {
+        switch(mode) {
+        case PWMOutput::fixed:
+            return "fixed";
+        case PWMOutput::target_temperature:
+            return "target_temperature";
+        case PWMOutput::dewpoint:
+            return "dewpoint";
+        default:
+            return "off";
+        }
+    }
+
+    Result run(const std::vector<Trace::Record> &records) {
+        Result result;
+        if(records.empty()) {
+            return result;
+        }
+        for(auto &output: replayed) {
+            output.clear();
+        }
+        prime(records);
+        const int64_t offset = static_cast<int64_t>(millis()) - records.front().timestamp;
+        std::optional<Trace::Record> command;
+        std::vector<const Trace::Record*> outputs;
+        for(const auto &record: records) {
+            advanceTo(record.timestamp + offset);
+            switch(record.type) {
+            case Trace::Type::Ambient:
+                apply(record);
+                break;
+            case Trace::Type::Thermistor:
+                apply(record);
+                break;
+            case Trace::Type::Command:
+                command = record;
+                break;
+            case Trace::Type::Setpoint:
+                if(command && command->index == record.index) {
+                    applyCommand(*command, record);
+                }
+                command.reset();
+                break;
+            case Trace::Type::Output:
+                outputs.push_back(&record);
+                break;
+            }
+        }
+        for(const Trace::Record *output: outputs) {
+            const Step step = compare(*output, output->timestamp + offset);
+            if(!matches(step)) {
+                result.mismatches++;
+                result.firstMismatch = result.firstMismatch.value_or(output->timestamp);
+            }
+            result.steps.push_back(step);
+        }
+        return result;
+    }
+private:
+    struct ReplayedSample {
+        uint32_t timestamp;
+        PWMOutputs::Sample sample;
+    };
+    std::array<Native::SHT4xDevice, 3> sht4x;
+    // Every control step of the replay, by output
+    std::array<std::vector<ReplayedSample>, APB_PWM_OUTPUTS_SIZE> replayed;
+    Scheduler scheduler;
+
+    void advanceTo(uint32_t timestamp) {
+        // Small steps, so that tasks run close to their scheduled time
+        while(static_cast<int32_t>(timestamp - millis()) > 0) {
+            Native::advance(std::min<uint32_t>(timestamp - millis(), 100));
+            scheduler.execute();
+        }
+    }
+
+    void apply(const Trace::Record &record) {
+        if(record.type == Trace::Type::Ambient && record.index < sht4x.size()) {
+            sht4x[record.index].offline = std::isnan(record.values[0]);
+            if(!sht4x[record.index].offline) {
+                sht4x[record.index].temperature = record.values[0];
+                sht4x[record.index].humidity = record.values[1];
+            }
+        }
+        if(record.type == Trace::Type::Thermistor && record.index < PWMOutputs::Instance.size()) {
+            const int8_t pin = PWMOutputs::Instance[record.index].thermistorPin();
+            if(pin >= 0) {
+                Native::setAnalogRead(pin, record.value);
+            }
+        }
+    }
+
+    void applyCommand(const Trace::Record &command, const Trace::Record &setpoint) {
+        if(command.index >= PWMOutputs::Instance.size()) {
+            return;
+        }
+        JsonDocument state;
+        const auto mode = static_cast<PWMOutput::Mode>(command.value);
+        state["mode"] = modeName(mode);
+        state["max_duty"] = command.values[0];
+        state["min_duty"] = command.values[1];
+        state["ramp_offset"] = setpoint.values[1];
+        state[mode == PWMOutput::dewpoint ? "dewpoint_offset" : "target_temperature"] = setpoint.values[0];
+        PWMOutputs::Instance[command.index].setState(state.as<JsonObject>());
+    }
+
+    // Starts from the first recorded inputs, so that the outputs have a temperature and the ambient a reading for the first command
+    void prime(const std::vector<Trace::Record> &records) {
+        for(auto &output: PWMOutputs::Instance) {
+            JsonDocument off;
+            off["mode"] = "off";
+            output.setState(off.as<JsonObject>());
+        }
+        std::array<bool, APB_PWM_OUTPUTS_SIZE> thermistors{};
+        std::array<bool, 3> ambient{};
+        for(const auto &record: records) {
+            if(record.type == Trace::Type::Thermistor && record.index < thermistors.size() && !thermistors[record.index]) {
+                thermistors[record.index] = true;
+                apply(record);
+            }
+            if(record.type == Trace::Type::Ambient && record.index < ambient.size() && !ambient[record.index]) {
+                ambient[record.index] = true;
+                apply(record);
+            }
+        }
+        advanceTo(millis() + APB_AMBIENT_SAMPLING_MAX_MS + APB_PWM_OUTPUT_SAMPLING_MAX_MS);
+    }
+
+    static bool matches(const Step &step) {
+        return std::abs(step.replayedPWM - step.recordedPWM) <= PWMTolerance &&
+            step.replayedTemperature.has_value() != std::isnan(step.recordedTemperature) &&
+            (!step.replayedTemperature || std::abs(*step.replayedTemperature - step.recordedTemperature) <= TemperatureTolerance);
+    }
+
+    // Control steps don't run at exactly the same times as on the device, so a recorded step is compared to the replayed steps
+    // right before and right after it, i.e. the replay may see a new input one step earlier or later.
+    Step compare(const Trace::Record &output, uint32_t replayTimestamp) const {
+        Step step{output.timestamp, output.index, output.value, output.values[0], 0, std::nullopt, PWMOutput::off};
+        const auto &samples = replayed[output.index];
+        const auto after = std::upper_bound(samples.begin(), samples.end(), replayTimestamp, [](uint32_t timestamp, const auto &sample) {
+            return timestamp < sample.timestamp;
+        });
+        std::optional<Step> candidate;
+        for(auto sample: {after == samples.begin() ? samples.end() : std::prev(after), after}) {
+            if(sample == samples.end()) {
+                continue;
+            }
+            Step replayedStep = step;
+            replayedStep.replayedPWM = std::lround(sample->sample.duty * 255);
+            replayedStep.replayedTemperature = sample->sample.temperature;
+            replayedStep.replayedMode = sample->sample.mode;
+            if(!candidate || matches(replayedStep)) {
+                candidate = replayedStep;
+            }
+        }
+        return candidate.value_or(step);
+    }
+};
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "Arduino.h"
+
+#define LOG_LEVEL_SILENT 0
+#define LOG_LEVEL_FATAL 1
+#define LOG_LEVEL_ERROR 2
+#define LOG_LEVEL_WARNING 3
+#define LOG_LEVEL_INFO 4
+#define LOG_LEVEL_NOTICE 4
+#define LOG_LEVEL_TRACE 5
+#define LOG_LEVEL_VERBOSE 6
+
+// ArduinoLog formatting (%d, %s, %F, %T, ...), silent until begin() is called, so tests and benchmarks don't pay for it.
+class Logging {
+public:
+    void begin(int level, Print *output, bool showLevel = true);
+    void setLevel(int level) { this->level = level; }
+    int getLevel() const { return level; }
+
+    template<class... Args> void fatal(const char *format, Args... args) { print(LOG_LEVEL_FATAL, false, format, args...); }
+    template<class... Args> void fatalln(const char *format, Args... args) { print(LOG_LEVEL_FATAL, true, format, args...); }
+    template<class... Args> void error(const char *format, Args... args) { print(LOG_LEVEL_ERROR, false, format, args...); }
+    template<class... Args> void errorln(const char *format, Args... args) { print(LOG_LEVEL_ERROR, true, format, args...); }
+    template<class... Args> void warning(const char *format, Args... args) { print(LOG_LEVEL_WARNING, false, format, args...); }
+    template<class... Args> void warningln(const char *format, Args... args) { print(LOG_LEVEL_WARNING, true, format, args...); }
+    template<class... Args> void notice(const char *format, Args... args) { print(LOG_LEVEL_NOTICE, false, format, args...); }
+    template<class... Args> void noticeln(const char *format, Args... args) { print(LOG_LEVEL_NOTICE, true, format, args...); }
+    template<class... Args> void info(const char *format, Args... args) { print(LOG_LEVEL_INFO, false, format, args...); }
+    template<class... Args> void infoln(const char *format, Args... args) { print(LOG_LEVEL_INFO, true, format, args...); }
+    template<class... Args> void trace(const char *format, Args... args) { print(LOG_LEVEL_TRACE, false, format, args...); }
+    template<class... Args> void traceln(const char *format, Args... args) { print(LOG_LEVEL_TRACE, true, format, args...); }
+    template<class... Args> void verbose(const char *format, Args... args) { print(LOG_LEVEL_VERBOSE, false, format, args...); }
+    template<class... Args> void verboseln(const char *format, Args... args) { print(LOG_LEVEL_VERBOSE, true, format, args...); }
+private:
+    int level = LOG_LEVEL_SILENT;
+    Print *output = nullptr;
+    bool showLevel = true;
+
+    template<class... Args> void print(int level, bool newLine, const char *format, Args... args) {
+        if(level > this->level || !output) {
+            return;
+        }
+        printFormat(level, newLine, format, args...);
+    }
+    void printFormat(int level, bool newLine, const char *format, ...);
+};
+
+extern Logging Log;
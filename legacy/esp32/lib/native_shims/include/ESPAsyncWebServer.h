@@ -0,0 +1,98 @@
+#pragma once
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include "Arduino.h"
+
+// Server Sent Events subset of ESPAsyncWebServer. There is no network: the host code connects clients with
+// AsyncEventSource::connect(), and the events they are sent are counted in memory.
+
+// Returned by a chunked response callback that has nothing to write yet: it is called again instead of ending the response
+#define RESPONSE_TRY_AGAIN 0xFFFFFFFF
+
+class IPAddress {
+public:
+    String toString() const { return "127.0.0.1"; }
+};
+
+class AsyncClient {
+public:
+    IPAddress remoteIP() const { return {}; }
+};
+
+class AsyncWebParameter {
+public:
+    AsyncWebParameter(const String &value) : _value{value} {}
+    const String &value() const { return _value; }
+private:
+    String _value;
+};
+
+class AsyncWebServerRequest {
+public:
+    // Query parameters, i.e. `topics` and `interval` for /api/events
+    std::map<std::string, AsyncWebParameter> params;
+    bool hasParam(const char *name) const { return params.count(name) > 0; }
+    const AsyncWebParameter *getParam(const char *name) const;
+    AsyncClient *client() { return &_client; }
+private:
+    AsyncClient _client;
+};
+
+using AsyncEvent_SharedData_t = std::shared_ptr<String>;
+
+class AsyncEventSourceClient {
+public:
+    AsyncEventSourceClient(AsyncClient *client, uint32_t lastId = 0) : _client{client}, _lastId{lastId} {}
+    AsyncClient *client() { return _client; }
+    uint32_t lastId() const { return _lastId; }
+    // Messages are delivered right away
+    size_t packetsWaiting() const { return 0; }
+    bool write(AsyncEvent_SharedData_t message);
+
+    size_t messages = 0;
+    size_t bytes = 0;
+    AsyncEvent_SharedData_t lastMessage;
+private:
+    AsyncClient *_client;
+    uint32_t _lastId;
+};
+
+class AsyncWebHandler {
+public:
+    virtual ~AsyncWebHandler() = default;
+};
+
+class AsyncEventSource : public AsyncWebHandler {
+public:
+    using AuthorizeConnectHandler = std::function<bool(AsyncWebServerRequest *request)>;
+    using EventHandler = std::function<void(AsyncEventSourceClient *client)>;
+
+    AsyncEventSource(const String &url) : _url{url} {}
+    const char *url() const { return _url.c_str(); }
+    void authorizeConnect(AuthorizeConnectHandler handler) { authorizeHandler = handler; }
+    void onConnect(EventHandler handler) { connectHandler = handler; }
+    void onDisconnect(EventHandler handler) { disconnectHandler = handler; }
+    size_t count() const { return clients.size(); }
+
+    // Runs the handlers of a new request, returns the client, or nullptr if the request wasn't authorized.
+    AsyncEventSourceClient *connect(AsyncWebServerRequest &request, uint32_t lastId = 0);
+    void disconnect(AsyncEventSourceClient *client);
+private:
+    String _url;
+    AuthorizeConnectHandler authorizeHandler;
+    EventHandler connectHandler;
+    EventHandler disconnectHandler;
+    std::list<AsyncEventSourceClient> clients;
+};
+
+class AsyncWebServer {
+public:
+    AsyncWebServer(uint16_t port = 80) {}
+    AsyncWebHandler &addHandler(AsyncWebHandler *handler) { handlers.push_back(handler); return *handler; }
+    const std::list<AsyncWebHandler*> &handlersList() const { return handlers; }
+private:
+    std::list<AsyncWebHandler*> handlers;
+};
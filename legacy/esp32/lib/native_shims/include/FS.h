@@ -0,0 +1,53 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <string>
+#include "Arduino.h"
+
+// In-memory filesystem with the Arduino ESP32 FS interface
+namespace fs {
+
+class File : public Stream {
+public:
+    File() = default;
+    File(const std::string &path, std::shared_ptr<std::string> content, bool writable);
+    explicit operator bool() const { return content != nullptr; }
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t size() const { return content ? content->size() : 0; }
+    size_t position() const { return offset; }
+    bool seek(size_t position);
+    const char *path() const { return _path.c_str(); }
+    const char *name() const;
+    void close() { content.reset(); }
+private:
+    std::string _path;
+    std::shared_ptr<std::string> content;
+    size_t offset = 0;
+    bool writable = false;
+};
+
+class FS {
+public:
+    File open(const char *path, const char *mode = "r", bool create = false);
+    File open(const String &path, const char *mode = "r", bool create = false) { return open(path.c_str(), mode, create); }
+    bool exists(const char *path) const;
+    bool exists(const String &path) const { return exists(path.c_str()); }
+    bool remove(const char *path);
+    bool remove(const String &path) { return remove(path.c_str()); }
+    bool rename(const char *from, const char *to);
+    bool mkdir(const char *) { return true; }
+    bool mkdir(const String &) { return true; }
+    bool rmdir(const char *) { return true; }
+    // Removes every file, see Native::reset()
+    void clear() { files.clear(); }
+private:
+    std::map<std::string, std::shared_ptr<std::string>> files;
+};
+}
+
+using fs::File;
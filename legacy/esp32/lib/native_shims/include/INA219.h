@@ -0,0 +1,28 @@
+#pragma once
+#include "Wire.h"
+
+// robtillaart/INA219 configuration subset: the firmware reads the registers through the I2C bus queue
+class INA219 {
+public:
+    INA219(uint8_t address, TwoWire *wire = &Wire) : address{address}, wire{wire} {}
+    bool begin();
+    bool isConnected();
+    bool setGain(uint8_t factor);
+    uint8_t getGain() const { return gain; }
+    bool setBusVoltageRange(uint8_t voltage);
+    uint8_t getBusVoltageRange() const { return busVoltageRange; }
+    // Current LSB is maxCurrent / 2^15, like the library without normalisation
+    bool setMaxCurrentShunt(float maxCurrent = 3.4, float shunt = 0.002);
+    float getMaxCurrent() const { return maxCurrent; }
+    float getShunt() const { return shunt; }
+    float getCurrentLSB() const { return currentLSB; }
+private:
+    uint8_t address;
+    TwoWire *wire;
+    uint8_t gain = 8;
+    uint8_t busVoltageRange = 32;
+    float maxCurrent = 0;
+    float shunt = 0;
+    float currentLSB = 0;
+    bool writeRegister(uint8_t reg, uint16_t value);
+};
@@ -0,0 +1,15 @@
+#pragma once
+#include "FS.h"
+
+namespace fs {
+class LittleFSFS : public FS {
+public:
+    bool begin(bool formatOnFail = false, const char *basePath = "/littlefs", uint8_t maxOpenFiles = 10, const char *partitionLabel = "spiffs") { return true; }
+    void end() {}
+    bool format() { clear(); return true; }
+    size_t totalBytes() const { return 1'441'792; }
+    size_t usedBytes() const { return 0; }
+};
+}
+
+extern fs::LittleFSFS LittleFS;
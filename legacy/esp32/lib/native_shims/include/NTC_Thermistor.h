@@ -0,0 +1,4 @@
+#pragma once
+
+// Only referenced by the firmware, SmoothThermistor does the conversion
+class NTC_Thermistor {};
@@ -0,0 +1,54 @@
+#pragma once
+#include <map>
+#include <string>
+#include "Arduino.h"
+
+// Non volatile storage preferences, kept in memory for the lifetime of the process
+class Preferences {
+public:
+    bool begin(const char *name, bool readOnly = false, const char *partitionLabel = nullptr);
+    void end() {}
+    bool clear();
+    bool remove(const char *key);
+    bool isKey(const char *key) const;
+
+    size_t putBool(const char *key, bool value) { return put(key, value); }
+    size_t putUChar(const char *key, uint8_t value) { return put(key, value); }
+    size_t putUShort(const char *key, uint16_t value) { return put(key, value); }
+    size_t putShort(const char *key, int16_t value) { return put(key, value); }
+    size_t putUInt(const char *key, uint32_t value) { return put(key, value); }
+    size_t putInt(const char *key, int32_t value) { return put(key, value); }
+    size_t putFloat(const char *key, float value) { return put(key, value); }
+    size_t putString(const char *key, const char *value);
+    size_t putString(const char *key, const String &value) { return putString(key, value.c_str()); }
+
+    bool getBool(const char *key, bool defaultValue = false) const { return get(key, defaultValue); }
+    uint8_t getUChar(const char *key, uint8_t defaultValue = 0) const { return get(key, defaultValue); }
+    uint16_t getUShort(const char *key, uint16_t defaultValue = 0) const { return get(key, defaultValue); }
+    int16_t getShort(const char *key, int16_t defaultValue = 0) const { return get(key, defaultValue); }
+    uint32_t getUInt(const char *key, uint32_t defaultValue = 0) const { return get(key, defaultValue); }
+    int32_t getInt(const char *key, int32_t defaultValue = 0) const { return get(key, defaultValue); }
+    float getFloat(const char *key, float defaultValue = 0) const { return get(key, defaultValue); }
+    String getString(const char *key, const String &defaultValue = String()) const;
+
+    // Removes every namespace, see Native::reset()
+    static void clearAll();
+private:
+    std::string name;
+    std::map<std::string, std::string> &values() const;
+
+    template<typename T> size_t put(const char *key, T value) {
+        values()[key] = std::string(reinterpret_cast<const char*>(&value), sizeof(T));
+        return sizeof(T);
+    }
+    template<typename T> T get(const char *key, T defaultValue) const {
+        const auto &stored = values();
+        const auto found = stored.find(key);
+        if(found == stored.end() || found->second.size() != sizeof(T)) {
+            return defaultValue;
+        }
+        T value;
+        memcpy(&value, found->second.data(), sizeof(T));
+        return value;
+    }
+};
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+
+// giannivh/SmoothThermistor: NTC thermistor with a series resistor to the supply, averaging `samples` analogRead()s
+class SmoothThermistor {
+public:
+    SmoothThermistor(uint8_t analogPin, uint16_t adcResolution = 10, uint32_t nominalResistance = 10000, uint32_t seriesResistance = 10000,
+        uint16_t betaCoefficient = 3950, uint8_t nominalTemperature = 25, uint8_t samples = 10);
+    float temperature();
+    void useAREF(bool) {}
+private:
+    uint8_t analogPin;
+    uint16_t adcMax;
+    uint32_t nominalResistance;
+    uint32_t seriesResistance;
+    uint16_t betaCoefficient;
+    uint8_t nominalTemperature;
+    uint8_t samples;
+};
@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// TaskScheduler subset on the native virtual clock, with the options used by the firmware:
+// _TASK_STD_FUNCTION, _TASK_TIMECRITICAL (start delay) and _TASK_TICKLESS (next run).
+#define TASK_IMMEDIATE 0
+#define TASK_SECOND 1000UL
+#define TASK_MINUTE 60000UL
+#define TASK_HOUR 3600000UL
+#define TASK_FOREVER (-1)
+#define TASK_ONCE 1
+
+using TaskCallback = std::function<void()>;
+using TaskOnEnable = std::function<bool()>;
+using TaskOnDisable = std::function<void()>;
+
+class Scheduler;
+
+class Task {
+public:
+    Task(unsigned long interval = 0, long iterations = 0, TaskCallback callback = nullptr, Scheduler *scheduler = nullptr, bool enable = false,
+        TaskOnEnable onEnable = nullptr, TaskOnDisable onDisable = nullptr);
+    ~Task();
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    void set(unsigned long interval, long iterations, TaskCallback callback, TaskOnEnable onEnable = nullptr, TaskOnDisable onDisable = nullptr);
+    bool enable();
+    bool enableIfNot();
+    bool enableDelayed(unsigned long delay = 0);
+    bool disable();
+    bool restart();
+    bool restartDelayed(unsigned long delay = 0);
+    // The next run is `delay` (or the interval) from now
+    void delay(unsigned long delay = 0);
+    void forceNextIteration();
+    void setInterval(unsigned long interval);
+    unsigned long getInterval() const { return interval; }
+    void setIterations(long iterations) { this->iterations = setIterationsCount = iterations; }
+    long getIterations() const { return iterations; }
+    unsigned long getRunCounter() const { return runCounter; }
+    bool isEnabled() const { return enabled; }
+    bool isFirstIteration() const { return runCounter <= 1; }
+    bool isLastIteration() const { return iterations == 0; }
+    void setCallback(TaskCallback callback) { this->callback = callback; }
+    // How late the current run started, in milliseconds
+    long getStartDelay() const { return startDelay; }
+    // Milliseconds until the next run, 0 if due, -1 if disabled
+    long untilNextRun() const;
+private:
+    friend class Scheduler;
+    Scheduler *scheduler = nullptr;
+    unsigned long interval = 0;
+    long iterations = 0;
+    long setIterationsCount = 0;
+    TaskCallback callback;
+    TaskOnEnable onEnable;
+    TaskOnDisable onDisable;
+    bool enabled = false;
+    unsigned long previousMillis = 0;
+    unsigned long delayMillis = 0;
+    unsigned long runCounter = 0;
+    long startDelay = 0;
+
+    bool run();
+};
+
+class Scheduler {
+public:
+    Scheduler() = default;
+    ~Scheduler();
+    void init() {}
+    void addTask(Task &task);
+    void deleteTask(Task &task);
+    void enableAll();
+    void disableAll();
+    // Runs the due tasks, returns true when none was due
+    bool execute();
+    Task &currentTask() { return *current; }
+    // Milliseconds until the next enabled task is due, 0 if any is due now
+    unsigned long getNextRun() const;
+private:
+    std::vector<Task*> tasks;
+    Task *current = nullptr;
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+// Arduino String, backed by std::string
+class String {
+public:
+    String(const char *str = "") : data{str ? str : ""} {}
+    String(const char *str, size_t length) : data{str, length} {}
+    String(const std::string &str) : data{str} {}
+    String(char c) : data(1, c) {}
+    String(int value, unsigned char base = 10) : String(static_cast<long long>(value), base) {}
+    String(unsigned int value, unsigned char base = 10) : String(static_cast<unsigned long long>(value), base) {}
+    String(long value, unsigned char base = 10) : String(static_cast<long long>(value), base) {}
+    String(unsigned long value, unsigned char base = 10) : String(static_cast<unsigned long long>(value), base) {}
+    String(long long value, unsigned char base = 10);
+    String(unsigned long long value, unsigned char base = 10);
+    String(float value, unsigned int decimals = 2) : String(static_cast<double>(value), decimals) {}
+    String(double value, unsigned int decimals = 2);
+
+    const char *c_str() const { return data.c_str(); }
+    unsigned int length() const { return data.length(); }
+    bool isEmpty() const { return data.empty(); }
+    bool reserve(unsigned int size) { data.reserve(size); return true; }
+    char operator[](unsigned int index) const { return index < data.length() ? data[index] : 0; }
+    char &operator[](unsigned int index) { return data[index]; }
+
+    bool concat(const String &str) { data += str.data; return true; }
+    bool concat(const char *str) { if(str) data += str; return str != nullptr; }
+    bool concat(const char *str, unsigned int length) { data.append(str, length); return true; }
+    bool concat(char c) { data += c; return true; }
+    bool concat(int value) { return concat(String(value)); }
+    bool concat(unsigned int value) { return concat(String(value)); }
+    bool concat(long value) { return concat(String(value)); }
+    bool concat(unsigned long value) { return concat(String(value)); }
+    bool concat(double value) { return concat(String(value)); }
+    String &operator+=(const String &str) { concat(str); return *this; }
+    String &operator+=(const char *str) { concat(str); return *this; }
+    String &operator+=(char c) { concat(c); return *this; }
+
+    bool operator==(const String &other) const { return data == other.data; }
+    bool operator==(const char *other) const { return data == (other ? other : ""); }
+    bool operator!=(const String &other) const { return !(*this == other); }
+    bool operator!=(const char *other) const { return !(*this == other); }
+    bool operator<(const String &other) const { return data < other.data; }
+    bool equals(const String &other) const { return *this == other; }
+    bool equalsIgnoreCase(const String &other) const;
+    bool startsWith(const String &prefix) const { return data.compare(0, prefix.data.length(), prefix.data) == 0; }
+    bool endsWith(const String &suffix) const;
+    int indexOf(char c, unsigned int from = 0) const;
+    int indexOf(const String &str, unsigned int from = 0) const;
+    String substring(unsigned int from) const { return substring(from, length()); }
+    String substring(unsigned int from, unsigned int to) const;
+    void trim();
+    void toLowerCase();
+    void toUpperCase();
+    long toInt() const { return std::strtol(c_str(), nullptr, 10); }
+    float toFloat() const { return std::strtof(c_str(), nullptr); }
+    double toDouble() const { return std::strtod(c_str(), nullptr); }
+private:
+    std::string data;
+};
+
+String operator+(const String &lhs, const String &rhs);
+String operator+(const String &lhs, const char *rhs);
+String operator+(const char *lhs, const String &rhs);
@@ -0,0 +1,18 @@
+#pragma once
+#include "Arduino.h"
+
+typedef enum { WIFI_OFF = 0, WIFI_STA, WIFI_AP, WIFI_AP_STA } wifi_mode_t;
+typedef enum { WIFI_PS_NONE, WIFI_PS_MIN_MODEM, WIFI_PS_MAX_MODEM } wifi_ps_type_t;
+
+// No radio on the host: always disconnected, in station mode
+class WiFiClass {
+public:
+    wifi_mode_t getMode() const { return WIFI_STA; }
+    bool setSleep(wifi_ps_type_t type) { sleep = type; return true; }
+    wifi_ps_type_t getSleep() const { return sleep; }
+    bool isConnected() const { return false; }
+private:
+    wifi_ps_type_t sleep = WIFI_PS_MIN_MODEM;
+};
+
+extern WiFiClass WiFi;
@@ -0,0 +1,39 @@
+#pragma once
+#include <array>
+#include "Arduino.h"
+
+// Arduino TwoWire on the simulated I2C bus: transactions are forwarded to the devices attached with Native::attachI2CDevice().
+class TwoWire : public Stream {
+public:
+    static constexpr size_t BufferLength = 128;
+
+    bool begin(int sdaPin = -1, int sclPin = -1, uint32_t frequency = 0);
+    bool end() { return true; }
+    bool setClock(uint32_t frequency) { clock = frequency; return true; }
+    uint32_t getClock() const { return clock; }
+    void setTimeOut(uint16_t timeoutMs) { this->timeoutMs = timeoutMs; }
+    uint16_t getTimeOut() const { return timeoutMs; }
+
+    void beginTransmission(uint16_t address);
+    // Returns 0 on success, 2 on address NACK, 3 on data NACK, like the ESP32 core
+    uint8_t endTransmission(bool sendStop = true);
+    size_t requestFrom(uint16_t address, size_t size, bool sendStop = true);
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+    int available() override { return rxLength - rxIndex; }
+    int read() override { return rxIndex < rxLength ? rxBuffer[rxIndex++] : -1; }
+    int peek() override { return rxIndex < rxLength ? rxBuffer[rxIndex] : -1; }
+private:
+    uint32_t clock = 100'000;
+    uint16_t timeoutMs = 50;
+    uint16_t txAddress = 0;
+    std::array<uint8_t, BufferLength> txBuffer;
+    size_t txLength = 0;
+    std::array<uint8_t, BufferLength> rxBuffer;
+    size_t rxIndex = 0;
+    size_t rxLength = 0;
+};
+
+extern TwoWire Wire;
@@ -0,0 +1,5 @@
+#pragma once
+#include <cstdint>
+
+// Microseconds since boot, on the native virtual clock
+int64_t esp_timer_get_time();
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Simulated hardware behind the native shims, for tests, benchmarks and simulations on the host.
+// Time is virtual: it only moves with advance() and delay(), so runs are deterministic and faster than real time.
+namespace Native {
+
+// Moves the clock forward, without running anything.
+void advance(uint32_t milliseconds);
+void advanceMicros(uint64_t microseconds);
+
+// analogRead() returns `value`, or calls `source` on every read.
+void setAnalogRead(uint8_t pin, uint16_t value);
+void setAnalogRead(uint8_t pin, const std::function<uint16_t()> &source);
+// Last value written with analogWrite() or ledcWrite(), 0 if never written.
+uint32_t analogWriteValue(uint8_t pin);
+uint8_t digitalWriteValue(uint8_t pin);
+
+// A device on the fake I2C bus. Both calls return false to NACK the transaction.
+class I2CDevice {
+public:
+    virtual ~I2CDevice() = default;
+    virtual bool write(const uint8_t *data, size_t length) = 0;
+    virtual bool read(uint8_t *data, size_t length) = 0;
+};
+// The device is not owned, and must outlive the bus usage, or be detached.
+void attachI2CDevice(uint8_t address, I2CDevice *device);
+void detachI2CDevice(uint8_t address);
+
+// Clears pins, I2C devices, files and preferences. The clock is monotonic and keeps running.
+void reset();
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <array>
+#include "native.h"
+
+// Simulated I2C sensors, to attach with Native::attachI2CDevice().
+namespace Native {
+
+// Sensirion SHT4x: serial number and high repeatability measurement commands, with CRC checked words.
+class SHT4xDevice : public I2CDevice {
+public:
+    float temperature = 20;
+    float humidity = 50;
+    // NACKs every transaction while set, like a disconnected sensor
+    bool offline = false;
+
+    bool write(const uint8_t *data, size_t length) override;
+    bool read(uint8_t *data, size_t length) override;
+private:
+    uint8_t command = 0;
+};
+
+// TI INA219: a write sets the register pointer, optionally followed by a register value; a read returns the register.
+// The measurement registers follow `busVoltage` and `current`, scaled with the calibration written by the driver.
+class INA219Device : public I2CDevice {
+public:
+    INA219Device(float shuntOhms) : shuntOhms{shuntOhms} {}
+    float busVoltage = 12;
+    float current = 0;
+
+    bool write(const uint8_t *data, size_t length) override;
+    bool read(uint8_t *data, size_t length) override;
+    uint16_t registerValue(uint8_t reg) const;
+private:
+    float shuntOhms;
+    uint8_t pointer = 0;
+    std::array<uint16_t, 6> registers{};
+};
+}
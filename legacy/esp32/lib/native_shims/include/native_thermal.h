@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdint>
+#include "native.h"
+
+// Thermal plant of a dew heater, for closed loop simulations of the PWM outputs.
+// A heater strap, carrying the thermistor, is wrapped around a lens. Both are first order nodes, coupled by conduction,
+// losing heat to the ambient air by convection (stronger with wind), and the lens also by radiation to the colder sky,
+// which is why an unheated lens dews up below the ambient temperature.
+namespace Native {
+
+class ThermalPlant {
+public:
+    struct Parameters {
+        // Heater power at full duty
+        float heaterWatts = 10;
+        float strapGrams = 30;
+        float lensGrams = 400;
+        float windMetersPerSecond = 1;
+        // Strap to lens conductance
+        float couplingWattsPerKelvin = 0.5;
+        float strapAreaSquareMeters = 0.02;
+        float lensAreaSquareMeters = 0.008;
+        // Clear sky radiative temperature, below the ambient
+        float skyDepressionKelvin = 15;
+    };
+    // NTC thermistor in a divider with a reference resistor, read with analogRead()
+    struct Thermistor {
+        uint8_t pin;
+        float nominalOhms;
+        float referenceOhms;
+        float beta;
+        float nominalCelsius;
+        uint8_t adcBits;
+    };
+
+    ThermalPlant(const Parameters &parameters, const Thermistor &thermistor, uint8_t heaterPin, uint8_t pwmBits = 8);
+    ~ThermalPlant();
+    // Starts at thermal equilibrium with the unheated ambient
+    void reset(float ambientCelsius);
+    // Integrates `seconds` with the heater duty last written to the heater pin.
+    void step(float seconds, float ambientCelsius);
+
+    float strapTemperature() const { return strap; }
+    float lensTemperature() const { return lens; }
+    float duty() const;
+    float power() const { return duty() * parameters.heaterWatts; }
+    float energyWattHours() const { return energy / 3600; }
+    // 0 if disconnected, like a broken thermistor wire
+    void setThermistorConnected(bool connected) { thermistorConnected = connected; }
+private:
+    Parameters parameters;
+    Thermistor thermistor;
+    uint8_t heaterPin;
+    uint32_t pwmMax;
+    float strap = 0;
+    float lens = 0;
+    float energy = 0;
+    bool thermistorConnected = true;
+
+    void integrate(float seconds, float ambientCelsius, float heaterWatts);
+    uint16_t thermistorADC() const;
+};
+
+// Control quality against a setpoint, and dew protection of the lens, accumulated at every simulation step.
+class ControlScore {
+public:
+    ControlScore(float bandKelvin = 1) : band{bandKelvin} {}
+    // A NaN setpoint, i.e. fixed duty, only scores the dew protection
+    void add(float seconds, float elapsedSeconds, float setpoint, float temperature, float lensTemperature, float dewpoint);
+
+    bool hasSetpoint() const { return _hasSetpoint; }
+
+    // Highest temperature above the setpoint, after getting within the band the first time
+    float overshoot() const { return _overshoot; }
+    // Time until the temperature stays within the band around the setpoint, or the whole run if it never settles
+    float settlingSeconds() const { return settled ? lastOutsideBand : elapsed; }
+    // RMS error after getting within the band the first time, including a steady state offset
+    float rmsError() const;
+    float minDewMargin() const { return _minDewMargin; }
+    // Time with the lens below the dewpoint
+    float dewSeconds() const { return _dewSeconds; }
+private:
+    float band;
+    bool _hasSetpoint = false;
+    bool reached = false;
+    bool settled = false;
+    float elapsed = 0;
+    float lastOutsideBand = 0;
+    float _overshoot = 0;
+    float squaredErrorSum = 0;
+    float errorSeconds = 0;
+    float _minDewMargin = 1e6;
+    float _dewSeconds = 0;
+};
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <Preferences.h>
+#include <FS.h>
+
+// GuLinux/WiFiManager settings: only the hostname is kept on the host
+namespace GuLinux {
+class WiFiSettings {
+public:
+    WiFiSettings(Preferences &preferences, fs::FS &filesystem, const char *hostname, bool appendMacSuffix = true,
+        uint8_t maxStations = 5, bool enableAccessPoint = true, uint8_t retries = 3) : _hostname{hostname} {}
+    void load() {}
+    void loadDefaults() {}
+    void save() {}
+    const char *hostname() const { return _hostname.c_str(); }
+private:
+    String _hostname;
+};
+}
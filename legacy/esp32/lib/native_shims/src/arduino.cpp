@@ -0,0 +1,168 @@
+#include "Arduino.h"
+#include "native.h"
+#include "native_p.h"
+#include "FS.h"
+#include "LittleFS.h"
+#include "Preferences.h"
+#include "WiFi.h"
+#include "Wire.h"
+#include <cstdarg>
+#include <map>
+#include <vector>
+
+namespace {
+    uint64_t clockMicros = 0;
+    uint8_t analogReadBits = 12;
+    std::map<uint8_t, std::function<uint16_t()>> analogSources;
+    std::map<uint8_t, uint32_t> analogValues;
+    std::map<uint8_t, uint8_t> digitalValues;
+    std::map<uint8_t, uint8_t> ledcChannelPins;
+}
+
+fs::LittleFSFS LittleFS;
+WiFiClass WiFi;
+
+void Native::advance(uint32_t milliseconds) {
+    clockMicros += milliseconds * 1000ull;
+}
+
+void Native::advanceMicros(uint64_t microseconds) {
+    clockMicros += microseconds;
+}
+
+void Native::setAnalogRead(uint8_t pin, uint16_t value) {
+    analogSources[pin] = [value](){ return value; };
+}
+
+void Native::setAnalogRead(uint8_t pin, const std::function<uint16_t()> &source) {
+    analogSources[pin] = source;
+}
+
+uint32_t Native::analogWriteValue(uint8_t pin) {
+    const auto found = analogValues.find(pin);
+    return found == analogValues.end() ? 0 : found->second;
+}
+
+uint8_t Native::digitalWriteValue(uint8_t pin) {
+    const auto found = digitalValues.find(pin);
+    return found == digitalValues.end() ? LOW : found->second;
+}
+
+void Native::reset() {
+    analogSources.clear();
+    analogValues.clear();
+    digitalValues.clear();
+    ledcChannelPins.clear();
+    LittleFS.clear();
+    Preferences::clearAll();
+    Native::Private::resetI2CDevices();
+}
+
+unsigned long millis() {
+    return clockMicros / 1000;
+}
+
+unsigned long micros() {
+    return clockMicros;
+}
+
+int64_t esp_timer_get_time() {
+    return clockMicros;
+}
+
+void delay(uint32_t ms) {
+    Native::advance(ms);
+}
+
+void delayMicroseconds(uint32_t us) {
+    Native::advanceMicros(us);
+}
+
+void pinMode(uint8_t, uint8_t) {
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    digitalValues[pin] = value;
+}
+
+int digitalRead(uint8_t pin) {
+    return Native::digitalWriteValue(pin);
+}
+
+uint16_t analogRead(uint8_t pin) {
+    const auto found = analogSources.find(pin);
+    return found == analogSources.end() ? 0 : std::min<uint16_t>(found->second(), (1 << analogReadBits) - 1);
+}
+
+void analogReadResolution(uint8_t bits) {
+    analogReadBits = bits;
+}
+
+void analogWrite(uint8_t pin, int value) {
+    analogValues[pin] = value;
+}
+
+uint32_t ledcSetup(uint8_t, uint32_t frequency, uint8_t) {
+    return frequency;
+}
+
+void ledcAttachPin(uint8_t pin, uint8_t channel) {
+    ledcChannelPins[channel] = pin;
+}
+
+void ledcWrite(uint8_t channel, uint32_t duty) {
+    const auto found = ledcChannelPins.find(channel);
+    if(found != ledcChannelPins.end()) {
+        analogValues[found->second] = duty;
+    }
+}
+
+float temperatureRead() {
+    return 40;
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+    size_t written = 0;
+    while(size--) {
+        written += write(*buffer++);
+    }
+    return written;
+}
+
+size_t Print::print(const String &str) {
+    return write(str.c_str());
+}
+
+size_t Print::printf(const char *format, ...) {
+    char stackBuffer[64];
+    va_list args;
+    va_start(args, format);
+    va_list copy;
+    va_copy(copy, args);
+    const int length = vsnprintf(stackBuffer, sizeof(stackBuffer), format, copy);
+    va_end(copy);
+    if(length < 0) {
+        va_end(args);
+        return 0;
+    }
+    if(static_cast<size_t>(length) < sizeof(stackBuffer)) {
+        va_end(args);
+        return write(reinterpret_cast<const uint8_t*>(stackBuffer), length);
+    }
+    std::vector<char> buffer(length + 1);
+    vsnprintf(buffer.data(), buffer.size(), format, args);
+    va_end(args);
+    return write(reinterpret_cast<const uint8_t*>(buffer.data()), length);
+}
+
+size_t Stream::readBytes(char *buffer, size_t length) {
+    size_t count = 0;
+    while(count < length) {
+        const int c = read();
+        if(c < 0) {
+            break;
+        }
+        buffer[count++] = static_cast<char>(c);
+    }
+    return count;
+}
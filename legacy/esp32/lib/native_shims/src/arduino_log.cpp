@@ -0,0 +1,49 @@
+#include "ArduinoLog.h"
+#include <cstdarg>
+
+Logging Log;
+
+namespace {
+    const char *levelNames[] = {"S", "F", "E", "W", "I", "T", "V"};
+}
+
+void Logging::begin(int level, Print *output, bool showLevel) {
+    this->level = level;
+    this->output = output;
+    this->showLevel = showLevel;
+}
+
+void Logging::printFormat(int level, bool newLine, const char *format, ...) {
+    if(showLevel) {
+        output->printf("%s: ", levelNames[level]);
+    }
+    va_list args;
+    va_start(args, format);
+    for(const char *c = format; *c; c++) {
+        if(*c != '%' || !c[1]) {
+            output->print(*c);
+            continue;
+        }
+        switch(*++c) {
+        case 's': output->print(va_arg(args, const char*)); break;
+        case 'c': output->print(static_cast<char>(va_arg(args, int))); break;
+        case 'd':
+        case 'i': output->print(va_arg(args, int)); break;
+        case 'u': output->print(va_arg(args, unsigned int)); break;
+        case 'l': output->print(va_arg(args, long)); break;
+        case 'x': output->printf("%x", va_arg(args, unsigned int)); break;
+        case 'X': output->printf("0x%X", va_arg(args, unsigned int)); break;
+        case 'p': output->printf("%p", va_arg(args, void*)); break;
+        case 'F':
+        case 'D': output->print(va_arg(args, double)); break;
+        case 't': output->print(va_arg(args, int) ? 'T' : 'F'); break;
+        case 'T': output->print(va_arg(args, int) ? "true" : "false"); break;
+        case '%': output->print('%'); break;
+        default: output->print('%'); output->print(*c);
+        }
+    }
+    va_end(args);
+    if(newLine) {
+        output->println();
+    }
+}
@@ -0,0 +1,31 @@
+#include "ESPAsyncWebServer.h"
+
+const AsyncWebParameter *AsyncWebServerRequest::getParam(const char *name) const {
+    const auto found = params.find(name);
+    return found == params.end() ? nullptr : &found->second;
+}
+
+bool AsyncEventSourceClient::write(AsyncEvent_SharedData_t message) {
+    messages++;
+    bytes += message->length();
+    lastMessage = message;
+    return true;
+}
+
+AsyncEventSourceClient *AsyncEventSource::connect(AsyncWebServerRequest &request, uint32_t lastId) {
+    if(authorizeHandler && !authorizeHandler(&request)) {
+        return nullptr;
+    }
+    AsyncEventSourceClient *client = &clients.emplace_back(request.client(), lastId);
+    if(connectHandler) {
+        connectHandler(client);
+    }
+    return client;
+}
+
+void AsyncEventSource::disconnect(AsyncEventSourceClient *client) {
+    if(disconnectHandler) {
+        disconnectHandler(client);
+    }
+    clients.remove_if([client](const AsyncEventSourceClient &c) { return &c == client; });
+}
@@ -0,0 +1,129 @@
+#include "FS.h"
+#include "Preferences.h"
+
+fs::File::File(const std::string &path, std::shared_ptr<std::string> content, bool writable) :
+    _path{path}, content{content}, writable{writable} {
+}
+
+size_t fs::File::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t fs::File::write(const uint8_t *buffer, size_t size) {
+    if(!content || !writable) {
+        return 0;
+    }
+    content->replace(offset, std::min(size, content->size() - offset), reinterpret_cast<const char*>(buffer), size);
+    offset += size;
+    return size;
+}
+
+int fs::File::available() {
+    return content ? content->size() - offset : 0;
+}
+
+int fs::File::read() {
+    const int c = peek();
+    if(c >= 0) {
+        offset++;
+    }
+    return c;
+}
+
+int fs::File::peek() {
+    if(!content || offset >= content->size()) {
+        return -1;
+    }
+    return static_cast<uint8_t>((*content)[offset]);
+}
+
+bool fs::File::seek(size_t position) {
+    if(!content || position > content->size()) {
+        return false;
+    }
+    offset = position;
+    return true;
+}
+
+const char *fs::File::name() const {
+    const size_t separator = _path.rfind('/');
+    return _path.c_str() + (separator == std::string::npos ? 0 : separator + 1);
+}
+
+fs::File fs::FS::open(const char *path, const char *mode, bool create) {
+    const bool write = mode[0] == 'w' || mode[0] == 'a';
+    auto found = files.find(path);
+    if(found == files.end()) {
+        if(!write) {
+            return File();
+        }
+        found = files.emplace(path, std::make_shared<std::string>()).first;
+    }
+    if(mode[0] == 'w') {
+        found->second->clear();
+    }
+    File file{path, found->second, write || mode[1] == '+'};
+    if(mode[0] == 'a') {
+        file.seek(file.size());
+    }
+    return file;
+}
+
+bool fs::FS::exists(const char *path) const {
+    return files.count(path) > 0;
+}
+
+bool fs::FS::remove(const char *path) {
+    return files.erase(path) > 0;
+}
+
+bool fs::FS::rename(const char *from, const char *to) {
+    const auto found = files.find(from);
+    if(found == files.end()) {
+        return false;
+    }
+    files[to] = found->second;
+    files.erase(from);
+    return true;
+}
+
+namespace {
+    std::map<std::string, std::map<std::string, std::string>> namespaces;
+}
+
+bool Preferences::begin(const char *name, bool, const char *) {
+    this->name = name;
+    return true;
+}
+
+std::map<std::string, std::string> &Preferences::values() const {
+    return namespaces[name];
+}
+
+bool Preferences::clear() {
+    values().clear();
+    return true;
+}
+
+bool Preferences::remove(const char *key) {
+    return values().erase(key) > 0;
+}
+
+bool Preferences::isKey(const char *key) const {
+    return values().count(key) > 0;
+}
+
+size_t Preferences::putString(const char *key, const char *value) {
+    values()[key] = value;
+    return strlen(value);
+}
+
+String Preferences::getString(const char *key, const String &defaultValue) const {
+    const auto &stored = values();
+    const auto found = stored.find(key);
+    return found == stored.end() ? defaultValue : String(found->second);
+}
+
+void Preferences::clearAll() {
+    namespaces.clear();
+}
@@ -0,0 +1,23 @@
+#include "i2c_wire.h"
+
+// The firmware bus task runs at a higher priority than the control task, so on the host
+// transactions run right away on submit. Transactions submitted by callbacks are run by the outer loop.
+namespace {
+    APB::I2C::WireBackend wireBackend{Wire, I2C_SDA_PIN, I2C_SCL_PIN};
+    bool processing = false;
+}
+
+APB::I2C::Bus &APB::I2C::Instance = *new APB::I2C::Bus(wireBackend, APB_I2C_QUEUE_SIZE);
+
+void APB::I2C::begin() {
+    Instance.setOnSubmit([](){
+        if(processing) {
+            return;
+        }
+        processing = true;
+        while(Instance.process()) {}
+        processing = false;
+    });
+    // Transactions submitted before begin()
+    while(Instance.process()) {}
+}
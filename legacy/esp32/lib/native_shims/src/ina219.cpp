@@ -0,0 +1,48 @@
+#include "INA219.h"
+
+#define INA219_CONFIGURATION_REGISTER 0x00
+#define INA219_CALIBRATION_REGISTER 0x05
+
+bool INA219::begin() {
+    return isConnected();
+}
+
+bool INA219::isConnected() {
+    wire->beginTransmission(address);
+    return wire->endTransmission() == 0;
+}
+
+bool INA219::setGain(uint8_t factor) {
+    if(factor != 1 && factor != 2 && factor != 4 && factor != 8) {
+        return false;
+    }
+    gain = factor;
+    return true;
+}
+
+bool INA219::setBusVoltageRange(uint8_t voltage) {
+    if(voltage > 32) {
+        return false;
+    }
+    busVoltageRange = voltage <= 16 ? 16 : 32;
+    return true;
+}
+
+bool INA219::setMaxCurrentShunt(float maxCurrent, float shunt) {
+    if(shunt < 0.001 || maxCurrent < 0.001) {
+        return false;
+    }
+    this->maxCurrent = maxCurrent;
+    this->shunt = shunt;
+    currentLSB = maxCurrent / 32768;
+    const uint16_t calibration = 0.04096 / (currentLSB * shunt);
+    return writeRegister(INA219_CALIBRATION_REGISTER, calibration);
+}
+
+bool INA219::writeRegister(uint8_t reg, uint16_t value) {
+    wire->beginTransmission(address);
+    wire->write(reg);
+    wire->write(value >> 8);
+    wire->write(value & 0xFF);
+    return wire->endTransmission() == 0;
+}
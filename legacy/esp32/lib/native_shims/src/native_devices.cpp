@@ -0,0 +1,97 @@
+#include "native_devices.h"
+#include <algorithm>
+#include <cmath>
+
+#define SHT4X_SERIAL_COMMAND 0x89
+#define SHT4X_MEASURE_HIGH_REPEATABILITY 0xFD
+#define SHT4X_MEASURE_LOW_REPEATABILITY 0xE0
+
+#define INA219_SHUNT_VOLTAGE_REGISTER 0x01
+#define INA219_BUS_VOLTAGE_REGISTER 0x02
+#define INA219_POWER_REGISTER 0x03
+#define INA219_CURRENT_REGISTER 0x04
+#define INA219_CALIBRATION_REGISTER 0x05
+
+namespace {
+    uint8_t sensirionCrc(const uint8_t *data) {
+        uint8_t crc = 0xFF;
+        for(int i = 0; i < 2; i++) {
+            crc ^= data[i];
+            for(int bit = 0; bit < 8; bit++) {
+                crc = crc & 0x80 ? (crc << 1) ^ 0x31 : crc << 1;
+            }
+        }
+        return crc;
+    }
+
+    void putWord(uint8_t *data, uint16_t word) {
+        data[0] = word >> 8;
+        data[1] = word & 0xFF;
+        data[2] = sensirionCrc(data);
+    }
+
+    uint16_t scale(float value, float offset, float range) {
+        return static_cast<uint16_t>(std::clamp((value - offset) / range, 0.f, 1.f) * 65535);
+    }
+}
+
+bool Native::SHT4xDevice::write(const uint8_t *data, size_t length) {
+    if(offline || length != 1) {
+        return false;
+    }
+    command = data[0];
+    return command == SHT4X_SERIAL_COMMAND || command == SHT4X_MEASURE_HIGH_REPEATABILITY || command == SHT4X_MEASURE_LOW_REPEATABILITY;
+}
+
+bool Native::SHT4xDevice::read(uint8_t *data, size_t length) {
+    if(offline || length != 6) {
+        return false;
+    }
+    if(command == SHT4X_SERIAL_COMMAND) {
+        putWord(data, 0x1234);
+        putWord(data + 3, 0x5678);
+        return true;
+    }
+    putWord(data, scale(temperature, -45, 175));
+    putWord(data + 3, scale(humidity, -6, 125));
+    return true;
+}
+
+bool Native::INA219Device::write(const uint8_t *data, size_t length) {
+    if(length == 0 || data[0] >= registers.size()) {
+        return false;
+    }
+    pointer = data[0];
+    if(length == 3) {
+        registers[pointer] = data[1] << 8 | data[2];
+    }
+    return length == 1 || length == 3;
+}
+
+bool Native::INA219Device::read(uint8_t *data, size_t length) {
+    if(length != 2) {
+        return false;
+    }
+    const uint16_t value = registerValue(pointer);
+    data[0] = value >> 8;
+    data[1] = value & 0xFF;
+    return true;
+}
+
+uint16_t Native::INA219Device::registerValue(uint8_t reg) const {
+    const uint16_t calibration = registers[INA219_CALIBRATION_REGISTER];
+    const float currentLSB = calibration > 0 ? 0.04096 / (calibration * shuntOhms) : 0;
+    switch(reg) {
+    case INA219_SHUNT_VOLTAGE_REGISTER:
+        return static_cast<int16_t>(std::lround(current * shuntOhms / 0.00001));
+    case INA219_BUS_VOLTAGE_REGISTER:
+        // Bits 3-15, 4mV LSB, with the conversion ready bit
+        return static_cast<uint16_t>(std::lround(busVoltage / 0.004)) << 3 | 0x02;
+    case INA219_POWER_REGISTER:
+        return currentLSB > 0 ? static_cast<uint16_t>(std::lround(std::abs(current * busVoltage) / (20 * currentLSB))) : 0;
+    case INA219_CURRENT_REGISTER:
+        return currentLSB > 0 ? static_cast<int16_t>(std::lround(current / currentLSB)) : 0;
+    default:
+        return registers[reg];
+    }
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+namespace Native::Private {
+void resetI2CDevices();
+}
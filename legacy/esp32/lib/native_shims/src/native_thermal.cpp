@@ -0,0 +1,91 @@
+#include "native_thermal.h"
+#include <Arduino.h>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    constexpr float STRAP_SPECIFIC_HEAT = 1200;
+    constexpr float LENS_SPECIFIC_HEAT = 840;
+    // Linearised black body radiation around 280K, glass emissivity 0.9
+    constexpr float RADIATION_WATTS_PER_SQUARE_METER_KELVIN = 4.6;
+    constexpr float KELVIN = 273.15;
+
+    // Forced convection, McAdams
+    float convection(float windMetersPerSecond) {
+        return 5.7 + 3.8 * windMetersPerSecond;
+    }
+}
+
+Native::ThermalPlant::ThermalPlant(const Parameters &parameters, const Thermistor &thermistor, uint8_t heaterPin, uint8_t pwmBits) :
+    parameters{parameters}, thermistor{thermistor}, heaterPin{heaterPin}, pwmMax{(1u << pwmBits) - 1} {
+    setAnalogRead(thermistor.pin, [this]() { return thermistorADC(); });
+}
+
+Native::ThermalPlant::~ThermalPlant() {
+    setAnalogRead(thermistor.pin, 0);
+}
+
+void Native::ThermalPlant::reset(float ambientCelsius) {
+    strap = ambientCelsius;
+    lens = ambientCelsius;
+    energy = 0;
+    // Settles the radiative cooling of the lens
+    for(int second = 0; second < 36'000; second++) {
+        integrate(1, ambientCelsius, 0);
+    }
+}
+
+float Native::ThermalPlant::duty() const {
+    return std::min(1.f, static_cast<float>(analogWriteValue(heaterPin)) / pwmMax);
+}
+
+void Native::ThermalPlant::step(float seconds, float ambientCelsius) {
+    integrate(seconds, ambientCelsius, power());
+}
+
+void Native::ThermalPlant::integrate(float seconds, float ambientCelsius, float heater) {
+    const float h = convection(parameters.windMetersPerSecond);
+    const float sky = ambientCelsius - parameters.skyDepressionKelvin;
+    const float conduction = parameters.couplingWattsPerKelvin * (strap - lens);
+    const float strapLoss = h * parameters.strapAreaSquareMeters * (strap - ambientCelsius);
+    const float lensLoss = h * parameters.lensAreaSquareMeters * (lens - ambientCelsius) +
+        RADIATION_WATTS_PER_SQUARE_METER_KELVIN * parameters.lensAreaSquareMeters * (lens - sky);
+    strap += seconds * (heater - conduction - strapLoss) / (parameters.strapGrams / 1000 * STRAP_SPECIFIC_HEAT);
+    lens += seconds * (conduction - lensLoss) / (parameters.lensGrams / 1000 * LENS_SPECIFIC_HEAT);
+    energy += heater * seconds;
+}
+
+uint16_t Native::ThermalPlant::thermistorADC() const {
+    if(!thermistorConnected) {
+        return 0;
+    }
+    const float resistance = thermistor.nominalOhms * std::exp(thermistor.beta * (1 / (strap + KELVIN) - 1 / (thermistor.nominalCelsius + KELVIN)));
+    const float adcMax = (1 << thermistor.adcBits) - 1;
+    return std::lround(adcMax * resistance / (resistance + thermistor.referenceOhms));
+}
+
+void Native::ControlScore::add(float seconds, float elapsedSeconds, float setpoint, float temperature, float lensTemperature, float dewpoint) {
+    const float error = temperature - setpoint;
+    elapsed = elapsedSeconds;
+    _hasSetpoint |= !std::isnan(setpoint);
+    reached |= std::abs(error) <= band;
+    if(reached) {
+        _overshoot = std::max(_overshoot, error);
+        squaredErrorSum += error * error * seconds;
+        errorSeconds += seconds;
+    }
+    if(std::abs(error) > band) {
+        lastOutsideBand = elapsedSeconds;
+        settled = false;
+    } else {
+        settled = true;
+    }
+    _minDewMargin = std::min(_minDewMargin, lensTemperature - dewpoint);
+    if(lensTemperature < dewpoint) {
+        _dewSeconds += seconds;
+    }
+}
+
+float Native::ControlScore::rmsError() const {
+    return errorSeconds > 0 ? std::sqrt(squaredErrorSum / errorSeconds) : 0;
+}
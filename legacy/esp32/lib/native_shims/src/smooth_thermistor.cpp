@@ -0,0 +1,26 @@
+#include "SmoothThermistor.h"
+#include "Arduino.h"
+
+SmoothThermistor::SmoothThermistor(uint8_t analogPin, uint16_t adcResolution, uint32_t nominalResistance, uint32_t seriesResistance,
+    uint16_t betaCoefficient, uint8_t nominalTemperature, uint8_t samples) :
+    analogPin{analogPin},
+    adcMax{static_cast<uint16_t>((1 << adcResolution) - 1)},
+    nominalResistance{nominalResistance},
+    seriesResistance{seriesResistance},
+    betaCoefficient{betaCoefficient},
+    nominalTemperature{nominalTemperature},
+    samples{samples} {
+}
+
+float SmoothThermistor::temperature() {
+    float average = 0;
+    for(uint8_t i = 0; i < samples; i++) {
+        average += analogRead(analogPin);
+    }
+    average /= samples;
+    // Thermistor resistance, then the B parameter equation
+    const float resistance = seriesResistance / (adcMax / average - 1);
+    float steinhart = std::log(resistance / nominalResistance) / betaCoefficient;
+    steinhart += 1.0 / (nominalTemperature + 273.15);
+    return 1.0 / steinhart - 273.15;
+}
@@ -0,0 +1,178 @@
+#include "TaskSchedulerDeclarations.h"
+#include "Arduino.h"
+#include <algorithm>
+#include <climits>
+
+Task::Task(unsigned long interval, long iterations, TaskCallback callback, Scheduler *scheduler, bool enable, TaskOnEnable onEnable, TaskOnDisable onDisable) {
+    set(interval, iterations, callback, onEnable, onDisable);
+    if(scheduler) {
+        scheduler->addTask(*this);
+    }
+    if(enable) {
+        this->enable();
+    }
+}
+
+Task::~Task() {
+    if(scheduler) {
+        scheduler->deleteTask(*this);
+    }
+}
+
+void Task::set(unsigned long interval, long iterations, TaskCallback callback, TaskOnEnable onEnable, TaskOnDisable onDisable) {
+    this->interval = interval;
+    this->iterations = setIterationsCount = iterations;
+    this->callback = callback;
+    this->onEnable = onEnable;
+    this->onDisable = onDisable;
+}
+
+bool Task::enable() {
+    if(!scheduler) {
+        return false;
+    }
+    runCounter = 0;
+    iterations = setIterationsCount;
+    enabled = onEnable ? onEnable() : true;
+    // First run right away
+    previousMillis = millis() - interval;
+    delayMillis = interval;
+    return enabled;
+}
+
+bool Task::enableIfNot() {
+    return enabled || enable();
+}
+
+bool Task::enableDelayed(unsigned long delay) {
+    enable();
+    this->delay(delay);
+    return enabled;
+}
+
+bool Task::disable() {
+    const bool wasEnabled = enabled;
+    enabled = false;
+    if(wasEnabled && onDisable) {
+        onDisable();
+    }
+    return wasEnabled;
+}
+
+bool Task::restart() {
+    iterations = setIterationsCount;
+    return enable();
+}
+
+bool Task::restartDelayed(unsigned long delay) {
+    iterations = setIterationsCount;
+    return enableDelayed(delay);
+}
+
+void Task::delay(unsigned long delay) {
+    delayMillis = delay ? delay : interval;
+    previousMillis = millis();
+}
+
+void Task::forceNextIteration() {
+    previousMillis = millis() - interval;
+    delayMillis = interval;
+}
+
+void Task::setInterval(unsigned long interval) {
+    this->interval = interval;
+    delay();
+}
+
+long Task::untilNextRun() const {
+    if(!enabled) {
+        return -1;
+    }
+    const unsigned long elapsed = millis() - previousMillis;
+    return elapsed >= delayMillis ? 0 : delayMillis - elapsed;
+}
+
+bool Task::run() {
+    if(!enabled || iterations == 0) {
+        return false;
+    }
+    const unsigned long now = millis();
+    if(now - previousMillis < delayMillis) {
+        return false;
+    }
+    // Scheduled from the previous target, catching up after a late run
+    startDelay = now - previousMillis - delayMillis;
+    previousMillis += delayMillis;
+    delayMillis = interval;
+    if(iterations > 0) {
+        iterations--;
+    }
+    runCounter++;
+    if(callback) {
+        callback();
+    }
+    if(iterations == 0) {
+        disable();
+    }
+    return true;
+}
+
+Scheduler::~Scheduler() {
+    for(Task *task: tasks) {
+        task->scheduler = nullptr;
+    }
+}
+
+void Scheduler::addTask(Task &task) {
+    if(task.scheduler == this) {
+        return;
+    }
+    if(task.scheduler) {
+        task.scheduler->deleteTask(task);
+    }
+    task.scheduler = this;
+    tasks.push_back(&task);
+}
+
+void Scheduler::deleteTask(Task &task) {
+    tasks.erase(std::remove(tasks.begin(), tasks.end(), &task), tasks.end());
+    task.scheduler = nullptr;
+}
+
+void Scheduler::enableAll() {
+    for(Task *task: tasks) {
+        task->enable();
+    }
+}
+
+void Scheduler::disableAll() {
+    for(Task *task: tasks) {
+        task->disable();
+    }
+}
+
+bool Scheduler::execute() {
+    bool idle = true;
+    // Tasks may add or delete tasks from their callbacks
+    const std::vector<Task*> pass{tasks};
+    for(Task *task: pass) {
+        if(std::find(tasks.begin(), tasks.end(), task) == tasks.end()) {
+            continue;
+        }
+        current = task;
+        idle &= !task->run();
+    }
+    current = nullptr;
+    return idle;
+}
+
+unsigned long Scheduler::getNextRun() const {
+    unsigned long nextRun = ULONG_MAX;
+    for(const Task *task: tasks) {
+        const long untilNextRun = task->untilNextRun();
+        if(untilNextRun >= 0) {
+            nextRun = std::min<unsigned long>(nextRun, untilNextRun);
+        }
+    }
+    return nextRun;
+}
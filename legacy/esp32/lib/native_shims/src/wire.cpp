@@ -0,0 +1,79 @@
+#include "Wire.h"
+#include "native.h"
+#include "native_p.h"
+#include <map>
+
+TwoWire Wire;
+
+namespace {
+    std::map<uint8_t, Native::I2CDevice*> devices;
+
+    Native::I2CDevice *device(uint16_t address) {
+        const auto found = devices.find(address);
+        return found == devices.end() ? nullptr : found->second;
+    }
+}
+
+void Native::attachI2CDevice(uint8_t address, I2CDevice *device) {
+    devices[address] = device;
+}
+
+void Native::detachI2CDevice(uint8_t address) {
+    devices.erase(address);
+}
+
+void Native::Private::resetI2CDevices() {
+    devices.clear();
+}
+
+bool TwoWire::begin(int, int, uint32_t frequency) {
+    if(frequency) {
+        clock = frequency;
+    }
+    return true;
+}
+
+void TwoWire::beginTransmission(uint16_t address) {
+    txAddress = address;
+    txLength = 0;
+}
+
+uint8_t TwoWire::endTransmission(bool) {
+    Native::I2CDevice *target = device(txAddress);
+    if(!target) {
+        return 2;
+    }
+    if(txLength > 0 && !target->write(txBuffer.data(), txLength)) {
+        return 3;
+    }
+    txLength = 0;
+    return 0;
+}
+
+size_t TwoWire::requestFrom(uint16_t address, size_t size, bool) {
+    rxIndex = 0;
+    rxLength = 0;
+    Native::I2CDevice *target = device(address);
+    size = std::min(size, BufferLength);
+    if(!target || !target->read(rxBuffer.data(), size)) {
+        return 0;
+    }
+    rxLength = size;
+    return size;
+}
+
+size_t TwoWire::write(uint8_t c) {
+    if(txLength >= BufferLength) {
+        return 0;
+    }
+    txBuffer[txLength++] = c;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t *buffer, size_t size) {
+    size_t written = 0;
+    while(written < size && write(buffer[written])) {
+        written++;
+    }
+    return written;
+}
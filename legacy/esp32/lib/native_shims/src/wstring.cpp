@@ -0,0 +1,94 @@
+#include "WString.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+
+namespace {
+    std::string toString(unsigned long long value, unsigned char base, bool negative) {
+        std::string digits;
+        do {
+            const int digit = value % base;
+            digits += static_cast<char>(digit < 10 ? '0' + digit : 'a' + digit - 10);
+            value /= base;
+        } while(value > 0);
+        if(negative) {
+            digits += '-';
+        }
+        return {digits.rbegin(), digits.rend()};
+    }
+}
+
+String::String(long long value, unsigned char base) :
+    data{toString(value < 0 ? -static_cast<unsigned long long>(value) : value, base, value < 0)} {
+}
+
+String::String(unsigned long long value, unsigned char base) : data{toString(value, base, false)} {
+}
+
+String::String(double value, unsigned int decimals) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+    data = buffer;
+}
+
+bool String::equalsIgnoreCase(const String &other) const {
+    return std::equal(data.begin(), data.end(), other.data.begin(), other.data.end(), [](char a, char b) {
+        return std::tolower(a) == std::tolower(b);
+    });
+}
+
+bool String::endsWith(const String &suffix) const {
+    return data.length() >= suffix.data.length() && data.compare(data.length() - suffix.data.length(), suffix.data.length(), suffix.data) == 0;
+}
+
+int String::indexOf(char c, unsigned int from) const {
+    const size_t found = data.find(c, from);
+    return found == std::string::npos ? -1 : found;
+}
+
+int String::indexOf(const String &str, unsigned int from) const {
+    const size_t found = data.find(str.data, from);
+    return found == std::string::npos ? -1 : found;
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+    if(from > to) {
+        std::swap(from, to);
+    }
+    if(from >= data.length()) {
+        return String();
+    }
+    return String(data.substr(from, std::min<size_t>(to, data.length()) - from));
+}
+
+void String::trim() {
+    const auto notSpace = [](unsigned char c) { return !std::isspace(c); };
+    data.erase(data.begin(), std::find_if(data.begin(), data.end(), notSpace));
+    data.erase(std::find_if(data.rbegin(), data.rend(), notSpace).base(), data.end());
+}
+
+void String::toLowerCase() {
+    std::transform(data.begin(), data.end(), data.begin(), [](unsigned char c) { return std::tolower(c); });
+}
+
+void String::toUpperCase() {
+    std::transform(data.begin(), data.end(), data.begin(), [](unsigned char c) { return std::toupper(c); });
+}
+
+String operator+(const String &lhs, const String &rhs) {
+    String result{lhs};
+    result += rhs;
+    return result;
+}
+
+String operator+(const String &lhs, const char *rhs) {
+    String result{lhs};
+    result += rhs;
+    return result;
+}
+
+String operator+(const char *lhs, const String &rhs) {
+    String result{lhs};
+    result += rhs;
+    return result;
+}
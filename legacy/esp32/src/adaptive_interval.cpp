@@ -0,0 +1,42 @@
+#include "adaptive_interval.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Weight of the latest sample in the running mean and variance
+    constexpr float Alpha = 0.3;
+}
+
+APB::AdaptiveInterval::AdaptiveInterval(const Bounds &bounds) : _bounds{bounds}, _interval{bounds.minimum} {
+}
+
+uint32_t APB::AdaptiveInterval::update(float value) {
+    if(!std::isfinite(value)) {
+        return interval();
+    }
+    if(!mean) {
+        mean = value;
+        return interval();
+    }
+    const float delta = value - *mean;
+    *mean += Alpha * delta;
+    variance = (1 - Alpha) * (variance + Alpha * delta * delta);
+    const float activity = std::max(std::abs(delta), std::sqrt(variance)) / _bounds.threshold;
+
+    uint32_t next = interval();
+    if(boosted.exchange(false) || activity >= 2) {
+        next = _bounds.minimum;
+    } else if(activity >= 1) {
+        next /= 2;
+    } else if(activity < 0.5) {
+        next += next / 4 + 1;
+    }
+    next = std::clamp(next, _bounds.minimum, _bounds.maximum);
+    _interval.store(next, std::memory_order_relaxed);
+    return next;
+}
+
+void APB::AdaptiveInterval::boost() {
+    boosted = true;
+    _interval.store(_bounds.minimum, std::memory_order_relaxed);
+}
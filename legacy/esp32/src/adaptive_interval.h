@@ -0,0 +1,34 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <optional>
+
+namespace APB {
+
+// Sampling interval adapting to the signal being sampled.
+// It drops towards `minimum` when the signal moves by more than `threshold` between samples, or when its
+// short term standard deviation does, and grows back towards `maximum` while the signal is stable.
+// update() must be called by a single task, interval() and boost() can be called from any task.
+class AdaptiveInterval {
+public:
+    struct Bounds {
+        uint32_t minimum;
+        uint32_t maximum;
+        float threshold;
+    };
+    AdaptiveInterval(const Bounds &bounds);
+
+    // Feeds a sample, and returns the interval until the next one
+    uint32_t update(float value);
+    // Samples at the minimum interval until the next update, i.e. when a control loop is near its setpoint
+    void boost();
+    uint32_t interval() const { return _interval.load(std::memory_order_relaxed); }
+    const Bounds &bounds() const { return _bounds; }
+private:
+    const Bounds _bounds;
+    std::optional<float> mean;
+    float variance = 0;
+    std::atomic<uint32_t> _interval;
+    std::atomic<bool> boosted{false};
+};
+}
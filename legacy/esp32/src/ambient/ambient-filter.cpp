@@ -0,0 +1,70 @@
+#include "ambient-filter.h"
+#include <algorithm>
+#include <cmath>
+
+APB::MedianEMAFilter::MedianEMAFilter(float maxDeviation, float alpha) : maxDeviation{maxDeviation}, alpha{alpha} {
+}
+
+bool APB::MedianEMAFilter::push(float value) {
+    window[next] = value;
+    next = (next + 1) % Window;
+    size = std::min(size + 1, Window);
+
+    std::array<float, Window> sorted;
+    std::copy_n(window.begin(), size, sorted.begin());
+    std::sort(sorted.begin(), sorted.begin() + size);
+    median = size % 2 ? sorted[size / 2] : (sorted[size / 2 - 1] + sorted[size / 2]) / 2;
+    return std::abs(value - median) <= maxDeviation;
+}
+
+float APB::MedianEMAFilter::accept() {
+    average = average ? *average + alpha * (median - *average) : median;
+    return *average;
+}
+
+std::optional<float> APB::MedianEMAFilter::add(float value) {
+    if(!push(value)) {
+        return {};
+    }
+    return accept();
+}
+
+void APB::MedianEMAFilter::reset() {
+    size = 0;
+    next = 0;
+    average.reset();
+}
+
+APB::AmbientFilter::AmbientFilter(const Parameters &parameters) :
+    holdTimeout{parameters.holdTimeout},
+    temperature{parameters.maxTemperatureDeviation, parameters.alpha},
+    humidity{parameters.maxHumidityDeviation, parameters.alpha} {
+}
+
+std::optional<APB::AmbientFilter::Sample> APB::AmbientFilter::add(const std::optional<Sample> &sample, uint32_t now) {
+    // Outside of the SHT3x/SHT4x operating range: a glitched read
+    if(!sample || !std::isfinite(sample->temperature) || !std::isfinite(sample->humidity) ||
+        sample->temperature < -40 || sample->temperature > 125 || sample->humidity < 0 || sample->humidity > 100) {
+        return hold(now);
+    }
+    // Both channels are checked before averaging either: an outlier on one of them rejects the whole sample
+    const bool temperatureValid = temperature.push(sample->temperature);
+    const bool humidityValid = humidity.push(sample->humidity);
+    if(!temperatureValid || !humidityValid) {
+        _rejected++;
+        return hold(now);
+    }
+    lastGood = Sample{temperature.accept(), humidity.accept(), sample->timestamp};
+    return lastGood;
+}
+
+std::optional<APB::AmbientFilter::Sample> APB::AmbientFilter::hold(uint32_t now) {
+    if(lastGood && now - lastGood->timestamp <= holdTimeout) {
+        return lastGood;
+    }
+    // Too old to be trusted, and so is the filters history
+    lastGood.reset();
+    temperature.reset();
+    humidity.reset();
+    return {};
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace APB {
+
+// Single channel streaming filter: a rolling median over the last `Window` samples, rejecting samples further than
+// `maxDeviation` from it, followed by an exponential moving average of the median.
+class MedianEMAFilter {
+public:
+    static constexpr size_t Window = 5;
+    MedianEMAFilter(float maxDeviation, float alpha);
+    // Adds `value` to the window, and returns false if it's an outlier. Outliers still enter the window,
+    // so that the median follows a genuine step after Window/2 + 1 samples.
+    bool push(float value);
+    // Moves the average towards the median of the last push(), and returns it. Only for accepted samples.
+    float accept();
+    // push(), then accept() unless `value` is an outlier: returns the filtered value, or nothing.
+    std::optional<float> add(float value);
+    void reset();
+private:
+    const float maxDeviation;
+    const float alpha;
+    std::array<float, Window> window;
+    size_t size = 0;
+    size_t next = 0;
+    float median = 0;
+    std::optional<float> average;
+};
+
+// Filter stage between the ambient sensor driver and the published reading.
+// Failed reads, out of range values and outliers keep the last good reading, with its original timestamp,
+// until it's older than `holdTimeout`.
+class AmbientFilter {
+public:
+    struct Parameters {
+        float maxTemperatureDeviation;
+        float maxHumidityDeviation;
+        float alpha;
+        uint32_t holdTimeout;
+    };
+    struct Sample {
+        float temperature;
+        float humidity;
+        uint32_t timestamp;
+    };
+    AmbientFilter(const Parameters &parameters);
+    // Feeds the raw sample read at `now`, or nothing for a failed read, and returns the reading to publish.
+    std::optional<Sample> add(const std::optional<Sample> &sample, uint32_t now);
+    uint32_t rejected() const { return _rejected; }
+private:
+    const uint32_t holdTimeout;
+    MedianEMAFilter temperature;
+    MedianEMAFilter humidity;
+    std::optional<Sample> lastGood;
+    std::atomic<uint32_t> _rejected = 0;
+
+    std::optional<Sample> hold(uint32_t now);
+};
+}
@@ -0,0 +1,62 @@
+#include "ambient-fusion.h"
+#include <algorithm>
+#include <cmath>
+
+const char *APB::AmbientFusion::policyName(Policy policy) {
+    switch(policy) {
+    case Policy::WorstCaseDewpoint:
+        return "worst_case_dewpoint";
+    case Policy::Average:
+        return "average";
+    case Policy::First:
+        return "first";
+    }
+    return "unknown";
+}
+
+float APB::AmbientFusion::dewpoint(float temperature, float humidity) {
+    static const float dewpointA = 17.62;
+    static const float dewpointB = 243.12;
+    const float a_t_rh = log(humidity / 100.0) + (dewpointA * temperature / (dewpointB + temperature));
+    return (dewpointB * a_t_rh) / (dewpointA - a_t_rh);
+}
+
+std::optional<APB::AmbientFilter::Sample> APB::AmbientFusion::fuse(Policy policy, const std::optional<AmbientFilter::Sample> *samples, size_t count) {
+    const auto end = samples + count;
+    const auto first = std::find_if(samples, end, [](const auto &sample) { return sample.has_value(); });
+    if(first == end) {
+        return {};
+    }
+    switch(policy) {
+    case Policy::WorstCaseDewpoint: {
+        const auto *worst = &**first;
+        std::for_each(first, end, [&worst](const auto &sample) {
+            if(sample && dewpoint(sample->temperature, sample->humidity) > dewpoint(worst->temperature, worst->humidity)) {
+                worst = &*sample;
+            }
+        });
+        return *worst;
+    }
+    case Policy::Average: {
+        AmbientFilter::Sample average{0, 0, (*first)->timestamp};
+        size_t valid = 0;
+        std::for_each(first, end, [&](const auto &sample) {
+            if(sample) {
+                average.temperature += sample->temperature;
+                average.humidity += sample->humidity;
+                // Timestamps are millis(), compared by difference so that the rollover doesn't matter
+                if(static_cast<int32_t>(sample->timestamp - average.timestamp) < 0) {
+                    average.timestamp = sample->timestamp;
+                }
+                valid++;
+            }
+        });
+        average.temperature /= valid;
+        average.humidity /= valid;
+        return average;
+    }
+    case Policy::First:
+        return *first;
+    }
+    return {};
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <optional>
+#include "ambient-filter.h"
+
+// Fusion of the readings of several ambient sensors, i.e. at the tube and in the box, into the single reading
+// used for the dewpoint targets of the PWM outputs.
+namespace APB::AmbientFusion {
+enum class Policy : uint8_t {
+    // The reading with the highest dewpoint, so that heaters protect against the most humid spot
+    WorstCaseDewpoint,
+    // Mean temperature and humidity
+    Average,
+    // The first sensor with a valid reading, in discovery order
+    First,
+};
+const char *policyName(Policy policy);
+
+float dewpoint(float temperature, float humidity);
+
+// Sensors without a valid reading are skipped. The fused timestamp is the oldest among the readings used.
+std::optional<AmbientFilter::Sample> fuse(Policy policy, const std::optional<AmbientFilter::Sample> *samples, size_t count);
+}
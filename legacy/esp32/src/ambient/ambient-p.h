@@ -2,5 +2,68 @@
 #include "ambient.h"
 
 #include <ArduinoLog.h>
+#include <atomic>
+#include <optional>
+#include <utility>
+#include "i2c_wire.h"
 
 #define LOG_SCOPE "Ambient - "
+
+namespace APB::AmbientSensirion {
+  // CRC-8 of a SHT3x/SHT4x 16 bit word: polynomial 0x31, initialisation 0xFF
+  inline uint8_t crc(const uint8_t *word) {
+    uint8_t crc = 0xFF;
+    for(uint8_t i = 0; i < 2; i++) {
+      crc ^= word[i];
+      for(uint8_t bit = 0; bit < 8; bit++) {
+        crc = crc & 0x80 ? (crc << 1) ^ 0x31 : crc << 1;
+      }
+    }
+    return crc;
+  }
+
+  // Raw temperature and humidity words of a 6 bytes SHT3x/SHT4x measurement, if the transaction succeeded and both CRCs match.
+  inline std::optional<std::pair<uint16_t, uint16_t>> words(const char *sensor, I2C::Status status, const uint8_t *data, size_t length) {
+    if(status != I2C::Status::Ok || length != 6) {
+      Log.errorln(LOG_SCOPE "%s: error reading temperature/humidity: %s", sensor, I2C::statusName(status));
+      return {};
+    }
+    if(crc(data) != data[2] || crc(data + 3) != data[5]) {
+      Log.errorln(LOG_SCOPE "%s: error reading temperature/humidity: CRC mismatch", sensor);
+      return {};
+    }
+    return std::pair<uint16_t, uint16_t>(data[0] << 8 | data[1], data[3] << 8 | data[4]);
+  }
+
+  struct Model {
+    const char *name;
+    // Command reading the serial number, used to identify the model while probing
+    uint8_t serialCommand[2];
+    uint8_t serialCommandLength;
+    // Single shot measurement, without clock stretching so that the bus is free during the conversion
+    uint8_t measureCommand[2];
+    uint8_t measureCommandLength;
+    uint32_t conversionMs;
+    float (*humidity)(uint16_t word);
+  };
+  extern const Model SHT3x;
+  extern const Model SHT4x;
+
+  // TCA9548A I2C multiplexer: a single byte write selects the enabled downstream channels
+  inline const I2C::Device mux{"tca9548a", APB_AMBIENT_MUX_I2C_ADDRESS, APB_AMBIENT_I2C_CLOCK};
+  constexpr int8_t MuxChannels = 8;
+}
+
+struct APB::Ambient::Sensor {
+  Sensor(const AmbientSensirion::Model &model, uint8_t address, int8_t muxChannel);
+  const AmbientSensirion::Model &model;
+  // Downstream TCA9548A channel, or -1 for sensors on the main bus
+  const int8_t muxChannel;
+  char name[24];
+  const I2C::Device device;
+  AmbientFilter filter;
+  // Filtered reading, written by the I2C bus task
+  Snapshot<std::optional<Reading>> reading;
+  // Set by the control task when the measurement read couldn't be queued, published as a failed read by the bus task
+  std::atomic<bool> fetchMissed{false};
+};
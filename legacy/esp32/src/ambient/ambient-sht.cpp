@@ -0,0 +1,151 @@
+#include "ambient-p.h"
+#include <Wire.h>
+#include <algorithm>
+
+namespace {
+  float sht3xHumidity(uint16_t word) {
+    return 100 * static_cast<float>(word) / 65535;
+  }
+
+  float sht4xHumidity(uint16_t word) {
+    return std::clamp(-6 + 125 * static_cast<float>(word) / 65535, 0.f, 100.f);
+  }
+
+  // Synchronous transactions on Wire, only used while probing, before the I2C bus task starts.
+  bool writeCommand(uint8_t address, const uint8_t *command, uint8_t length) {
+    Wire.beginTransmission(address);
+    Wire.write(command, length);
+    return Wire.endTransmission() == 0;
+  }
+
+  bool identify(uint8_t address, const APB::AmbientSensirion::Model &model) {
+    if(!writeCommand(address, model.serialCommand, model.serialCommandLength)) {
+      return false;
+    }
+    delay(2);
+    uint8_t data[6];
+    if(Wire.requestFrom(static_cast<uint16_t>(address), static_cast<size_t>(6), true) != 6) {
+      return false;
+    }
+    Wire.readBytes(data, 6);
+    return APB::AmbientSensirion::crc(data) == data[2] && APB::AmbientSensirion::crc(data + 3) == data[5];
+  }
+
+  bool selectMuxChannel(int8_t channel) {
+    const uint8_t mask = channel < 0 ? 0 : 1 << channel;
+    return writeCommand(APB_AMBIENT_MUX_I2C_ADDRESS, &mask, 1);
+  }
+}
+
+#ifdef APB_AMBIENT_LOW_REPEATABILITY
+const APB::AmbientSensirion::Model APB::AmbientSensirion::SHT3x{"sht3x", {0x37, 0x80}, 2, {0x24, 0x16}, 2, 5, &sht3xHumidity};
+const APB::AmbientSensirion::Model APB::AmbientSensirion::SHT4x{"sht4x", {0x89}, 1, {0xE0}, 1, 2, &sht4xHumidity};
+#else
+const APB::AmbientSensirion::Model APB::AmbientSensirion::SHT3x{"sht3x", {0x37, 0x80}, 2, {0x24, 0x00}, 2, 16, &sht3xHumidity};
+const APB::AmbientSensirion::Model APB::AmbientSensirion::SHT4x{"sht4x", {0x89}, 1, {0xFD}, 1, 9, &sht4xHumidity};
+#endif
+
+APB::Ambient::Sensor::Sensor(const AmbientSensirion::Model &model, uint8_t address, int8_t muxChannel) :
+  model{model},
+  muxChannel{muxChannel},
+  name{},
+  device{name, address, APB_AMBIENT_I2C_CLOCK},
+  filter{{
+    APB_AMBIENT_FILTER_MAX_TEMPERATURE_DEVIATION,
+    APB_AMBIENT_FILTER_MAX_HUMIDITY_DEVIATION,
+    APB_AMBIENT_FILTER_ALPHA,
+    APB_AMBIENT_HOLD_LAST_GOOD_MS,
+  }} {
+  if(muxChannel < 0) {
+    snprintf(name, sizeof(name), "%s_0x%x", model.name, address);
+  } else {
+    snprintf(name, sizeof(name), "%s_0x%x_ch%d", model.name, address, muxChannel);
+  }
+}
+
+void APB::Ambient::probeSensors() {
+#ifdef APB_AMBIENT_TEMPERATURE_SENSOR_NONE
+  Log.infoln(LOG_SCOPE "No Ambient sensor installed");
+#else
+  static const uint8_t addresses[] = APB_AMBIENT_SENSOR_ADDRESSES;
+  static const AmbientSensirion::Model *models[] = {&AmbientSensirion::SHT4x, &AmbientSensirion::SHT3x};
+  hasMux = selectMuxChannel(-1);
+  if(hasMux) {
+    Log.infoln(LOG_SCOPE "TCA9548A multiplexer found at address 0x%x", APB_AMBIENT_MUX_I2C_ADDRESS);
+  }
+  // The main bus first, then every multiplexer channel
+  for(int8_t channel = -1; channel < (hasMux ? AmbientSensirion::MuxChannels : 0); channel++) {
+    if(hasMux) {
+      selectMuxChannel(channel);
+    }
+    for(const uint8_t address: addresses) {
+      const auto model = std::find_if(std::begin(models), std::end(models), [address](const AmbientSensirion::Model *model) {
+        return identify(address, *model);
+      });
+      if(model == std::end(models)) {
+        continue;
+      }
+      if(sensors.size() == APB_AMBIENT_MAX_SENSORS) {
+        Log.warningln(LOG_SCOPE "Ignoring %s at address 0x%x, channel %d: too many sensors", (*model)->name, address, channel);
+        continue;
+      }
+      const Sensor &sensor = *sensors.emplace_back(std::make_unique<Sensor>(**model, address, channel));
+      Log.infoln(LOG_SCOPE "Found ambient sensor %s", sensor.name);
+    }
+  }
+  if(hasMux) {
+    selectMuxChannel(-1);
+  }
+#endif
+}
+
+bool APB::Ambient::selectChannel(const Sensor &sensor) {
+  if(!hasMux) {
+    return true;
+  }
+  // Channels are deselected for sensors on the main bus, so that they can share an address with the downstream ones
+  const uint8_t mask = sensor.muxChannel < 0 ? 0 : 1 << sensor.muxChannel;
+  return I2C::Instance.submit(AmbientSensirion::mux, {mask}, 0, [](I2C::Status status, const uint8_t *, size_t) {
+    if(status != I2C::Status::Ok) {
+      Log.errorln(LOG_SCOPE "Error selecting multiplexer channel: %s", I2C::statusName(status));
+    }
+  });
+}
+
+bool APB::Ambient::triggerMeasurement(Sensor &sensor) {
+  const auto onTriggered = [this, &sensor](I2C::Status status, const uint8_t *, size_t) {
+    publishMissedReadings();
+    if(status != I2C::Status::Ok) {
+      Log.errorln(LOG_SCOPE "%s: error triggering measurement: %s", sensor.name, I2C::statusName(status));
+    }
+  };
+  if(!selectChannel(sensor)) {
+    return false;
+  }
+  const uint8_t *command = sensor.model.measureCommand;
+  if(sensor.model.measureCommandLength == 1) {
+    return I2C::Instance.submit(sensor.device, {command[0]}, 0, onTriggered);
+  }
+  return I2C::Instance.submit(sensor.device, {command[0], command[1]}, 0, onTriggered);
+}
+
+void APB::Ambient::fetchMeasurement(Sensor &sensor) {
+  const bool submitted = selectChannel(sensor) && I2C::Instance.submit(sensor.device, {}, 6, [this, &sensor](I2C::Status status, const uint8_t *data, size_t length) {
+    const auto words = AmbientSensirion::words(sensor.name, status, data, length);
+    if(!words) {
+      publishReading(sensor, std::nullopt);
+      return;
+    }
+    const Reading reading{-45 + 175 * static_cast<float>(words->first) / 65535, sensor.model.humidity(words->second)};
+    #ifdef DEBUG_AMBIENT_STATUS
+    Log.infoln(LOG_SCOPE "Ambient reading %s: T=%F, H=%F, D=%F", sensor.name, reading.temperature, reading.humidity, reading.dewpoint());
+    #endif
+    publishReading(sensor, reading);
+  });
+  // I2C queue full: a failed read, so that the filter timeout runs and the last sensor still triggers the fusion.
+  // The reading is only written by the bus task, which publishes it with its next callback.
+  if(!submitted) {
+    Log.warningln(LOG_SCOPE "%s: unable to queue the measurement read", sensor.name);
+    sensor.fetchMissed = true;
+  }
+}
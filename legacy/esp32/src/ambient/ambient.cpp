@@ -1,46 +1,184 @@
 #include "ambient-p.h"
 #include "ambient.h"
+#include "latency.h"
+#include "trace.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numeric>
 
 APB::Ambient &APB::Ambient::Instance = *new APB::Ambient();
 
 APB::Ambient::Ambient() {
 }
 
+APB::Ambient::~Ambient() {
+}
+
 
 void APB::Ambient::setup(Scheduler &scheduler) {
   Log.infoln(LOG_SCOPE "Ambient initialising");
-  initialised = initialiseSensor();
+  probeSensors();
+  initialised = !sensors.empty();
   if(initialised) {
-    readValuesTask.set(APB_AMBIENT_UPDATE_INTERVAL_SECONDS * 1000, TASK_FOREVER, std::bind(&Ambient::readSensor, this));
+    readValuesTask.set(sampling.interval(), TASK_FOREVER, Latency::task(scheduler, "ambient", std::bind(&Ambient::readSensors, this)));
     scheduler.addTask(readValuesTask);
-    readSensor();
+    // Blocking first reading, so that the PWM outputs can be restored at startup.
+    // The I2C bus task isn't running yet, so the transactions are processed here.
+    if(const auto conversionTime = triggerMeasurements()) {
+      while(I2C::Instance.process()) {}
+      delay(*conversionTime);
+      fetchMeasurements();
+      while(I2C::Instance.process()) {}
+    }
     readValuesTask.enable();
-    Log.infoln(LOG_SCOPE "Ambient initialised");
+    Log.infoln(LOG_SCOPE "Ambient initialised: %d sensors, fusion policy: %s",
+      sensors.size(), AmbientFusion::policyName(AmbientFusion::Policy::APB_AMBIENT_FUSION_POLICY));
   } else {
-    Log.errorln(LOG_SCOPE "Error initialising ambient sensor");
+    Log.errorln(LOG_SCOPE "No ambient sensor found");
+  }
+}
+
+void APB::Ambient::readSensors() {
+  if(!measuring) {
+    const auto conversionTime = triggerMeasurements();
+    if(conversionTime) {
+      measuring = true;
+      readValuesTask.delay(*conversionTime);
+    } else {
+      // I2C queue full: the reading is only updated by the bus task, retry at the next interval
+      Log.warningln(LOG_SCOPE "Unable to queue ambient measurements");
+      readValuesTask.delay(sampling.interval());
+    }
+    return;
+  }
+  measuring = false;
+  fetchMeasurements();
+  // The interval is updated by the fetch callbacks, so it's based on the readings up to the previous one
+  readValuesTask.delay(sampling.interval());
+}
+
+std::optional<uint32_t> APB::Ambient::triggerMeasurements() {
+  std::optional<uint32_t> conversionTime;
+  for(auto &sensor: sensors) {
+    if(triggerMeasurement(*sensor)) {
+      conversionTime = std::max(conversionTime.value_or(0), sensor->model.conversionMs);
+    }
+  }
+  return conversionTime;
+}
+
+void APB::Ambient::fetchMeasurements() {
+  for(auto &sensor: sensors) {
+    fetchMeasurement(*sensor);
+  }
+}
+
+void APB::Ambient::publishReading(Sensor &sensor, const std::optional<Reading> &reading) {
+  publishMissedReadings();
+  const uint32_t sampledAt = micros();
+  const auto index = std::find_if(sensors.begin(), sensors.end(), [&sensor](const auto &item) { return item.get() == &sensor; }) - sensors.begin();
+  Trace::Instance.add(Trace::Type::Ambient, index, 0, reading ? reading->temperature : NAN, reading ? reading->humidity : NAN);
+  // A single glitched or failed read must not reach the dewpoint targets of the PWM outputs.
+  const uint32_t now = millis();
+  std::optional<AmbientFilter::Sample> sample;
+  if(reading) {
+    sample = AmbientFilter::Sample{reading->temperature, reading->humidity, now};
+  }
+  const auto filtered = sensor.filter.add(sample, now);
+  if(filtered) {
+    sensor.reading.write(Reading{filtered->temperature, filtered->humidity, filtered->timestamp});
+  } else {
+    if(sensor.reading.read()) {
+      Log.warningln(LOG_SCOPE "%s: no valid reading for %dms, discarding the last one", sensor.name, APB_AMBIENT_HOLD_LAST_GOOD_MS);
+    }
+    sensor.reading.write(std::nullopt);
+  }
+  // Sensors are fetched in order in a single pass: fuse once all of them are done
+  if(&sensor == sensors.back().get()) {
+    fuseReadings(sampledAt);
   }
 }
 
+void APB::Ambient::publishMissedReadings() {
+  for(auto &sensor: sensors) {
+    if(sensor->fetchMissed.exchange(false)) {
+      publishReading(*sensor, std::nullopt);
+    }
+  }
+}
+
+void APB::Ambient::fuseReadings(uint32_t sampledAt) {
+  std::array<std::optional<AmbientFilter::Sample>, APB_AMBIENT_MAX_SENSORS> sensorSamples;
+  for(size_t index = 0; index < sensors.size(); index++) {
+    if(const auto reading = sensors[index]->reading.read()) {
+      sensorSamples[index] = AmbientFilter::Sample{reading->temperature, reading->humidity, reading->timestamp};
+    }
+  }
+  const auto fused = AmbientFusion::fuse(AmbientFusion::Policy::APB_AMBIENT_FUSION_POLICY, sensorSamples.data(), sensors.size());
+  if(!fused) {
+    _reading.write(std::nullopt);
+    samples.publish({std::nullopt, sampledAt});
+    return;
+  }
+  const auto previous = _reading.read();
+  const Reading published{fused->temperature, fused->humidity, fused->timestamp};
+  _reading.write(published);
+  // Held readings don't carry any new information for the sampling interval
+  if(!previous || previous->timestamp != published.timestamp) {
+    sampling.update(published.dewpoint());
+  }
+  samples.publish({published, sampledAt});
+}
+
 bool APB::Ambient::isInitialised() const {
   return initialised;
 }
 
+const char *APB::Ambient::sensorName(size_t index) const {
+  return sensors[index]->name;
+}
+
+std::optional<APB::Ambient::Reading> APB::Ambient::sensorReading(size_t index) const {
+  return sensors[index]->reading.read();
+}
+
+uint32_t APB::Ambient::rejectedReadings() const {
+  return std::accumulate(sensors.begin(), sensors.end(), uint32_t{0}, [](uint32_t rejected, const auto &sensor) {
+    return rejected + sensor->filter.rejected();
+  });
+}
+
 
 float APB::Ambient::Reading::dewpoint() const {
   return calculateDewpoint(temperature, humidity);
 }
 
-
+uint32_t APB::Ambient::Reading::age() const {
+  return millis() - timestamp;
+}
 
 float APB::Ambient::calculateDewpoint(float temperature, float humidity) {
-  static const float dewpointA = 17.62;
-  static const float dewpointB = 243.12;
-  const float a_t_rh = log(humidity / 100.0) + (dewpointA * temperature / (dewpointB + temperature));
-  return (dewpointB * a_t_rh) / (dewpointA - a_t_rh);
+  return AmbientFusion::dewpoint(temperature, humidity);
 }
 
 void APB::Ambient::toJson(JsonObject ambientStatus) {
-    ambientStatus["temperature"] = _reading->temperature;
-    ambientStatus["humidity"] = _reading->humidity;
-    ambientStatus["dewpoint"] = _reading->dewpoint();
-}
\ No newline at end of file
+    // The reading may have been lost since the caller checked it
+    const auto reading = _reading.read();
+    if(!reading) {
+        return;
+    }
+    ambientStatus["temperature"] = reading->temperature;
+    ambientStatus["humidity"] = reading->humidity;
+    ambientStatus["dewpoint"] = reading->dewpoint();
+    JsonArray sensorsStatus = ambientStatus["sensors"].to<JsonArray>();
+    for(const auto &sensor: sensors) {
+        JsonObject sensorStatus = sensorsStatus.add<JsonObject>();
+        sensorStatus["name"] = sensor->name;
+        if(const auto sensorReading = sensor->reading.read()) {
+            sensorStatus["temperature"] = sensorReading->temperature;
+            sensorStatus["humidity"] = sensorReading->humidity;
+            sensorStatus["dewpoint"] = sensorReading->dewpoint();
+        }
+    }
+}
@@ -2,10 +2,17 @@
 #define APB_AMBIENT_H
 
 #include <TaskSchedulerDeclarations.h>
+#include <memory>
 #include <optional>
+#include <vector>
 #include <ArduinoJson.h>
 
 #include "configuration.h"
+#include "snapshot.h"
+#include "topic.h"
+#include "adaptive_interval.h"
+#include "ambient-filter.h"
+#include "ambient-fusion.h"
 
 
 namespace APB {
@@ -14,24 +21,67 @@ class Ambient {
 public:
     static Ambient &Instance;
     Ambient();
+    ~Ambient();
     void setup(Scheduler &scheduler);
     struct Reading {
         float temperature;
         float humidity;
+        // millis() when the sample was taken. Held readings keep their original timestamp.
+        uint32_t timestamp = 0;
         float dewpoint() const;
+        uint32_t age() const;
     };
-    std::optional<Reading> reading() const { return _reading; };
+    struct Sample {
+        // Fused reading, or nothing once all the sensors are lost
+        std::optional<Reading> reading;
+        // micros() when the sensors were read, for the sensor to PWM latency
+        uint32_t sampledAt;
+    };
+    // Fused reading of all the sensors, according to APB_AMBIENT_FUSION_POLICY
+    std::optional<Reading> reading() const { return _reading.read(); };
+    // Every fused sample, published by the I2C bus task once per sampling pass
+    Topic<Sample> samples;
     bool isInitialised() const;
+    size_t sensorsCount() const { return sensors.size(); }
+    const char *sensorName(size_t index) const;
+    std::optional<Reading> sensorReading(size_t index) const;
+    uint32_t samplingInterval() const { return sampling.interval(); }
+    // Samples rejected as outliers by the filter stage, for all the sensors
+    uint32_t rejectedReadings() const;
+    // Samples at the fastest rate, i.e. while a PWM output is close to its dewpoint target
+    void boostSampling() { sampling.boost(); }
+
+    // Sensor drivers: sensors discovered on the bus, the TCA9548A multiplexer channels included
+    struct Sensor;
+    std::vector<std::unique_ptr<Sensor>> sensors;
+    bool hasMux = false;
+    void probeSensors();
+    bool selectChannel(const Sensor &sensor);
+    // Sensor drivers: starts a conversion, returning false if the transactions were not queued.
+    bool triggerMeasurement(Sensor &sensor);
+    // Sensor drivers: reads the conversion started by triggerMeasurement(). The reading is published by the I2C bus task.
+    void fetchMeasurement(Sensor &sensor);
 
     Task readValuesTask;
     bool initialised = false;
-    bool initialiseSensor();
-    void readSensor();
-    std::optional<Reading> _reading;
+    // Alternates between starting a conversion on all the sensors and fetching the results, so the scheduler never waits for them.
+    void readSensors();
+    // Milliseconds to wait before fetching the conversions, or nothing if none was queued.
+    std::optional<uint32_t> triggerMeasurements();
+    void fetchMeasurements();
+    bool measuring = false;
+    // Called by the sensor drivers from the I2C bus task, with the raw reading or nothing on errors
+    void publishReading(Sensor &sensor, const std::optional<Reading> &reading);
+    // Called by the sensor drivers from the I2C bus task: publishes the reads that couldn't be queued as failed
+    void publishMissedReadings();
+    void fuseReadings(uint32_t sampledAt);
+    AdaptiveInterval sampling{{APB_AMBIENT_SAMPLING_MIN_MS, APB_AMBIENT_SAMPLING_MAX_MS, APB_AMBIENT_SAMPLING_THRESHOLD}};
+    // Written by the I2C bus task
+    Snapshot<std::optional<Reading>> _reading;
     static float calculateDewpoint(float temperature, float humidity);
     void toJson(JsonObject ambientStatus);
 };
 
 }
 
-#endif
\ No newline at end of file
+#endif
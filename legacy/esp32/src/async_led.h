@@ -2,77 +2,75 @@
 #define ASYNC_LED_H
 #include <unistd.h>
 #include <Arduino.h>
-#include <list>
-#include <Ticker.h>
-#include <TaskSchedulerDeclarations.h>
+#include <mutex>
+#include <esp_timer.h>
+#include "led_pattern.h"
 
+// Plays LedPattern step tables with a one-shot esp_timer, armed only at transitions:
+// a steady LED costs no timer callbacks, and no scheduler task.
 class AsyncLed {
 public:
     AsyncLed(uint8_t pin, bool invertLogic=false) : pin{pin}, invertLogic{invertLogic} {
    }
 
-    void setup(Scheduler *scheduler) {
+    void setup() {
         pinMode(pin, OUTPUT);
-        writePin(false);
-        leds.push_back(this);
-        AsyncLed::setupTask(scheduler);
+        const esp_timer_create_args_t timerArgs{
+            .callback = &AsyncLed::onTimer,
+            .arg = this,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "led",
+        };
+        std::lock_guard<std::mutex> lock(mutex);
+        esp_timer_create(&timerArgs, &timer);
+        step = 0;
+        playStep();
     }
 
     float duty() const {
         return _duty;
     }
 
-    static void setupTask(Scheduler *scheduler) {
-        if(task) {
-            return;
-        }
-        task = new Task(100, TASK_FOREVER, [](){
-            // Serial.println("Task running");
-            for(auto led: leds) {
-                led->loop();
-            }
-        }, scheduler, true);
-        // Serial.printf("Ticker active: %d\n", ticker.active());  
-    }
-
     void on() {
-        repeats = 0;
-        writePin(true);
+        setPattern(APB::LedPattern::steady(true));
     }
 
     void off() {
-        repeats = 0;
-        writePin(false);
+        setPattern(APB::LedPattern::steady(false));
     }
 
-    // Each "blink" is 100ms
+    // Each "blink" is APB::LedPattern::BlinkMs
     void setPattern(uint8_t onBlinks, uint8_t offBlinks, uint8_t repeats=1, uint8_t blinksBetweenRepeats=0, bool stateBetweenRepeats = false) {
-        this->onBlinks = onBlinks;
-        this->offBlinks = offBlinks;
-        this->repeats = repeats;
-        this->blinksBetweenRepeats = blinksBetweenRepeats;
-        this->blinksToNextStep = onBlinks;
-        this->step = 0;
-        this->stateBetweenRepeats = stateBetweenRepeats;
+        setPattern(APB::LedPattern::blink(onBlinks, offBlinks, repeats, blinksBetweenRepeats, stateBetweenRepeats));
     }
 
-    void setDuty(float duty) { this->_duty = duty; }
+    void setPattern(const APB::LedPattern &pattern) {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->pattern = pattern;
+        step = 0;
+        if(timer) {
+            esp_timer_stop(timer);
+            playStep();
+        }
+    }
+
+    void setDuty(float duty) {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->_duty = duty;
+        if(timer) {
+            writePin(pattern.steps[step].on);
+        }
+    }
 
 private:
     uint8_t pin;
     bool invertLogic;
-    uint8_t onBlinks;
-    uint8_t offBlinks;
-    uint8_t repeats;
-    uint8_t blinksBetweenRepeats;
-
-    uint8_t blinksToNextStep;
-    uint8_t step;
-    bool stateBetweenRepeats;
+    APB::LedPattern pattern;
+    uint8_t step = 0;
     float _duty = 1;
-
-
-    
+    esp_timer_handle_t timer = nullptr;
+    // setPattern() and setDuty() run on the Arduino loop and WiFi event tasks, the timer callback on the esp_timer task
+    std::mutex mutex;
 
     void writePin(bool on) {
         if(_duty != 1) {
@@ -82,29 +80,25 @@ private:
         }
     }
 
-    void loop() {
-        if(repeats == 0) {
-            return;
+    // Writes the current step, and arms the timer for the next transition
+    void playStep() {
+        const APB::LedPattern::Step &current = pattern.steps[step];
+        writePin(current.on);
+        if(pattern.animated()) {
+            esp_timer_start_once(timer, current.durationMs * 1000ull);
         }
-        uint8_t steps = 2 * repeats;
-        bool state = (step == steps) ? stateBetweenRepeats : (step%2 == 0);
-        // Serial.printf("LED loop: steps=%d, blinksToNextStep=%d, step=%d, on=%d\n", steps, blinksToNextStep, step, state);
+    }
 
-        if(blinksToNextStep > 0) {
-            blinksToNextStep--;
-            writePin(state);
+    static void onTimer(void *arg) {
+        AsyncLed *led = static_cast<AsyncLed*>(arg);
+        std::lock_guard<std::mutex> lock(led->mutex);
+        // setPattern() restarted the timer while this callback was waiting for the lock
+        if(esp_timer_is_active(led->timer)) {
             return;
         }
-        step = (step+1) % (steps+1);
-
-        blinksToNextStep = !state ? onBlinks : offBlinks;
-        if(step == steps) {
-            blinksToNextStep = blinksBetweenRepeats;
-        }
-
+        led->step = (led->step + 1) % led->pattern.size;
+        led->playStep();
     }
-    static inline Task *task = nullptr;
-    static inline std::list<AsyncLed*> leds;
 };
 
 #endif
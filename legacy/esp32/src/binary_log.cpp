@@ -0,0 +1,190 @@
+#include "binary_log.h"
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define LOG_SCOPE "APB::BinaryLog "
+
+static_assert((APB_BINARY_LOG_BYTES & (APB_BINARY_LOG_BYTES - 1)) == 0, "The binary log size must be a power of two");
+static_assert((APB_BINARY_LOG_PSRAM_BYTES & (APB_BINARY_LOG_PSRAM_BYTES - 1)) == 0, "The binary log size must be a power of two");
+
+APB::BinaryLog &APB::BinaryLog::Instance = *new APB::BinaryLog();
+
+void APB::BinaryLog::setup() {
+    std::lock_guard<std::mutex> lock(mutex);
+    dropped = 0;
+    if(!ring.allocate(APB_BINARY_LOG_BYTES, APB_BINARY_LOG_PSRAM_BYTES)) {
+        Log.errorln(LOG_SCOPE "Unable to allocate the log buffer");
+        return;
+    }
+    Log.infoln(LOG_SCOPE "Logging up to %d bytes, level %d", ring.capacity(), APB_BINARY_LOG_LEVEL);
+}
+
+void APB::BinaryLog::push(Format format, const uint8_t *arguments, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(ring.capacity() == 0) {
+        return;
+    }
+    const Record record{static_cast<uint32_t>(millis()), format, static_cast<uint8_t>(size), 0};
+    while(ring.full(sizeof(Record) + size)) {
+        ring.drop(ring.tail() + sizeof(Record) + recordAt(ring.tail()).size);
+        dropped++;
+    }
+    ring.append(&record, sizeof(Record));
+    ring.append(arguments, size);
+}
+
+void APB::BinaryLog::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    ring.clear();
+    dropped = 0;
+}
+
+size_t APB::BinaryLog::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return ring.size();
+}
+
+APB::BinaryLog::Record APB::BinaryLog::recordAt(uint32_t offset) const {
+    Record record;
+    ring.read(offset, &record, sizeof(Record));
+    return record;
+}
+
+size_t APB::BinaryLog::format(const Record &record, const uint8_t *arguments, char *buffer, size_t size) {
+    static const char levels[] = "SFEWITV";
+    if(size == 0) {
+        return 0;
+    }
+    if(static_cast<size_t>(record.format) >= std::size(formats)) {
+        return std::min<size_t>(snprintf(buffer, size, "%.3f ?: unknown format %d\n", record.timestamp / 1000.0, static_cast<int>(record.format)), size - 1);
+    }
+    const FormatInfo &info = formats[static_cast<size_t>(record.format)];
+    size_t length = std::min<size_t>(snprintf(buffer, size, "%.3f %c: ", record.timestamp / 1000.0, levels[std::clamp(info.level, 0, 6)]), size - 1);
+    size_t offset = 0;
+    auto append = [&](const char *format, auto value) {
+        length += std::min<size_t>(snprintf(buffer + length, size - length, format, value), size - 1 - length);
+    };
+    for(const char *c = info.format; *c && length + 1 < size; c++) {
+        if(*c != '%' || *++c == '%') {
+            buffer[length++] = *c;
+            continue;
+        }
+        if(*c == 'T') {
+            if(offset + 1 > record.size) {
+                break;
+            }
+            append("%s", arguments[offset++] ? "true" : "false");
+            continue;
+        }
+        if(offset + 4 > record.size) {
+            break;
+        }
+        if(*c == 'F') {
+            float value;
+            memcpy(&value, arguments + offset, sizeof(value));
+            append("%.2f", value);
+        } else {
+            int32_t value;
+            memcpy(&value, arguments + offset, sizeof(value));
+            if(*c == 'x') {
+                append("%lx", static_cast<unsigned long>(static_cast<uint32_t>(value)));
+            } else {
+                append("%ld", static_cast<long>(value));
+            }
+        }
+        offset += 4;
+    }
+    if(length + 1 < size) {
+        buffer[length++] = '\n';
+    }
+    buffer[length] = 0;
+    return length;
+}
+
+bool APB::BinaryLog::decode(const uint8_t *bytes, size_t size, const std::function<void(const char *line)> &onLine) {
+    const Header expected{};
+    Header header;
+    if(size < sizeof(Header)) {
+        return false;
+    }
+    memcpy(&header, bytes, sizeof(Header));
+    if(memcmp(header.magic, expected.magic, 4) != 0 || header.version != expected.version || header.formatsHash != expected.formatsHash) {
+        return false;
+    }
+    char line[256];
+    for(size_t offset = sizeof(Header); offset + sizeof(Record) <= size;) {
+        Record record;
+        memcpy(&record, bytes + offset, sizeof(Record));
+        offset += sizeof(Record);
+        if(offset + record.size > size) {
+            break;
+        }
+        format(record, bytes + offset, line, sizeof(line));
+        onLine(line);
+        offset += record.size;
+    }
+    return true;
+}
+
+APB::BinaryLog::Serialiser::Serialiser(BinaryLog &log, bool text) : log{log}, text{text} {
+    std::lock_guard<std::mutex> lock(log.mutex);
+    header.timestamp = millis();
+    header.dropped = log.dropped;
+    next = log.ring.tail();
+    end = log.ring.head();
+}
+
+size_t APB::BinaryLog::Serialiser::write(uint8_t *buffer, size_t maxLen, size_t index) {
+    // Chunks only hold whole records, or lines unless they are longer than a chunk
+    size_t length = 0;
+    if(index == 0 && !text) {
+        if(maxLen < sizeof(Header)) {
+            return RESPONSE_TRY_AGAIN;
+        }
+        memcpy(buffer, &header, sizeof(Header));
+        length += sizeof(Header);
+    }
+    if(lineSent < lineLength) {
+        length = std::min(lineLength - lineSent, maxLen);
+        memcpy(buffer, line + lineSent, length);
+        lineSent += length;
+        return length;
+    }
+    std::lock_guard<std::mutex> lock(log.mutex);
+    if(log.ring.capacity() == 0) {
+        return length;
+    }
+    log.ring.skipOverwritten(next, end);
+    uint8_t arguments[UINT8_MAX];
+    while(next != end) {
+        const Record record = log.recordAt(next);
+        const size_t size = sizeof(Record) + record.size;
+        if(text) {
+            log.ring.read(next + sizeof(Record), arguments, record.size);
+            lineLength = format(record, arguments, line, sizeof(line));
+            if(length + lineLength > maxLen && length > 0) {
+                lineLength = 0;
+                break;
+            }
+            lineSent = std::min(lineLength, maxLen - length);
+            memcpy(buffer + length, line, lineSent);
+            length += lineSent;
+        } else {
+            if(length + size > maxLen) {
+                break;
+            }
+            log.ring.read(next, buffer + length, size);
+            length += size;
+        }
+        next += size;
+        if(lineSent < lineLength) {
+            break;
+        }
+    }
+    // Returning 0 would end the response with records left: the chunk is too small for the next one
+    return length == 0 && next != end ? RESPONSE_TRY_AGAIN : length;
+}
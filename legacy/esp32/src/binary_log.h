@@ -0,0 +1,178 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <functional>
+#include <mutex>
+#include <type_traits>
+#include <ArduinoLog.h>
+
+#include "configuration.h"
+#include "byte_ring.h"
+
+// Deferred log of the control loops messages: records of a format id and the raw arguments in a ring buffer, formatted only
+// when read, as text from /api/logs/binary?format=text, or on the host from the binary download with bench/native.sh log_decode.
+// Formats above APB_BINARY_LOG_LEVEL compile to nothing, arguments included.
+
+// X(id, level, format). Arguments: %d integer, %x integer as hex, %F float, %T bool, checked at compile time.
+// The host decoder only accepts downloads from a build with the same table.
+#define APB_BINARY_LOG_FORMATS(X) \
+    X(PWMOutputTarget, LOG_LEVEL_TRACE, "PWMOutput[%d] - Got target temperature=`%F`, current temperature=`%F`") \
+    X(PWMOutputRamp, LOG_LEVEL_INFO, "PWMOutput[%d] - temperature `%F` lower than target temperature `%F`, ramp=`%F` and PWM range is `%F-%F`, ramp factor=`%F`, setting PWM to `%F`") \
+    X(PWMOutputReached, LOG_LEVEL_INFO, "PWMOutput[%d] - temperature `%F` reached target temperature `%F`, setting PWM to 0") \
+    X(PWMOutputSetPWM, LOG_LEVEL_TRACE, "PWMOutput[%d] - setting PWM=%d for pin %d") \
+    X(FanDuty, LOG_LEVEL_TRACE, "APB::Fan Fan duty %F (analog value %d) on channel %d")
+
+#define APB_BINARY_LOG(id, ...) do { \
+    if constexpr(APB::BinaryLog::enabled(APB::BinaryLog::Format::id)) { \
+        APB::BinaryLog::Instance.add<APB::BinaryLog::Format::id>(__VA_ARGS__); \
+    } \
+} while(false)
+
+namespace APB {
+
+class BinaryLog {
+public:
+    enum class Format : uint8_t {
+#define APB_BINARY_LOG_FORMAT_ID(id, level, format) id,
+        APB_BINARY_LOG_FORMATS(APB_BINARY_LOG_FORMAT_ID)
+#undef APB_BINARY_LOG_FORMAT_ID
+    };
+    struct FormatInfo {
+        int level;
+        const char *format;
+    };
+    static constexpr FormatInfo formats[] = {
+#define APB_BINARY_LOG_FORMAT_INFO(id, level, format) {level, format},
+        APB_BINARY_LOG_FORMATS(APB_BINARY_LOG_FORMAT_INFO)
+#undef APB_BINARY_LOG_FORMAT_INFO
+    };
+    static constexpr bool enabled(Format format) { return formats[static_cast<size_t>(format)].level <= APB_BINARY_LOG_LEVEL; }
+
+    // Stored in the ring and downloaded as is, followed by `size` bytes of arguments: int32_t, float, or one byte for bools
+    struct Record {
+        // millis()
+        uint32_t timestamp;
+        Format format;
+        uint8_t size;
+        uint16_t reserved;
+    };
+    static_assert(sizeof(Record) == 8, "Log records are downloaded as raw bytes");
+
+    // Starts a binary download, followed by the records as stored, oldest first. Little endian, as the ESP32.
+    struct Header {
+        char magic[4] = {'A', 'P', 'B', 'L'};
+        uint8_t version = 1;
+        uint8_t reserved[3] = {};
+        uint32_t formatsHash = BinaryLog::formatsHash();
+        // millis() when the download started
+        uint32_t timestamp;
+        // Records overwritten since boot or the last clear
+        uint32_t dropped;
+    };
+    static_assert(sizeof(Header) == 20, "Log headers are downloaded as raw bytes");
+
+    // To be called at boot, before logging: records are dropped until then.
+    void setup();
+    // Use APB_BINARY_LOG, that compiles away formats above the threshold
+    template<Format id, typename... Args> void add(Args... args) {
+        static_assert(matches<Args...>(formats[static_cast<size_t>(id)].format), "Binary log arguments don't match the format");
+        std::array<uint8_t, (0 + ... + encodedSize<Args>())> arguments;
+        size_t offset = 0;
+        (encode(arguments.data(), offset, args), ...);
+        push(id, arguments.data(), arguments.size());
+    }
+    void clear();
+    size_t capacity() const { return ring.capacity(); }
+    // Bytes used by the records
+    size_t size() const;
+
+    // Writes "<seconds> <level>: <message>\n", truncated to `size`, and returns the length
+    static size_t format(const Record &record, const uint8_t *arguments, char *buffer, size_t size);
+    // Formats a download line by line, false if it's not from a build with the same formats
+    static bool decode(const uint8_t *bytes, size_t size, const std::function<void(const char *line)> &onLine);
+
+    // Writes the log in chunks, for AsyncWebServer chunked responses: binary, or formatted as text.
+    // Records overwritten while downloading are skipped. Returns RESPONSE_TRY_AGAIN when a binary chunk can't hold the
+    // header or the next record, 0 at the end of the log.
+    class Serialiser {
+    public:
+        Serialiser(BinaryLog &log, bool text);
+        size_t write(uint8_t *buffer, size_t maxLen, size_t index);
+    private:
+        BinaryLog &log;
+        const bool text;
+        Header header;
+        uint32_t next;
+        uint32_t end;
+        // Text line longer than the last chunk
+        char line[256];
+        size_t lineLength = 0;
+        size_t lineSent = 0;
+    };
+
+    static BinaryLog &Instance;
+private:
+    // Records followed by their arguments, from the tail
+    ByteRing ring;
+    uint32_t dropped = 0;
+    mutable std::mutex mutex;
+
+    void push(Format format, const uint8_t *arguments, size_t size);
+    // Requires the mutex
+    Record recordAt(uint32_t offset) const;
+
+    template<typename T> static constexpr char kind() {
+        if constexpr(std::is_same_v<T, bool>) {
+            return 'T';
+        } else if constexpr(std::is_floating_point_v<T>) {
+            return 'F';
+        } else if constexpr(std::is_integral_v<T> || std::is_enum_v<T>) {
+            return 'd';
+        }
+        return 0;
+    }
+    template<typename T> static constexpr size_t encodedSize() { return kind<T>() == 'T' ? 1 : 4; }
+
+    template<typename... Args> static constexpr bool matches(const char *format) {
+        constexpr char kinds[] = {kind<Args>()..., 0};
+        size_t argument = 0;
+        for(const char *c = format; *c; c++) {
+            if(*c != '%' || *++c == '%') {
+                continue;
+            }
+            if(argument == sizeof...(Args) || kinds[argument++] != (*c == 'x' ? 'd' : *c)) {
+                return false;
+            }
+        }
+        return argument == sizeof...(Args);
+    }
+
+    template<typename T> static void encode(uint8_t *arguments, size_t &offset, T value) {
+        if constexpr(kind<T>() == 'T') {
+            arguments[offset++] = value;
+        } else if constexpr(kind<T>() == 'F') {
+            const float encoded = value;
+            memcpy(arguments + offset, &encoded, sizeof(encoded));
+            offset += sizeof(encoded);
+        } else {
+            const int32_t encoded = static_cast<int32_t>(value);
+            memcpy(arguments + offset, &encoded, sizeof(encoded));
+            offset += sizeof(encoded);
+        }
+    }
+
+    static constexpr uint32_t formatsHash() {
+        // FNV-1a of the levels and formats
+        uint32_t hash = 2'166'136'261u;
+        for(const auto &format: formats) {
+            hash = (hash ^ static_cast<uint8_t>(format.level)) * 16'777'619u;
+            for(const char *c = format.format; *c; c++) {
+                hash = (hash ^ static_cast<uint8_t>(*c)) * 16'777'619u;
+            }
+        }
+        return hash;
+    }
+};
+}
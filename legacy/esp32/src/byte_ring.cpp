@@ -0,0 +1,46 @@
+#include "byte_ring.h"
+#include <Arduino.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+bool APB::ByteRing::allocate(size_t bytes, size_t psramBytes) {
+    _tail = _head = 0;
+    if(buffer) {
+        return true;
+    }
+#ifdef BOARD_HAS_PSRAM
+    _capacity = psramBytes;
+    buffer = static_cast<uint8_t*>(ps_malloc(_capacity));
+#endif
+    if(!buffer) {
+        _capacity = bytes;
+        buffer = static_cast<uint8_t*>(malloc(_capacity));
+    }
+    if(!buffer) {
+        _capacity = 0;
+    }
+    return buffer;
+}
+
+void APB::ByteRing::append(const void *data, size_t size) {
+    // Offsets wrap around consistently as the capacity divides 2^32
+    const size_t position = _head & (_capacity - 1);
+    const size_t first = std::min(size, _capacity - position);
+    memcpy(buffer + position, data, first);
+    memcpy(buffer, static_cast<const uint8_t*>(data) + first, size - first);
+    _head += size;
+}
+
+void APB::ByteRing::read(uint32_t offset, void *destination, size_t size) const {
+    const size_t position = offset & (_capacity - 1);
+    const size_t first = std::min(size, _capacity - position);
+    memcpy(destination, buffer + position, first);
+    memcpy(static_cast<uint8_t*>(destination) + first, buffer, size - first);
+}
+
+void APB::ByteRing::skipOverwritten(uint32_t &next, uint32_t end) const {
+    if(before(next, _tail)) {
+        next = before(end, _tail) ? end : _tail;
+    }
+}
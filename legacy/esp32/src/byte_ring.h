@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Ring buffer of bytes under the log ring, the binary log and the trace. Bytes are addressed by offsets counted since
+// boot, so that readers can tell what was overwritten since their last chunk. The owner drops the oldest bytes itself,
+// knowing where its records start, and holds its own mutex around every call.
+namespace APB {
+
+class ByteRing {
+public:
+    // Allocates `psramBytes` in PSRAM when the board has it, `bytes` otherwise, both powers of two, then empties the ring.
+    // A buffer from a previous call is kept. False without any buffer: the ring then has no capacity.
+    bool allocate(size_t bytes, size_t psramBytes);
+    size_t capacity() const { return _capacity; }
+    // Offset of the oldest byte, and of the next one appended
+    uint32_t tail() const { return _tail; }
+    uint32_t head() const { return _head; }
+    size_t size() const { return _head - _tail; }
+    // Whether appending `size` bytes requires dropping some first
+    bool full(size_t size) const { return this->size() + size > _capacity; }
+
+    // Appends at the head. The owner must have made room first, with `full()` and `drop()`: older bytes are overwritten otherwise
+    void append(const void *data, size_t size);
+    void read(uint32_t offset, void *destination, size_t size) const;
+    uint8_t at(uint32_t offset) const { return buffer[offset & (_capacity - 1)]; }
+    // Forgets the bytes before `offset`
+    void drop(uint32_t offset) { _tail = offset; }
+    void clear() { _tail = _head; }
+
+    // Moves a reader from `next` to the oldest byte if what it was about to read was overwritten, without passing `end`
+    void skipOverwritten(uint32_t &next, uint32_t end) const;
+    // Offsets comparison, across wraps of the 32 bits counter
+    static bool before(uint32_t offset, uint32_t other) { return static_cast<int32_t>(offset - other) < 0; }
+private:
+    uint8_t *buffer = nullptr;
+    size_t _capacity = 0;
+    uint32_t _tail = 0;
+    uint32_t _head = 0;
+};
+}
@@ -17,9 +17,19 @@
 #define APB_STATUS_LED_INVERT_LOGIC false
 #define WIFIMANAGER_MAX_STATIONS 5
 #define APB_NETWORK_LOGGER_BACKLOG 20
-#define APB_AMBIENT_UPDATE_INTERVAL_SECONDS 5
-#define APB_PWM_OUTPUT_UPDATE_INTERVAL_SECONDS 5
-#define APB_AMBIENT_TEMPERATURE_SENSOR_I2C_ADDRESS 0x44
+// Bytes of log lines kept for /api/logs. Powers of two, boards with PSRAM keep a longer log there.
+// The three rings in PSRAM (log, trace and binary log) take 448 KiB together, leaving most of a 2 MiB PSRAM free.
+#define APB_LOG_RING_BYTES 16'384
+#define APB_LOG_RING_PSRAM_BYTES 131'072
+// SHT3x/SHT4x ambient sensors are probed at these addresses on the main bus, and on every channel of a TCA9548A multiplexer if present
+#define APB_AMBIENT_SENSOR_ADDRESSES {0x44, 0x45, 0x46}
+#define APB_AMBIENT_MUX_I2C_ADDRESS 0x70
+#define APB_AMBIENT_MAX_SENSORS 4
+// Boards without ambient sensors skip probing with APB_AMBIENT_TEMPERATURE_SENSOR_NONE
+// How the readings of several ambient sensors are combined: WorstCaseDewpoint, Average or First
+#define APB_AMBIENT_FUSION_POLICY WorstCaseDewpoint
+// Low repeatability ambient measurements: shorter conversions (SHT4x: 1.7ms instead of 8.3ms, SHT3x: 4ms instead of 15ms), but noisier readings
+// #define APB_AMBIENT_LOW_REPEATABILITY
 #define APB_PWM_OUTPUT_TEMPERATURE_AVERAGE_COUNT 10
 #define APB_PWM_OUTPUT_TEMPERATURE_SENSOR_THERMISTOR_REFERENCE 10'000
 #define APB_PWM_OUTPUT_TEMPERATURE_SENSOR_THERMISTOR_NOMINAL 10'000
@@ -30,13 +40,105 @@
 #define APB_POWER_INA219_GAIN 8
 #define APB_POWER_INA219_VOLTAGE_RANGE 16
 #define APB_HISTORY_TASK_SECONDS 10'000
+#define APB_POWER_MONITOR_UPDATE_INTERVAL_MS 1000
+// Adaptive sampling intervals (milliseconds): sampling speeds up to the minimum interval when the value changes
+// by more than the threshold between samples, and slows down to the maximum interval while it's stable.
+#define APB_AMBIENT_SAMPLING_MIN_MS 2'000
+#define APB_AMBIENT_SAMPLING_MAX_MS 30'000
+// Dewpoint, °C
+#define APB_AMBIENT_SAMPLING_THRESHOLD 0.2
+#define APB_POWER_MONITOR_SAMPLING_MIN_MS APB_POWER_MONITOR_UPDATE_INTERVAL_MS
+#define APB_POWER_MONITOR_SAMPLING_MAX_MS 10'000
+// Power, W
+#define APB_POWER_MONITOR_SAMPLING_THRESHOLD 0.5
+#define APB_PWM_OUTPUT_SAMPLING_MIN_MS 1'000
+#define APB_PWM_OUTPUT_SAMPLING_MAX_MS 10'000
+// Heater temperature, °C
+#define APB_PWM_OUTPUT_SAMPLING_THRESHOLD 0.3
+// Ambient filter stage: samples further than the deviation from the rolling median are rejected as outliers,
+// the median is then smoothed with an EMA of the given weight.
+#define APB_AMBIENT_FILTER_MAX_TEMPERATURE_DEVIATION 2.0
+#define APB_AMBIENT_FILTER_MAX_HUMIDITY_DEVIATION 8.0
+#define APB_AMBIENT_FILTER_ALPHA 0.5
+// Failed or rejected ambient reads keep the last good reading for this long before the reading is lost
+#define APB_AMBIENT_HOLD_LAST_GOOD_MS 90'000
+// Distance from the target temperature (°C) below which PWM outputs, and the ambient sensor for dewpoint mode, sample at the minimum interval
+#define APB_PWM_OUTPUT_SETPOINT_MARGIN 1.0
 
-#define APB_AMBIENT_TEMPERATURE_SENSOR_SHT4x
 #define APB_PWM_OUTPUT_TEMPERATURE_SENSOR_THERMISTOR
 
+// Fan curve: the duty follows the highest of the box temperature (°C) and the average duty of the PWM outputs ramps.
+// The box temperature is the chip internal sensor, or the ambient sensor with APB_FAN_TEMPERATURE_SENSOR_AMBIENT.
+#define APB_FAN_CONTROL_INTERVAL_MS 2'000
+#define APB_FAN_MIN_DUTY 0.25
+#define APB_FAN_START_TEMPERATURE 40
+#define APB_FAN_FULL_TEMPERATURE 60
+#define APB_FAN_TEMPERATURE_HYSTERESIS 3
+#define APB_FAN_START_LOAD 0.3
+#define APB_FAN_FULL_LOAD 0.9
+// #define APB_FAN_TEMPERATURE_SENSOR_AMBIENT
+// Fan tachometer input, counted by the PCNT peripheral (not available on the ESP32-C3). A stall is reported after
+// APB_FAN_STALL_SAMPLES control steps below APB_FAN_STALL_RPM while driven at least at APB_FAN_STALL_MIN_DUTY.
+// #define APB_FAN_TACH_PIN 5
+#define APB_FAN_TACH_PULSES_PER_REVOLUTION 2
+#define APB_FAN_STALL_MIN_DUTY 0.3
+#define APB_FAN_STALL_RPM 200
+#define APB_FAN_STALL_SAMPLES 3
+
 #define APB_INA1219_ADDRESS 0x40
 
-#define MAX_EVENTS_SIZE 1200
+// Arduino loop: blocks until the next scheduler deadline, at most APB_MAIN_LOOP_MAX_SLEEP_MS, bounding the delay of tasks
+// added by other FreeRTOS tasks. The user button wakes it by interrupt, and is polled while pressed.
+#define APB_MAIN_LOOP_MAX_SLEEP_MS 1'000
+#define APB_USER_BUTTON_POLL_MS 10
+// WiFi modem sleep once no HTTP request was served for APB_POWERSAVE_IDLE_MS, and no SSE or WebSocket client is connected
+#define APB_POWERSAVE_IDLE_MS 30'000
+#define APB_POWERSAVE_UPDATE_INTERVAL_MS 1'000
+// Moving average weight of the controller current samples
+#define APB_POWERSAVE_CURRENT_ALPHA 0.05
+// Automatic light sleep while the PWM outputs and the fan are off. Requires an SDK built with CONFIG_PM_ENABLE and CONFIG_FREERTOS_USE_TICKLESS_IDLE.
+// #define APB_POWERSAVE_LIGHT_SLEEP
+
+// Asynchronous I2C bus: transactions queue, and bus task, preempting the control task while waiting for the bus
+#define APB_I2C_QUEUE_SIZE 16
+#define APB_I2C_TASK_PRIORITY 4
+#define APB_I2C_TASK_STACK_SIZE 6144
+#define APB_INA219_I2C_CLOCK 400'000
+#define APB_AMBIENT_I2C_CLOCK 100'000
+
+#define APB_EVENTS_INTERVAL_MS 1000
+#define APB_EVENTS_MIN_INTERVAL_MS 1000
+#define APB_EVENTS_MAX_INTERVAL_MS 60'000
+#define APB_EVENTS_KEYFRAME_EVERY 30
+#define APB_EVENTS_CLIENT_BACKLOG 4
+#define APB_EVENTS_CLIENT_IN_FLIGHT 2
+#define APB_EVENTS_REPLAY_BATCH 10
+// Arena for the documents of each event, rewound after publishing
+#define APB_EVENTS_ARENA_BYTES 8'192
+#define APB_TELEMETRY_MAX_INTERVAL_MS 60'000
+// Sensors acquisition and PWM outputs control task. Its priority is above the Arduino loop task (1), which runs WiFi and web tasks.
+// On dual core chips it's pinned to the application core, on single core chips (S2, C3) APB_CONTROL_TASK_CORE is ignored.
+#define APB_CONTROL_TASK_PRIORITY 3
+#define APB_CONTROL_TASK_CORE 1
+#define APB_CONTROL_TASK_STACK_SIZE 8192
+// The control task blocks until its next scheduler deadline, at most APB_CONTROL_TASK_MAX_SLEEP_MS. Commands wake it up.
+#define APB_CONTROL_TASK_MAX_SLEEP_MS 1'000
+// Records of the control trace (16 bytes each), downloaded from /api/trace. Powers of two, boards with PSRAM keep a longer
+// trace there: 256 KiB, half an hour with 4 outputs sampled every second, hours at the usual sampling intervals.
+#define APB_TRACE_RECORDS 1'024
+#define APB_TRACE_PSRAM_RECORDS 16'384
+// Bytes of the deferred log of the control loops (src/binary_log.h), read from /api/logs/binary. Powers of two, boards with PSRAM keep a longer log there.
+#define APB_BINARY_LOG_BYTES 8'192
+#define APB_BINARY_LOG_PSRAM_BYTES 65'536
+// Binary log formats above this level are compiled away, i.e. LOG_LEVEL_TRACE to keep every control step
+#define APB_BINARY_LOG_LEVEL LOG_LEVEL_INFO
+// Arenas for the JSON documents of the request handlers, and the size of each
+#define APB_JSON_ARENAS 2
+#define APB_JSON_ARENA_BYTES 4'096
+// FreeRTOS tasks whose stack high-water mark is reported in /api/info and /api/metrics
+#define APB_TASK_STACKS_MAX 24
+// Comment out to compile away task, I2C and HTTP latency histograms
+#define APB_LATENCY_HISTOGRAMS
 
 #if __has_include ("configuration_custom.h")
 #include "configuration_custom.h"
@@ -4,9 +4,6 @@
 
 // #define APB_HEATER_TEMPERATURE_AVERAGE_COUNT 1
 
-// #undef APB_AMBIENT_TEMPERATURE_SENSOR_SHT30
-// #define APB_AMBIENT_TEMPERATURE_SENSOR_SHT4x
-
 #define INFLUXDB_URL "http://sirius.lan:8086"
 #define INFLUXDB_TOKEN "GuXyyAx5tXh66uvT5K7ap3VeIlsTNh5rZ0wPbJaZioNINT-5iSo_gL54U8d5F1oNKOW9bp1DDU1KV1wiisl8SQ=="
 #define INFLUXDB_ORG "0d19837b81f9b7e1"
@@ -30,9 +27,6 @@
 #undef APB_POWER_SHUNT_OHMS
 #define APB_POWER_SHUNT_OHMS 0.1
 
-#undef APB_AMBIENT_TEMPERATURE_SENSOR_SHT4x
-#define APB_AMBIENT_TEMPERATURE_SENSOR_SHT30
-
 #undef APB_HISTORY_TASK_SECONDS 
 #define APB_HISTORY_TASK_SECONDS 1'000
 
@@ -47,8 +41,6 @@
 
 
 #ifdef CONFIGURATION_FOR_C11
-#undef APB_AMBIENT_TEMPERATURE_SENSOR_SHT4x
-#define APB_AMBIENT_TEMPERATURE_SENSOR_SHT30
 #endif
 
 #ifdef CONFIGURATION_FOR_ESPRIT100
@@ -89,7 +81,6 @@
 #define APB_PWM_OUTPUTS_SIZE 0
 #define APB_PWM_OUTPUTS_TEMP_SENSORS 0
 
-#undef APB_AMBIENT_TEMPERATURE_SENSOR_SHT4x
 #define APB_AMBIENT_TEMPERATURE_SENSOR_NONE
 
 #undef APB_STATUS_LED_INVERT_LOGIC
@@ -106,7 +97,6 @@
 #define APB_PWM_OUTPUTS_SIZE 0
 #define APB_PWM_OUTPUTS_TEMP_SENSORS 0
 
-#undef APB_AMBIENT_TEMPERATURE_SENSOR_SHT4x
 #define APB_AMBIENT_TEMPERATURE_SENSOR_NONE
 
 #undef APB_STATUS_LED_INVERT_LOGIC
@@ -125,9 +115,6 @@
 
 #undef ONEBUTTON_USER_BUTTON_1
 #define ONEBUTTON_USER_BUTTON_1 7
-
-#undef MAX_EVENTS_SIZE
-#define MAX_EVENTS_SIZE 1500
 #endif
 
 #ifdef CONFIG_PINOUT_WROOM_V1
@@ -0,0 +1,39 @@
+#include "control_task.h"
+#include <ArduinoLog.h>
+#include <algorithm>
+
+#define LOG_SCOPE "APB::ControlTask - "
+
+APB::ControlTask &APB::ControlTask::Instance = *new APB::ControlTask();
+
+void APB::ControlTask::begin() {
+#if CONFIG_FREERTOS_UNICORE
+    const BaseType_t core = tskNO_AFFINITY;
+#else
+    const BaseType_t core = APB_CONTROL_TASK_CORE;
+#endif
+    xTaskCreatePinnedToCore(&ControlTask::run, "apb_control", APB_CONTROL_TASK_STACK_SIZE, this, APB_CONTROL_TASK_PRIORITY, &handle, core);
+    Log.infoln(LOG_SCOPE "started, priority: %d, core: %d", APB_CONTROL_TASK_PRIORITY, core);
+}
+
+void APB::ControlTask::wake() {
+    if(handle) {
+        xTaskNotifyGive(handle);
+    }
+}
+
+void APB::ControlTask::run(void *controlTask) {
+    ControlTask &task = *static_cast<ControlTask*>(controlTask);
+    Scheduler &scheduler = task._scheduler;
+    while(true) {
+        if(task.onWake) {
+            task.onWake();
+        }
+        scheduler.execute();
+        // Tickless: block until the next task is due or wake() is called, letting the lower priority tasks, the idle task and light sleep run in between
+        const uint32_t sleepMs = std::min<unsigned long>(scheduler.getNextRun(), APB_CONTROL_TASK_MAX_SLEEP_MS);
+        if(sleepMs > 0) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(sleepMs));
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef APB_CONTROL_TASK_H
+#define APB_CONTROL_TASK_H
+
+#include <Arduino.h>
+#include <TaskSchedulerDeclarations.h>
+#include <functional>
+
+#include "configuration.h"
+
+namespace APB {
+
+// Dedicated FreeRTOS task for sensors acquisition and PWM outputs control.
+// It runs its own scheduler, so that WiFi polling and web serialization in the Arduino loop don't delay the control loop.
+// State is published to the other tasks through Snapshot, so readers never block it.
+class ControlTask {
+public:
+    static ControlTask &Instance;
+    Scheduler &scheduler() { return _scheduler; }
+    // Starts running the scheduler tasks, to be called after the control tasks have been added.
+    void begin();
+    // Wakes the control task up, i.e. after another task changed its scheduler tasks. Safe from any task.
+    void wake();
+    // Called by the control task every time it wakes up, before running the due tasks, i.e. for work posted by other tasks.
+    // To be set before begin().
+    void setOnWake(const std::function<void()> &onWake) { this->onWake = onWake; }
+private:
+    std::function<void()> onWake;
+    Scheduler _scheduler;
+    TaskHandle_t handle = nullptr;
+
+    static void run(void *controlTask);
+};
+}
+
+#endif
@@ -1,6 +1,19 @@
 #include "fan.h"
 #include "configuration.h"
+#include "pwm_output.h"
+#include "latency.h"
+#include "binary_log.h"
 #include <ArduinoLog.h>
+#include <numeric>
+
+#ifdef APB_FAN_TACH_PIN
+#include <soc/soc_caps.h>
+#if !SOC_PCNT_SUPPORTED
+#error "APB_FAN_TACH_PIN requires the pulse counter (PCNT) peripheral"
+#endif
+#include <driver/pcnt.h>
+#define APB_FAN_TACH_PCNT_UNIT PCNT_UNIT_0
+#endif
 
 #define LOG_SCOPE "APB::Fan "
 
@@ -30,22 +43,129 @@ void Fan::setup(uint32_t frequency, float duty)
 #endif
 }
 
+void Fan::setupControl(Scheduler &scheduler, bool automatic) {
+#ifdef APB_PWM_FAN_PIN
+#ifdef APB_FAN_TACH_PIN
+    // Pulses are counted in hardware, on rising edges, with the glitch filter at its maximum (1023 APB clock cycles, ~12.8µs)
+    pcnt_config_t tachConfig{};
+    tachConfig.pulse_gpio_num = APB_FAN_TACH_PIN;
+    tachConfig.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+    tachConfig.lctrl_mode = PCNT_MODE_KEEP;
+    tachConfig.hctrl_mode = PCNT_MODE_KEEP;
+    tachConfig.pos_mode = PCNT_COUNT_INC;
+    tachConfig.neg_mode = PCNT_COUNT_DIS;
+    tachConfig.counter_h_lim = INT16_MAX;
+    tachConfig.counter_l_lim = 0;
+    tachConfig.unit = APB_FAN_TACH_PCNT_UNIT;
+    tachConfig.channel = PCNT_CHANNEL_0;
+    pcnt_unit_config(&tachConfig);
+    pcnt_set_filter_value(APB_FAN_TACH_PCNT_UNIT, 1023);
+    pcnt_filter_enable(APB_FAN_TACH_PCNT_UNIT);
+    pcnt_counter_clear(APB_FAN_TACH_PCNT_UNIT);
+    pcnt_counter_resume(APB_FAN_TACH_PCNT_UNIT);
+    Log.infoln(LOG_SCOPE "Tachometer on pin %d", APB_FAN_TACH_PIN);
+#endif
+    APB::PWMOutputs::samples.subscribe([this](const APB::PWMOutputs::Sample &sample) {
+        std::lock_guard<std::mutex> lock(mutex);
+        pwmOutputsDuty[sample.index] = sample.duty;
+    });
+    _automatic = automatic;
+    lastControlAt = millis();
+    controlTask.set(APB_FAN_CONTROL_INTERVAL_MS, TASK_FOREVER, APB::Latency::task(scheduler, "fan", std::bind(&Fan::control, this)));
+    scheduler.addTask(controlTask);
+    controlTask.enable();
+    Log.infoln(LOG_SCOPE "Fan control initialised, automatic=%T", automatic);
+#endif
+}
+
+void Fan::control() {
+    std::lock_guard<std::mutex> lock(mutex);
+    const uint32_t now = millis();
+#ifdef APB_FAN_TACH_PIN
+    int16_t pulses = 0;
+    pcnt_get_counter_value(APB_FAN_TACH_PCNT_UNIT, &pulses);
+    pcnt_counter_clear(APB_FAN_TACH_PCNT_UNIT);
+    _rpm = pulses * 60'000.f / APB_FAN_TACH_PULSES_PER_REVOLUTION / std::max<uint32_t>(now - lastControlAt, 1);
+    // The duty is the one applied during the interval the pulses were counted in
+    const bool wasStalled = stallDetector.stalled();
+    if(stallDetector.update(_duty, *_rpm) != wasStalled) {
+        if(wasStalled) {
+            Log.infoln(LOG_SCOPE "Fan spinning again: %F RPM", *_rpm);
+        } else {
+            Log.errorln(LOG_SCOPE "Fan stalled: %F RPM at duty %F", *_rpm, _duty);
+        }
+    }
+#endif
+    lastControlAt = now;
+    _temperature = readTemperature();
+    _load = pwmOutputsDuty.empty() ? 0 : std::accumulate(pwmOutputsDuty.begin(), pwmOutputsDuty.end(), 0.f) / pwmOutputsDuty.size();
+    if(!_automatic) {
+        return;
+    }
+    float duty = curve.duty(_temperature, _load);
+    // Kick a stalled fan at full duty until it spins again
+    if(stallDetector.stalled()) {
+        duty = 1;
+    }
+    writeDuty(duty);
+}
+
+std::optional<float> Fan::readTemperature() const {
+#ifdef APB_FAN_TEMPERATURE_SENSOR_AMBIENT
+    const auto reading = APB::Ambient::Instance.reading();
+    if(!reading) {
+        return {};
+    }
+    return reading->temperature;
+#else
+    return temperatureRead();
+#endif
+}
+
 void Fan::setDuty(float duty) {
 #ifdef APB_PWM_FAN_PIN
+    std::lock_guard<std::mutex> lock(mutex);
+    _automatic = false;
+    Log.infoln(LOG_SCOPE "Setting fan duty to %F", duty);
+    writeDuty(duty);
+#endif
+}
+
+void Fan::writeDuty(float duty) {
+#ifdef APB_PWM_FAN_PIN
+    const int analogValue = static_cast<int>(duty * 255.0);
+    if(analogValue != static_cast<int>(_duty * 255.0)) {
+        APB_BINARY_LOG(FanDuty, duty, analogValue, channel);
+    }
     _duty = duty;
-    int analogValue = static_cast<int>(duty * 255.0);
-    Log.infoln(LOG_SCOPE "Setting fan duty to %F (analog value %d) to channel %d", duty, analogValue, channel);
     ledcWrite(channel, analogValue);
 #endif
 }
+
+void Fan::setAutomatic(bool automatic) {
+    std::lock_guard<std::mutex> lock(mutex);
+    _automatic = automatic;
+}
+
+bool Fan::automatic() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return _automatic;
+}
+
 float Fan::duty() const {
 #ifdef APB_PWM_FAN_PIN
+    std::lock_guard<std::mutex> lock(mutex);
     return _duty;
 #else
     return 0;
 #endif
 }
 
+Fan::Status Fan::status() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return {_duty, _automatic, _temperature, _load, _rpm, stallDetector.stalled()};
+}
+
 Fan::~Fan() {
 #ifdef APB_PWM_FAN_PIN
     ledcWrite(channel, 0);
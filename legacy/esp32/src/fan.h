@@ -1,16 +1,60 @@
 #pragma once
 #include <esp32-hal-ledc.h>
+#include <TaskSchedulerDeclarations.h>
+#include <array>
+#include <mutex>
+#include <optional>
+
+#include "configuration.h"
+#include "fan_control.h"
 
 class Fan {
 private:
     Fan();
     float _duty;
     uint8_t channel;
+    bool _automatic = false;
+    std::optional<float> _temperature;
+    float _load = 0;
+    std::optional<float> _rpm;
+    uint32_t lastControlAt = 0;
+    // Latest duty of each PWM output, from the PWMOutputs::samples subscription
+    std::array<float, APB_PWM_OUTPUTS_SIZE> pwmOutputsDuty{};
+    APB::FanCurve curve{{
+        APB_FAN_MIN_DUTY,
+        APB_FAN_START_TEMPERATURE,
+        APB_FAN_FULL_TEMPERATURE,
+        APB_FAN_TEMPERATURE_HYSTERESIS,
+        APB_FAN_START_LOAD,
+        APB_FAN_FULL_LOAD,
+    }};
+    APB::FanStallDetector stallDetector{APB_FAN_STALL_MIN_DUTY, APB_FAN_STALL_RPM, APB_FAN_STALL_SAMPLES};
+    Task controlTask;
+    // The control task runs the curve, the web server sets the duty by hand
+    mutable std::mutex mutex;
+    void control();
+    void writeDuty(float duty);
+    std::optional<float> readTemperature() const;
 public:
+    struct Status {
+        float duty;
+        bool automatic;
+        std::optional<float> temperature;
+        // Average duty of the PWM outputs
+        float load;
+        // Only with a tachometer input
+        std::optional<float> rpm;
+        bool stalled;
+    };
     static Fan &Instance();
     void setup(uint32_t frequency=20'000, float duty=0.f);
+    // Closed loop control on `scheduler`: the duty follows the fan curve while automatic
+    void setupControl(Scheduler &scheduler, bool automatic);
+    // Sets the duty by hand, disabling the automatic control
     void setDuty(float duty);
+    void setAutomatic(bool automatic);
+    bool automatic() const;
     float duty() const;
+    Status status() const;
     ~Fan();
 };
-
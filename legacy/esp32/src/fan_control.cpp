@@ -0,0 +1,43 @@
+#include "fan_control.h"
+#include <algorithm>
+
+namespace {
+    float ramp(float value, float start, float full) {
+        return std::clamp((value - start) / (full - start), 0.f, 1.f);
+    }
+}
+
+APB::FanCurve::FanCurve(const Parameters &parameters) : parameters{parameters} {
+}
+
+float APB::FanCurve::duty(const std::optional<float> &temperature, float load) {
+    if(!temperature) {
+        _running = true;
+        return 1;
+    }
+    const float demand = std::max(
+        ramp(*temperature, parameters.startTemperature, parameters.fullTemperature),
+        ramp(load, parameters.startLoad, parameters.fullLoad)
+    );
+    if(demand > 0) {
+        _running = true;
+    } else if(*temperature < parameters.startTemperature - parameters.hysteresis) {
+        _running = false;
+    }
+    if(!_running) {
+        return 0;
+    }
+    return parameters.minDuty + demand * (1 - parameters.minDuty);
+}
+
+APB::FanStallDetector::FanStallDetector(float minDuty, float minRpm, uint8_t samples) : minDuty{minDuty}, minRpm{minRpm}, samples{samples} {
+}
+
+bool APB::FanStallDetector::update(float duty, float rpm) {
+    if(duty >= minDuty && rpm < minRpm) {
+        slowSamples = std::min<uint8_t>(slowSamples + 1, samples);
+    } else {
+        slowSamples = 0;
+    }
+    return stalled();
+}
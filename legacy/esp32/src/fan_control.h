@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+
+namespace APB {
+
+// Fan duty from the box temperature and the total PWM load: the higher of two linear ramps, starting at `minDuty`,
+// so that the fan idles quietly until either the temperature or the load requires cooling.
+// The fan stops again once the load is below its start value, and the temperature `hysteresis` degrees below its start value.
+class FanCurve {
+public:
+    struct Parameters {
+        // Lowest duty at which the fan keeps spinning
+        float minDuty;
+        float startTemperature;
+        float fullTemperature;
+        float hysteresis;
+        // Average duty of the PWM outputs
+        float startLoad;
+        float fullLoad;
+    };
+    FanCurve(const Parameters &parameters);
+    // Without a temperature the fan runs at full duty.
+    float duty(const std::optional<float> &temperature, float load);
+    bool running() const { return _running; }
+private:
+    const Parameters parameters;
+    bool _running = false;
+};
+
+// Reports a stall once the fan is driven above `minDuty`, but spins slower than `minRpm`, for `samples` consecutive readings.
+class FanStallDetector {
+public:
+    FanStallDetector(float minDuty, float minRpm, uint8_t samples);
+    bool update(float duty, float rpm);
+    bool stalled() const { return slowSamples >= samples; }
+private:
+    const float minDuty;
+    const float minRpm;
+    const uint8_t samples;
+    uint8_t slowSamples = 0;
+};
+}
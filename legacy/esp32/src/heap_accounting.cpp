@@ -0,0 +1,132 @@
+#include "heap_accounting.h"
+#include <array>
+#include <atomic>
+#include <cstdlib>
+
+namespace {
+using Subsystem = APB::HeapAccounting::Subsystem;
+
+// Updated from every task: relaxed atomics, the numbers are statistics
+struct Counters {
+    std::atomic<uint32_t> bytes{0};
+    std::atomic<uint32_t> peak{0};
+    std::atomic<uint32_t> allocations{0};
+    std::atomic<uint32_t> failures{0};
+
+    void allocated(size_t size) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        const uint32_t now = bytes.fetch_add(size, std::memory_order_relaxed) + size;
+        uint32_t previous = peak.load(std::memory_order_relaxed);
+        while(now > previous && !peak.compare_exchange_weak(previous, now, std::memory_order_relaxed)) {
+        }
+    }
+    void freed(size_t size) { bytes.fetch_sub(size, std::memory_order_relaxed); }
+};
+
+std::array<Counters, static_cast<size_t>(Subsystem::Count)> &counters() {
+    static std::array<Counters, static_cast<size_t>(Subsystem::Count)> counters;
+    return counters;
+}
+
+Counters &countersFor(Subsystem subsystem) {
+    return counters()[static_cast<size_t>(subsystem)];
+}
+
+// ArduinoJson only passes the pointer when freeing: the block size is kept in a header
+class JsonAllocator : public ArduinoJson::Allocator {
+public:
+    Subsystem subsystem;
+
+    void *allocate(size_t size) override {
+        auto *block = static_cast<uint8_t*>(malloc(size + Header));
+        if(!block) {
+            countersFor(subsystem).failures.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        *reinterpret_cast<size_t*>(block) = size;
+        countersFor(subsystem).allocated(size);
+        return block + Header;
+    }
+    void deallocate(void *pointer) override {
+        if(!pointer) {
+            return;
+        }
+        auto *block = static_cast<uint8_t*>(pointer) - Header;
+        countersFor(subsystem).freed(*reinterpret_cast<size_t*>(block));
+        free(block);
+    }
+    void *reallocate(void *pointer, size_t size) override {
+        if(!pointer) {
+            return allocate(size);
+        }
+        auto *block = static_cast<uint8_t*>(pointer) - Header;
+        const size_t previous = *reinterpret_cast<size_t*>(block);
+        auto *resized = static_cast<uint8_t*>(realloc(block, size + Header));
+        if(!resized) {
+            countersFor(subsystem).failures.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        *reinterpret_cast<size_t*>(resized) = size;
+        countersFor(subsystem).freed(previous);
+        countersFor(subsystem).allocated(size);
+        return resized + Header;
+    }
+private:
+    // Keeps the blocks aligned as malloc ones
+    static constexpr size_t Header = alignof(std::max_align_t);
+};
+}
+
+const char *APB::HeapAccounting::name(Subsystem subsystem) {
+    switch(subsystem) {
+    case Subsystem::Json:
+        return "json";
+    case Subsystem::Events:
+        return "events";
+    case Subsystem::History:
+        return "history";
+    case Subsystem::Responses:
+        return "responses";
+    default:
+        return "unknown";
+    }
+}
+
+APB::HeapAccounting::Usage APB::HeapAccounting::usage(Subsystem subsystem) {
+    const Counters &counters = countersFor(subsystem);
+    return {
+        counters.bytes.load(std::memory_order_relaxed),
+        counters.peak.load(std::memory_order_relaxed),
+        counters.allocations.load(std::memory_order_relaxed),
+        counters.failures.load(std::memory_order_relaxed),
+    };
+}
+
+void *APB::HeapAccounting::allocate(Subsystem subsystem, size_t size) {
+    void *pointer = malloc(size);
+    if(!pointer) {
+        countersFor(subsystem).failures.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    countersFor(subsystem).allocated(size);
+    return pointer;
+}
+
+void APB::HeapAccounting::deallocate(Subsystem subsystem, void *pointer, size_t size) {
+    if(!pointer) {
+        return;
+    }
+    countersFor(subsystem).freed(size);
+    free(pointer);
+}
+
+ArduinoJson::Allocator *APB::HeapAccounting::json(Subsystem subsystem) {
+    static std::array<JsonAllocator, static_cast<size_t>(Subsystem::Count)> allocators = [] {
+        std::array<JsonAllocator, static_cast<size_t>(Subsystem::Count)> allocators;
+        for(size_t index = 0; index < allocators.size(); index++) {
+            allocators[index].subsystem = static_cast<Subsystem>(index);
+        }
+        return allocators;
+    }();
+    return &allocators[static_cast<size_t>(subsystem)];
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ArduinoJson.h>
+
+// Heap usage by subsystem, so that a drop of the free heap can be attributed: JSON documents, SSE, history and response
+// buffers allocate through the allocators below. Reported in /api/info and /api/metrics.
+namespace APB {
+
+class HeapAccounting {
+public:
+    enum class Subsystem : uint8_t {
+        // Request, command and configuration documents
+        Json,
+        // Server sent events documents
+        Events,
+        History,
+        // Chunked responses state and buffers
+        Responses,
+        Count,
+    };
+    struct Usage {
+        uint32_t bytes;
+        uint32_t peak;
+        uint32_t allocations;
+        uint32_t failures;
+    };
+    static const char *name(Subsystem subsystem);
+    static Usage usage(Subsystem subsystem);
+
+    static void *allocate(Subsystem subsystem, size_t size);
+    static void deallocate(Subsystem subsystem, void *pointer, size_t size);
+    // For JsonDocument(HeapAccounting::json(...))
+    static ArduinoJson::Allocator *json(Subsystem subsystem);
+
+    // Standard library allocator, i.e. for containers and std::allocate_shared
+    template<typename T, Subsystem subsystem> struct Allocator {
+        using value_type = T;
+        template<typename U> struct rebind {
+            using other = Allocator<U, subsystem>;
+        };
+        Allocator() = default;
+        template<typename U> Allocator(const Allocator<U, subsystem> &) {}
+        T *allocate(size_t count) {
+            void *pointer = HeapAccounting::allocate(subsystem, count * sizeof(T));
+            if(!pointer) {
+                abort();
+            }
+            return static_cast<T*>(pointer);
+        }
+        void deallocate(T *pointer, size_t count) { HeapAccounting::deallocate(subsystem, pointer, count * sizeof(T)); }
+        template<typename U> bool operator==(const Allocator<U, subsystem> &) const { return true; }
+        template<typename U> bool operator!=(const Allocator<U, subsystem> &) const { return false; }
+    };
+
+    template<typename T, Subsystem subsystem = Subsystem::Responses, typename... Args> static std::shared_ptr<T> makeShared(Args&&... args) {
+        return std::allocate_shared<T>(Allocator<T, subsystem>{}, std::forward<Args>(args)...);
+    }
+};
+}
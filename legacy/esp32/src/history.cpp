@@ -1,9 +1,11 @@
 #include "history.h"
 #include <ArduinoLog.h>
 #include "utils.h"
+#include "latency.h"
 #include <iterator>
 #include "configuration.h"
 #include <memory>
+#include <algorithm>
 
 APB::History &APB::History::Instance = *new APB::History{};
 
@@ -13,9 +15,9 @@ APB::History::History() {
 
 
 #if APB_PWM_OUTPUTS_SIZE > 0
-void APB::History::Entry::PWMOutput::set(const APB::PWMOutput &pwmOutput) {
-    temperatureHundredth = static_cast<int16_t>(pwmOutput.temperature().value_or(-100.0) * 100.0);
-    duty = pwmOutput.active() ? pwmOutput.duty() : 0;
+void APB::History::Entry::PWMOutput::set(const PWMOutputs::Sample &sample) {
+    temperatureHundredth = static_cast<int16_t>(sample.temperature.value_or(-100.0) * 100.0);
+    duty = sample.duty;
 }
 #endif
 
@@ -32,7 +34,7 @@ void APB::History::Entry::setPower(const PowerMonitor::Status & powerStatus) {
     currentHundreth = static_cast<uint16_t>(powerStatus.current * 100.0);
 }
 
-void APB::History::Entry::populate(JsonObject object) {
+void APB::History::Entry::populate(JsonObject object) const {
     object["uptime"] = secondsFromBoot;
 
 #ifndef APB_AMBIENT_TEMPERATURE_SENSOR_NONE
@@ -60,7 +62,7 @@ void APB::History::Entry::populate(JsonObject object) {
 }
 
 
-void APB::History::Entry::setNullableFloat(JsonObject object, const char *field, float value, float minValue) {
+void APB::History::Entry::setNullableFloat(JsonObject object, const char *field, float value, float minValue) const {
     if(value < minValue) {
         object[field] = (char*)0;
     } else {
@@ -78,16 +80,26 @@ void APB::History::add() {
     static_cast<uint32_t>(esp_timer_get_time() / 1000'000)
   };
 
+  std::unique_lock<std::mutex> lock(mutex);
 #ifndef APB_AMBIENT_TEMPERATURE_SENSOR_NONE
-  entry.setAmbient(APB::Ambient::Instance.reading());
+  entry.setAmbient(pending.ambient);
 #endif
   
 #if APB_PWM_OUTPUTS_SIZE > 0
   for(uint8_t i=0; i<APB_PWM_OUTPUTS_TEMP_SENSORS; i++) {
-    entry.pwmOutputs[i].set(APB::PWMOutputs::Instance[i]);
+    entry.pwmOutputs[i].set(pending.pwmOutputs[i]);
   }
 #endif
-  entry.setPower(PowerMonitor::Instance.status());
+  PowerMonitor::Status power = pending.power;
+  if(pending.powerSamples > 0) {
+    power.busVoltage = pending.busVoltageSum / pending.powerSamples;
+    power.current = pending.currentSum / pending.powerSamples;
+  }
+  pending.busVoltageSum = 0;
+  pending.currentSum = 0;
+  pending.powerSamples = 0;
+  lock.unlock();
+  entry.setPower(power);
 
   _entries.push_back(entry);
   while(_entries.size() > maxSize) {
@@ -95,6 +107,17 @@ void APB::History::add() {
   }
 }
 
+size_t APB::History::entriesSince(uint32_t afterMillis, size_t maxEntries, const std::function<void(const Entry &)> &callback) const {
+    auto it = std::find_if(_entries.begin(), _entries.end(), [afterMillis](const Entry &entry){
+        return static_cast<uint64_t>(entry.secondsFromBoot) * 1000 > afterMillis;
+    });
+    size_t visited = 0;
+    for(; it != _entries.end() && visited < maxEntries; it++, visited++) {
+        callback(*it);
+    }
+    return visited;
+}
+
 
 #define JSON_SERIALISER_TAG "[History::JsonSerialiser] "
 
@@ -116,13 +139,13 @@ int APB::History::JsonSerialiser::write(uint8_t *buffer, size_t maxLen, size_t i
     // }};
     
     if(!headerCreated) {
-        response = overflowPrint->printf("{\"now\":%d,\"entries\":[", esp_timer_get_time() / 1'000'000);
+        response += overflowPrint->printf("{\"now\":%d,\"entries\":[", esp_timer_get_time() / 1'000'000);
         // Log.traceln(JSON_SERIALISER_TAG "Creating header, response=%d", response);
         headerCreated = true;
         it = history._entries.begin();
     }
-    if(history._entries.empty()) {
-        response = overflowPrint->printf("]}");
+    if(history._entries.empty() && !footerCreated) {
+        response += overflowPrint->print("]}");
         footerCreated = true;
     }
     if(footerCreated) {
@@ -147,5 +170,30 @@ int APB::History::JsonSerialiser::write(uint8_t *buffer, size_t maxLen, size_t i
 }
 
 void APB::History::setup(Scheduler &scheduler) {
-  new Task(APB_HISTORY_TASK_SECONDS, TASK_FOREVER, std::bind(&History::add, this), &scheduler, true);
+  // Samples published before the subscriptions, i.e. the first ambient reading
+  pending.ambient = Ambient::Instance.reading();
+  pending.power = PowerMonitor::Instance.status();
+#if APB_PWM_OUTPUTS_SIZE > 0
+  for(const auto &pwmOutput: PWMOutputs::Instance) {
+    pending.pwmOutputs[pwmOutput.index()] = {pwmOutput.index(), pwmOutput.mode(), pwmOutput.duty(), pwmOutput.temperature()};
+  }
+#endif
+  Ambient::Instance.samples.subscribe([this](const Ambient::Sample &sample) {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.ambient = sample.reading;
+  });
+  PowerMonitor::Instance.samples.subscribe([this](const PowerMonitor::Status &status) {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.power = status;
+    pending.busVoltageSum += status.busVoltage;
+    pending.currentSum += status.current;
+    pending.powerSamples++;
+  });
+#if APB_PWM_OUTPUTS_SIZE > 0
+  PWMOutputs::samples.subscribe([this](const PWMOutputs::Sample &sample) {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.pwmOutputs[sample.index] = sample;
+  });
+#endif
+  new Task(APB_HISTORY_TASK_SECONDS, TASK_FOREVER, Latency::task(scheduler, "history", std::bind(&History::add, this)), &scheduler, true);
 }
@@ -3,15 +3,18 @@
 #include <array>
 #include <configuration.h>
 #include <list>
+#include <mutex>
 #include <optional>
 #include <ArduinoJson.h>
 #include <memory>
+#include <functional>
 #include <TaskSchedulerDeclarations.h>
 
 #include "ambient/ambient.h"
 #include "powermonitor.h"
 #include "pwm_output.h"
 #include "utils.h"
+#include "heap_accounting.h"
 
 #define HISTORY_ENTRY_SIZE 256
 
@@ -26,7 +29,7 @@ public:
         struct PWMOutput {
             int16_t temperatureHundredth;
             uint8_t duty;
-            void set(const APB::PWMOutput &pwmOutput);
+            void set(const PWMOutputs::Sample &sample);
             float getTemperature() const { return static_cast<float>(temperatureHundredth) / 100.0; }
             float getDuty() const { return static_cast<float>(duty); }
         };
@@ -52,13 +55,13 @@ public:
         float getPower() const { return getCurrent() * getBusVoltage(); }
         
 
-        void populate(JsonObject object);
+        void populate(JsonObject object) const;
         
     private:
-        void setNullableFloat(JsonObject object, const char *field, float value, float minValue=-50);
+        void setNullableFloat(JsonObject object, const char *field, float value, float minValue=-50) const;
     };
 
-    typedef std::list<Entry> Entries;
+    typedef std::list<Entry, HeapAccounting::Allocator<Entry, HeapAccounting::Subsystem::History>> Entries;
     
     class JsonSerialiser {
     public:
@@ -70,7 +73,7 @@ public:
         bool footerCreated = false;
         bool firstEntrySent = false;
         Entries::iterator it;
-        JsonDocument jsonDocument;
+        JsonDocument jsonDocument{HeapAccounting::json(HeapAccounting::Subsystem::History)};
         size_t currentIndex = 0;
         std::unique_ptr<OverflowPrint> overflowPrint;
     };
@@ -80,11 +83,27 @@ public:
     void add();
 
     Entries entries() const { return _entries; }
+    // Calls `callback` on at most `maxEntries` entries added after `afterMillis`, returns how many entries were visited.
+    size_t entriesSince(uint32_t afterMillis, size_t maxEntries, const std::function<void(const Entry &)> &callback) const;
 
     size_t jsonSize() const { return _entries.size() * HISTORY_ENTRY_SIZE; }
 
     static History &Instance;
 private:
+    // Latest samples from the telemetry pipeline subscriptions, with the power averaged since the last entry.
+    // Written by the publishing tasks, protected by `mutex`.
+    struct Pending {
+        std::optional<Ambient::Reading> ambient;
+        #if APB_PWM_OUTPUTS_SIZE > 0
+        std::array<PWMOutputs::Sample, APB_PWM_OUTPUTS_SIZE> pwmOutputs;
+        #endif
+        PowerMonitor::Status power;
+        float busVoltageSum = 0;
+        float currentSum = 0;
+        uint16_t powerSamples = 0;
+    };
+    Pending pending;
+    std::mutex mutex;
     Entries _entries;
     uint16_t maxSize = 300;
     bool lockInserts = false;
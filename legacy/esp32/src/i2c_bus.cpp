@@ -0,0 +1,97 @@
+#include "i2c_bus.h"
+#include <algorithm>
+
+const char *APB::I2C::statusName(Status status) {
+    switch(status) {
+    case Status::Ok:
+        return "ok";
+    case Status::AddressNack:
+        return "address_nack";
+    case Status::DataNack:
+        return "data_nack";
+    case Status::ShortRead:
+        return "short_read";
+    case Status::Timeout:
+        return "timeout";
+    case Status::BusError:
+        return "bus_error";
+    case Status::QueueFull:
+        return "queue_full";
+    }
+    return "unknown";
+}
+
+APB::I2C::Bus::Bus(Backend &backend, size_t maxQueued) : backend{backend}, maxQueued{maxQueued} {
+}
+
+bool APB::I2C::Bus::submit(const Device &device, std::initializer_list<uint8_t> write, uint8_t readLength, const Callback &callback) {
+    if(write.size() > MaxWriteLength || readLength > MaxReadLength) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(queue.size() >= maxQueued) {
+            _statistics.dropped++;
+            return false;
+        }
+        Transaction &transaction = queue.emplace_back(Transaction{&device, {}, static_cast<uint8_t>(write.size()), readLength, callback});
+        std::copy(write.begin(), write.end(), transaction.write.begin());
+    }
+    if(onSubmit) {
+        onSubmit();
+    }
+    return true;
+}
+
+bool APB::I2C::Bus::process() {
+    Transaction transaction;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(queue.empty()) {
+            return false;
+        }
+        transaction = std::move(queue.front());
+        queue.pop_front();
+    }
+    const Device &device = *transaction.device;
+    if(configuredFor != &device) {
+        backend.configure(device.clock, device.timeoutMs);
+        configuredFor = &device;
+    }
+    std::array<uint8_t, MaxReadLength> read;
+    const Status status = backend.transfer(device, transaction.write.data(), transaction.writeLength, read.data(), transaction.readLength);
+
+    bool recovered = true;
+    if(status == Status::Timeout || status == Status::BusError) {
+        recovered = backend.recover();
+        // Recovery reinitialises the bus peripheral
+        configuredFor = nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        _statistics.transactions++;
+        if(status != Status::Ok) {
+            _statistics.errors++;
+        }
+        if(status == Status::Timeout) {
+            _statistics.timeouts++;
+        }
+        if(status == Status::Timeout || status == Status::BusError) {
+            (recovered ? _statistics.recoveries : _statistics.failedRecoveries)++;
+        }
+    }
+    if(transaction.callback) {
+        transaction.callback(status, read.data(), status == Status::Ok ? transaction.readLength : 0);
+    }
+    return true;
+}
+
+size_t APB::I2C::Bus::queued() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queue.size();
+}
+
+APB::I2C::Bus::Statistics APB::I2C::Bus::statistics() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return _statistics;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+
+// Asynchronous I2C transactions queue, shared by all the devices on a bus.
+// Devices submit transactions from any task, and a single bus task runs them in order, reconfiguring
+// the bus clock and timeout for each device, and delivering the results by callback.
+// The bus hardware is behind I2C::Backend, so that the queue can be tested on the host with a simulated bus.
+namespace APB::I2C {
+
+enum class Status : uint8_t {
+    Ok,
+    AddressNack,
+    DataNack,
+    // The read returned fewer bytes than requested
+    ShortRead,
+    Timeout,
+    // Arbitration lost, or a device holding SDA low
+    BusError,
+    // The transaction was not submitted because the queue was full
+    QueueFull,
+};
+const char *statusName(Status status);
+
+struct Device {
+    const char *name;
+    uint8_t address;
+    uint32_t clock = 100'000;
+    uint16_t timeoutMs = 50;
+};
+
+constexpr size_t MaxWriteLength = 4;
+constexpr size_t MaxReadLength = 8;
+
+// `data` is only valid during the callback, which runs on the bus task.
+using Callback = std::function<void(Status status, const uint8_t *data, size_t length)>;
+
+class Backend {
+public:
+    virtual ~Backend() = default;
+    virtual void configure(uint32_t clock, uint16_t timeoutMs) = 0;
+    // Writes `writeLength` bytes (if any), then reads `readLength` bytes (if any) with a repeated start.
+    virtual Status transfer(const Device &device, const uint8_t *write, size_t writeLength, uint8_t *read, size_t readLength) = 0;
+    // Clocks SCL until a device holding SDA low releases it, and sends a STOP. Returns true when the bus is idle again.
+    virtual bool recover() = 0;
+};
+
+class Bus {
+public:
+    struct Statistics {
+        uint32_t transactions = 0;
+        uint32_t errors = 0;
+        uint32_t timeouts = 0;
+        uint32_t recoveries = 0;
+        uint32_t failedRecoveries = 0;
+        uint32_t dropped = 0;
+    };
+
+    Bus(Backend &backend, size_t maxQueued = 16);
+
+    // Queues a write of `write`, followed by a read of `readLength` bytes. Either can be empty.
+    // Returns false, without calling `callback`, when the queue is full.
+    bool submit(const Device &device, std::initializer_list<uint8_t> write, uint8_t readLength, const Callback &callback);
+    // Runs the oldest queued transaction. Returns false if the queue was empty.
+    bool process();
+    // Called after every submitted transaction, i.e. to wake up the bus task.
+    void setOnSubmit(const std::function<void()> &onSubmit) { this->onSubmit = onSubmit; }
+
+    size_t queued() const;
+    Statistics statistics() const;
+private:
+    struct Transaction {
+        const Device *device;
+        std::array<uint8_t, MaxWriteLength> write;
+        uint8_t writeLength;
+        uint8_t readLength;
+        Callback callback;
+    };
+    Backend &backend;
+    const size_t maxQueued;
+    std::deque<Transaction> queue;
+    mutable std::mutex mutex;
+    std::function<void()> onSubmit;
+    Statistics _statistics;
+    // Only accessed by the bus task
+    const Device *configuredFor = nullptr;
+};
+}
@@ -0,0 +1,22 @@
+#include "i2c_wire.h"
+
+namespace {
+    APB::I2C::WireBackend wireBackend{Wire, I2C_SDA_PIN, I2C_SCL_PIN};
+    TaskHandle_t busTask = nullptr;
+
+    void runBus(void *) {
+        while(true) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            while(APB::I2C::Instance.process()) {}
+        }
+    }
+}
+
+APB::I2C::Bus &APB::I2C::Instance = *new APB::I2C::Bus(wireBackend, APB_I2C_QUEUE_SIZE);
+
+void APB::I2C::begin() {
+    xTaskCreate(&runBus, "apb_i2c", APB_I2C_TASK_STACK_SIZE, nullptr, APB_I2C_TASK_PRIORITY, &busTask);
+    Instance.setOnSubmit([](){ xTaskNotifyGive(busTask); });
+    // Transactions submitted before the task started
+    xTaskNotifyGive(busTask);
+}
@@ -0,0 +1,35 @@
+#ifndef APB_I2C_WIRE_H
+#define APB_I2C_WIRE_H
+
+#include <Wire.h>
+#include <unordered_map>
+
+#include "configuration.h"
+#include "i2c_bus.h"
+#include "latency.h"
+
+namespace APB::I2C {
+
+// I2C::Backend running transactions on an Arduino TwoWire peripheral.
+class WireBackend : public Backend {
+public:
+    WireBackend(TwoWire &wire, int8_t sdaPin, int8_t sclPin);
+    void configure(uint32_t clock, uint16_t timeoutMs) override;
+    Status transfer(const Device &device, const uint8_t *write, size_t writeLength, uint8_t *read, size_t readLength) override;
+    bool recover() override;
+private:
+    TwoWire &wire;
+    int8_t sdaPin;
+    int8_t sclPin;
+#ifdef APB_LATENCY_HISTOGRAMS
+    std::unordered_map<const Device*, Latency::Probe*> probes;
+#endif
+};
+
+// The bus on `Wire`, used by every device after startup.
+extern Bus &Instance;
+// Starts the bus task. Devices may still use `Wire` synchronously during setup, before calling this.
+void begin();
+}
+
+#endif
@@ -0,0 +1,78 @@
+#include "i2c_wire.h"
+#include <ArduinoLog.h>
+
+#define LOG_SCOPE "APB::I2C - "
+
+APB::I2C::WireBackend::WireBackend(TwoWire &wire, int8_t sdaPin, int8_t sclPin) : wire{wire}, sdaPin{sdaPin}, sclPin{sclPin} {
+}
+
+void APB::I2C::WireBackend::configure(uint32_t clock, uint16_t timeoutMs) {
+    wire.setClock(clock);
+    wire.setTimeOut(timeoutMs);
+}
+
+APB::I2C::Status APB::I2C::WireBackend::transfer(const Device &device, const uint8_t *write, size_t writeLength, uint8_t *read, size_t readLength) {
+#ifdef APB_LATENCY_HISTOGRAMS
+    Latency::Probe *&probe = probes[&device];
+    if(!probe) {
+        probe = new Latency::Probe{"i2c", device.name};
+    }
+    Latency::Scope scope{*probe};
+#endif
+    if(writeLength > 0) {
+        wire.beginTransmission(device.address);
+        wire.write(write, writeLength);
+        switch(wire.endTransmission(readLength == 0)) {
+        case 0:
+            break;
+        case 2:
+            return Status::AddressNack;
+        case 3:
+            return Status::DataNack;
+        case 5:
+            return Status::Timeout;
+        default:
+            return Status::BusError;
+        }
+    }
+    if(readLength > 0) {
+        const size_t received = wire.requestFrom(static_cast<uint16_t>(device.address), readLength, true);
+        if(received == 0) {
+            return Status::AddressNack;
+        }
+        wire.readBytes(read, received);
+        if(received < readLength) {
+            return Status::ShortRead;
+        }
+    }
+    return Status::Ok;
+}
+
+bool APB::I2C::WireBackend::recover() {
+    Log.warningln(LOG_SCOPE "Recovering bus, SDA=%d", digitalRead(sdaPin));
+    wire.end();
+    pinMode(sdaPin, INPUT_PULLUP);
+    pinMode(sclPin, OUTPUT_OPEN_DRAIN);
+    // Up to 9 clocks, so that a slave in the middle of a byte shifts it out and releases SDA
+    for(uint8_t clock = 0; clock < 9 && digitalRead(sdaPin) == LOW; clock++) {
+        digitalWrite(sclPin, LOW);
+        delayMicroseconds(5);
+        digitalWrite(sclPin, HIGH);
+        delayMicroseconds(5);
+    }
+    // STOP condition: SDA rising while SCL is high
+    pinMode(sdaPin, OUTPUT_OPEN_DRAIN);
+    digitalWrite(sdaPin, LOW);
+    delayMicroseconds(5);
+    digitalWrite(sclPin, HIGH);
+    delayMicroseconds(5);
+    digitalWrite(sdaPin, HIGH);
+    delayMicroseconds(5);
+    pinMode(sdaPin, INPUT_PULLUP);
+    const bool idle = digitalRead(sdaPin) == HIGH;
+    wire.begin(sdaPin, sclPin);
+    if(!idle) {
+        Log.errorln(LOG_SCOPE "Bus recovery failed, SDA still held low");
+    }
+    return idle;
+}
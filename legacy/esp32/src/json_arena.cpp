@@ -0,0 +1,167 @@
+#include "json_arena.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+namespace {
+// Each block is preceded by its size, as ArduinoJson only passes the pointer when reallocating.
+// Keeps the blocks aligned as malloc ones.
+constexpr size_t Header = alignof(std::max_align_t);
+
+constexpr size_t aligned(size_t size) {
+    return (size + Header - 1) / Header * Header;
+}
+
+struct Counters {
+    std::atomic<uint32_t> leases{0};
+    std::atomic<uint32_t> exhausted{0};
+    std::atomic<uint32_t> overflows{0};
+    std::atomic<uint32_t> peak{0};
+} counters;
+
+struct Pool {
+    std::array<APB::JsonArena*, APB_JSON_ARENAS> arenas{};
+    std::array<bool, APB_JSON_ARENAS> leased{};
+    std::mutex mutex;
+};
+
+void recordPeak(uint32_t used) {
+    uint32_t peak = counters.peak.load(std::memory_order_relaxed);
+    while(used > peak && !counters.peak.compare_exchange_weak(peak, used, std::memory_order_relaxed)) {
+    }
+}
+
+Pool &pool() {
+    static Pool pool;
+    return pool;
+}
+}
+
+APB::JsonArena::JsonArena(HeapAccounting::Subsystem subsystem, size_t capacity)
+    : subsystem{subsystem},
+    buffer{static_cast<uint8_t*>(HeapAccounting::allocate(subsystem, capacity))},
+    _capacity{buffer ? capacity : 0} {
+}
+
+APB::JsonArena::~JsonArena() {
+    HeapAccounting::deallocate(subsystem, buffer, _capacity);
+}
+
+size_t APB::JsonArena::blockSize(const void *pointer) {
+    size_t size;
+    memcpy(&size, static_cast<const uint8_t*>(pointer) - Header, sizeof(size));
+    return size;
+}
+
+void *APB::JsonArena::allocate(size_t size) {
+    const size_t needed = Header + aligned(size);
+    if(needed > _capacity - offset) {
+        counters.overflows.fetch_add(1, std::memory_order_relaxed);
+        return HeapAccounting::json(subsystem)->allocate(size);
+    }
+    uint8_t *block = buffer + offset + Header;
+    memcpy(block - Header, &size, sizeof(size));
+    offset += needed;
+    live++;
+    recordPeak(offset);
+    return block;
+}
+
+void APB::JsonArena::deallocate(void *pointer) {
+    if(!owns(pointer)) {
+        HeapAccounting::json(subsystem)->deallocate(pointer);
+        return;
+    }
+    // Only the last block can be given back before the arena is empty
+    if(static_cast<uint8_t*>(pointer) + aligned(blockSize(pointer)) == buffer + offset) {
+        offset -= Header + aligned(blockSize(pointer));
+    }
+    if(--live == 0) {
+        offset = 0;
+    }
+}
+
+void *APB::JsonArena::reallocate(void *pointer, size_t size) {
+    if(!pointer) {
+        return allocate(size);
+    }
+    if(!owns(pointer)) {
+        return HeapAccounting::json(subsystem)->reallocate(pointer, size);
+    }
+    auto *block = static_cast<uint8_t*>(pointer);
+    const size_t previous = blockSize(pointer);
+    // The last block grows or shrinks in place, i.e. ArduinoJson's string buffers and pools being shrunk to fit
+    const size_t blockOffset = block - buffer;
+    if(block + aligned(previous) == buffer + offset && aligned(size) <= _capacity - blockOffset) {
+        memcpy(block - Header, &size, sizeof(size));
+        offset = blockOffset + aligned(size);
+        recordPeak(offset);
+        return block;
+    }
+    if(size <= previous) {
+        memcpy(block - Header, &size, sizeof(size));
+        return block;
+    }
+    void *resized = allocate(size);
+    if(resized) {
+        memcpy(resized, block, previous);
+        deallocate(block);
+    }
+    return resized;
+}
+
+APB::JsonArena::Statistics APB::JsonArena::statistics() {
+    return {
+        counters.leases.load(std::memory_order_relaxed),
+        counters.exhausted.load(std::memory_order_relaxed),
+        counters.overflows.load(std::memory_order_relaxed),
+        counters.peak.load(std::memory_order_relaxed),
+    };
+}
+
+void APB::JsonArena::setup() {
+    Pool &arenas = pool();
+    std::lock_guard<std::mutex> lock(arenas.mutex);
+    for(auto &arena: arenas.arenas) {
+        if(!arena) {
+            arena = new JsonArena(HeapAccounting::Subsystem::Json, APB_JSON_ARENA_BYTES);
+        }
+    }
+}
+
+APB::JsonArena::Lease::Lease() : arena{nullptr} {
+    counters.leases.fetch_add(1, std::memory_order_relaxed);
+    Pool &arenas = pool();
+    {
+        std::lock_guard<std::mutex> lock(arenas.mutex);
+        for(size_t index = 0; index < arenas.arenas.size(); index++) {
+            if(arenas.arenas[index] && !arenas.leased[index]) {
+                arenas.leased[index] = true;
+                arena = arenas.arenas[index];
+                break;
+            }
+        }
+    }
+    if(!arena) {
+        counters.exhausted.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+APB::JsonArena::Lease::~Lease() {
+    if(!arena) {
+        return;
+    }
+    Pool &arenas = pool();
+    std::lock_guard<std::mutex> lock(arenas.mutex);
+    const auto found = std::find(arenas.arenas.begin(), arenas.arenas.end(), arena);
+    arenas.leased[found - arenas.arenas.begin()] = false;
+}
+
+APB::JsonArena::Lease::operator ArduinoJson::Allocator*() const {
+    if(arena) {
+        return arena;
+    }
+    return HeapAccounting::json(HeapAccounting::Subsystem::Json);
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ArduinoJson.h>
+
+#include "configuration.h"
+#include "heap_accounting.h"
+
+// ArduinoJson allocator carving the documents out of a block allocated once, so that parsing and building documents
+// for each request doesn't leave holes in the heap. The arena rewinds when its last block is released, i.e. when its
+// documents are cleared or destroyed; allocations that don't fit fall back to the heap, and are counted.
+namespace APB {
+
+class JsonArena : public ArduinoJson::Allocator {
+public:
+    JsonArena(HeapAccounting::Subsystem subsystem, size_t capacity);
+    ~JsonArena();
+    void *allocate(size_t size) override;
+    void deallocate(void *pointer) override;
+    void *reallocate(void *pointer, size_t size) override;
+    size_t capacity() const { return _capacity; }
+    // Bytes in use, headers included
+    size_t used() const { return offset; }
+
+    // Totals of all the arenas since boot
+    struct Statistics {
+        uint32_t leases;
+        // Leases served by the heap, all the pool arenas being in use
+        uint32_t exhausted;
+        // Allocations that didn't fit in their arena
+        uint32_t overflows;
+        // Most bytes used at once in a single arena
+        uint32_t peak;
+    };
+    static Statistics statistics();
+
+    // Allocates the APB_JSON_ARENAS arenas of the request handlers pool, early, while the heap is not fragmented yet.
+    static void setup();
+
+    // An arena of the pool for the scope of a handler, or the heap when none is free.
+    // Declare it before the documents using it, so that they're released first.
+    class Lease {
+    public:
+        Lease();
+        ~Lease();
+        Lease(const Lease &) = delete;
+        Lease &operator=(const Lease &) = delete;
+        operator ArduinoJson::Allocator*() const;
+    private:
+        JsonArena *arena;
+    };
+private:
+    const HeapAccounting::Subsystem subsystem;
+    uint8_t *buffer;
+    const size_t _capacity;
+    size_t offset = 0;
+    // Blocks not yet released: the arena rewinds when they're all gone
+    size_t live = 0;
+
+    bool owns(const void *pointer) const { return buffer && pointer >= buffer && pointer < buffer + _capacity; }
+    static size_t blockSize(const void *pointer);
+};
+}
@@ -0,0 +1,43 @@
+#include "latency.h"
+#include <Arduino.h>
+#include <algorithm>
+#include <atomic>
+#include <TaskSchedulerDeclarations.h>
+
+namespace {
+    std::atomic<const APB::Latency::Probe*> probesHead{nullptr};
+}
+
+void APB::Latency::Histogram::record(uint32_t micros) {
+    const float seconds = micros / 1'000'000.0;
+    const auto bucket = std::lower_bound(BucketsSeconds.begin(), BucketsSeconds.end(), seconds);
+    _buckets[std::distance(BucketsSeconds.begin(), bucket)]++;
+    _sumMicros += micros;
+}
+
+APB::Latency::Probe::Probe(const char *kind, const char *name, bool hasLateness) : kind{kind}, name{name}, hasLateness{hasLateness} {
+    next = probesHead.load();
+    while(!probesHead.compare_exchange_weak(next, this)) {}
+}
+
+const APB::Latency::Probe *APB::Latency::probes() {
+    return probesHead.load();
+}
+
+APB::Latency::Scope::Scope(Probe &probe) : probe{probe}, started{static_cast<uint32_t>(micros())} {
+}
+
+APB::Latency::Scope::~Scope() {
+    probe.duration.record(micros() - started);
+}
+
+#ifdef APB_LATENCY_HISTOGRAMS
+TaskCallback APB::Latency::task(Scheduler &scheduler, const char *name, TaskCallback callback) {
+    Probe *probe = new Probe{"task", name, true};
+    return [probe, callback, &scheduler]() {
+        probe->lateness.record(scheduler.currentTask().getStartDelay() * 1000);
+        Scope scope{*probe};
+        callback();
+    };
+}
+#endif
@@ -0,0 +1,69 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <TaskSchedulerDeclarations.h>
+
+#include "configuration.h"
+
+// Duration and lateness histograms for scheduler tasks, I2C transactions and HTTP handlers, exported in /api/metrics.
+// With APB_LATENCY_HISTOGRAMS undefined, every probe compiles away.
+namespace APB::Latency {
+
+constexpr std::array<float, 12> BucketsSeconds { 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 1 };
+
+// Each probe is only recorded from a single FreeRTOS task (the Arduino loop, the control task or async_tcp), so counters are not atomic.
+class Histogram {
+public:
+    void record(uint32_t micros);
+    // Non cumulative bucket counts, the last one being the `+Inf` bucket.
+    const std::array<uint32_t, BucketsSeconds.size() + 1> &buckets() const { return _buckets; }
+    float sumSeconds() const { return _sumMicros / 1'000'000.0; }
+private:
+    std::array<uint32_t, BucketsSeconds.size() + 1> _buckets{};
+    uint64_t _sumMicros = 0;
+};
+
+struct Probe {
+    // Probes are never destroyed, and are prepended to a global list, so a list walk started from `probes()` is always stable.
+    Probe(const char *kind, const char *name, bool hasLateness=false);
+    const char *kind;
+    const char *name;
+    bool hasLateness;
+    Histogram duration;
+    Histogram lateness;
+    const Probe *next;
+};
+
+const Probe *probes();
+
+class Scope {
+public:
+    Scope(Probe &probe);
+    ~Scope();
+private:
+    Probe &probe;
+    uint32_t started;
+};
+
+#ifdef APB_LATENCY_HISTOGRAMS
+// Wraps a task callback, recording its duration and how late `scheduler` started it (requires _TASK_TIMECRITICAL).
+// The scheduler is passed explicitly, since Scheduler::currentScheduler() is shared by the schedulers running on other FreeRTOS tasks.
+TaskCallback task(Scheduler &scheduler, const char *name, TaskCallback callback);
+#else
+inline TaskCallback task(Scheduler &, const char *, TaskCallback callback) { return callback; }
+#endif
+}
+
+#define APB_LATENCY_CONCAT_(a, b) a##b
+#define APB_LATENCY_NAME_(prefix, line) APB_LATENCY_CONCAT_(prefix, line)
+#ifdef APB_LATENCY_HISTOGRAMS
+// Records the duration of the enclosing block
+#define APB_LATENCY_SCOPE(kind, name) \
+    static APB::Latency::Probe APB_LATENCY_NAME_(_apbLatencyProbe, __LINE__){kind, name}; \
+    APB::Latency::Scope APB_LATENCY_NAME_(_apbLatencyScope, __LINE__){APB_LATENCY_NAME_(_apbLatencyProbe, __LINE__)}
+// Records the duration of an expression, and returns its value
+#define APB_LATENCY_MEASURE(kind, name, expression) ([&]() { APB_LATENCY_SCOPE(kind, name); return (expression); }())
+#else
+#define APB_LATENCY_SCOPE(kind, name)
+#define APB_LATENCY_MEASURE(kind, name, expression) (expression)
+#endif
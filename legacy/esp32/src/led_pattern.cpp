@@ -0,0 +1,41 @@
+#include "led_pattern.h"
+
+APB::LedPattern APB::LedPattern::blink(uint8_t onBlinks, uint8_t offBlinks, uint8_t repeats, uint8_t blinksBetweenRepeats, bool stateBetweenRepeats) {
+    LedPattern pattern;
+    pattern.size = 0;
+    bool complete = true;
+    for(uint8_t repeat = 0; complete && repeat < repeats; repeat++) {
+        complete = pattern.append(true, onBlinks * BlinkMs) && pattern.append(false, offBlinks * BlinkMs);
+    }
+    if(complete) {
+        pattern.append(stateBetweenRepeats, blinksBetweenRepeats * BlinkMs);
+    }
+    if(pattern.size == 0) {
+        return steady(false);
+    }
+    if(pattern.size == 1) {
+        return steady(pattern.steps[0].on);
+    }
+    return pattern;
+}
+
+APB::LedPattern APB::LedPattern::steady(bool on) {
+    LedPattern pattern;
+    pattern.steps[0] = {on, 0};
+    return pattern;
+}
+
+bool APB::LedPattern::append(bool on, uint32_t durationMs) {
+    if(durationMs == 0) {
+        return true;
+    }
+    if(size > 0 && steps[size-1].on == on) {
+        steps[size-1].durationMs += durationMs;
+        return true;
+    }
+    if(size == MaxSteps) {
+        return false;
+    }
+    steps[size++] = {on, durationMs};
+    return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+namespace APB {
+
+// Blink pattern compiled into a looping table of LED states and durations.
+// AsyncLed plays it back with one timer callback per transition, and no timer at all for a steady LED.
+struct LedPattern {
+    struct Step {
+        bool on = false;
+        uint32_t durationMs = 0;
+    };
+    static constexpr uint8_t MaxSteps = 16;
+    static constexpr uint32_t BlinkMs = 100;
+
+    // `repeats` cycles of `onBlinks` on and `offBlinks` off, followed by `blinksBetweenRepeats` in `stateBetweenRepeats`,
+    // each blink lasting BlinkMs. Empty steps are dropped, and consecutive steps with the same state merged.
+    // Patterns longer than MaxSteps are truncated.
+    static LedPattern blink(uint8_t onBlinks, uint8_t offBlinks, uint8_t repeats=1, uint8_t blinksBetweenRepeats=0, bool stateBetweenRepeats=false);
+    static LedPattern steady(bool on);
+
+    bool animated() const { return size > 1; }
+
+    std::array<Step, MaxSteps> steps{};
+    uint8_t size = 1;
+private:
+    // Returns false when the table is full
+    bool append(bool on, uint32_t durationMs);
+};
+}
@@ -0,0 +1,159 @@
+#include "log_ring.h"
+#include <Arduino.h>
+#include <ArduinoLog.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+static_assert((APB_LOG_RING_BYTES & (APB_LOG_RING_BYTES - 1)) == 0, "The log ring size must be a power of two");
+static_assert((APB_LOG_RING_PSRAM_BYTES & (APB_LOG_RING_PSRAM_BYTES - 1)) == 0, "The log ring size must be a power of two");
+
+APB::LogRing &APB::LogRing::Instance = *new APB::LogRing();
+
+void APB::LogRing::setup() {
+    std::lock_guard<std::mutex> lock(mutex);
+    ring.allocate(APB_LOG_RING_BYTES, APB_LOG_RING_PSRAM_BYTES);
+    lineEnd = 0;
+}
+
+size_t APB::LogRing::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t APB::LogRing::write(const uint8_t *data, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(ring.capacity() == 0 || size == 0) {
+        return size;
+    }
+    const size_t written = size;
+    if(size > ring.capacity()) {
+        data += size - ring.capacity();
+        size = ring.capacity();
+    }
+    if(ring.full(size)) {
+        // Drops whole lines, unless a single line fills the ring
+        const uint32_t needed = ring.head() + size - ring.capacity();
+        uint32_t tail = needed;
+        for(uint32_t offset = needed - 1; offset != ring.head(); offset++) {
+            if(ring.at(offset) == '\n') {
+                tail = offset + 1;
+                break;
+            }
+        }
+        ring.drop(tail);
+        if(ByteRing::before(lineEnd, tail)) {
+            lineEnd = tail;
+        }
+    }
+    const uint32_t start = ring.head();
+    ring.append(data, size);
+    for(size_t index = size; index > 0; index--) {
+        if(data[index - 1] == '\n') {
+            lineEnd = start + index;
+            break;
+        }
+    }
+    return written;
+}
+
+uint32_t APB::LogRing::lineAfter(uint32_t offset, uint32_t end) const {
+    while(offset != end) {
+        if(ring.at(offset++) == '\n') {
+            return offset;
+        }
+    }
+    return end;
+}
+
+int APB::LogRing::lineLevel(uint8_t first) {
+    switch(first) {
+    case 'F':
+        return LOG_LEVEL_FATAL;
+    case 'E':
+        return LOG_LEVEL_ERROR;
+    case 'W':
+        return LOG_LEVEL_WARNING;
+    case 'I':
+    case 'N':
+        return LOG_LEVEL_INFO;
+    case 'T':
+        return LOG_LEVEL_TRACE;
+    case 'V':
+        return LOG_LEVEL_VERBOSE;
+    default:
+        // Without a level prefix: always shown
+        return LOG_LEVEL_SILENT;
+    }
+}
+
+int APB::LogRing::parseLevel(const char *level) {
+    static const char *names[] = {"silent", "fatal", "error", "warning", "info", "trace", "verbose"};
+    for(int index = 0; index < static_cast<int>(std::size(names)); index++) {
+        if(strcasecmp(level, names[index]) == 0) {
+            return index;
+        }
+    }
+    if(strcasecmp(level, "notice") == 0) {
+        return LOG_LEVEL_NOTICE;
+    }
+    char *end;
+    const long number = strtol(level, &end, 10);
+    return end != level && *end == 0 ? std::clamp<long>(number, LOG_LEVEL_SILENT, LOG_LEVEL_VERBOSE) : LOG_LEVEL_VERBOSE;
+}
+
+APB::LogRing::Reader::Reader(LogRing &ring, uint32_t since, int level) : ring{ring}, level{level} {
+    std::lock_guard<std::mutex> lock(ring.mutex);
+    next = since;
+    // Overwritten, or from before a reboot
+    if(ByteRing::before(since, ring.ring.tail()) || ByteRing::before(ring.lineEnd, since)) {
+        next = ring.ring.tail();
+    }
+    _first = next;
+    _end = ring.lineEnd;
+}
+
+void APB::LogRing::Reader::copy(uint8_t *buffer, size_t size) {
+    ring.ring.read(next, buffer, size);
+    next += size;
+}
+
+size_t APB::LogRing::Reader::read(uint8_t *buffer, size_t maxLen) {
+    std::lock_guard<std::mutex> lock(ring.mutex);
+    if(ByteRing::before(next, ring.ring.tail())) {
+        ring.ring.skipOverwritten(next, _end);
+        // The rest of a line being sent was overwritten: end it, so that it doesn't run into the next one
+        if(lineLeft > 0 && maxLen > 0) {
+            lineLeft = 0;
+            buffer[0] = '\n';
+            return 1;
+        }
+        lineLeft = 0;
+    }
+    size_t length = 0;
+    if(lineLeft > 0) {
+        length = std::min(lineLeft, maxLen);
+        copy(buffer, length);
+        lineLeft -= length;
+        return length;
+    }
+    while(next != _end && length < maxLen) {
+        const uint32_t lineEnd = ring.lineAfter(next, _end);
+        const size_t lineLength = lineEnd - next;
+        if(lineLevel(ring.ring.at(next)) > level) {
+            next = lineEnd;
+            continue;
+        }
+        if(length + lineLength > maxLen) {
+            // Lines are only split when a whole chunk can't hold them
+            if(length == 0) {
+                copy(buffer, maxLen);
+                lineLeft = lineLength - maxLen;
+                return maxLen;
+            }
+            break;
+        }
+        copy(buffer + length, lineLength);
+        length += lineLength;
+    }
+    return length;
+}
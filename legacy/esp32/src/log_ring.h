@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <Print.h>
+
+#include "configuration.h"
+#include "byte_ring.h"
+
+// Text log ring buffer, added as an ArduinoLog handler, in PSRAM when available. Every byte has an offset counted since boot,
+// so that /api/logs?since=<offset> clients only get the lines written after their last request, and know what they missed.
+namespace APB {
+
+class LogRing : public Print {
+public:
+    // Allocates the ring buffer. Lines written before are discarded.
+    void setup();
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    size_t capacity() const { return ring.capacity(); }
+
+    // Streams the complete lines from an offset at the given level or more severe, copying them from the ring to the chunks.
+    // Lines overwritten before or while streaming are skipped, and a line overwritten halfway through is ended with a newline.
+    class Reader {
+    public:
+        Reader(LogRing &ring, uint32_t since, int level);
+        size_t read(uint8_t *buffer, size_t maxLen);
+        // Offset of the first line streamed, after `since` if older lines were overwritten
+        uint32_t first() const { return _first; }
+        // Offset to request next
+        uint32_t end() const { return _end; }
+    private:
+        LogRing &ring;
+        const int level;
+        uint32_t next;
+        uint32_t _first;
+        uint32_t _end;
+        // Bytes left of a line longer than the last chunk
+        size_t lineLeft = 0;
+        // Requires the ring mutex
+        void copy(uint8_t *buffer, size_t size);
+    };
+
+    static int parseLevel(const char *level);
+    static LogRing &Instance;
+private:
+    // From the oldest line to the partial line being written
+    ByteRing ring;
+    // End of the last complete line
+    uint32_t lineEnd = 0;
+    std::mutex mutex;
+
+    // Requires the mutex. Offset after the end of the line starting at `offset`, or `end` if not complete
+    uint32_t lineAfter(uint32_t offset, uint32_t end) const;
+    static int lineLevel(uint8_t first);
+};
+}
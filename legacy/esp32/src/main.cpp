@@ -23,12 +23,29 @@
 #include <ArduinoOTA.h>
 #include "pd_protocol.h"
 #include "fan.h"
+#include "latency.h"
+#include "control_task.h"
+#include "i2c_wire.h"
+#include "power_save.h"
+#include "trace.h"
+#include "binary_log.h"
+#include "log_ring.h"
+#include "json_arena.h"
 
 Scheduler scheduler;
 
 
+// Arduino loop task, notified by the user button interrupt
+TaskHandle_t loopTask;
+
 #ifdef ONEBUTTON_USER_BUTTON_1
 OneButton userButton;
+
+void IRAM_ATTR onUserButton() {
+  BaseType_t higherPriorityTaskWoken = pdFALSE;
+  vTaskNotifyGiveFromISR(loopTask, &higherPriorityTaskWoken);
+  portYIELD_FROM_ISR(higherPriorityTaskWoken);
+}
 #endif
 
 
@@ -43,6 +60,7 @@ using namespace std::placeholders;
 using namespace GuLinux;
 
 void setup() {
+  loopTask = xTaskGetCurrentTaskHandle();
   Serial.begin(115200);
   #ifdef WAIT_FOR_SERIAL
   auto wait_until = millis() + WAIT_FOR_SERIAL; while(!Serial && millis() < wait_until);
@@ -54,21 +72,26 @@ void setup() {
   AsyncBufferedTCPLogger::instance().begin(9911);
   AsyncBufferedTCPLogger::instance().setBacklogLines(APB_NETWORK_LOGGER_BACKLOG);
 
+  APB::LogRing::Instance.setup();
   Log.begin(LOG_LEVEL_VERBOSE, &Serial, true);
   Log.addHandler(&AsyncBufferedTCPLogger::instance());
+  Log.addHandler(&APB::LogRing::Instance);
   Log.infoln(LOG_SCOPE "setup, core: %d", xPortGetCoreID());
   
   
 
   LittleFS.begin();
   APB::Settings::Instance.setup();
+  APB::Trace::Instance.setup();
+  APB::BinaryLog::Instance.setup();
+  APB::JsonArena::setup();
 
   PDProtocol::setVoltage(APB::Settings::Instance.pdVoltage());
 
   #ifdef APB_PWM_FAN_PIN
   Fan::Instance().setup(100'000, APB::Settings::Instance.fanDuty());
   #endif
-  APB::StatusLed::Instance.setup(&scheduler);
+  APB::StatusLed::Instance.setup();
   #ifdef WIFI_POWER_TX
   WiFi.setTxPower(WIFI_POWER_TX);
   #endif
@@ -80,10 +103,10 @@ void setup() {
     Log.infoln(LOG_SCOPE "WiFi event: %s", WiFi.eventName(event));
   });
   
-  rescanTask.set(30'000, TASK_FOREVER, [](){
+  rescanTask.set(30'000, TASK_FOREVER, APB::Latency::task(scheduler, "wifi_rescan", [](){
     Log.infoln(LOG_SCOPE "Rescanning WiFi networks");
     WiFiManager::Instance.rescan();
-  });
+  }));
   scheduler.addTask(rescanTask);
   WiFiManager::Instance.setOnConnectedCallback([](const AsyncWiFiMulti::ApSettings &){
     APB::StatusLed::Instance.okPattern();
@@ -96,17 +119,28 @@ void setup() {
   WiFiManager::Instance.setOnDisconnectedCallback(std::bind(&APB::StatusLed::wifiConnectionFailedPattern, &APB::StatusLed::Instance));
   WiFiManager::Instance.setup(&APB::Settings::Instance.wifi());
 
-  new Task(500, TASK_FOREVER, [](){ WiFiManager::Instance.loop(); }, &scheduler, true);
+  new Task(500, TASK_FOREVER, APB::Latency::task(scheduler, "wifimanager", [](){ WiFiManager::Instance.loop(); }), &scheduler, true);
 
+  // Drivers initialise synchronously on Wire, then all transactions go through the I2C bus task
   Wire.begin(I2C_SDA_PIN, I2C_SCL_PIN);
   Wire.setClock(100000);
-  APB::Ambient::Instance.setup(scheduler);
-  APB::PowerMonitor::Instance.setup(scheduler);
-  std::for_each(APB::PWMOutputs::Instance.begin(), APB::PWMOutputs::Instance.end(), [i=0](APB::PWMOutput &pwmOutput) mutable { pwmOutput.setup(i++, scheduler); });
+  Scheduler &controlScheduler = APB::ControlTask::Instance.scheduler();
+  APB::Ambient::Instance.setup(controlScheduler);
+  APB::PowerMonitor::Instance.setup(controlScheduler);
+  std::for_each(APB::PWMOutputs::Instance.begin(), APB::PWMOutputs::Instance.end(), [&controlScheduler, i=0](APB::PWMOutput &pwmOutput) mutable { pwmOutput.setup(i++, controlScheduler); });
+  #ifdef APB_PWM_FAN_PIN
+  Fan::Instance().setupControl(controlScheduler, APB::Settings::Instance.fanAutomatic());
+  #endif
   
   webServer.setup();
   ArduinoOTAManager::Instance.setup([](const char*s) { Log.warning(s); }, std::bind(&fs::LittleFSFS::end, &LittleFS));
   APB::History::Instance.setup(scheduler);
+  APB::PowerSave::Instance.setup(scheduler, std::bind(&APB::WebServer::clientsCount, &webServer));
+  // All the telemetry sinks are subscribed: start publishing
+  APB::I2C::begin();
+  APB::PWMOutputs::setWakeControl(std::bind(&APB::ControlTask::wake, &APB::ControlTask::Instance));
+  APB::ControlTask::Instance.setOnWake(&APB::PWMOutputs::processAmbientSamples);
+  APB::ControlTask::Instance.begin();
 
 #ifdef ONEBUTTON_USER_BUTTON_1
   userButton.attachDoubleClick([]() {
@@ -126,15 +160,24 @@ void setup() {
   #define _BTN_MODE INPUT_PULLUP
   #endif
   userButton.setup(ONEBUTTON_USER_BUTTON_1, _BTN_MODE, _BTN_ACTIVELOW);
+  attachInterrupt(ONEBUTTON_USER_BUTTON_1, onUserButton, CHANGE);
 #endif
 
-  new Task(100, TASK_FOREVER, [](){ ArduinoOTAManager::Instance.loop(); }, &scheduler, true);
+  new Task(100, TASK_FOREVER, APB::Latency::task(scheduler, "ota", [](){ ArduinoOTAManager::Instance.loop(); }), &scheduler, true);
 }
 
 void loop() {
   scheduler.execute();
+  // Tickless: block until the next task is due, letting the idle task (and light sleep) run in between
+  uint32_t sleepMs = std::min<unsigned long>(scheduler.getNextRun(), APB_MAIN_LOOP_MAX_SLEEP_MS);
 
 #ifdef ONEBUTTON_USER_BUTTON_1
   userButton.tick();
+  if(!userButton.isIdle()) {
+    sleepMs = std::min<uint32_t>(sleepMs, APB_USER_BUTTON_POLL_MS);
+  }
 #endif
+  if(sleepMs > 0) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(sleepMs));
+  }
 }
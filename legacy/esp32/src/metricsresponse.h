@@ -1,40 +1,43 @@
 #pragma once
 
-#include <ESPAsyncWebServer.h>
-#include <list>
-#include <ArduinoLog.h>
-#include <StreamString.h>
-#include "utils.h"
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <algorithm>
-#include <numeric>
 
 #define METRICS_CONTENT_TYPE "text/plain; version=0.0.4"
+#define METRICS_LABELS_SIZE 160
+#define METRICS_RECORD_SIZE 384
 
-namespace APB {   
+namespace APB {
 
+// Prometheus text exposition writer.
+// Records (a sample, plus its HELP/TYPE headers) are formatted on the stack and copied straight into the supplied buffer,
+// typically the buffer of a chunked response, so a scrape doesn't use the heap.
+// When a record doesn't fit, writing stops: the next chunk replays the same sequence of calls with `skipRecords`
+// set to `records()`, so that the records already sent are skipped without being formatted.
+// If not even the first record fits, `written()` is 0 while `full()` is set: the chunk should be retried, not ended.
 class MetricsResponse {
 public:
-    struct Labels {
-        StreamString buffer;
-        Labels concat(const Labels &other) const {
-            Labels newLabels;
-            newLabels.add(*this);
-            newLabels.add(other);
-            return newLabels;
-        }
-
+    class Labels {
+    public:
+        Labels() : buffer{}, length{0} {}
 
         Labels &add(const Labels &other) {
-            if(!other.buffer.isEmpty()) {
-                addSeparator();
+            if(!other.empty()) {
+                append("%s%s", separator(), other.c_str());
             }
-            buffer.print(other.c_str());
             return *this;
         }
 
         Labels &add(const char *label, const char *value) {
-            addSeparator();
-            buffer.printf(R"(%s="%s")", label, value);
+            append(R"(%s%s="%s")", separator(), label, value);
+            return *this;
+        }
+        Labels &add(const char *label, int value) {
+            append(R"(%s%s="%d")", separator(), label, value);
             return *this;
         }
         Labels &field(const char *value) {
@@ -45,56 +48,135 @@ public:
         }
 
         const char *c_str() const {
-            return buffer.c_str();
+            return buffer;
         }
+        bool empty() const {
+            return length == 0;
+        }
+    private:
+        char buffer[METRICS_LABELS_SIZE];
+        size_t length;
 
-        void addSeparator() {
-            if(!buffer.isEmpty()) {
-                buffer.write(',');
-            }
+        const char *separator() const {
+            return empty() ? "" : ",";
+        }
+        void append(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+            va_list args;
+            va_start(args, format);
+            int appended = vsnprintf(buffer + length, sizeof(buffer) - length, format, args);
+            va_end(args);
+            length = std::min(sizeof(buffer) - 1, length + std::max(appended, 0));
         }
     };
-    MetricsResponse(AsyncWebServerRequest *request, const Labels &fixedLabels, size_t bufferSize=1048 * 10, int statusCode=200)
-        : request{request}, response{request->beginResponseStream(METRICS_CONTENT_TYPE)}, fixedLabels{fixedLabels} {
+
+    MetricsResponse(uint8_t *buffer, size_t bufferSize, const Labels &fixedLabels, size_t skipRecords=0)
+        : buffer{buffer}, bufferSize{bufferSize}, fixedLabels{fixedLabels}, skipRecords{skipRecords} {
     }
 
     MetricsResponse &counter(const char *name, float value, const Labels &labels = {}, const char *help = nullptr, bool addHeaders=true) {
-        if(addHeaders) {
-            addHelp(name, help);
-            addType(name, "counter");
-        }
-        response->printf("%s {%s} %f\n", name, fixedLabels.concat(labels).c_str(), value);
-        return *this;
+        return sample(name, "counter", value, labels, help, addHeaders);
     }
 
     MetricsResponse &gauge(const char *name, float value, const Labels &labels = {}, const char *help = nullptr, bool addHeaders=true) {
+        return sample(name, "gauge", value, labels, help, addHeaders);
+    }
+
+    // `bucketCounts` holds the non cumulative count for each of the `buckets` upper bounds, followed by the `+Inf` bucket count.
+    // Every line is a separate record, so that a histogram can span several chunks.
+    MetricsResponse &histogram(const char *name, const float *upperBounds, const uint32_t *bucketCounts, size_t buckets, float sum,
+        const Labels &labels = {}, const char *help = nullptr, bool addHeaders=true) {
         if(addHeaders) {
-            addHelp(name, help);
-            addType(name, "gauge");
+            record([&](Record &record) { record.headers(name, "histogram", help); });
+        }
+        Labels series;
+        series.add(fixedLabels).add(labels);
+        const char *separator = series.empty() ? "" : ",";
+        uint32_t cumulative = 0;
+        for(size_t bucket = 0; bucket < buckets; bucket++) {
+            cumulative += bucketCounts[bucket];
+            record([&](Record &record) {
+                record.print("%s_bucket {%s%sle=\"%g\"} %u\n", name, series.c_str(), separator, upperBounds[bucket], cumulative);
+            });
         }
-        
-        
-        response->printf("%s {%s} %f\n", name, fixedLabels.concat(labels).c_str(), value);
+        cumulative += bucketCounts[buckets];
+        record([&](Record &record) { record.print("%s_bucket {%s%sle=\"+Inf\"} %u\n", name, series.c_str(), separator, cumulative); });
+        record([&](Record &record) { record.print("%s_sum {%s} %f\n", name, series.c_str(), sum); });
+        record([&](Record &record) { record.print("%s_count {%s} %u\n", name, series.c_str(), cumulative); });
         return *this;
     }
 
-    ~MetricsResponse() {
-        request->send(response);
-    }
+    // Bytes written in the buffer
+    size_t written() const { return _written; }
+    // Records consumed so far, either written or skipped. Pass it as `skipRecords` when writing the next chunk.
+    size_t records() const { return _records; }
+    bool full() const { return _full; }
 
 private:
-    void addType(const char *name, const char *type) {
-        response->printf("# TYPE %s %s\n", name, type);
+    struct Record {
+        char buffer[METRICS_RECORD_SIZE];
+        size_t length = 0;
+        bool truncated = false;
+        template<typename... Args> void print(const char *format, Args... args) {
+            int printed = snprintf(buffer + length, sizeof(buffer) - length, format, args...);
+            truncated |= length + std::max(printed, 0) >= sizeof(buffer);
+            length = std::min(sizeof(buffer) - 1, length + std::max(printed, 0));
+        }
+        void headers(const char *name, const char *type, const char *help) {
+            if(help) {
+                print("# HELP %s %s\n", name, help);
+            }
+            print("# TYPE %s %s\n", name, type);
+        }
+    };
+
+    template<typename F> void record(F format) {
+        if(!beginRecord()) {
+            return;
+        }
+        Record record;
+        format(record);
+        commitRecord(record.buffer, record.truncated ? 0 : record.length);
     }
-    void addHelp(const char *name, const char *help) {
-        if(help) {
-            response->printf("# HELP %s %s\n", name, help);
+
+    MetricsResponse &sample(const char *name, const char *type, float value, const Labels &labels, const char *help, bool addHeaders) {
+        record([&](Record &record) {
+            if(addHeaders) {
+                record.headers(name, type, help);
+            }
+            record.print("%s {%s%s%s} %f\n", name, fixedLabels.c_str(), !fixedLabels.empty() && !labels.empty() ? "," : "", labels.c_str(), value);
+        });
+        return *this;
+    }
+
+    bool beginRecord() {
+        if(_full) {
+            return false;
+        }
+        if(_records < skipRecords) {
+            _records++;
+            return false;
+        }
+        return true;
+    }
+
+    // A record truncated to METRICS_RECORD_SIZE is passed with length 0, and dropped instead of sending a partial line.
+    void commitRecord(const char *record, size_t length) {
+        if(_written + length > bufferSize) {
+            _full = true;
+            return;
         }
+        memcpy(buffer + _written, record, length);
+        _written += length;
+        _records++;
     }
 
-    AsyncResponseStream *response;
-    AsyncWebServerRequest *request;
-    const Labels fixedLabels;
+    uint8_t *buffer;
+    size_t bufferSize;
+    const Labels &fixedLabels;
+    size_t skipRecords;
+    size_t _written = 0;
+    size_t _records = 0;
+    bool _full = false;
 };
 
 }
@@ -0,0 +1,113 @@
+#include "power_save.h"
+#include <ArduinoLog.h>
+#include <WiFi.h>
+#include <cmath>
+#include "fan.h"
+#include "latency.h"
+
+#define LOG_SCOPE "APB::PowerSave - "
+
+APB::PowerSave &APB::PowerSave::Instance = *new APB::PowerSave();
+
+void APB::PowerSave::setup(Scheduler &scheduler, const ClientsCount &clientsCount) {
+    this->clientsCount = clientsCount;
+    activity();
+#ifdef APB_POWERSAVE_LIGHT_SLEEP
+#if CONFIG_PM_ENABLE && CONFIG_FREERTOS_USE_TICKLESS_IDLE
+    // Same minimum and maximum frequency: scaling the APB clock would also change the LEDC PWM frequencies
+    const int cpuFrequency = getCpuFrequencyMhz();
+#if CONFIG_IDF_TARGET_ESP32S2
+    esp_pm_config_esp32s2_t pmConfig{};
+#elif CONFIG_IDF_TARGET_ESP32S3
+    esp_pm_config_esp32s3_t pmConfig{};
+#elif CONFIG_IDF_TARGET_ESP32C3
+    esp_pm_config_esp32c3_t pmConfig{};
+#else
+    esp_pm_config_esp32_t pmConfig{};
+#endif
+    pmConfig.max_freq_mhz = cpuFrequency;
+    pmConfig.min_freq_mhz = cpuFrequency;
+    pmConfig.light_sleep_enable = true;
+    esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "apb_outputs", &noLightSleepLock);
+    if(esp_err_t result = esp_pm_configure(&pmConfig); result != ESP_OK) {
+        Log.warningln(LOG_SCOPE "Unable to enable automatic light sleep: %s", esp_err_to_name(result));
+    }
+#else
+    Log.warningln(LOG_SCOPE "Automatic light sleep requires CONFIG_PM_ENABLE and CONFIG_FREERTOS_USE_TICKLESS_IDLE");
+#endif
+#endif
+    PWMOutputs::samples.subscribe(std::bind(&PowerSave::onPWMOutputSample, this, std::placeholders::_1));
+    PowerMonitor::Instance.samples.subscribe(std::bind(&PowerSave::onPowerSample, this, std::placeholders::_1));
+    updateTask.set(APB_POWERSAVE_UPDATE_INTERVAL_MS, TASK_FOREVER, Latency::task(scheduler, "powersave", std::bind(&PowerSave::update, this)));
+    scheduler.addTask(updateTask);
+    updateTask.enable();
+    Log.infoln(LOG_SCOPE "Setup finished");
+}
+
+std::optional<float> APB::PowerSave::controllerCurrent(bool modemSleep) const {
+    const float current = _controllerCurrent[modemSleep].load(std::memory_order_relaxed);
+    if(std::isnan(current)) {
+        return {};
+    }
+    return current;
+}
+
+void APB::PowerSave::update() {
+#ifdef APB_PWM_FAN_PIN
+    fanOn = Fan::Instance().duty() > 0;
+#endif
+#ifdef APB_POWERSAVE_LIGHT_SLEEP
+    updateLightSleepLock();
+#endif
+    const bool idle = clientsCount() == 0 && millis() - lastActivity.load(std::memory_order_relaxed) > APB_POWERSAVE_IDLE_MS;
+    // Modem sleep is only supported in station mode
+    const bool modemSleep = idle && WiFi.getMode() == WIFI_STA;
+    if(modemSleep == _modemSleep) {
+        return;
+    }
+    if(WiFi.setSleep(modemSleep ? WIFI_PS_MIN_MODEM : WIFI_PS_NONE)) {
+        _modemSleep = modemSleep;
+        Log.infoln(LOG_SCOPE "WiFi modem sleep %s", modemSleep ? "enabled" : "disabled");
+    }
+}
+
+void APB::PowerSave::onPWMOutputSample(const PWMOutputs::Sample &sample) {
+    const uint32_t mask = 1 << sample.index;
+    if(sample.duty > 0) {
+        activeOutputs.fetch_or(mask, std::memory_order_relaxed);
+    } else {
+        activeOutputs.fetch_and(~mask, std::memory_order_relaxed);
+    }
+#ifdef APB_POWERSAVE_LIGHT_SLEEP
+    // Taken right away from the publishing task, so the output doesn't stop until the next update
+    updateLightSleepLock();
+#endif
+}
+
+void APB::PowerSave::onPowerSample(const PowerMonitor::Status &status) {
+    if(activeOutputs.load(std::memory_order_relaxed) != 0 || fanOn) {
+        return;
+    }
+    std::atomic<float> &average = _controllerCurrent[_modemSleep];
+    const float previous = average.load(std::memory_order_relaxed);
+    average.store(std::isnan(previous) ? status.current : previous + APB_POWERSAVE_CURRENT_ALPHA * (status.current - previous), std::memory_order_relaxed);
+}
+
+#ifdef APB_POWERSAVE_LIGHT_SLEEP
+void APB::PowerSave::updateLightSleepLock() {
+    if(!noLightSleepLock) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(lightSleepMutex);
+    const bool hold = activeOutputs.load(std::memory_order_relaxed) != 0 || fanOn;
+    if(hold == lightSleepHeld) {
+        return;
+    }
+    if(hold) {
+        esp_pm_lock_acquire(noLightSleepLock);
+    } else {
+        esp_pm_lock_release(noLightSleepLock);
+    }
+    lightSleepHeld = hold;
+}
+#endif
@@ -0,0 +1,62 @@
+#ifndef APB_POWER_SAVE_H
+#define APB_POWER_SAVE_H
+
+#include <Arduino.h>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <TaskSchedulerDeclarations.h>
+
+#include "configuration.h"
+#include "powermonitor.h"
+#include "pwm_output.h"
+
+#ifdef APB_POWERSAVE_LIGHT_SLEEP
+#include <esp_pm.h>
+#endif
+
+namespace APB {
+
+// Lowers the controller's own draw while nobody is watching.
+// WiFi modem sleep is enabled in station mode once no HTTP request was served for APB_POWERSAVE_IDLE_MS,
+// and no SSE or WebSocket client is connected. With APB_POWERSAVE_LIGHT_SLEEP, the chip also enters automatic
+// light sleep between the tasks deadlines, held off by a power management lock while any PWM output or the fan is on,
+// since LEDC stops during light sleep.
+// The controller draw is measured by the INA219 itself, while all the PWM outputs and the fan are off,
+// and averaged separately with and without modem sleep.
+class PowerSave {
+public:
+    using ClientsCount = std::function<size_t()>;
+    static PowerSave &Instance;
+    void setup(Scheduler &scheduler, const ClientsCount &clientsCount);
+    // An HTTP request was served, keeping the radio awake for APB_POWERSAVE_IDLE_MS
+    void activity() { lastActivity.store(millis(), std::memory_order_relaxed); }
+    bool modemSleep() const { return _modemSleep; }
+    // Average controller current (A), with or without modem sleep, once measured
+    std::optional<float> controllerCurrent(bool modemSleep) const;
+private:
+    ClientsCount clientsCount;
+    Task updateTask;
+    std::atomic<uint32_t> lastActivity{0};
+    std::atomic<bool> _modemSleep{false};
+    // Bitmask of the PWM outputs with a duty above 0, set by the PWMOutputs::samples subscription
+    std::atomic<uint32_t> activeOutputs{0};
+    std::atomic<bool> fanOn{false};
+    // Exponential moving averages, NaN until the first sample. Written by the I2C bus task.
+    std::array<std::atomic<float>, 2> _controllerCurrent{NAN, NAN};
+#ifdef APB_POWERSAVE_LIGHT_SLEEP
+    esp_pm_lock_handle_t noLightSleepLock = nullptr;
+    bool lightSleepHeld = false;
+    std::mutex lightSleepMutex;
+    void updateLightSleepLock();
+#endif
+
+    void update();
+    void onPWMOutputSample(const PWMOutputs::Sample &sample);
+    void onPowerSample(const PowerMonitor::Status &status);
+};
+}
+
+#endif
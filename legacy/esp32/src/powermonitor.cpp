@@ -4,12 +4,23 @@
 #include <array>
 #include <utility>
 #include "settings.h"
+#include "latency.h"
+#include "i2c_wire.h"
+
+#define INA219_SHUNT_VOLTAGE_REGISTER 0x01
+#define INA219_BUS_VOLTAGE_REGISTER 0x02
+#define INA219_POWER_REGISTER 0x03
+#define INA219_CURRENT_REGISTER 0x04
 
 
 float lipoBatteryCharge(uint8_t cells, float voltage);
 
 APB::PowerMonitor &APB::PowerMonitor::Instance = *new APB::PowerMonitor();
 
+namespace {
+    const APB::I2C::Device ina219Device{"ina219", APB_INA1219_ADDRESS, APB_INA219_I2C_CLOCK};
+}
+
 APB::PowerMonitor::PowerMonitor() {
 }
 
@@ -17,8 +28,9 @@ APB::PowerMonitor::~PowerMonitor() {
 }
 
 void APB::PowerMonitor::setup(Scheduler &scheduler) {
-    _status.initialised = _ina219.begin();
-    if(_status.initialised) {
+    const bool initialised = _ina219.begin();
+    _status.write(Status{initialised});
+    if(initialised) {
         Log.infoln("Powermonitor initialised: INA219 with address 0x%x", APB_INA1219_ADDRESS);
         
         
@@ -33,18 +45,8 @@ void APB::PowerMonitor::setup(Scheduler &scheduler) {
             static_cast<int>(_ina219.getShunt() * 1000.0)
         );
 
-        _loopTask.set(1000, TASK_FOREVER, [this](){
-            _status.busVoltage = _ina219.getBusVoltage();
-            _status.current = _ina219.getCurrent();
-            _status.power = _ina219.getPower();
-            _status.shuntVoltage = _ina219.getShuntVoltage();
-            setCharge();
-            if(_status.power == 0 && _status.current == 0) {
-                #ifdef DEBUG_POWERMONITOR_STATUS
-                Log.warningln("Powermonitor: Reporting power as 0. INA status: %d", _ina219.isConnected());
-                #endif
-            }
-        });
+        _currentLSB = _ina219.getCurrentLSB();
+        _loopTask.set(_sampling.interval(), TASK_FOREVER, Latency::task(scheduler, "powermonitor", std::bind(&PowerMonitor::requestSample, this)));
         scheduler.addTask(_loopTask);
         _loopTask.enable();
     } else {
@@ -52,22 +54,70 @@ void APB::PowerMonitor::setup(Scheduler &scheduler) {
     }
 }
 
+void APB::PowerMonitor::requestSample() {
+    if(_loopTask.getInterval() != _sampling.interval()) {
+        _loopTask.setInterval(_sampling.interval());
+    }
+    // Register reads go through the I2C bus queue, the sample is published by the last callback, on the bus task.
+    const auto readRegister = [this](uint8_t reg, void (PowerMonitor::*onRead)(I2C::Status, int16_t)) {
+        return I2C::Instance.submit(ina219Device, {reg}, 2, [this, onRead](I2C::Status status, const uint8_t *data, size_t) {
+            (this->*onRead)(status, status == I2C::Status::Ok ? static_cast<int16_t>(data[0] << 8 | data[1]) : 0);
+        });
+    };
+    readRegister(INA219_BUS_VOLTAGE_REGISTER, &PowerMonitor::onBusVoltage) &&
+        readRegister(INA219_SHUNT_VOLTAGE_REGISTER, &PowerMonitor::onShuntVoltage) &&
+        readRegister(INA219_POWER_REGISTER, &PowerMonitor::onPower) &&
+        readRegister(INA219_CURRENT_REGISTER, &PowerMonitor::onCurrent);
+}
+
+void APB::PowerMonitor::onBusVoltage(I2C::Status status, int16_t value) {
+    _sample = Status{true};
+    _sampleValid = status == I2C::Status::Ok;
+    // Bits 3-15, 4mV LSB
+    _sample.busVoltage = (static_cast<uint16_t>(value) >> 3) * 0.004f;
+}
+
+void APB::PowerMonitor::onShuntVoltage(I2C::Status status, int16_t value) {
+    _sampleValid &= status == I2C::Status::Ok;
+    // 10uV LSB
+    _sample.shuntVoltage = value * 0.00001f;
+}
+
+void APB::PowerMonitor::onPower(I2C::Status status, int16_t value) {
+    _sampleValid &= status == I2C::Status::Ok;
+    _sample.power = static_cast<uint16_t>(value) * 20 * _currentLSB;
+}
+
+void APB::PowerMonitor::onCurrent(I2C::Status status, int16_t value) {
+    _sampleValid &= status == I2C::Status::Ok;
+    _sample.current = value * _currentLSB;
+    if(!_sampleValid) {
+        Log.warningln("Powermonitor: error reading INA219 registers, keeping the previous sample");
+        return;
+    }
+    setCharge(_sample);
+    _status.write(_sample);
+    _sampling.update(_sample.power);
+    samples.publish(_sample);
+}
+
 void APB::PowerMonitor::toJson(JsonObject powerStatus) {
-    powerStatus["busVoltage"] = _status.busVoltage;
-    powerStatus["current"] = _status.current;
-    powerStatus["power"] = _status.power;
-    powerStatus["shuntVoltage"] = _status.shuntVoltage;
-    powerStatus["charge"] = _status.charge;
+    const Status status = _status.read();
+    powerStatus["busVoltage"] = status.busVoltage;
+    powerStatus["current"] = status.current;
+    powerStatus["power"] = status.power;
+    powerStatus["shuntVoltage"] = status.shuntVoltage;
+    powerStatus["charge"] = status.charge;
 }
 
-void APB::PowerMonitor::setCharge()
+void APB::PowerMonitor::setCharge(Status &status)
 {
     switch (Settings::Instance.powerSource()) {
     case LipoBattery3C:
-        _status.charge = lipoBatteryCharge(3, _status.busVoltage);
+        status.charge = lipoBatteryCharge(3, status.busVoltage);
         break;
     default:
-        _status.charge = 100.0f;
+        status.charge = 100.0f;
     }
 }
 
@@ -3,10 +3,15 @@
 
 #include <optional>
 #include <memory>
+#include <functional>
 #include <TaskSchedulerDeclarations.h>
 #include <ArduinoJson.h>
 
 #include "configuration.h"
+#include "snapshot.h"
+#include "topic.h"
+#include "i2c_bus.h"
+#include "adaptive_interval.h"
 #include <INA219.h>
 
 namespace APB {
@@ -30,15 +35,29 @@ public:
         AC = 0,
         LipoBattery3C = 1,
     };
-    Status status() const { return _status; }
+    Status status() const { return _status.read(); }
     void toJson(JsonObject powerStatus);
+    // Every valid sample, published by the I2C bus task
+    Topic<Status> samples;
+    uint32_t samplingInterval() const { return _sampling.interval(); }
 private:
     INA219 _ina219{APB_INA1219_ADDRESS};
-    PowerMonitor::Status _status;
+    // Written at setup, then by the I2C bus task callbacks
+    Snapshot<Status> _status;
     Task _loopTask;
     PowerSource _powerSource = AC;
+    float _currentLSB = 0;
+    // Sample being read, only accessed by the I2C bus callbacks
+    Status _sample;
+    bool _sampleValid = false;
+    AdaptiveInterval _sampling{{APB_POWER_MONITOR_SAMPLING_MIN_MS, APB_POWER_MONITOR_SAMPLING_MAX_MS, APB_POWER_MONITOR_SAMPLING_THRESHOLD}};
 
-    void setCharge();
+    static void setCharge(Status &status);
+    void requestSample();
+    void onBusVoltage(I2C::Status status, int16_t value);
+    void onShuntVoltage(I2C::Status status, int16_t value);
+    void onPower(I2C::Status status, int16_t value);
+    void onCurrent(I2C::Status status, int16_t value);
 };
 }
 
@@ -1,6 +1,10 @@
 #include <ArduinoLog.h>
 #include <LittleFS.h>
 #include <array>
+#include <atomic>
+#include <functional>
+#include <cmath>
+#include <mutex>
 
 #include "pwm_output.h"
 #include "configuration.h"
@@ -12,6 +16,12 @@
 
 #include "settings.h"
 #include "utils.h"
+#include "latency.h"
+#include "snapshot.h"
+#include "adaptive_interval.h"
+#include "trace.h"
+#include "binary_log.h"
+#include "json_arena.h"
 #include <unordered_map>
 
 #define PWM_OUT_CONF_FILENAME APB_CONFIG_DIRECTORY "/pwmOutputs.json"
@@ -21,32 +31,75 @@ static const char *TEMPERATURE_NOT_FOUND_WARNING_LOG = "%s Cannot set PWM output
 static const char *AMBIENT_NOT_FOUND_WARNING_LOG = "%s Cannot set PWM output temperature without ambient sensor";
 
 APB::PWMOutputs::Array &APB::PWMOutputs::Instance = *new APB::PWMOutputs::Array();
+APB::Topic<APB::PWMOutputs::Sample> &APB::PWMOutputs::samples = *new APB::Topic<APB::PWMOutputs::Sample>();
+
+namespace {
+std::function<void()> wakeControl;
+}
+
+void APB::PWMOutputs::setWakeControl(const std::function<void()> &wake) {
+    wakeControl = wake;
+}
+
+void APB::PWMOutputs::processAmbientSamples() {
+    std::for_each(Instance.begin(), Instance.end(), std::mem_fn(&PWMOutput::processAmbientSample));
+}
 
 struct APB::PWMOutput::Private {
     Private(PWMOutput *q, Type type) : q{q}, type{type} {}
     APB::PWMOutput *q;
     Type type;
-    
-    PWMOutput::Mode mode{PWMOutput::Mode::off};
-    float maxDuty;
-    float minDuty = 0;
-    std::optional<float> temperature;
-    float targetTemperature;
-    float dewpointOffset;
-    float rampOffset = 0;
 
-    bool applyAtStartup = false;
+    struct State {
+        PWMOutput::Mode mode{PWMOutput::Mode::off};
+        float maxDuty = 0;
+        float minDuty = 0;
+        std::optional<float> temperature;
+        float targetTemperature = 0;
+        float dewpointOffset = 0;
+        float rampOffset = 0;
+        float duty = 0;
+        bool applyAtStartup = false;
+
+        std::optional<float> targetTemperatureIfSet() const;
+        std::optional<float> dewpointOffsetIfSet() const;
+        std::optional<float> rampOffsetIfSet() const;
+        std::optional<float> minDutyIfSet() const;
+    };
+    // Owned by the control task, and by commands from the web server: both hold the mutex while changing it.
+    State state;
+    std::mutex mutex;
+    // Copy of `state` for the getters, published after every change. Written from several tasks, always under the mutex.
+    Snapshot<State> published;
+    AdaptiveInterval sampling{{APB_PWM_OUTPUT_SAMPLING_MIN_MS, APB_PWM_OUTPUT_SAMPLING_MAX_MS, APB_PWM_OUTPUT_SAMPLING_THRESHOLD}};
+    // Target temperature of the last control step, for the trace. Requires the mutex.
+    std::optional<float> target;
+    // Last ambient sample, delivered by the Ambient::samples subscription. Requires the mutex.
+    std::optional<Ambient::Reading> ambient;
+    // Set by the subscription for dewpoint outputs, cleared by the control step following the sample
+    std::atomic<bool> ambientPending{false};
+    // micros() of the pending sample, for the latency probe. Requires the mutex.
+    uint32_t ambientSampledAt = 0;
 
     Task loopTask;
     char log_scope[20];
+    char task_name[16];
     uint8_t index;
     PWMOutput::GetTargetTemperature getTargetTemperature;
     
     void privateSetup();
     void loop();
+    // Runs the control step and publishes the state, requires the mutex.
+    void update();
+    // After a command: the control task recomputes its next deadline
+    void wakeControl();
+    void control();
+    // Records the state set by a command, requires the mutex
+    void traceCommand();
+    void onAmbientSample(const Ambient::Sample &sample);
+    void ambientStep();
     void readTemperature();
     void writePinDuty(float pwm);
-    float getDuty() const;
 
 #ifdef APB_PWM_OUTPUT_TEMPERATURE_SENSOR_THERMISTOR
 #if APB_PWM_OUTPUTS_SIZE > 0
@@ -99,10 +152,13 @@ APB::PWMOutput::Type APB::PWMOutput::type() const {
 void APB::PWMOutput::setup(uint8_t index, Scheduler &scheduler) {
     d->index = index;
     sprintf(d->log_scope, "PWMOutput[%d] -", index);
+    sprintf(d->task_name, "pwm_output_%d", index);
 
     d->privateSetup();
+    d->ambient = Ambient::Instance.reading();
+    Ambient::Instance.samples.subscribe(std::bind(&PWMOutput::Private::onAmbientSample, d, std::placeholders::_1));
 
-    d->loopTask.set(APB_PWM_OUTPUT_UPDATE_INTERVAL_SECONDS * 1000, TASK_FOREVER, std::bind(&PWMOutput::Private::loop, d));
+    d->loopTask.set(d->sampling.interval(), TASK_FOREVER, Latency::task(scheduler, d->task_name, std::bind(&PWMOutput::Private::loop, d)));
     scheduler.addTask(d->loopTask);
     d->loopTask.enable();
     loadFromJson(); 
@@ -119,7 +175,8 @@ void APB::PWMOutput::loadFromJson() {
         } else {
             Log.infoln("%s PWMOutputs configuration file opened", d->log_scope);
         }
-        JsonDocument doc;
+        JsonArena::Lease arena;
+        JsonDocument doc(arena);
         DeserializationError error = deserializeJson(doc, file);
         if(error) {
             Log.errorln("%s Error parsing pwmOutputs configuration file: %s", d->log_scope, error.c_str());
@@ -133,7 +190,7 @@ void APB::PWMOutput::loadFromJson() {
         bool applyAtStartup = pwmOutputs[d->index]["apply_at_startup"].as<bool>();
         Log.infoln("%s PWMOutputs configuration file loaded, applyAtStartup=%T", d->log_scope, applyAtStartup);
         if(applyAtStartup) {
-            d->readTemperature();
+            d->loop();
             const char *error = setState(pwmOutputs[d->index].as<JsonObject>());
             if(error) {
                 Log.errorln("%s Error setting pwm output state from configuration: %s", d->log_scope, error);
@@ -144,18 +201,19 @@ void APB::PWMOutput::loadFromJson() {
 
 
 void APB::PWMOutput::toJson(JsonObject pwmOutputStatus) {
-    pwmOutputStatus["mode"] = modeAsString(),
-    pwmOutputStatus["max_duty"] = maxDuty();
-    pwmOutputStatus["duty"] = duty();
-    pwmOutputStatus["active"] = active();
-    pwmOutputStatus["has_temperature"] = temperature().has_value();
-    pwmOutputStatus["apply_at_startup"] = d->applyAtStartup;
+    const Private::State state = d->published.read();
+    pwmOutputStatus["mode"] = Private::modesToString.at(state.mode),
+    pwmOutputStatus["max_duty"] = state.maxDuty;
+    pwmOutputStatus["duty"] = state.duty;
+    pwmOutputStatus["active"] = state.duty > 0;
+    pwmOutputStatus["has_temperature"] = state.temperature.has_value();
+    pwmOutputStatus["apply_at_startup"] = state.applyAtStartup;
     pwmOutputStatus["type"] = d->typesToString.at(type());
-    optional::if_present(rampOffset(), [&](float v){ pwmOutputStatus["ramp_offset"] = v; });
-    optional::if_present(minDuty(), [&](float v){ pwmOutputStatus["min_duty"] = v; });
-    optional::if_present(temperature(), [&](float v){ pwmOutputStatus["temperature"] = v; });
-    optional::if_present(targetTemperature(), [&](float v){ pwmOutputStatus["target_temperature"] = v; });
-    optional::if_present(dewpointOffset(), [&](float v){ pwmOutputStatus["dewpoint_offset"] = v; });
+    optional::if_present(state.rampOffsetIfSet(), [&](float v){ pwmOutputStatus["ramp_offset"] = v; });
+    optional::if_present(state.minDutyIfSet(), [&](float v){ pwmOutputStatus["min_duty"] = v; });
+    optional::if_present(state.temperature, [&](float v){ pwmOutputStatus["temperature"] = v; });
+    optional::if_present(state.targetTemperatureIfSet(), [&](float v){ pwmOutputStatus["target_temperature"] = v; });
+    optional::if_present(state.dewpointOffsetIfSet(), [&](float v){ pwmOutputStatus["dewpoint_offset"] = v; });
 }
 
 std::forward_list<String> APB::PWMOutput::validModes()
@@ -176,38 +234,49 @@ APB::PWMOutput::Mode APB::PWMOutput::modeFromString(const String &mode) {
 
 const String APB::PWMOutput::modeAsString() const
 {
+    return modeName();
+}
+
+const char *APB::PWMOutput::modeName() const {
     return Private::modesToString.at(mode());
 }
 
 float APB::PWMOutput::maxDuty() const {
-    return d->maxDuty;
+    return d->published.read().maxDuty;
 }
 
 float APB::PWMOutput::duty() const {
-    return d->getDuty();
+    return d->published.read().duty;
 }
 
 bool APB::PWMOutput::active() const {
-    return d->getDuty() > 0;
+    return duty() > 0;
 }
 
 bool APB::PWMOutput::applyAtStartup() const {
-    return d->applyAtStartup;
+    return d->published.read().applyAtStartup;
 }
 
 void APB::PWMOutput::setMaxDuty(float duty) {
+    std::lock_guard<std::mutex> lock(d->mutex);
     if(duty > 0) {
-        d->maxDuty = duty;
-        d->mode = PWMOutput::Mode::fixed;
+        d->state.maxDuty = duty;
+        d->state.mode = PWMOutput::Mode::fixed;
     } else {
-        d->mode = PWMOutput::Mode::off;
+        d->state.mode = PWMOutput::Mode::off;
     }
-    d->loop();
+    d->traceCommand();
+    d->update();
+    d->wakeControl();
 }
 
 const char *APB::PWMOutput::setState(JsonObject json) {
     PWMOutput::Mode mode = PWMOutput::modeFromString(json["mode"]);
-    d->applyAtStartup = json["apply_at_startup"].as<bool>();
+    {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        d->state.applyAtStartup = json["apply_at_startup"].as<bool>();
+        d->published.write(d->state);
+    }
     if(mode == PWMOutput::Mode::off) {
         setMaxDuty(0);
         return nullptr;
@@ -239,22 +308,37 @@ const char *APB::PWMOutput::setState(JsonObject json) {
     return nullptr;
 }
 
+uint32_t APB::PWMOutput::samplingInterval() const {
+    return d->sampling.interval();
+}
+
 uint8_t APB::PWMOutput::index() const { 
     return d->index;
 }
 
+int8_t APB::PWMOutput::thermistorPin() const {
+#ifdef APB_PWM_OUTPUT_TEMPERATURE_SENSOR_THERMISTOR
+    return d->pinout->thermistor;
+#else
+    return -1;
+#endif
+}
+
 
 bool APB::PWMOutput::setTemperature(float targetTemperature, float maxDuty, float minDuty, float rampOffset) {
     if(!this->temperature().has_value()) {
         Log.warningln(TEMPERATURE_NOT_FOUND_WARNING_LOG, d->log_scope);
         return false;
     }
-    d->targetTemperature = targetTemperature;
-    d->maxDuty = maxDuty;
-    d->minDuty = minDuty;
-    d->mode = PWMOutput::Mode::target_temperature;
-    d->rampOffset = rampOffset >= 0 ? rampOffset : 0;
-    d->loop();
+    std::lock_guard<std::mutex> lock(d->mutex);
+    d->state.targetTemperature = targetTemperature;
+    d->state.maxDuty = maxDuty;
+    d->state.minDuty = minDuty;
+    d->state.mode = PWMOutput::Mode::target_temperature;
+    d->state.rampOffset = rampOffset >= 0 ? rampOffset : 0;
+    d->traceCommand();
+    d->update();
+    d->wakeControl();
     return true;
 }
 
@@ -267,114 +351,202 @@ bool APB::PWMOutput::setDewpoint(float offset, float maxDuty, float minDuty, flo
         Log.warningln(AMBIENT_NOT_FOUND_WARNING_LOG, d->log_scope);
         return false;
     }
-    d->dewpointOffset = offset;
-    d->rampOffset = rampOffset >= 0 ? rampOffset : 0;
-    d->minDuty = minDuty;
-    d->maxDuty = maxDuty;
-    d->mode = PWMOutput::Mode::dewpoint;
-    d->loop();
+    std::lock_guard<std::mutex> lock(d->mutex);
+    d->state.dewpointOffset = offset;
+    d->state.rampOffset = rampOffset >= 0 ? rampOffset : 0;
+    d->state.minDuty = minDuty;
+    d->state.maxDuty = maxDuty;
+    d->state.mode = PWMOutput::Mode::dewpoint;
+    d->traceCommand();
+    d->update();
+    d->wakeControl();
     return true;
 }
 
 
 std::optional<float> APB::PWMOutput::targetTemperature() const {
-    if(d->mode != PWMOutput::Mode::target_temperature) {
+    return d->published.read().targetTemperatureIfSet();
+}
+
+std::optional<float> APB::PWMOutput::dewpointOffset() const {
+    return d->published.read().dewpointOffsetIfSet();
+}
+
+std::optional<float> APB::PWMOutput::rampOffset() const {
+    return d->published.read().rampOffsetIfSet();
+}
+
+std::optional<float> APB::PWMOutput::minDuty() const {
+    return d->published.read().minDutyIfSet();
+}
+
+std::optional<float> APB::PWMOutput::temperature() const {
+    return d->published.read().temperature;
+}
+
+APB::PWMOutput::Mode APB::PWMOutput::mode() const {
+    return d->published.read().mode;
+}
+
+std::optional<float> APB::PWMOutput::Private::State::targetTemperatureIfSet() const {
+    if(mode != PWMOutput::Mode::target_temperature) {
         return {};
     }
-    return {d->targetTemperature};
+    return {targetTemperature};
 }
 
-std::optional<float> APB::PWMOutput::dewpointOffset() const {
-    if(d->mode != PWMOutput::Mode::dewpoint) {
+std::optional<float> APB::PWMOutput::Private::State::dewpointOffsetIfSet() const {
+    if(mode != PWMOutput::Mode::dewpoint) {
         return {};
     }
-    return {d->dewpointOffset};
+    return {dewpointOffset};
 }
 
-std::optional<float> APB::PWMOutput::rampOffset() const {
-    if(d->mode != Mode::dewpoint && d->mode != Mode::target_temperature) {
+std::optional<float> APB::PWMOutput::Private::State::rampOffsetIfSet() const {
+    if(mode != Mode::dewpoint && mode != Mode::target_temperature) {
         return {};
     }
-    return {d->rampOffset};
+    return {rampOffset};
 }
 
-std::optional<float> APB::PWMOutput::minDuty() const {
-    if(d->mode != Mode::dewpoint && d->mode != Mode::target_temperature) {
+std::optional<float> APB::PWMOutput::Private::State::minDutyIfSet() const {
+    if(mode != Mode::dewpoint && mode != Mode::target_temperature) {
         return {};
     }
-    return {d->minDuty};
+    return {minDuty};
 }
 
-std::optional<float> APB::PWMOutput::temperature() const {
-    return d->temperature;
+void APB::PWMOutput::Private::loop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    update();
+    if(state.temperature) {
+        sampling.update(*state.temperature);
+    }
+    if(loopTask.getInterval() != sampling.interval()) {
+        loopTask.setInterval(sampling.interval());
+    }
 }
 
-APB::PWMOutput::Mode APB::PWMOutput::mode() const {
-    return d->mode;
+void APB::PWMOutput::Private::update() {
+    control();
+    Trace::Instance.add(Trace::Type::Output, index, pwmValue, state.temperature.value_or(NAN), target.value_or(NAN));
+    published.write(state);
+    PWMOutputs::samples.publish({index, state.mode, state.duty, state.temperature});
+}
+
+void APB::PWMOutput::Private::traceCommand() {
+    const float setpoint = state.mode == Mode::dewpoint ? state.dewpointOffset : state.targetTemperature;
+    Trace::Instance.addCommand(index, state.mode, state.maxDuty, state.minDuty, setpoint, state.rampOffset);
+}
+
+void APB::PWMOutput::Private::onAmbientSample(const Ambient::Sample &sample) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ambient = sample.reading;
+        if(state.mode != PWMOutput::Mode::dewpoint) {
+            return;
+        }
+        ambientSampledAt = sample.sampledAt;
+    }
+    // Dewpoint targets follow each ambient sample right away instead of at the next control step. This runs on the I2C
+    // bus task, that must not wait for the ADC and control work: the control task is woken up to run the step.
+    ambientPending = true;
+    if(::wakeControl) {
+        ::wakeControl();
+    } else {
+        ambientStep();
+    }
+}
+
+void APB::PWMOutput::processAmbientSample() {
+    d->ambientStep();
+}
+
+void APB::PWMOutput::Private::ambientStep() {
+    if(!ambientPending.exchange(false)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if(state.mode != PWMOutput::Mode::dewpoint) {
+        return;
+    }
+    update();
+#ifdef APB_LATENCY_HISTOGRAMS
+    // All the outputs record from the control task
+    static Latency::Probe latency{"pipeline", "ambient_to_pwm"};
+    latency.duration.record(micros() - ambientSampledAt);
+#endif
 }
 
-void APB::PWMOutput::Private::loop()
+void APB::PWMOutput::Private::wakeControl() {
+    if(::wakeControl) {
+        ::wakeControl();
+    }
+}
+
+void APB::PWMOutput::Private::control()
 {
+    target.reset();
     readTemperature();
     
-    if(temperature.has_value() && temperature.value() < -50) {
+    if(state.temperature.has_value() && state.temperature.value() < -50) {
         #ifdef DEBUG_HEATER_STATUS
         Log.traceln("%s invalid temperature detected, discarding temperature", log_scope);
         #endif
-        temperature = {};
-        if(mode == PWMOutput::Mode::dewpoint || mode == PWMOutput::Mode::target_temperature) {
+        state.temperature = {};
+        if(state.mode == PWMOutput::Mode::dewpoint || state.mode == PWMOutput::Mode::target_temperature) {
             Log.warningln("%s Lost temperature sensor, switching off.", log_scope);
-            mode = PWMOutput::Mode::off;
+            state.mode = PWMOutput::Mode::off;
         }
     }
 
-    if(mode == PWMOutput::Mode::fixed) {
-        writePinDuty(maxDuty);
+    if(state.mode == PWMOutput::Mode::fixed) {
+        writePinDuty(state.maxDuty);
         return;
     }
-    if(mode == PWMOutput::Mode::off) {
+    if(state.mode == PWMOutput::Mode::off) {
         writePinDuty(0);
         return;
     }
     // From nmow on we require a temperature sensor on the heater
-    if(!temperature) {
+    if(!state.temperature) {
         Log.warningln("%s Unable to set target temperature, sensor not found.", log_scope);
-        q->setMaxDuty(0);
+        state.mode = PWMOutput::Mode::off;
+        writePinDuty(0);
         return;
     }
 
     float dynamicTargetTemperature;
-    if(mode == PWMOutput::Mode::target_temperature) {
-        dynamicTargetTemperature = this->targetTemperature;
+    if(state.mode == PWMOutput::Mode::target_temperature) {
+        dynamicTargetTemperature = state.targetTemperature;
     }
-    if(mode == PWMOutput::Mode::dewpoint) {
-        if(!Ambient::Instance.reading()) {
+    if(state.mode == PWMOutput::Mode::dewpoint) {
+        if(!ambient) {
             Log.warningln("%s Unable to set target temperature, ambient sensor not found.", log_scope);
-            q->setMaxDuty(0);
+            state.mode = PWMOutput::Mode::off;
+            writePinDuty(0);
             return;
         }
-        dynamicTargetTemperature = dewpointOffset + Ambient::Instance.reading()->dewpoint();
+        dynamicTargetTemperature = state.dewpointOffset + ambient->dewpoint();
     }
 
-    float currentTemperature = temperature.value();
-    Log.traceln("%s Got target temperature=`%F`", log_scope, dynamicTargetTemperature);
-    Log.traceln("%s current temperature=`%F`", log_scope, currentTemperature);
+    target = dynamicTargetTemperature;
+    float currentTemperature = state.temperature.value();
+    // Close to the setpoint the control loop needs fresh readings
+    if(std::abs(dynamicTargetTemperature - currentTemperature) < APB_PWM_OUTPUT_SETPOINT_MARGIN) {
+        sampling.boost();
+        if(state.mode == PWMOutput::Mode::dewpoint) {
+            Ambient::Instance.boostSampling();
+        }
+    }
+    APB_BINARY_LOG(PWMOutputTarget, index, dynamicTargetTemperature, currentTemperature);
     if(currentTemperature < dynamicTargetTemperature) {
-        float rampFactor = rampOffset > 0 ? (dynamicTargetTemperature - currentTemperature)/rampOffset : 1;
-        float targetPWM = std::max(0.f, std::min(1.f, rampFactor * (maxDuty-minDuty) + minDuty));
-        Log.infoln("%s - temperature `%F` lower than target temperature `%F`, ramp=`%F` and PWM range is `%F-%F`, ramp factor=`%F`, setting PWM to `%F`",
-            log_scope,
-            currentTemperature,
-            dynamicTargetTemperature,
-            rampOffset,
-            minDuty,
-            maxDuty,
-            rampFactor,
-            targetPWM
-        );
+        float rampFactor = state.rampOffset > 0 ? (dynamicTargetTemperature - currentTemperature)/state.rampOffset : 1;
+        float targetPWM = std::max(0.f, std::min(1.f, rampFactor * (state.maxDuty-state.minDuty) + state.minDuty));
+        APB_BINARY_LOG(PWMOutputRamp, index, currentTemperature, dynamicTargetTemperature, state.rampOffset, state.minDuty, state.maxDuty, rampFactor, targetPWM);
         writePinDuty(targetPWM);
     } else {
-        Log.infoln("%s - temperature `%F` reached target temperature `%F`, setting PWM to 0", log_scope, currentTemperature, dynamicTargetTemperature);
+        APB_BINARY_LOG(PWMOutputReached, index, currentTemperature, dynamicTargetTemperature);
         writePinDuty(0);
     }
 }
@@ -408,26 +580,21 @@ void APB::PWMOutput::Private::readTemperature() {
         return;
     }
     auto rawValue = analogRead(pinout->thermistor);
-    temperature = smoothThermistor->temperature();
+    state.temperature = smoothThermistor->temperature();
+    Trace::Instance.add(Trace::Type::Thermistor, index, rawValue, *state.temperature, NAN);
     #ifdef DEBUG_HEATER_STATUS
-    Log.infoln("%s readThemperature: raw=%F, from smoothThermistor: %F", log_scope, rawValue, *temperature);
+    Log.infoln("%s readThemperature: raw=%F, from smoothThermistor: %F", log_scope, rawValue, *state.temperature);
     #endif
 }
 
-float APB::PWMOutput::Private::getDuty() const {
-    int8_t pwmChannel = analogGetChannel(pinout->thermistor);
-    float pwmValue = ledcRead(pwmChannel);
-    // Log.traceln("%s PWM value from ADC channel %d: %F; stored PWM value: %d", log_scope, pwmChannel, pwmValue, this->pwmValue);
-    return this->pwmValue/MAX_PWM;
-}
-
 void APB::PWMOutput::Private::writePinDuty(float pwm) {
     int16_t newPWMValue = std::max(int16_t{0}, static_cast<int16_t>(std::min(MAX_PWM, MAX_PWM * pwm)));
     if(newPWMValue != pwmValue) {
         pwmValue = newPWMValue;
-        Log.traceln("%s setting PWM=%d for pin %d", log_scope, pwmValue, pinout->pwm);
+        APB_BINARY_LOG(PWMOutputSetPWM, index, pwmValue, pinout->pwm);
         analogWrite(pinout->pwm, pwmValue);
     }
+    state.duty = pwmValue/MAX_PWM;
 }
 
 #endif
@@ -447,7 +614,8 @@ void APB::PWMOutputs::saveConfig() {
         Log.errorln("[PWMOutputs] Error opening pwmOutputs configuration file" );
         return;
     }
-    JsonDocument doc;
+    JsonArena::Lease arena;
+    JsonDocument doc(arena);
     toJson(doc.to<JsonArray>());
     serializeJson(doc, file);
     file.close();
@@ -9,6 +9,7 @@
 
 #include "configuration.h"
 #include "ambient/ambient.h"
+#include "topic.h"
 
 namespace APB {
 
@@ -18,6 +19,11 @@ namespace PWMOutputs {
     extern Array &Instance;
     void toJson(JsonArray pwmOutputStatus);
     void saveConfig();
+    // Called from other tasks to wake up the control task running the outputs: after commands, and when an ambient sample
+    // is pending for a dewpoint output, for processAmbientSamples(). Without it, i.e. on the host, samples are processed
+    // right away by the Ambient::samples subscription.
+    void setWakeControl(const std::function<void()> &wake);
+    void processAmbientSamples();
 }
 
 
@@ -50,8 +56,14 @@ public:
     static std::forward_list<String> validModes();
     static Mode modeFromString(const String &mode);
     const String modeAsString() const;
+    const char *modeName() const;
     uint8_t index() const;
+    uint32_t samplingInterval() const;
     Type type() const;
+    // Analog input of the thermistor, or -1 without temperature sensor
+    int8_t thermistorPin() const;
+    // Runs the dewpoint control step following an ambient sample, if one is pending. On the control task.
+    void processAmbientSample();
 private:
     bool setTemperature(float targetTemperature, float maxDuty=1, float minDuty=0, float rampOffset=0);
     bool setDewpoint(float offset, float maxDuty=1, float minDuty=0, float rampOffset=0);
@@ -63,6 +75,17 @@ private:
     friend struct Private;
     std::shared_ptr<Private> d;
 };
+
+namespace PWMOutputs {
+    struct Sample {
+        uint8_t index;
+        PWMOutput::Mode mode;
+        float duty;
+        std::optional<float> temperature;
+    };
+    // Every control step of every PWM output, published by the task running it: the control task, or the web server for commands.
+    extern Topic<Sample> &samples;
+}
 }
 
 
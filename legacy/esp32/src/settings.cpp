@@ -10,6 +10,7 @@
 
 #define APB_KEY_STATUS_LED_DUTY "status_led_duty"
 #define APB_KEY_FAN_DUTY "fan_duty"
+#define APB_KEY_FAN_AUTOMATIC "fan_auto"
 #define APB_KEY_POWER_SOURCE_TYPE "power_src_type"
 
 #define LOG_SCOPE "APB::Configuration - "
@@ -52,6 +53,7 @@ void APB::Settings::load() {
     }
     _statusLedDuty = prefs.getFloat(APB_KEY_STATUS_LED_DUTY, 1);
     _fanDuty = prefs.getFloat(APB_KEY_FAN_DUTY, 1.0);
+    _fanAutomatic = prefs.getBool(APB_KEY_FAN_AUTOMATIC, true);
     _pdVoltage = static_cast<PDProtocol::Voltage>(prefs.getUShort("pd_voltage", static_cast<uint16_t>(PDProtocol::V12)));
     _powerSource = static_cast<PowerMonitor::PowerSource>(prefs.getUShort(APB_KEY_POWER_SOURCE_TYPE, static_cast<uint16_t>(PowerMonitor::AC)));
     wifiSettings.load();
@@ -63,6 +65,7 @@ void APB::Settings::loadDefaults() {
     _powerSource = PowerMonitor::AC;
     _statusLedDuty = 1.0;
     _fanDuty = 1.0;
+    _fanAutomatic = true;
     _pdVoltage = PDProtocol::V12;
 }
 
@@ -74,6 +77,7 @@ void APB::Settings::save() {
     wifiSettings.save();
     prefs.putFloat(APB_KEY_STATUS_LED_DUTY, _statusLedDuty);
     prefs.putFloat(APB_KEY_FAN_DUTY, _fanDuty);
+    prefs.putBool(APB_KEY_FAN_AUTOMATIC, _fanAutomatic);
     prefs.putUShort(APB_KEY_POWER_SOURCE_TYPE, static_cast<uint16_t>(_powerSource));
     prefs.putUShort("pd_voltage", static_cast<uint16_t>(_pdVoltage));
     Log.infoln(LOG_SCOPE "Preferences saved");
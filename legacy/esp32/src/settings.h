@@ -22,10 +22,12 @@ public:
 
     float statusLedDuty() const { return _statusLedDuty; };
     float fanDuty() const { return _fanDuty; };
+    bool fanAutomatic() const { return _fanAutomatic; };
     PDProtocol::Voltage pdVoltage() const { return _pdVoltage; }
     void setPdVoltage(PDProtocol::Voltage voltage) { _pdVoltage = voltage; }
     void setStatusLedDuty(float duty) { _statusLedDuty = duty; }
     void setFanDuty(float duty) { _fanDuty = duty; }
+    void setFanAutomatic(bool automatic) { _fanAutomatic = automatic; }
     PowerMonitor::PowerSource powerSource() const;
     void setPowerSource(PowerMonitor::PowerSource powerSource);
 
@@ -35,6 +37,7 @@ private:
     GuLinux::WiFiSettings wifiSettings;
     float _statusLedDuty;
     float _fanDuty;
+    bool _fanAutomatic;
     PDProtocol::Voltage _pdVoltage = PDProtocol::V12;
     PowerMonitor::PowerSource _powerSource;
     void loadDefaults();
@@ -0,0 +1,38 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+namespace APB {
+
+// Lock-free publication of a value from serialized writers to any number of readers.
+// Double buffered seqlock: the writer fills the inactive slot and then flips the version, so it never waits for readers.
+// Readers copy the active slot, and retry only if a whole write completed meanwhile, so a higher priority reader
+// preempting the writer on the same core can't spin.
+template<typename T> class Snapshot {
+    static_assert(std::is_trivially_copyable_v<T>, "Snapshot values are copied while possibly being written, they must be trivially copyable");
+public:
+    Snapshot(const T &value = {}) : slots{value, value} {}
+
+    // Writers must be serialized: by a single task, or by a mutex held around every write. Never waits for readers.
+    void write(const T &value) {
+        const uint32_t next = version.load(std::memory_order_relaxed) + 1;
+        slots[next & 1] = value;
+        version.store(next, std::memory_order_release);
+    }
+
+    T read() const {
+        T copy;
+        uint32_t current;
+        do {
+            current = version.load(std::memory_order_acquire);
+            copy = slots[current & 1];
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while(current != version.load(std::memory_order_relaxed));
+        return copy;
+    }
+private:
+    std::atomic<uint32_t> version{0};
+    T slots[2];
+};
+}
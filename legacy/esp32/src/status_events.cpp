@@ -0,0 +1,337 @@
+#include "status_events.h"
+#include <ArduinoLog.h>
+#include <algorithm>
+#include <optional>
+
+#include "ambient/ambient.h"
+#include "powermonitor.h"
+#include "pwm_output.h"
+#include "history.h"
+#include "latency.h"
+
+#define LOG_SCOPE "APB::StatusEvents "
+
+namespace {
+    using Topic = APB::StatusEvents::Topic;
+    struct TopicName {
+        Topic topic;
+        const char *name;
+    };
+    constexpr std::array<TopicName, 4> topicNames {{
+        { Topic::TopicAmbient, "ambient" },
+        { Topic::TopicPower, "power" },
+        { Topic::TopicPWMOutputs, "pwmOutputs" },
+        { Topic::TopicApp, "app" },
+    }};
+
+    // ArduinoJson writer appending to an existing String, since serializeJson(doc, String&) replaces its content.
+    struct StringAppender {
+        String &string;
+        size_t write(uint8_t c) {
+            return string.concat(static_cast<char>(c)) ? 1 : 0;
+        }
+        size_t write(const uint8_t *buffer, size_t length) {
+            return string.concat(reinterpret_cast<const char*>(buffer), length) ? length : 0;
+        }
+    };
+}
+
+APB::StatusEvents::StatusEvents(const char *url) : events{url} {
+}
+
+void APB::StatusEvents::setup(AsyncWebServer &webserver, Scheduler &scheduler) {
+    events.authorizeConnect(std::bind(&StatusEvents::onAuthorize, this, std::placeholders::_1));
+    events.onConnect(std::bind(&StatusEvents::onConnect, this, std::placeholders::_1));
+    events.onDisconnect(std::bind(&StatusEvents::onDisconnect, this, std::placeholders::_1));
+    webserver.addHandler(&events);
+    Ambient::Instance.samples.subscribe([this](const Ambient::Sample &) { updatedTopics |= TopicAmbient; });
+    PowerMonitor::Instance.samples.subscribe([this](const PowerMonitor::Status &) { updatedTopics |= TopicPower; });
+    PWMOutputs::samples.subscribe([this](const PWMOutputs::Sample &) { updatedTopics |= TopicPWMOutputs; });
+    new Task(APB_EVENTS_MIN_INTERVAL_MS, TASK_FOREVER, Latency::task(scheduler, "sse_events", [this](){ publish(); }), &scheduler, true);
+}
+
+uint8_t APB::StatusEvents::parseTopics(const String &topics) {
+    uint8_t parsed = 0;
+    unsigned int start = 0;
+    while(start <= topics.length()) {
+        const int comma = topics.indexOf(',', start);
+        const unsigned int end = comma < 0 ? topics.length() : static_cast<unsigned int>(comma);
+        const String topic = topics.substring(start, end);
+        for(const auto &topicName: topicNames) {
+            if(topic == topicName.name) {
+                parsed |= topicName.topic;
+            }
+        }
+        start = end + 1;
+    }
+    return parsed;
+}
+
+bool APB::StatusEvents::onAuthorize(AsyncWebServerRequest *request) {
+    Subscription subscription;
+    if(request->hasParam("topics")) {
+        subscription.topics = parseTopics(request->getParam("topics")->value());
+        if(subscription.topics == 0) {
+            Log.warningln(LOG_SCOPE "[SSE] No valid topics in `%s`, subscribing to all topics", request->getParam("topics")->value().c_str());
+            subscription.topics = TopicAll;
+        }
+    }
+    if(request->hasParam("interval")) {
+        subscription.interval = std::clamp<long>(request->getParam("interval")->value().toInt(), APB_EVENTS_MIN_INTERVAL_MS, APB_EVENTS_MAX_INTERVAL_MS);
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    pendingSubscriptions[request->client()] = subscription;
+    return true;
+}
+
+void APB::StatusEvents::onConnect(AsyncEventSourceClient *client) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Subscription subscription;
+    auto pending = pendingSubscriptions.find(client->client());
+    if(pending != pendingSubscriptions.end()) {
+        subscription = pending->second;
+        pendingSubscriptions.erase(pending);
+    }
+    Channel &channel = channelFor(subscription);
+    channel.clients++;
+    clients.push_back({client, &channel});
+    // Event ids are millis(): a Last-Event-ID in the future means we rebooted since, and there's nothing to catch up.
+    if(client->lastId() > 0 && client->lastId() <= millis()) {
+        clients.back().replayAfter = client->lastId();
+    }
+    Log.infoln(LOG_SCOPE "[SSE] Client connected: lastId=%d, %s, topics=%X, interval=%d",
+        client->lastId(), client->client()->remoteIP().toString().c_str(), subscription.topics, subscription.interval);
+}
+
+void APB::StatusEvents::onDisconnect(AsyncEventSourceClient *client) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t dropped = 0;
+    clients.remove_if([client, &dropped](Client &c) {
+        if(c.client != client) {
+            return false;
+        }
+        c.channel->clients--;
+        dropped = c.dropped;
+        return true;
+    });
+    channels.remove_if([](const Channel &channel){ return channel.clients == 0; });
+    Log.infoln(LOG_SCOPE "[SSE] Client disconnected, dropped events: %d", dropped);
+}
+
+APB::StatusEvents::Channel &APB::StatusEvents::channelFor(const Subscription &subscription) {
+    auto found = std::find_if(channels.begin(), channels.end(), [&subscription](const Channel &channel){ return channel.subscription == subscription; });
+    if(found != channels.end()) {
+        return *found;
+    }
+    channels.emplace_back();
+    channels.back().subscription = subscription;
+    return channels.back();
+}
+
+void APB::StatusEvents::publish() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(clients.empty()) {
+        return;
+    }
+    std::for_each(clients.begin(), clients.end(), std::bind(&StatusEvents::flush, this, std::placeholders::_1));
+    std::for_each(clients.begin(), clients.end(), std::bind(&StatusEvents::replay, this, std::placeholders::_1));
+    const uint32_t now = millis();
+    // The uptime in the app topic changes at every event
+    const uint8_t updated = updatedTopics.exchange(0) | TopicApp;
+    std::for_each(channels.begin(), channels.end(), [updated](Channel &channel){ channel.pendingTopics |= updated; });
+    const auto isDue = [now](const Channel &channel) {
+        return channel.lastSent.isNull() || (
+            now - channel.lastSentAt + APB_EVENTS_MIN_INTERVAL_MS / 2 >= channel.subscription.interval &&
+            (channel.pendingTopics & channel.subscription.topics) != 0
+        );
+    };
+    uint8_t dueTopics = 0;
+    std::for_each(channels.begin(), channels.end(), [&](const Channel &channel){
+        if(isDue(channel)) {
+            dueTopics |= channel.subscription.topics;
+        }
+    });
+    if(dueTopics != 0) {
+        populateStatus(dueTopics);
+    }
+    std::for_each(channels.begin(), channels.end(), [&](Channel &channel){
+        if(isDue(channel)) {
+            publish(channel, now);
+            return;
+        }
+        // Late joiners get the last state sent to their channel, so that the following deltas apply cleanly.
+        std::optional<Message> keyframe;
+        for(auto &client: clients) {
+            if(client.channel != &channel || !client.needsKeyframe || client.replayAfter) {
+                continue;
+            }
+            if(!keyframe) {
+                keyframe = createMessage(channel.lastSent, "status", channel.lastSentAt, true);
+            }
+            client.needsKeyframe = false;
+            enqueue(client, *keyframe);
+        }
+    });
+    statusDocument.clear();
+    channelDocument.clear();
+    deltaDocument.clear();
+    replayDocument.clear();
+}
+
+void APB::StatusEvents::populateStatus(uint8_t topics) {
+    statusDocument.clear();
+    if(topics & TopicAmbient) {
+        if(Ambient::Instance.reading().has_value()) {
+            Ambient::Instance.toJson(statusDocument["ambient"].to<JsonObject>());
+        } else {
+            statusDocument["ambient"] = static_cast<char*>(0);
+        }
+    }
+    if(topics & TopicPower) {
+        PowerMonitor::Instance.toJson(statusDocument["power"].to<JsonObject>());
+    }
+    if(topics & TopicPWMOutputs) {
+        PWMOutputs::toJson(statusDocument["pwmOutputs"].to<JsonArray>());
+    }
+    if(topics & TopicApp) {
+        statusDocument["app"]["uptime"] = esp_timer_get_time() / 1000'000.0;
+    }
+}
+
+void APB::StatusEvents::publish(Channel &channel, uint32_t now) {
+    channelDocument.clear();
+    for(const auto &topicName: topicNames) {
+        if(channel.subscription.topics & topicName.topic) {
+            channelDocument[topicName.name] = statusDocument[topicName.name];
+        }
+    }
+    const bool isKeyframe = channel.eventsSinceKeyframe == 0;
+    std::optional<Message> delta;
+    if(!isKeyframe) {
+        deltaDocument.clear();
+        if(diff(channel.lastSent, channelDocument, deltaDocument.to<JsonObject>())) {
+            delta = createMessage(deltaDocument, "delta", now, false);
+        }
+    }
+    std::optional<Message> keyframe;
+    for(auto &client: clients) {
+        if(client.channel != &channel || client.replayAfter) {
+            continue;
+        }
+        if(isKeyframe || client.needsKeyframe) {
+            if(!keyframe) {
+                keyframe = createMessage(channelDocument, "status", now, true);
+            }
+            client.needsKeyframe = false;
+            enqueue(client, *keyframe);
+        } else if(delta) {
+            enqueue(client, *delta);
+        }
+    }
+    channel.lastSent = channelDocument;
+    channel.lastSentAt = now;
+    channel.pendingTopics = 0;
+    channel.eventsSinceKeyframe = (channel.eventsSinceKeyframe + 1) % APB_EVENTS_KEYFRAME_EVERY;
+}
+
+APB::StatusEvents::Message APB::StatusEvents::createMessage(JsonVariantConst payload, const char *event, uint32_t id, bool keyframe) {
+    auto data = HeapAccounting::makeShared<String, HeapAccounting::Subsystem::Events>();
+    data->reserve(measureJson(payload) + 48);
+    data->concat("id: ");
+    data->concat(id);
+    data->concat("\nevent: ");
+    data->concat(event);
+    data->concat("\nretry: 5000\ndata: ");
+    StringAppender appender{*data};
+    serializeJson(payload, appender);
+    data->concat("\n\n");
+    return {data, keyframe};
+}
+
+void APB::StatusEvents::enqueue(Client &client, const Message &message) {
+    client.backlog.push_back(message);
+    while(client.backlog.size() > APB_EVENTS_CLIENT_BACKLOG) {
+        const bool droppedDelta = !client.backlog.front().keyframe;
+        client.backlog.pop_front();
+        client.dropped++;
+        // Each delta builds on the previous ones: once one is lost, skip to the next keyframe, or request a new one.
+        if(droppedDelta) {
+            while(!client.backlog.empty() && !client.backlog.front().keyframe) {
+                client.backlog.pop_front();
+                client.dropped++;
+            }
+            client.needsKeyframe = client.backlog.empty();
+        }
+    }
+    flush(client);
+}
+
+void APB::StatusEvents::flush(Client &client) {
+    while(!client.backlog.empty() && client.client->packetsWaiting() < APB_EVENTS_CLIENT_IN_FLIGHT) {
+        if(!client.client->write(client.backlog.front().data)) {
+            return;
+        }
+        client.backlog.pop_front();
+    }
+}
+
+void APB::StatusEvents::replay(Client &client) {
+    // Live events for this client are held back until the replay is complete, then it gets a keyframe.
+    while(client.replayAfter && client.backlog.size() < APB_EVENTS_CLIENT_BACKLOG) {
+        replayDocument.clear();
+        replayDocument["now"] = esp_timer_get_time() / 1'000'000;
+        JsonArray entries = replayDocument["entries"].to<JsonArray>();
+        uint32_t lastEntryMillis = *client.replayAfter;
+        const size_t replayed = History::Instance.entriesSince(*client.replayAfter, APB_EVENTS_REPLAY_BATCH, [&entries, &lastEntryMillis](const History::Entry &entry){
+            entry.populate(entries.add<JsonObject>());
+            lastEntryMillis = entry.secondsFromBoot * 1000;
+        });
+        if(replayed == 0) {
+            client.replayAfter.reset();
+            return;
+        }
+        enqueue(client, createMessage(replayDocument, "history", lastEntryMillis, true));
+        client.replayAfter = lastEntryMillis;
+    }
+}
+
+bool APB::StatusEvents::diff(JsonVariantConst previous, JsonVariantConst current, JsonVariant delta) {
+    bool changed = false;
+    const auto diffMember = [&changed, &delta](JsonVariantConst previousValue, JsonVariantConst currentValue, auto key) {
+        const bool previousIsContainer = previousValue.is<JsonObjectConst>() || previousValue.is<JsonArrayConst>();
+        const bool currentIsContainer = currentValue.is<JsonObjectConst>() || currentValue.is<JsonArrayConst>();
+        const bool sameShape = previousValue.is<JsonArrayConst>() == currentValue.is<JsonArrayConst>() && previousValue.size() == currentValue.size();
+        if(previousIsContainer && currentIsContainer && (sameShape || currentValue.is<JsonObjectConst>())) {
+            if(diff(previousValue, currentValue, delta[key].template to<JsonObject>())) {
+                changed = true;
+            } else {
+                delta.remove(key);
+            }
+        } else if(previousValue != currentValue) {
+            delta[key] = currentValue;
+            changed = true;
+        }
+    };
+    if(current.is<JsonArrayConst>()) {
+        JsonArrayConst previousArray = previous.as<JsonArrayConst>();
+        JsonArrayConst currentArray = current.as<JsonArrayConst>();
+        char key[6];
+        for(size_t index = 0; index < currentArray.size(); index++) {
+            snprintf(key, sizeof(key), "%u", static_cast<unsigned>(index));
+            diffMember(previousArray[index], currentArray[index], key);
+        }
+        return changed;
+    }
+    JsonObjectConst previousObject = previous.as<JsonObjectConst>();
+    for(JsonPairConst member: current.as<JsonObjectConst>()) {
+        diffMember(previousObject[member.key()], member.value(), member.key());
+    }
+    for(JsonPairConst member: previousObject) {
+        if(!current[member.key()].isUnbound()) {
+            continue;
+        }
+        delta[member.key()] = static_cast<char*>(0);
+        changed = true;
+    }
+    return changed;
+}
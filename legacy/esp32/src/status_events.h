@@ -0,0 +1,104 @@
+#ifndef APB_STATUS_EVENTS_H
+#define APB_STATUS_EVENTS_H
+
+#include <ESPAsyncWebServer.h>
+#include <ArduinoJson.h>
+#include <TaskSchedulerDeclarations.h>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+#include "configuration.h"
+#include "heap_accounting.h"
+#include "json_arena.h"
+
+namespace APB {
+
+// Server Sent Events publisher for `/api/events`.
+// Clients can subscribe to a subset of topics and to a custom rate, i.e. `/api/events?topics=power,ambient&interval=5000`.
+// Clients sharing the same subscription are grouped in a channel: each channel sends a full `status` keyframe first,
+// then `delta` events carrying only the changed fields, with a full keyframe every APB_EVENTS_KEYFRAME_EVERY events.
+// Each event is formatted once, and the same refcounted buffer is queued to every client of the channel.
+// Reconnecting clients sending `Last-Event-ID` first receive the missed History entries as `history` events.
+// Topics are only rebuilt after their sensors published a new sample, so an idle channel costs nothing.
+class StatusEvents {
+public:
+    enum Topic : uint8_t {
+        TopicAmbient = 1 << 0,
+        TopicPower = 1 << 1,
+        TopicPWMOutputs = 1 << 2,
+        TopicApp = 1 << 3,
+        TopicAll = TopicAmbient | TopicPower | TopicPWMOutputs | TopicApp,
+    };
+    StatusEvents(const char *url);
+    void setup(AsyncWebServer &webserver, Scheduler &scheduler);
+
+    size_t clientsCount() const { return events.count(); }
+
+    static uint8_t parseTopics(const String &topics);
+    // Writes in `delta` the members of `current` that differ from `previous`.
+    // Arrays are diffed by index, and encoded as objects keyed by the element index.
+    static bool diff(JsonVariantConst previous, JsonVariantConst current, JsonVariant delta);
+private:
+    struct Subscription {
+        uint8_t topics = TopicAll;
+        uint32_t interval = APB_EVENTS_INTERVAL_MS;
+        bool operator==(const Subscription &other) const { return topics == other.topics && interval == other.interval; }
+    };
+    struct Channel {
+        Subscription subscription;
+        JsonDocument lastSent{HeapAccounting::json(HeapAccounting::Subsystem::Events)};
+        uint32_t lastSentAt = 0;
+        uint16_t eventsSinceKeyframe = 0;
+        uint16_t clients = 0;
+        // Topics updated since the last event
+        uint8_t pendingTopics = TopicAll;
+    };
+    struct Message {
+        AsyncEvent_SharedData_t data;
+        bool keyframe;
+    };
+    // Messages waiting for the client to drain its socket queue, at most APB_EVENTS_CLIENT_BACKLOG, dropping the oldest.
+    struct Client {
+        AsyncEventSourceClient *client;
+        Channel *channel;
+        bool needsKeyframe = true;
+        std::deque<Message, HeapAccounting::Allocator<Message, HeapAccounting::Subsystem::Events>> backlog;
+        uint32_t dropped = 0;
+        std::optional<uint32_t> replayAfter;
+    };
+
+    AsyncEventSource events;
+    std::list<Channel, HeapAccounting::Allocator<Channel, HeapAccounting::Subsystem::Events>> channels;
+    std::list<Client, HeapAccounting::Allocator<Client, HeapAccounting::Subsystem::Events>> clients;
+    std::unordered_map<AsyncClient*, Subscription> pendingSubscriptions;
+    std::mutex mutex;
+    // Set by the telemetry pipeline subscriptions, from the control and I2C bus tasks
+    std::atomic<uint8_t> updatedTopics{TopicAll};
+    // Scratch documents of a single publish() run, cleared when done so that the arena rewinds
+    JsonArena arena{HeapAccounting::Subsystem::Events, APB_EVENTS_ARENA_BYTES};
+    JsonDocument statusDocument{&arena};
+    JsonDocument channelDocument{&arena};
+    JsonDocument deltaDocument{&arena};
+    JsonDocument replayDocument{&arena};
+
+    bool onAuthorize(AsyncWebServerRequest *request);
+    void onConnect(AsyncEventSourceClient *client);
+    void onDisconnect(AsyncEventSourceClient *client);
+    void publish();
+    void populateStatus(uint8_t topics);
+    void publish(Channel &channel, uint32_t now);
+    Channel &channelFor(const Subscription &subscription);
+    static Message createMessage(JsonVariantConst payload, const char *event, uint32_t id, bool keyframe);
+    void enqueue(Client &client, const Message &message);
+    void flush(Client &client);
+    void replay(Client &client);
+};
+}
+
+#endif
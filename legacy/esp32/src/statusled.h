@@ -9,7 +9,7 @@ class StatusLed {
 public:
     static StatusLed &Instance;
     StatusLed();
-    void setup(Scheduler *scheduler);
+    void setup();
     float duty() const;
     void setDuty(float duty);
 
@@ -0,0 +1,175 @@
+#include "telemetry_socket.h"
+#include <ArduinoLog.h>
+#include <algorithm>
+#include <validation.h>
+
+#include "ambient/ambient.h"
+#include "pwm_output.h"
+#include "commandparser.h"
+#include "latency.h"
+#include "json_arena.h"
+
+#define LOG_SCOPE "APB::TelemetrySocket "
+
+using namespace std::placeholders;
+
+APB::TelemetrySocket::TelemetrySocket(const char *url) : socket{url},
+    frame(sizeof(FrameHeader) + sizeof(PowerFrame) + sizeof(AmbientFrame) + sizeof(PWMOutputFrame) * APB_PWM_OUTPUTS_SIZE) {
+}
+
+void APB::TelemetrySocket::setup(AsyncWebServer &webserver, Scheduler &scheduler) {
+    socket.onEvent(std::bind(&TelemetrySocket::onEvent, this, _1, _2, _3, _4, _5, _6));
+    webserver.addHandler(&socket);
+    PowerMonitor::Instance.samples.subscribe(std::bind(&TelemetrySocket::onPowerSample, this, _1));
+    new Task(APB_POWER_MONITOR_UPDATE_INTERVAL_MS, TASK_FOREVER, Latency::task(scheduler, "ws_telemetry", std::bind(&TelemetrySocket::sendFrames, this)), &scheduler, true);
+}
+
+void APB::TelemetrySocket::onEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len) {
+    switch(type) {
+    case WS_EVT_CONNECT: {
+        std::lock_guard<std::mutex> lock(mutex);
+        clients.push_back({client->id()});
+        Log.infoln(LOG_SCOPE "Client %d connected: %s", client->id(), client->remoteIP().toString().c_str());
+        break;
+    }
+    case WS_EVT_DISCONNECT: {
+        std::lock_guard<std::mutex> lock(mutex);
+        clients.remove_if([client](const Client &c){ return c.id == client->id(); });
+        Log.infoln(LOG_SCOPE "Client %d disconnected", client->id());
+        break;
+    }
+    case WS_EVT_DATA: {
+        const AwsFrameInfo *info = static_cast<AwsFrameInfo*>(arg);
+        // Commands are small, so only single frame text messages are accepted
+        if(info->final && info->index == 0 && info->len == len && info->opcode == WS_TEXT) {
+            onCommand(client, data, len);
+        } else {
+            client->text(R"({"error":"Only single frame text commands are supported"})");
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void APB::TelemetrySocket::onCommand(AsyncWebSocketClient *client, const uint8_t *data, size_t len) {
+    JsonArena::Lease arena;
+    JsonDocument request(arena);
+    DeserializationError error = deserializeJson(request, data, len);
+    if(error) {
+        Log.warningln(LOG_SCOPE "Invalid command from client %d: %s", client->id(), error.c_str());
+        client->text(R"({"error":"Invalid JSON command"})");
+        return;
+    }
+    const String command = request["command"] | "";
+    String reply;
+    if(command == "setInterval") {
+        const uint32_t interval = std::clamp<uint32_t>(request["interval"] | 1000, APB_POWER_MONITOR_UPDATE_INTERVAL_MS, APB_TELEMETRY_MAX_INTERVAL_MS);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = std::find_if(clients.begin(), clients.end(), [client](const Client &c){ return c.id == client->id(); });
+            if(found != clients.end()) {
+                found->interval = interval;
+            }
+        }
+        JsonDocument response(arena);
+        response["interval"] = interval;
+        serializeJson(response, reply);
+    } else if(command == "getPWMOutputs") {
+        serializeJson(CommandParser::Instance.getPWMOutputs().root(), reply);
+    } else if(command == "setState") {
+        Validation validation{request.as<JsonObject>()};
+        serializeJson(CommandParser::Instance.setPWMOutputs(validation).root(), reply);
+    } else {
+        reply = R"({"error":"Unknown command"})";
+    }
+    client->text(reply);
+}
+
+void APB::TelemetrySocket::onPowerSample(const PowerMonitor::Status &status) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for(auto &client: clients) {
+        client.samples++;
+        client.busVoltage.add(status.busVoltage);
+        client.current.add(status.current);
+        client.power.add(status.power);
+    }
+}
+
+void APB::TelemetrySocket::sendFrames() {
+    socket.cleanupClients();
+    std::lock_guard<std::mutex> lock(mutex);
+    const uint32_t now = millis();
+    for(auto &client: clients) {
+        if(now - client.lastFrameAt + APB_POWER_MONITOR_UPDATE_INTERVAL_MS / 2 < client.interval) {
+            continue;
+        }
+        AsyncWebSocketClient *socketClient = socket.client(client.id);
+        if(!socketClient || socketClient->queueIsFull()) {
+            continue;
+        }
+        const size_t size = buildFrame(client, now);
+        socketClient->binary(frame.data(), size);
+    }
+}
+
+size_t APB::TelemetrySocket::buildFrame(Client &client, uint32_t now) {
+    uint8_t *position = frame.data();
+    const auto append = [&position](const auto &section) {
+        memcpy(position, &section, sizeof(section));
+        position += sizeof(section);
+    };
+
+    const auto ambientReading = Ambient::Instance.reading();
+    FrameHeader header;
+    header.pwmOutputs = APB_PWM_OUTPUTS_SIZE;
+    header.flags = (PowerMonitor::Instance.status().initialised ? HasPowerMonitor : 0) | (ambientReading ? HasAmbient : 0);
+    header.millis = now;
+    append(header);
+
+    const PowerMonitor::Status powerStatus = PowerMonitor::Instance.status();
+    if(client.samples == 0) {
+        // The power monitor samples slower than the frame rate while the load is stable: repeat the last sample
+        append(PowerFrame{0, Statistics::of(powerStatus.busVoltage), Statistics::of(powerStatus.current), Statistics::of(powerStatus.power), powerStatus.charge});
+    } else {
+        append(PowerFrame{
+            client.samples,
+            client.busVoltage.get(client.samples),
+            client.current.get(client.samples),
+            client.power.get(client.samples),
+            powerStatus.charge,
+        });
+    }
+    client.samples = 0;
+    client.busVoltage = {};
+    client.current = {};
+    client.power = {};
+    client.lastFrameAt = now;
+
+    if(ambientReading) {
+        append(AmbientFrame{ambientReading->temperature, ambientReading->humidity, ambientReading->dewpoint()});
+    } else {
+        append(AmbientFrame{NAN, NAN, NAN});
+    }
+
+    std::for_each(PWMOutputs::Instance.begin(), PWMOutputs::Instance.end(), [&append](const PWMOutput &pwmOutput) {
+        append(PWMOutputFrame{
+            static_cast<uint8_t>(pwmOutput.mode()),
+            pwmOutput.active(),
+            static_cast<uint16_t>(std::clamp(pwmOutput.duty(), 0.f, 1.f) * UINT16_MAX),
+            pwmOutput.temperature().value_or(NAN),
+        });
+    });
+    return position - frame.data();
+}
+
+void APB::TelemetrySocket::StatisticsAccumulator::add(float value) {
+    min = std::isnan(min) ? value : std::min(min, value);
+    max = std::isnan(max) ? value : std::max(max, value);
+    sum += value;
+}
+
+APB::TelemetrySocket::Statistics APB::TelemetrySocket::StatisticsAccumulator::get(uint16_t samples) const {
+    return { min, samples > 0 ? static_cast<float>(sum / samples) : NAN, max };
+}
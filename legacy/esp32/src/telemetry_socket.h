@@ -0,0 +1,103 @@
+#ifndef APB_TELEMETRY_SOCKET_H
+#define APB_TELEMETRY_SOCKET_H
+
+#include <ESPAsyncWebServer.h>
+#include <ArduinoJson.h>
+#include <TaskSchedulerDeclarations.h>
+#include <cmath>
+#include <list>
+#include <mutex>
+#include <vector>
+
+#include "configuration.h"
+#include "powermonitor.h"
+
+namespace APB {
+
+// WebSocket channel streaming packed binary telemetry frames, and accepting JSON text commands.
+// Commands:
+//  - `{"command": "setInterval", "interval": <ms>}`: frame interval, down to the power monitor sampling rate.
+//  - `{"command": "getPWMOutputs"}`
+//  - `{"command": "setState", "index": ..., "mode": ..., ...}`: same parameters as `POST /api/pwmOutput`.
+// Each command is answered with a JSON text message.
+class TelemetrySocket {
+public:
+    static constexpr uint8_t FrameMagic = 0xAB;
+    static constexpr uint8_t FrameVersion = 1;
+
+    // All fields are little endian. Missing readings are NaN.
+#pragma pack(push, 1)
+    struct Statistics {
+        float min;
+        float mean;
+        float max;
+        static Statistics of(float value) { return {value, value, value}; }
+    };
+    struct FrameHeader {
+        uint8_t magic = FrameMagic;
+        uint8_t version = FrameVersion;
+        uint8_t pwmOutputs;
+        uint8_t flags;
+        uint32_t millis;
+    };
+    struct PowerFrame {
+        // 0 when no new sample was taken since the previous frame, the statistics then repeat the latest sample
+        uint16_t samples;
+        Statistics busVoltage;
+        Statistics current;
+        Statistics power;
+        float charge;
+    };
+    struct AmbientFrame {
+        float temperature;
+        float humidity;
+        float dewpoint;
+    };
+    struct PWMOutputFrame {
+        uint8_t mode;
+        uint8_t active;
+        // Duty cycle, 0-65535 for 0-100%
+        uint16_t duty;
+        float temperature;
+    };
+#pragma pack(pop)
+    enum FrameFlags : uint8_t {
+        HasPowerMonitor = 1 << 0,
+        HasAmbient = 1 << 1,
+    };
+
+    TelemetrySocket(const char *url);
+    void setup(AsyncWebServer &webserver, Scheduler &scheduler);
+    size_t clientsCount() const { return socket.count(); }
+private:
+    struct StatisticsAccumulator {
+        float min = NAN;
+        float max = NAN;
+        double sum = 0;
+        void add(float value);
+        Statistics get(uint16_t samples) const;
+    };
+    struct Client {
+        uint32_t id;
+        uint32_t interval = 1000;
+        uint32_t lastFrameAt = 0;
+        uint16_t samples = 0;
+        StatisticsAccumulator busVoltage;
+        StatisticsAccumulator current;
+        StatisticsAccumulator power;
+    };
+
+    AsyncWebSocket socket;
+    std::list<Client> clients;
+    std::mutex mutex;
+    std::vector<uint8_t> frame;
+
+    void onEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len);
+    void onCommand(AsyncWebSocketClient *client, const uint8_t *data, size_t len);
+    void onPowerSample(const PowerMonitor::Status &status);
+    void sendFrames();
+    size_t buildFrame(Client &client, uint32_t now);
+};
+}
+
+#endif
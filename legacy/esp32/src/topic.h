@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace APB {
+
+// Typed publish/subscribe channel between the stages of the telemetry pipeline: sensor -> filter -> controller -> sinks.
+// Each published sample is delivered once to every subscriber, synchronously on the publishing FreeRTOS task,
+// so subscribers must be quick, and must protect whatever they share with other tasks.
+// Subscriptions are only added during setup, before the control and I2C bus tasks start publishing, so publish() doesn't lock.
+template<typename T>
+class Topic {
+public:
+    using Subscriber = std::function<void(const T &)>;
+    void subscribe(const Subscriber &subscriber) { subscribers.push_back(subscriber); }
+    void publish(const T &sample) const {
+        for(const auto &subscriber: subscribers) {
+            subscriber(sample);
+        }
+    }
+    size_t subscribersCount() const { return subscribers.size(); }
+private:
+    std::vector<Subscriber> subscribers;
+};
+}
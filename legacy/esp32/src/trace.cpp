@@ -0,0 +1,108 @@
+#include "trace.h"
+#include <Arduino.h>
+#include <ArduinoLog.h>
+#include <ESPAsyncWebServer.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#define LOG_SCOPE "APB::Trace "
+
+APB::Trace &APB::Trace::Instance = *new APB::Trace();
+
+static_assert((APB_TRACE_RECORDS & (APB_TRACE_RECORDS - 1)) == 0, "The trace size must be a power of two");
+static_assert((APB_TRACE_PSRAM_RECORDS & (APB_TRACE_PSRAM_RECORDS - 1)) == 0, "The trace size must be a power of two");
+
+void APB::Trace::setup() {
+    std::lock_guard<std::mutex> lock(mutex);
+    dropped = 0;
+    evictedCommands = {};
+    if(!ring.allocate(APB_TRACE_RECORDS * sizeof(Record), APB_TRACE_PSRAM_RECORDS * sizeof(Record))) {
+        Log.errorln(LOG_SCOPE "Unable to allocate the trace buffer");
+        return;
+    }
+    Log.infoln(LOG_SCOPE "Tracing up to %d records", capacity());
+}
+
+void APB::Trace::add(Type type, uint8_t index, uint16_t value, float first, float second) {
+    std::lock_guard<std::mutex> lock(mutex);
+    push({static_cast<uint32_t>(millis()), type, index, value, {first, second}});
+}
+
+void APB::Trace::addCommand(uint8_t index, uint16_t mode, float maxDuty, float minDuty, float setpoint, float rampOffset) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const uint32_t now = millis();
+    push({now, Type::Command, index, mode, {maxDuty, minDuty}});
+    push({now, Type::Setpoint, index, 0, {setpoint, rampOffset}});
+}
+
+void APB::Trace::push(const Record &record) {
+    if(ring.capacity() == 0) {
+        return;
+    }
+    if(ring.full(sizeof(Record))) {
+        Record evicted;
+        ring.read(ring.tail(), &evicted, sizeof(Record));
+        if((evicted.type == Type::Command || evicted.type == Type::Setpoint) && evicted.index < APB_PWM_OUTPUTS_SIZE) {
+            evictedCommands[evicted.index * 2 + (evicted.type == Type::Setpoint)] = evicted;
+        }
+        ring.drop(ring.tail() + sizeof(Record));
+        dropped++;
+    }
+    ring.append(&record, sizeof(Record));
+}
+
+void APB::Trace::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    ring.clear();
+    dropped = 0;
+    evictedCommands = {};
+}
+
+size_t APB::Trace::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return ring.size() / sizeof(Record);
+}
+
+APB::Trace::Serialiser::Serialiser(Trace &trace) : trace{trace} {
+    std::lock_guard<std::mutex> lock(trace.mutex);
+    header.timestamp = millis();
+    header.dropped = trace.dropped;
+    next = trace.ring.tail();
+    end = trace.ring.head();
+    // Outputs without a command still in the ring
+    for(const Record &command: trace.evictedCommands) {
+        if(command.type == Type::Command || command.type == Type::Setpoint) {
+            commands[commandsCount++] = command;
+        }
+    }
+}
+
+size_t APB::Trace::Serialiser::write(uint8_t *buffer, size_t maxLen, size_t index) {
+    // Every part is 16 bytes, and chunks only hold whole parts
+    size_t length = 0;
+    if(index == 0) {
+        if(maxLen < sizeof(Header)) {
+            return RESPONSE_TRY_AGAIN;
+        }
+        memcpy(buffer, &header, sizeof(Header));
+        length += sizeof(Header);
+    }
+    size_t command = index > 0 ? (index - sizeof(Header)) / sizeof(Record) : 0;
+    for(; command < commandsCount && length + sizeof(Record) <= maxLen; command++) {
+        memcpy(buffer + length, &commands[command], sizeof(Record));
+        length += sizeof(Record);
+    }
+    if(command < commandsCount) {
+        return length > 0 ? length : RESPONSE_TRY_AGAIN;
+    }
+    std::lock_guard<std::mutex> lock(trace.mutex);
+    // Overwritten records are skipped, and a clear while downloading ends the trace
+    trace.ring.skipOverwritten(next, end);
+    for(; next != end && length + sizeof(Record) <= maxLen; next += sizeof(Record)) {
+        trace.ring.read(next, buffer + length, sizeof(Record));
+        length += sizeof(Record);
+    }
+    // Returning 0 would end the response with records left: the chunk is too small for a single one
+    return length == 0 && next != end ? RESPONSE_TRY_AGAIN : length;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <mutex>
+
+#include "configuration.h"
+#include "byte_ring.h"
+
+// Binary trace of the raw inputs and outputs of the PWM outputs control: ambient sensor readings, thermistor ADC readings,
+// commands and control steps, in a ring buffer of fixed size records. Downloaded from /api/trace,
+// and replayed on the host against the firmware code with bench/native.sh trace_replay.
+namespace APB {
+
+class Trace {
+public:
+    enum class Type : uint8_t {
+        // Raw reading of ambient sensor `index`: temperature and humidity, both NaN for a failed read
+        Ambient = 1,
+        // Thermistor of PWM output `index`: `value` is the ADC reading, the first value the converted temperature
+        Thermistor = 2,
+        // Command to PWM output `index`: `value` is the mode, the values max and min duty. Always followed by a Setpoint record.
+        Command = 3,
+        // Second half of a command: target temperature, or dewpoint offset, and ramp offset
+        Setpoint = 4,
+        // Control step of PWM output `index`: `value` is the PWM value (0-255), the values the temperature and the target temperature, NaN if unset
+        Output = 5,
+    };
+
+    struct Record {
+        // millis()
+        uint32_t timestamp;
+        Type type;
+        uint8_t index;
+        uint16_t value;
+        float values[2];
+    };
+    static_assert(sizeof(Record) == 16, "Trace records are downloaded as raw bytes");
+
+    // First 16 bytes of /api/trace. The evicted commands come next, then the stored records, as raw little endian structs.
+    struct Header {
+        char magic[4] = {'A', 'P', 'B', 'T'};
+        uint8_t version = 1;
+        uint8_t recordSize = sizeof(Record);
+        uint16_t reserved = 0;
+        // millis() when the download started
+        uint32_t timestamp;
+        // Records overwritten since boot or the last clear
+        uint32_t dropped;
+    };
+    static_assert(sizeof(Header) == 16, "Trace headers are downloaded as raw bytes");
+
+    // Sizes the trace from APB_TRACE_RECORDS or APB_TRACE_PSRAM_RECORDS. Nothing is traced before.
+    void setup();
+    void add(Type type, uint8_t index, uint16_t value, float first, float second);
+    // Adds a Command record and its Setpoint, next to each other
+    void addCommand(uint8_t index, uint16_t mode, float maxDuty, float minDuty, float setpoint, float rampOffset);
+    void clear();
+    // In records
+    size_t capacity() const { return ring.capacity() / sizeof(Record); }
+    size_t size() const;
+
+    // Writes the trace in chunks, for AsyncWebServer chunked responses. Records overwritten while downloading are skipped.
+    // Returns RESPONSE_TRY_AGAIN when the chunk can't hold the next part, 0 at the end of the trace.
+    class Serialiser {
+    public:
+        Serialiser(Trace &trace);
+        size_t write(uint8_t *buffer, size_t maxLen, size_t index);
+    private:
+        Trace &trace;
+        Header header;
+        // Last commands overwritten by the ring, so that a replay starts from the state of the outputs at the oldest record
+        std::array<Record, APB_PWM_OUTPUTS_SIZE * 2> commands;
+        size_t commandsCount = 0;
+        uint32_t next;
+        uint32_t end;
+    };
+
+    static Trace &Instance;
+private:
+    ByteRing ring;
+    uint32_t dropped = 0;
+    std::array<Record, APB_PWM_OUTPUTS_SIZE * 2> evictedCommands{};
+    mutable std::mutex mutex;
+
+    // Requires the mutex
+    void push(const Record &record);
+};
+}
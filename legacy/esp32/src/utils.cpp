@@ -1,4 +1,5 @@
 #include "utils.h"
+#include "heap_accounting.h"
 #include <cmath>
 #include <ArduinoLog.h>
 
@@ -15,7 +16,8 @@ String APB::float2s(float f, uint8_t decimals)
 APB::OverflowPrint::OverflowPrint(uint8_t *mainBuffer, size_t mainBufferSize, size_t overflowBufferSize) :
     mainBuffer{mainBuffer},
     mainBufferSize{mainBufferSize},
-    overflowBuffer{std::make_unique<uint8_t[]>(overflowBufferSize)},
+    overflowBuffer{static_cast<uint8_t*>(HeapAccounting::allocate(HeapAccounting::Subsystem::Responses, overflowBufferSize)),
+        [overflowBufferSize](uint8_t *buffer) { HeapAccounting::deallocate(HeapAccounting::Subsystem::Responses, buffer, overflowBufferSize); }},
     overflowBufferSize{overflowBufferSize}
 {
     Log.traceln(OVERFLOW_TAG "Loaded new overflow object, mainBufferSize=%d, overflowBufferSize=%d", mainBufferSize, overflowBufferSize);
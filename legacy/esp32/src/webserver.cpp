@@ -14,6 +14,17 @@
 #include "commandparser.h"
 #include "fan.h"
 #include "asyncbufferedtcplogger.h"
+#include "latency.h"
+#include "i2c_wire.h"
+#include "power_save.h"
+#include "trace.h"
+#include "binary_log.h"
+#include "log_ring.h"
+#include "json_arena.h"
+#include "heap_accounting.h"
+#include <array>
+#include <optional>
+#include <vector>
 
 #define LOG_SCOPE "APB::WebServer "
 
@@ -21,7 +32,8 @@ using namespace std::placeholders;
 using namespace GuLinux;
 
 APB::WebServer::WebServer(Scheduler &scheduler) : AsyncWebServerBase{},
-    events("/api/events"),
+    statusEvents("/api/events"),
+    telemetrySocket("/api/ws"),
     scheduler(scheduler) {
 }
 
@@ -36,30 +48,24 @@ void APB::WebServer::setup() {
     setupCors();
 #endif
 
-    onJsonRequest("/api/config/accessPoint", [](AsyncWebServerRequest *request, JsonVariant &json){ WiFiManager::Instance.onConfigAccessPoint(request, json); }, HTTP_POST | HTTP_DELETE);
-    onJsonRequest("/api/config/station", [](AsyncWebServerRequest *request, JsonVariant &json){ WiFiManager::Instance.onConfigStation(request, json); }, HTTP_POST | HTTP_DELETE);
-    onJsonRequest("/api/config/statusLedDuty", std::bind(&WebServer::onConfigStatusLedDuty, this, _1, _2), HTTP_POST);
-    onJsonRequest("/api/config/fanDuty", std::bind(&WebServer::onConfigFanDuty, this, _1, _2), HTTP_POST);
-    onJsonRequest("/api/config/pdVoltage", std::bind(&WebServer::onConfigPDVoltage, this, _1, _2), HTTP_POST);
-    onJsonRequest("/api/config/powerSourceType", std::bind(&WebServer::onConfigPowerSourceType, this, _1, _2), HTTP_POST);
-    webserver.on("/api/metrics", HTTP_GET, std::bind(&WebServer::onGetMetrics, this, _1), nullptr, nullptr);
-    webserver.on("/api/config/write", HTTP_POST, std::bind(&WebServer::onPostWriteConfig, this, _1), nullptr, nullptr);
-    webserver.on("/api/config", HTTP_GET, std::bind(&WebServer::onGetConfig, this, _1), nullptr, nullptr);
-    webserver.on("/api/info", HTTP_GET, std::bind(&WebServer::onGetESPInfo, this, _1), nullptr, nullptr);
-    webserver.on("/api/history", HTTP_GET, std::bind(&WebServer::onGetHistory, this, _1), nullptr, nullptr);
-    webserver.on("/api/power", HTTP_GET, std::bind(&WebServer::onGetPower, this, _1), nullptr, nullptr);
-    webserver.on("/api/logs", HTTP_GET, [](AsyncWebServerRequest *request){ 
-        auto response = request->beginResponseStream("text/plain");
-        response->setCode(200);
-        response->addHeader("Cache-Control", "no-cache");
-        auto backlog = AsyncBufferedTCPLogger::instance().getBacklog();
-        while(!backlog.empty()) {
-            response->print(backlog.front());
-            backlog.pop();
-        }
-        request->send(response);
-    }, nullptr, nullptr);
-    webserver.on("/api/wifi/connect", HTTP_POST, std::bind(&WiFiManager::onPostReconnectWiFi, &WiFiManager::Instance, _1), nullptr, nullptr);
+    onJsonRequest("/api/config/accessPoint", instrumentJson("/api/config/accessPoint", [](AsyncWebServerRequest *request, JsonVariant &json){ WiFiManager::Instance.onConfigAccessPoint(request, json); }), HTTP_POST | HTTP_DELETE);
+    onJsonRequest("/api/config/station", instrumentJson("/api/config/station", [](AsyncWebServerRequest *request, JsonVariant &json){ WiFiManager::Instance.onConfigStation(request, json); }), HTTP_POST | HTTP_DELETE);
+    onJsonRequest("/api/config/statusLedDuty", instrumentJson("/api/config/statusLedDuty", std::bind(&WebServer::onConfigStatusLedDuty, this, _1, _2)), HTTP_POST);
+    onJsonRequest("/api/config/fanDuty", instrumentJson("/api/config/fanDuty", std::bind(&WebServer::onConfigFanDuty, this, _1, _2)), HTTP_POST);
+    onJsonRequest("/api/config/pdVoltage", instrumentJson("/api/config/pdVoltage", std::bind(&WebServer::onConfigPDVoltage, this, _1, _2)), HTTP_POST);
+    onJsonRequest("/api/config/powerSourceType", instrumentJson("/api/config/powerSourceType", std::bind(&WebServer::onConfigPowerSourceType, this, _1, _2)), HTTP_POST);
+    webserver.on("/api/metrics", HTTP_GET, instrument("/api/metrics", std::bind(&WebServer::onGetMetrics, this, _1)), nullptr, nullptr);
+    webserver.on("/api/config/write", HTTP_POST, instrument("/api/config/write", std::bind(&WebServer::onPostWriteConfig, this, _1)), nullptr, nullptr);
+    webserver.on("/api/config", HTTP_GET, instrument("/api/config", std::bind(&WebServer::onGetConfig, this, _1)), nullptr, nullptr);
+    webserver.on("/api/info", HTTP_GET, instrument("/api/info", std::bind(&WebServer::onGetESPInfo, this, _1)), nullptr, nullptr);
+    webserver.on("/api/history", HTTP_GET, instrument("/api/history", std::bind(&WebServer::onGetHistory, this, _1)), nullptr, nullptr);
+    webserver.on("/api/trace", HTTP_GET, instrument("/api/trace", std::bind(&WebServer::onGetTrace, this, _1)), nullptr, nullptr);
+    webserver.on("/api/trace", HTTP_DELETE, instrument("/api/trace", std::bind(&WebServer::onDeleteTrace, this, _1)), nullptr, nullptr);
+    webserver.on("/api/power", HTTP_GET, instrument("/api/power", std::bind(&WebServer::onGetPower, this, _1)), nullptr, nullptr);
+    webserver.on("/api/logs/binary", HTTP_GET, instrument("/api/logs/binary", std::bind(&WebServer::onGetBinaryLog, this, _1)), nullptr, nullptr);
+    webserver.on("/api/logs/binary", HTTP_DELETE, instrument("/api/logs/binary", std::bind(&WebServer::onDeleteBinaryLog, this, _1)), nullptr, nullptr);
+    webserver.on("/api/logs", HTTP_GET, instrument("/api/logs", std::bind(&WebServer::onGetLogs, this, _1)), nullptr, nullptr);
+    webserver.on("/api/wifi/connect", HTTP_POST, instrument("/api/wifi/connect", std::bind(&WiFiManager::onPostReconnectWiFi, &WiFiManager::Instance, _1)), nullptr, nullptr);
     #ifdef CONFIGURATION_FOR_PROTOTYPE
     server.on("/api/wifi", HTTP_DELETE, [this](AsyncWebServerRequest *request){
         new Task(1'000, TASK_ONCE, [](){WiFi.disconnect();}, &scheduler, true);
@@ -67,21 +73,16 @@ void APB::WebServer::setup() {
         response.root()["status"] = "Dropping WiFi";
     }, nullptr, nullptr);
     #endif
-    webserver.on("/api/wifi", HTTP_GET, [](AsyncWebServerRequest *request){ WiFiManager::Instance.onGetWiFiStatus(request); }, nullptr, nullptr);
-    webserver.on("/api/restart", HTTP_POST, std::bind(&WebServer::onRestart, this, _1), nullptr, nullptr);
+    webserver.on("/api/wifi", HTTP_GET, instrument("/api/wifi", [](AsyncWebServerRequest *request){ WiFiManager::Instance.onGetWiFiStatus(request); }), nullptr, nullptr);
+    webserver.on("/api/restart", HTTP_POST, instrument("/api/restart", std::bind(&WebServer::onRestart, this, _1)), nullptr, nullptr);
     
-    webserver.on("/api/status", HTTP_GET, std::bind(&WebServer::onGetStatus, this, _1), nullptr, nullptr);
-    webserver.on("/api/ambient", HTTP_GET, std::bind(&WebServer::onGetAmbient, this, _1), nullptr, nullptr);
-    webserver.on("/api/pwmOutputs", HTTP_GET, std::bind(&WebServer::onGetPWMOutputs, this, _1), nullptr, nullptr);
-    onJsonRequest("/api/pwmOutput", std::bind(&APB::WebServer::onPostSetPWMOutputs, this, _1, _2), HTTP_POST);
+    webserver.on("/api/status", HTTP_GET, instrument("/api/status", std::bind(&WebServer::onGetStatus, this, _1)), nullptr, nullptr);
+    webserver.on("/api/ambient", HTTP_GET, instrument("/api/ambient", std::bind(&WebServer::onGetAmbient, this, _1)), nullptr, nullptr);
+    webserver.on("/api/pwmOutputs", HTTP_GET, instrument("/api/pwmOutputs", std::bind(&WebServer::onGetPWMOutputs, this, _1)), nullptr, nullptr);
+    onJsonRequest("/api/pwmOutput", instrumentJson("/api/pwmOutput", std::bind(&APB::WebServer::onPostSetPWMOutputs, this, _1, _2)), HTTP_POST);
 
-    events.onConnect([](AsyncEventSourceClient *client){
-        Log.infoln(LOG_SCOPE "[SSE] Client connected: lastId=%d, %s", client->lastId(), client->client()->remoteIP().toString().c_str());
-    });
-    events.onDisconnect([](AsyncEventSourceClient *client){
-        Log.infoln(LOG_SCOPE "[SSE] Client disconnected");
-    });
-    webserver.addHandler(&events);
+    statusEvents.setup(webserver, scheduler);
+    telemetrySocket.setup(webserver, scheduler);
     
     webserver.serveStatic("/", LittleFS, "/web/").setDefaultFile("index.html");
     webserver.serveStatic("/static", LittleFS, "/web/static").setDefaultFile("index.html");
@@ -90,21 +91,6 @@ void APB::WebServer::setup() {
  
     Log.infoln(LOG_SCOPE "Setup finished");
     webserver.begin();
-
-    new Task(1000, TASK_FOREVER, [this](){
-        eventsDocument.clear();
-        if(Ambient::Instance.reading().has_value()) {
-            Ambient::Instance.toJson(eventsDocument["ambient"].to<JsonObject>());
-        } else {
-            eventsDocument["ambient"] = static_cast<char*>(0);
-        }
-        
-        PowerMonitor::Instance.toJson(eventsDocument["power"].to<JsonObject>());
-        PWMOutputs::toJson(eventsDocument["pwmOutputs"].to<JsonArray>());
-        eventsDocument["app"]["uptime"] = esp_timer_get_time() / 1000'000.0;
-        serializeJson(eventsDocument, eventsString.data(), eventsString.size());
-        this->events.send(eventsString.data(), "status", millis(), 5000);
-    }, &scheduler, true);
 }
 
 
@@ -132,13 +118,14 @@ void APB::WebServer::onGetConfig(AsyncWebServerRequest *request) {
     rootObject["ledDuty"] = Settings::Instance.statusLedDuty();
     #ifdef APB_PWM_FAN_PIN
     rootObject["fanDuty"] = Settings::Instance.fanDuty();
+    rootObject["fanAutomatic"] = Settings::Instance.fanAutomatic();
     #endif
     rootObject["pdVoltage"] = Settings::Instance.pdVoltage();
     rootObject["powerSourceType"] = Settings::PowerSourcesNames.at(Settings::Instance.powerSource());
 }
 
 void APB::WebServer::onGetHistory(AsyncWebServerRequest *request) {
-    auto jsonSerialiser = std::make_shared<History::JsonSerialiser>(History::Instance);
+    auto jsonSerialiser = HeapAccounting::makeShared<History::JsonSerialiser>(History::Instance);
    
     AsyncWebServerResponse* response = request->beginChunkedResponse("application/json",
         [jsonSerialiser](uint8_t *buffer, size_t maxLen, size_t index){
@@ -147,6 +134,57 @@ void APB::WebServer::onGetHistory(AsyncWebServerRequest *request) {
     request->send(response);
 }
 
+void APB::WebServer::onGetTrace(AsyncWebServerRequest *request) {
+    auto serialiser = HeapAccounting::makeShared<Trace::Serialiser>(Trace::Instance);
+    AsyncWebServerResponse* response = request->beginChunkedResponse("application/octet-stream",
+        [serialiser](uint8_t *buffer, size_t maxLen, size_t index){
+            return serialiser->write(buffer, maxLen, index);
+        });
+    response->addHeader("Content-Disposition", "attachment; filename=\"astropowerbox.trace\"");
+    request->send(response);
+}
+
+void APB::WebServer::onDeleteTrace(AsyncWebServerRequest *request) {
+    Trace::Instance.clear();
+    JsonWebResponse response(request);
+    response.root()["status"] = "ok";
+}
+
+void APB::WebServer::onGetLogs(AsyncWebServerRequest *request) {
+    const uint32_t since = request->hasParam("since") ? strtoul(request->getParam("since")->value().c_str(), nullptr, 10) : 0;
+    const int level = request->hasParam("level") ? LogRing::parseLevel(request->getParam("level")->value().c_str()) : LOG_LEVEL_VERBOSE;
+    auto reader = HeapAccounting::makeShared<LogRing::Reader>(LogRing::Instance, since, level);
+    AsyncWebServerResponse* response = request->beginChunkedResponse("text/plain",
+        [reader](uint8_t *buffer, size_t maxLen, size_t){
+            return reader->read(buffer, maxLen);
+        });
+    response->addHeader("Cache-Control", "no-cache");
+    // Lines before X-Log-First were overwritten: a client polling with since=<X-Log-Next> knows what it missed
+    response->addHeader("X-Log-First", String(reader->first()));
+    response->addHeader("X-Log-Next", String(reader->end()));
+    request->send(response);
+}
+
+void APB::WebServer::onGetBinaryLog(AsyncWebServerRequest *request) {
+    const bool text = request->hasParam("format") && request->getParam("format")->value() == "text";
+    auto serialiser = HeapAccounting::makeShared<BinaryLog::Serialiser>(BinaryLog::Instance, text);
+    AsyncWebServerResponse* response = request->beginChunkedResponse(text ? "text/plain" : "application/octet-stream",
+        [serialiser](uint8_t *buffer, size_t maxLen, size_t index){
+            return serialiser->write(buffer, maxLen, index);
+        });
+    response->addHeader("Cache-Control", "no-cache");
+    if(!text) {
+        response->addHeader("Content-Disposition", "attachment; filename=\"astropowerbox.binlog\"");
+    }
+    request->send(response);
+}
+
+void APB::WebServer::onDeleteBinaryLog(AsyncWebServerRequest *request) {
+    BinaryLog::Instance.clear();
+    JsonWebResponse response(request);
+    response.root()["status"] = "ok";
+}
+
 void APB::WebServer::onPostWriteConfig(AsyncWebServerRequest *request) {
     Settings::Instance.save();
     onGetConfig(request);
@@ -170,75 +208,292 @@ void APB::WebServer::onGetPower(AsyncWebServerRequest *request) {
     PowerMonitor::Instance.toJson(response.root().to<JsonObject>());
 }
 
-void APB::WebServer::onGetMetrics(AsyncWebServerRequest *request) {
-    MetricsResponse metricsResponse(request, MetricsResponse::Labels().add("source", Settings::Instance.wifi().hostname()));
-    const auto powerMonitorReading = PowerMonitor::Instance.status();
-    metricsResponse
-        .gauge("powermonitor", powerMonitorReading.busVoltage, MetricsResponse::Labels().unit("V").field("voltage"))
-        .gauge("powermonitor", powerMonitorReading.current, MetricsResponse::Labels().unit("A").field("current"), nullptr, false)
-        .gauge("powermonitor", powerMonitorReading.power, MetricsResponse::Labels().unit("W").field("power"), nullptr, false);
-    
-    const auto ambientReading = Ambient::Instance.reading();
-    if(ambientReading.has_value()) {
-        // Log.traceln("adding ambient metrics data: T=%d, H=%d, D=%d", ambientReading->temperature, ambientReading->humidity, ambientReading->dewpoint());
-        metricsResponse
-            .gauge("ambient", ambientReading->temperature, MetricsResponse::Labels().unit("°C").field("temperature"))
-            .gauge("ambient", ambientReading->humidity, MetricsResponse::Labels().unit("%").field("humidity"), nullptr, false)
-            .gauge("ambient", ambientReading->dewpoint(), MetricsResponse::Labels().unit("°C").field("dewpoint"), nullptr, false);
+ArRequestHandlerFunction APB::WebServer::instrument(const char *route, ArRequestHandlerFunction handler) {
+#ifdef APB_LATENCY_HISTOGRAMS
+    Latency::Probe *probe = new Latency::Probe{"http", route};
+    return [probe, handler](AsyncWebServerRequest *request) {
+        Latency::Scope scope{*probe};
+        PowerSave::Instance.activity();
+        handler(request);
+    };
+#else
+    return [handler](AsyncWebServerRequest *request) {
+        PowerSave::Instance.activity();
+        handler(request);
+    };
+#endif
+}
+
+ArJsonRequestHandlerFunction APB::WebServer::instrumentJson(const char *route, ArJsonRequestHandlerFunction handler) {
+#ifdef APB_LATENCY_HISTOGRAMS
+    Latency::Probe *probe = new Latency::Probe{"http", route};
+    return [probe, handler](AsyncWebServerRequest *request, JsonVariant &json) {
+        Latency::Scope scope{*probe};
+        PowerSave::Instance.activity();
+        handler(request, json);
+    };
+#else
+    return [handler](AsyncWebServerRequest *request, JsonVariant &json) {
+        PowerSave::Instance.activity();
+        handler(request, json);
+    };
+#endif
+}
+
+namespace {
+struct TaskStack {
+    char name[configMAX_TASK_NAME_LEN];
+    // Least free stack since the task started
+    uint32_t freeBytes;
+};
+
+// Stack high-water marks of the FreeRTOS tasks, at most `capacity`
+size_t taskStacks(TaskStack *tasks, size_t capacity) {
+#if configUSE_TRACE_FACILITY
+    using Allocator = APB::HeapAccounting::Allocator<TaskStatus_t, APB::HeapAccounting::Subsystem::Responses>;
+    // Room for tasks started meanwhile
+    std::vector<TaskStatus_t, Allocator> status(uxTaskGetNumberOfTasks() + 4);
+    const size_t count = std::min<size_t>(uxTaskGetSystemState(status.data(), status.size(), nullptr), capacity);
+    for(size_t index = 0; index < count; index++) {
+        strlcpy(tasks[index].name, status[index].pcTaskName, sizeof(tasks[index].name));
+        // ESP-IDF counts stacks in bytes, not words
+        tasks[index].freeBytes = status[index].usStackHighWaterMark;
     }
-    std::for_each(PWMOutputs::Instance.begin(), PWMOutputs::Instance.end(), [&metricsResponse](const PWMOutput &pwmOutput) {
-        metricsResponse.gauge("pwmOutput", pwmOutput.maxDuty(), MetricsResponse::Labels()
-            .add("index", String(pwmOutput.index()).c_str())
-            .field("maxDuty")
-            .add("mode", pwmOutput.modeAsString().c_str()), nullptr, pwmOutput.index() ==0);
-    });
-    std::for_each(PWMOutputs::Instance.begin(), PWMOutputs::Instance.end(), [&metricsResponse](const PWMOutput &pwmOutput) {
-        metricsResponse.gauge("pwmOutput", pwmOutput.duty(), MetricsResponse::Labels()
-            .add("index", String(pwmOutput.index()).c_str())
-            .field("duty")
-            .add("mode", pwmOutput.modeAsString().c_str()), nullptr, false);
-    });
+    return count;
+#else
+    return 0;
+#endif
+}
 
-    std::for_each(PWMOutputs::Instance.begin(), PWMOutputs::Instance.end(), [&metricsResponse](const PWMOutput &pwmOutput) {
-        metricsResponse.gauge("pwmOutput", pwmOutput.active(), MetricsResponse::Labels()
-            .add("index", String(pwmOutput.index()).c_str())
-            .field("active")
-            .add("mode", pwmOutput.modeAsString().c_str()), nullptr, false);
-    });
-    std::for_each(PWMOutputs::Instance.begin(), PWMOutputs::Instance.end(), [&metricsResponse](const PWMOutput &pwmOutput) {
-        if(pwmOutput.temperature().has_value()) {
-            metricsResponse.gauge("pwmOutput", pwmOutput.temperature().value(), MetricsResponse::Labels()
-                .add("index", String(pwmOutput.index()).c_str())
-                .unit("°C")
-                .field("temperature")
-                .add("mode", pwmOutput.modeAsString().c_str()), nullptr, false);
-        }
-    });
-    std::for_each(PWMOutputs::Instance.begin(), PWMOutputs::Instance.end(), [&metricsResponse](const PWMOutput &pwmOutput) {
-        if(pwmOutput.targetTemperature().has_value()) {
-            metricsResponse.gauge("pwmOutput_target_temperature", pwmOutput.targetTemperature().value(), MetricsResponse::Labels()
-                .add("index", String(pwmOutput.index()).c_str())
-                .field("target_temperature")
-                .unit("°C")
-                .add("mode", pwmOutput.modeAsString().c_str()), nullptr, false);
+// Values for a single scrape, captured once so that every chunk of the response is consistent.
+struct MetricsSnapshot {
+    using Labels = APB::MetricsResponse::Labels;
+    struct PWMOutput {
+        Labels labels;
+        float maxDuty;
+        float duty;
+        bool active;
+        std::optional<float> temperature;
+        std::optional<float> targetTemperature;
+        std::optional<float> dewpointOffset;
+        uint32_t samplingInterval;
+    };
+    Labels fixedLabels;
+    APB::PowerMonitor::Status power;
+    std::optional<APB::Ambient::Reading> ambient;
+    uint32_t ambientSamplingInterval;
+    uint32_t ambientRejectedReadings;
+    struct AmbientSensor {
+        const char *name;
+        std::optional<APB::Ambient::Reading> reading;
+    };
+    std::array<AmbientSensor, APB_AMBIENT_MAX_SENSORS> ambientSensors;
+    size_t ambientSensorsCount;
+    uint32_t powerSamplingInterval;
+    std::array<PWMOutput, APB_PWM_OUTPUTS_SIZE> pwmOutputs;
+    #ifdef APB_PWM_FAN_PIN
+    Fan::Status fan{Fan::Instance().status()};
+    #endif
+    bool modemSleep{APB::PowerSave::Instance.modemSleep()};
+    std::array<std::optional<float>, 2> controllerCurrent{APB::PowerSave::Instance.controllerCurrent(false), APB::PowerSave::Instance.controllerCurrent(true)};
+    uint32_t freeHeap;
+    uint32_t heapSize;
+    uint32_t minFreeHeap;
+    uint32_t maxAllocHeap;
+    std::array<APB::HeapAccounting::Usage, static_cast<size_t>(APB::HeapAccounting::Subsystem::Count)> subsystems;
+    APB::JsonArena::Statistics jsonArenas{APB::JsonArena::statistics()};
+    std::array<TaskStack, APB_TASK_STACKS_MAX> tasks;
+    size_t tasksCount{taskStacks(tasks.data(), tasks.size())};
+    float uptime;
+    APB::I2C::Bus::Statistics i2c;
+    const APB::Latency::Probe *latencyProbes = APB::Latency::probes();
+    size_t recordsSent = 0;
+
+    MetricsSnapshot();
+    void write(APB::MetricsResponse &metrics) const;
+};
+
+MetricsSnapshot::MetricsSnapshot() :
+    power{APB::PowerMonitor::Instance.status()},
+    ambient{APB::Ambient::Instance.reading()},
+    ambientSamplingInterval{APB::Ambient::Instance.samplingInterval()},
+    ambientRejectedReadings{APB::Ambient::Instance.rejectedReadings()},
+    ambientSensorsCount{APB::Ambient::Instance.sensorsCount()},
+    powerSamplingInterval{APB::PowerMonitor::Instance.samplingInterval()},
+    freeHeap{ESP.getFreeHeap()},
+    heapSize{ESP.getHeapSize()},
+    minFreeHeap{ESP.getMinFreeHeap()},
+    maxAllocHeap{ESP.getMaxAllocHeap()},
+    uptime{static_cast<float>(esp_timer_get_time() / 1000'000.0)},
+    i2c{APB::I2C::Instance.statistics()}
+{
+    fixedLabels.add("source", APB::Settings::Instance.wifi().hostname());
+    for(size_t index = 0; index < subsystems.size(); index++) {
+        subsystems[index] = APB::HeapAccounting::usage(static_cast<APB::HeapAccounting::Subsystem>(index));
+    }
+    for(size_t index = 0; index < ambientSensorsCount; index++) {
+        ambientSensors[index] = {APB::Ambient::Instance.sensorName(index), APB::Ambient::Instance.sensorReading(index)};
+    }
+    for(const auto &pwmOutput: APB::PWMOutputs::Instance) {
+        PWMOutput &snapshot = pwmOutputs[pwmOutput.index()];
+        snapshot.labels.add("index", pwmOutput.index()).add("mode", pwmOutput.modeName());
+        snapshot.maxDuty = pwmOutput.maxDuty();
+        snapshot.duty = pwmOutput.duty();
+        snapshot.active = pwmOutput.active();
+        snapshot.temperature = pwmOutput.temperature();
+        snapshot.targetTemperature = pwmOutput.targetTemperature();
+        snapshot.dewpointOffset = pwmOutput.dewpointOffset();
+        snapshot.samplingInterval = pwmOutput.samplingInterval();
+    }
+}
+
+void MetricsSnapshot::write(APB::MetricsResponse &metrics) const {
+    metrics
+        .gauge("powermonitor", power.busVoltage, Labels().unit("V").field("voltage"))
+        .gauge("powermonitor", power.current, Labels().unit("A").field("current"), nullptr, false)
+        .gauge("powermonitor", power.power, Labels().unit("W").field("power"), nullptr, false);
+    
+    if(ambient.has_value()) {
+        metrics
+            .gauge("ambient", ambient->temperature, Labels().unit("°C").field("temperature"))
+            .gauge("ambient", ambient->humidity, Labels().unit("%").field("humidity"), nullptr, false)
+            .gauge("ambient", ambient->dewpoint(), Labels().unit("°C").field("dewpoint"), nullptr, false)
+            .gauge("ambient", ambient->age() / 1000.f, Labels().unit("s").field("age"), nullptr, false);
+    }
+    bool addSensorHeaders = true;
+    for(size_t index = 0; index < ambientSensorsCount; index++) {
+        const AmbientSensor &sensor = ambientSensors[index];
+        if(sensor.reading) {
+            metrics
+                .gauge("ambient_sensor", sensor.reading->temperature, Labels().add("sensor", sensor.name).unit("°C").field("temperature"), nullptr, addSensorHeaders)
+                .gauge("ambient_sensor", sensor.reading->humidity, Labels().add("sensor", sensor.name).unit("%").field("humidity"), nullptr, false)
+                .gauge("ambient_sensor", sensor.reading->dewpoint(), Labels().add("sensor", sensor.name).unit("°C").field("dewpoint"), nullptr, false);
+            addSensorHeaders = false;
         }
+    }
+    metrics.counter("ambient_rejected_readings", ambientRejectedReadings, {}, "Ambient samples rejected as outliers");
+    metrics.gauge("powersave", modemSleep, Labels().field("modem_sleep"), "WiFi modem sleep state");
+    bool addControllerHeaders = true;
+    for(bool sleeping: {false, true}) {
+        APB::optional::if_present(controllerCurrent[sleeping], [&](float v){
+            metrics.gauge("controller_current", v, Labels().add("modem_sleep", sleeping ? 1 : 0).unit("A"), "Controller draw measured while the outputs are off", addControllerHeaders);
+            addControllerHeaders = false;
+        });
+    }
+    #ifdef APB_PWM_FAN_PIN
+    metrics
+        .gauge("fan", fan.duty, Labels().field("duty"))
+        .gauge("fan", fan.automatic, Labels().field("automatic"), nullptr, false)
+        .gauge("fan", fan.load, Labels().field("load"), nullptr, false)
+        .gauge("fan", fan.stalled, Labels().field("stalled"), nullptr, false);
+    APB::optional::if_present(fan.temperature, [&](float v){
+        metrics.gauge("fan", v, Labels().unit("°C").field("temperature"), nullptr, false);
     });
-    std::for_each(PWMOutputs::Instance.begin(), PWMOutputs::Instance.end(), [index=0, &metricsResponse](const PWMOutput &pwmOutput) mutable {
-        if(pwmOutput.dewpointOffset().has_value()) {
-            metricsResponse.gauge("pwmOutput_dewpoint_offset", pwmOutput.dewpointOffset().value(), MetricsResponse::Labels()
-                .add("index", String(pwmOutput.index()).c_str())
-                .field("dewpoint_offset")
-                .unit("°C")
-                .add("mode", pwmOutput.modeAsString().c_str()), nullptr, false);
-        }
+    APB::optional::if_present(fan.rpm, [&](float v){
+        metrics.gauge("fan", v, Labels().unit("rpm").field("speed"), nullptr, false);
     });
+    #endif
+    bool addHeaders = true;
+    for(const auto &pwmOutput: pwmOutputs) {
+        metrics.gauge("pwmOutput", pwmOutput.maxDuty, Labels(pwmOutput.labels).field("maxDuty"), nullptr, addHeaders);
+        addHeaders = false;
+    }
+    for(const auto &pwmOutput: pwmOutputs) {
+        metrics.gauge("pwmOutput", pwmOutput.duty, Labels(pwmOutput.labels).field("duty"), nullptr, false);
+    }
+    for(const auto &pwmOutput: pwmOutputs) {
+        metrics.gauge("pwmOutput", pwmOutput.active, Labels(pwmOutput.labels).field("active"), nullptr, false);
+    }
+    for(const auto &pwmOutput: pwmOutputs) {
+        APB::optional::if_present(pwmOutput.temperature, [&](float v){
+            metrics.gauge("pwmOutput", v, Labels(pwmOutput.labels).unit("°C").field("temperature"), nullptr, false);
+        });
+    }
+    addHeaders = true;
+    for(const auto &pwmOutput: pwmOutputs) {
+        APB::optional::if_present(pwmOutput.targetTemperature, [&](float v){
+            metrics.gauge("pwmOutput_target_temperature", v, Labels(pwmOutput.labels).field("target_temperature").unit("°C"), nullptr, addHeaders);
+            addHeaders = false;
+        });
+    }
+    addHeaders = true;
+    for(const auto &pwmOutput: pwmOutputs) {
+        APB::optional::if_present(pwmOutput.dewpointOffset, [&](float v){
+            metrics.gauge("pwmOutput_dewpoint_offset", v, Labels(pwmOutput.labels).field("dewpoint_offset").unit("°C"), nullptr, addHeaders);
+            addHeaders = false;
+        });
+    }
 
+    metrics.gauge("sampling_interval_seconds", ambientSamplingInterval / 1000.0, Labels().add("sensor", "ambient"), "Current adaptive sampling interval");
+    metrics.gauge("sampling_interval_seconds", powerSamplingInterval / 1000.0, Labels().add("sensor", "powermonitor"), nullptr, false);
+    for(const auto &pwmOutput: pwmOutputs) {
+        metrics.gauge("sampling_interval_seconds", pwmOutput.samplingInterval / 1000.0, Labels(pwmOutput.labels).add("sensor", "pwm_output"), nullptr, false);
+    }
 
-    metricsResponse.gauge("heap", ESP.getFreeHeap(), MetricsResponse::Labels().field("free"));
-    metricsResponse.gauge("heap", ESP.getHeapSize(), MetricsResponse::Labels().field("size"), nullptr, false);
-    metricsResponse.gauge("heap", ESP.getMinFreeHeap(), MetricsResponse::Labels().field("min_free"), nullptr, false);
-    metricsResponse.gauge("heap", ESP.getMaxAllocHeap(), MetricsResponse::Labels().field("max_alloc"), nullptr, false);
-    metricsResponse.gauge("uptime", esp_timer_get_time() / 1000'000.0);
+    metrics.gauge("heap", freeHeap, Labels().field("free"));
+    metrics.gauge("heap", heapSize, Labels().field("size"), nullptr, false);
+    metrics.gauge("heap", minFreeHeap, Labels().field("min_free"), nullptr, false);
+    metrics.gauge("heap", maxAllocHeap, Labels().field("max_alloc"), nullptr, false);
+    for(size_t index = 0; index < subsystems.size(); index++) {
+        const char *subsystem = APB::HeapAccounting::name(static_cast<APB::HeapAccounting::Subsystem>(index));
+        metrics.gauge("heap_subsystem", subsystems[index].bytes, Labels().add("subsystem", subsystem).field("bytes"), "Heap allocated by the firmware subsystems", index == 0);
+        metrics.gauge("heap_subsystem", subsystems[index].peak, Labels().add("subsystem", subsystem).field("peak"), nullptr, false);
+    }
+    for(size_t index = 0; index < subsystems.size(); index++) {
+        const char *subsystem = APB::HeapAccounting::name(static_cast<APB::HeapAccounting::Subsystem>(index));
+        metrics.counter("heap_subsystem_allocations", subsystems[index].allocations, Labels().add("subsystem", subsystem), "Heap allocations by the firmware subsystems", index == 0);
+    }
+    for(size_t index = 0; index < subsystems.size(); index++) {
+        const char *subsystem = APB::HeapAccounting::name(static_cast<APB::HeapAccounting::Subsystem>(index));
+        metrics.counter("heap_subsystem_failures", subsystems[index].failures, Labels().add("subsystem", subsystem), "Failed heap allocations by the firmware subsystems", index == 0);
+    }
+    metrics.counter("json_arena", jsonArenas.leases, Labels().field("leases"), "Arenas of the JSON documents: leases, then leases and allocations falling back to the heap");
+    metrics.counter("json_arena", jsonArenas.exhausted, Labels().field("exhausted"), nullptr, false);
+    metrics.counter("json_arena", jsonArenas.overflows, Labels().field("overflows"), nullptr, false);
+    metrics.gauge("json_arena_peak", jsonArenas.peak, Labels().unit("bytes"), "Most bytes used at once in a JSON documents arena");
+    for(size_t index = 0; index < tasksCount; index++) {
+        metrics.gauge("task_stack_free", tasks[index].freeBytes, Labels().add("task", tasks[index].name).unit("bytes"), "Least free stack of the FreeRTOS tasks since they started", index == 0);
+    }
+    metrics.gauge("uptime", uptime);
+
+    metrics.counter("i2c", i2c.transactions, Labels().field("transactions"), "I2C bus transactions");
+    metrics.counter("i2c", i2c.errors, Labels().field("errors"), nullptr, false);
+    metrics.counter("i2c", i2c.timeouts, Labels().field("timeouts"), nullptr, false);
+    metrics.counter("i2c", i2c.recoveries, Labels().field("recoveries"), nullptr, false);
+    metrics.counter("i2c", i2c.failedRecoveries, Labels().field("failed_recoveries"), nullptr, false);
+    metrics.counter("i2c", i2c.dropped, Labels().field("dropped"), nullptr, false);
+
+#ifdef APB_LATENCY_HISTOGRAMS
+    addHeaders = true;
+    for(const APB::Latency::Probe *probe = latencyProbes; probe; probe = probe->next) {
+        metrics.histogram("latency_duration_seconds", APB::Latency::BucketsSeconds.data(), probe->duration.buckets().data(), APB::Latency::BucketsSeconds.size(),
+            probe->duration.sumSeconds(), Labels().add("kind", probe->kind).add("name", probe->name), "Run time of tasks, I2C transactions and HTTP handlers", addHeaders);
+        addHeaders = false;
+    }
+    addHeaders = true;
+    for(const APB::Latency::Probe *probe = latencyProbes; probe; probe = probe->next) {
+        if(!probe->hasLateness) {
+            continue;
+        }
+        metrics.histogram("latency_lateness_seconds", APB::Latency::BucketsSeconds.data(), probe->lateness.buckets().data(), APB::Latency::BucketsSeconds.size(),
+            probe->lateness.sumSeconds(), Labels().add("kind", probe->kind).add("name", probe->name), "Delay between scheduled and actual task start", addHeaders);
+        addHeaders = false;
+    }
+#endif
+}
+}
+
+void APB::WebServer::onGetMetrics(AsyncWebServerRequest *request) {
+    auto snapshot = HeapAccounting::makeShared<MetricsSnapshot>();
+    AsyncWebServerResponse* response = request->beginChunkedResponse(METRICS_CONTENT_TYPE,
+        [snapshot](uint8_t *buffer, size_t maxLen, size_t index){
+            MetricsResponse metrics{buffer, maxLen, snapshot->fixedLabels, snapshot->recordsSent};
+            snapshot->write(metrics);
+            snapshot->recordsSent = metrics.records();
+            // Not even one record fitted in this chunk: retry with the next one instead of ending the response
+            return metrics.written() == 0 && metrics.full() ? RESPONSE_TRY_AGAIN : metrics.written();
+        });
+    request->send(response);
 }
 
 
@@ -253,6 +508,29 @@ void APB::WebServer::onGetESPInfo(AsyncWebServerRequest *request) {
     response.root()["mem"]["usedPsRam"] = ESP.getPsramSize() - ESP.getFreePsram();
     response.root()["mem"]["maxAllocHeap"] = ESP.getMaxAllocHeap();
     response.root()["mem"]["maxAllocPsRam"] = ESP.getMaxAllocPsram();
+    response.root()["mem"]["minFreeHeap"] = ESP.getMinFreeHeap();
+    for(size_t index = 0; index < static_cast<size_t>(HeapAccounting::Subsystem::Count); index++) {
+        const auto subsystem = static_cast<HeapAccounting::Subsystem>(index);
+        const HeapAccounting::Usage usage = HeapAccounting::usage(subsystem);
+        JsonObject subsystemObject = response.root()["mem"]["subsystems"][HeapAccounting::name(subsystem)].to<JsonObject>();
+        subsystemObject["bytes"] = usage.bytes;
+        subsystemObject["peak"] = usage.peak;
+        subsystemObject["allocations"] = usage.allocations;
+        subsystemObject["failures"] = usage.failures;
+    }
+    const JsonArena::Statistics jsonArenas = JsonArena::statistics();
+    response.root()["mem"]["jsonArenas"]["count"] = APB_JSON_ARENAS;
+    response.root()["mem"]["jsonArenas"]["bytes"] = APB_JSON_ARENA_BYTES;
+    response.root()["mem"]["jsonArenas"]["leases"] = jsonArenas.leases;
+    response.root()["mem"]["jsonArenas"]["exhausted"] = jsonArenas.exhausted;
+    response.root()["mem"]["jsonArenas"]["overflows"] = jsonArenas.overflows;
+    response.root()["mem"]["jsonArenas"]["peak"] = jsonArenas.peak;
+    std::array<TaskStack, APB_TASK_STACKS_MAX> tasks;
+    const size_t tasksCount = taskStacks(tasks.data(), tasks.size());
+    JsonObject tasksObject = response.root()["tasks"].to<JsonObject>();
+    for(size_t index = 0; index < tasksCount; index++) {
+        tasksObject[tasks[index].name]["stackFree"] = tasks[index].freeBytes;
+    }
     response.root()["sketch"]["MD5"] = ESP.getSketchMD5();
     response.root()["sketch"]["size"] = ESP.getSketchSize();
     response.root()["sketch"]["totalSpace"] = ESP.getFreeSketchSpace();
@@ -305,6 +583,14 @@ void APB::WebServer::onConfigFanDuty(AsyncWebServerRequest *request, JsonVariant
     #ifndef APB_PWM_FAN_PIN
         JsonWebResponse(request).error(JsonWebResponse::NotFound, "Fan control not supported on this hardware", request);
     #else
+        // {"automatic": true} hands the fan back to the fan curve, a duty sets it by hand
+        if(json["automatic"].as<bool>()) {
+            Fan::Instance().setAutomatic(true);
+            Settings::Instance.setFanAutomatic(true);
+            JsonWebResponse response(request);
+            response.root()["automatic"] = true;
+            return;
+        }
         WebValidation validation{request, json};
         if(validation.required<float>("duty")
             .range("duty", {0}, {1})
@@ -313,7 +599,9 @@ void APB::WebServer::onConfigFanDuty(AsyncWebServerRequest *request, JsonVariant
         Fan::Instance().setDuty(duty);
         JsonWebResponse response(request);
         response.root()["duty"] = duty;
+        response.root()["automatic"] = false;
         Settings::Instance.setFanDuty(duty);
+        Settings::Instance.setFanAutomatic(false);
     #endif
 }
 
@@ -3,6 +3,7 @@
 
 #include <ESPAsyncWebServer.h>
 #include <ArduinoJson.h>
+#include <AsyncJson.h>
 
 #include "settings.h"
 #include <wifimanager.h>
@@ -12,6 +13,8 @@
 #include <TaskSchedulerDeclarations.h>
 #include "statusled.h"
 #include "history.h"
+#include "status_events.h"
+#include "telemetry_socket.h"
 
 #include <AsyncWebServerBase.h>
 
@@ -21,15 +24,21 @@ class WebServer : public AsyncWebServerBase {
 public:
     WebServer(Scheduler &scheduler);
     void setup();
+    // Connected SSE and WebSocket clients
+    size_t clientsCount() const { return statusEvents.clientsCount() + telemetrySocket.clientsCount(); }
 private:
-    AsyncEventSource events;
+    StatusEvents statusEvents;
+    TelemetrySocket telemetrySocket;
     Scheduler &scheduler;
-    JsonDocument eventsDocument;
-    std::array<char, MAX_EVENTS_SIZE> eventsString;
 
     void onGetStatus(AsyncWebServerRequest *request);
     void onGetConfig(AsyncWebServerRequest *request);
     void onGetHistory(AsyncWebServerRequest *request);
+    void onGetTrace(AsyncWebServerRequest *request);
+    void onDeleteTrace(AsyncWebServerRequest *request);
+    void onGetLogs(AsyncWebServerRequest *request);
+    void onGetBinaryLog(AsyncWebServerRequest *request);
+    void onDeleteBinaryLog(AsyncWebServerRequest *request);
     void onPostWriteConfig(AsyncWebServerRequest *request);
     void onGetAmbient(AsyncWebServerRequest *request);
     void onGetPower(AsyncWebServerRequest *request);
@@ -42,6 +51,9 @@ private:
     void onConfigFanDuty(AsyncWebServerRequest *request, JsonVariant &json);
     void onConfigPDVoltage(AsyncWebServerRequest *request, JsonVariant &json);
     void onConfigPowerSourceType(AsyncWebServerRequest *request, JsonVariant &json);
+
+    static ArRequestHandlerFunction instrument(const char *route, ArRequestHandlerFunction handler);
+    static ArJsonRequestHandlerFunction instrumentJson(const char *route, ArJsonRequestHandlerFunction handler);
 };
 }
 
@@ -0,0 +1,86 @@
+// `pio test -e native -f test_adaptive_interval`
+#include <unity.h>
+#include <cmath>
+#include "adaptive_interval.h"
+
+using APB::AdaptiveInterval;
+
+namespace {
+const AdaptiveInterval::Bounds bounds{1'000, 30'000, 0.2};
+
+uint32_t feed(AdaptiveInterval &interval, float value, int samples) {
+    uint32_t result = interval.interval();
+    for(int i = 0; i < samples; i++) {
+        result = interval.update(value);
+    }
+    return result;
+}
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_starts_at_minimum() {
+    AdaptiveInterval interval{bounds};
+    TEST_ASSERT_EQUAL(1'000, interval.interval());
+    TEST_ASSERT_EQUAL(1'000, interval.update(10));
+}
+
+void test_stable_signal_slows_down_to_maximum() {
+    AdaptiveInterval interval{bounds};
+    uint32_t previous = interval.update(10);
+    for(int i = 0; i < 5; i++) {
+        const uint32_t next = interval.update(10.01);
+        TEST_ASSERT_GREATER_THAN(previous, next);
+        previous = next;
+    }
+    TEST_ASSERT_EQUAL(30'000, feed(interval, 10.01, 50));
+}
+
+void test_step_goes_back_to_minimum() {
+    AdaptiveInterval interval{bounds};
+    feed(interval, 10, 50);
+    TEST_ASSERT_EQUAL(30'000, interval.interval());
+    TEST_ASSERT_EQUAL(1'000, interval.update(11));
+}
+
+void test_moderate_change_halves_the_interval() {
+    AdaptiveInterval interval{bounds};
+    feed(interval, 10, 50);
+    TEST_ASSERT_EQUAL(15'000, interval.update(10.3));
+}
+
+void test_noisy_signal_stays_fast() {
+    AdaptiveInterval interval{bounds};
+    for(int i = 0; i < 50; i++) {
+        interval.update(i % 2 ? 10.5 : 10);
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(2'000, interval.interval());
+}
+
+void test_boost_forces_minimum_for_one_update() {
+    AdaptiveInterval interval{bounds};
+    feed(interval, 10, 50);
+    interval.boost();
+    TEST_ASSERT_EQUAL(1'000, interval.interval());
+    TEST_ASSERT_EQUAL(1'000, interval.update(10));
+    TEST_ASSERT_GREATER_THAN(1'000, interval.update(10));
+}
+
+void test_invalid_samples_are_ignored() {
+    AdaptiveInterval interval{bounds};
+    feed(interval, 10, 50);
+    TEST_ASSERT_EQUAL(30'000, interval.update(NAN));
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_starts_at_minimum);
+    RUN_TEST(test_stable_signal_slows_down_to_maximum);
+    RUN_TEST(test_step_goes_back_to_minimum);
+    RUN_TEST(test_moderate_change_halves_the_interval);
+    RUN_TEST(test_noisy_signal_stays_fast);
+    RUN_TEST(test_boost_forces_minimum_for_one_update);
+    RUN_TEST(test_invalid_samples_are_ignored);
+    return UNITY_END();
+}
@@ -0,0 +1,103 @@
+// `pio test -e native -f test_ambient_filter`
+#include <unity.h>
+#include "ambient/ambient-filter.h"
+
+using APB::AmbientFilter;
+using APB::MedianEMAFilter;
+
+namespace {
+const AmbientFilter::Parameters parameters{2, 5, 0.5, 60'000};
+
+AmbientFilter::Sample sample(float temperature, float humidity, uint32_t timestamp) {
+    return {temperature, humidity, timestamp};
+}
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_median_rejects_a_spike() {
+    MedianEMAFilter filter{2, 1};
+    TEST_ASSERT_EQUAL_FLOAT(10, *filter.add(10));
+    TEST_ASSERT_EQUAL_FLOAT(10, *filter.add(10));
+    TEST_ASSERT_FALSE(filter.add(30).has_value());
+    TEST_ASSERT_EQUAL_FLOAT(10, *filter.add(10));
+}
+
+void test_median_follows_a_step() {
+    MedianEMAFilter filter{2, 1};
+    for(int i = 0; i < 5; i++) {
+        filter.add(10);
+    }
+    TEST_ASSERT_FALSE(filter.add(15).has_value());
+    TEST_ASSERT_FALSE(filter.add(15).has_value());
+    TEST_ASSERT_EQUAL_FLOAT(15, *filter.add(15));
+}
+
+void test_ema_smooths_the_median() {
+    MedianEMAFilter filter{10, 0.5};
+    const auto first = filter.add(10);
+    TEST_ASSERT_EQUAL_FLOAT(10, *first);
+    // Median of {10, 12} is 11, EMA 10 + 0.5 * (11 - 10)
+    const auto second = filter.add(12);
+    TEST_ASSERT_EQUAL_FLOAT(10.5, *second);
+}
+
+void test_failed_reads_hold_the_last_good_reading() {
+    AmbientFilter filter{parameters};
+    filter.add(sample(10, 80, 1'000), 1'000);
+    const auto held = filter.add({}, 30'000);
+    TEST_ASSERT_TRUE(held.has_value());
+    TEST_ASSERT_EQUAL_FLOAT(10, held->temperature);
+    TEST_ASSERT_EQUAL(1'000, held->timestamp);
+    TEST_ASSERT_FALSE(filter.add({}, 61'001).has_value());
+}
+
+void test_outliers_and_invalid_values_hold_the_last_good_reading() {
+    AmbientFilter filter{parameters};
+    filter.add(sample(10, 80, 0), 0);
+    filter.add(sample(10, 80, 5'000), 5'000);
+    const auto outlier = filter.add(sample(10, 20, 10'000), 10'000);
+    TEST_ASSERT_EQUAL_FLOAT(80, outlier->humidity);
+    TEST_ASSERT_EQUAL(5'000, outlier->timestamp);
+    TEST_ASSERT_EQUAL(1, filter.rejected());
+    const auto invalid = filter.add(sample(-100, 80, 15'000), 15'000);
+    TEST_ASSERT_EQUAL(5'000, invalid->timestamp);
+}
+
+void test_rejected_samples_dont_move_the_averages() {
+    AmbientFilter filter{parameters};
+    filter.add(sample(10, 80, 0), 0);
+    // Median humidity 82, EMA 80 + 0.5 * (82 - 80)
+    const auto accepted = filter.add(sample(10, 84, 1'000), 1'000);
+    TEST_ASSERT_EQUAL_FLOAT(81, accepted->humidity);
+    // The temperature is an outlier: the humidity is valid, but its average must not move either
+    const auto rejected = filter.add(sample(30, 84, 2'000), 2'000);
+    TEST_ASSERT_EQUAL_FLOAT(81, rejected->humidity);
+    // Median humidity 84, EMA 81 + 0.5 * (84 - 81)
+    const auto next = filter.add(sample(10, 84, 3'000), 3'000);
+    TEST_ASSERT_EQUAL_FLOAT(82.5, next->humidity);
+}
+
+void test_history_is_discarded_after_the_hold_timeout() {
+    AmbientFilter filter{parameters};
+    filter.add(sample(10, 80, 0), 0);
+    filter.add(sample(10, 80, 1'000), 1'000);
+    TEST_ASSERT_FALSE(filter.add({}, 100'000).has_value());
+    // A new level is accepted straight away, instead of being rejected against the old median
+    const auto fresh = filter.add(sample(20, 50, 101'000), 101'000);
+    TEST_ASSERT_TRUE(fresh.has_value());
+    TEST_ASSERT_EQUAL_FLOAT(20, fresh->temperature);
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_median_rejects_a_spike);
+    RUN_TEST(test_median_follows_a_step);
+    RUN_TEST(test_ema_smooths_the_median);
+    RUN_TEST(test_failed_reads_hold_the_last_good_reading);
+    RUN_TEST(test_outliers_and_invalid_values_hold_the_last_good_reading);
+    RUN_TEST(test_rejected_samples_dont_move_the_averages);
+    RUN_TEST(test_history_is_discarded_after_the_hold_timeout);
+    return UNITY_END();
+}
@@ -0,0 +1,58 @@
+// `pio test -e native -f test_ambient_fusion`
+#include <unity.h>
+#include <array>
+#include "ambient/ambient-fusion.h"
+
+using APB::AmbientFilter;
+namespace Fusion = APB::AmbientFusion;
+
+namespace {
+// Box: warm and dry. Tube: colder, close to saturation, with the higher dewpoint
+const std::array<std::optional<AmbientFilter::Sample>, 3> samples{{
+    AmbientFilter::Sample{20, 50, 2'000},
+    std::nullopt,
+    AmbientFilter::Sample{12, 95, 1'000},
+}};
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_dewpoint() {
+    const float dewpoint = Fusion::dewpoint(20, 50);
+    TEST_ASSERT_FLOAT_WITHIN(0.1, 9.3, dewpoint);
+}
+
+void test_worst_case_dewpoint_picks_the_most_humid_sensor() {
+    const auto fused = Fusion::fuse(Fusion::Policy::WorstCaseDewpoint, samples.data(), samples.size());
+    TEST_ASSERT_EQUAL_FLOAT(12, fused->temperature);
+    TEST_ASSERT_EQUAL(1'000, fused->timestamp);
+}
+
+void test_average_skips_missing_readings_and_keeps_the_oldest_timestamp() {
+    const auto fused = Fusion::fuse(Fusion::Policy::Average, samples.data(), samples.size());
+    TEST_ASSERT_EQUAL_FLOAT(16, fused->temperature);
+    TEST_ASSERT_EQUAL_FLOAT(72.5, fused->humidity);
+    TEST_ASSERT_EQUAL(1'000, fused->timestamp);
+}
+
+void test_first_valid_reading() {
+    const auto fused = Fusion::fuse(Fusion::Policy::First, samples.data() + 1, 2);
+    TEST_ASSERT_EQUAL_FLOAT(12, fused->temperature);
+}
+
+void test_no_valid_readings() {
+    const std::optional<AmbientFilter::Sample> missing[2];
+    TEST_ASSERT_FALSE(Fusion::fuse(Fusion::Policy::WorstCaseDewpoint, missing, 2).has_value());
+    TEST_ASSERT_FALSE(Fusion::fuse(Fusion::Policy::Average, missing, 0).has_value());
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_dewpoint);
+    RUN_TEST(test_worst_case_dewpoint_picks_the_most_humid_sensor);
+    RUN_TEST(test_average_skips_missing_readings_and_keeps_the_oldest_timestamp);
+    RUN_TEST(test_first_valid_reading);
+    RUN_TEST(test_no_valid_readings);
+    return UNITY_END();
+}
@@ -0,0 +1,148 @@
+// Deferred binary log ring buffer, formatting and download: `pio test -e native -f test_binary_log`
+#include <unity.h>
+#include <string>
+#include <vector>
+#include <ESPAsyncWebServer.h>
+#include <native.h>
+#include "binary_log.h"
+
+using APB::BinaryLog;
+
+namespace {
+// Downloads the log like the chunked response, cycling through the chunk sizes. RESPONSE_TRY_AGAIN retries with the next size.
+std::vector<uint8_t> download(bool text, const std::vector<size_t> &chunkSizes, size_t *retries = nullptr) {
+    BinaryLog::Serialiser serialiser{BinaryLog::Instance, text};
+    std::vector<uint8_t> bytes;
+    for(size_t call = 0; ; call++) {
+        std::vector<uint8_t> chunk(chunkSizes[call % chunkSizes.size()]);
+        const size_t written = serialiser.write(chunk.data(), chunk.size(), bytes.size());
+        if(written == RESPONSE_TRY_AGAIN) {
+            if(retries) {
+                (*retries)++;
+            }
+            continue;
+        }
+        if(written == 0) {
+            return bytes;
+        }
+        bytes.insert(bytes.end(), chunk.begin(), chunk.begin() + written);
+    }
+}
+
+std::vector<uint8_t> download(bool text, size_t chunkSize) {
+    return download(text, std::vector<size_t>{chunkSize});
+}
+
+std::vector<std::string> decode(const std::vector<uint8_t> &bytes) {
+    std::vector<std::string> lines;
+    if(!BinaryLog::decode(bytes.data(), bytes.size(), [&lines](const char *line) { lines.push_back(line); })) {
+        lines.push_back("not a binary log");
+    }
+    return lines;
+}
+}
+
+void setUp() {
+    BinaryLog::Instance.clear();
+}
+
+void tearDown() {}
+
+void test_formats_arguments() {
+    const uint32_t now = millis();
+    APB_BINARY_LOG(PWMOutputRamp, uint8_t{1}, 4.5f, 7.25f, 2.f, 0.1f, 1.f, 1.375, 0.92f);
+    APB_BINARY_LOG(PWMOutputReached, 2, 8.f, 7.f);
+    const auto lines = decode(download(false, 1'024));
+    TEST_ASSERT_EQUAL(2, lines.size());
+    char expected[256];
+    snprintf(expected, sizeof(expected), "%.3f I: PWMOutput[1] - temperature `4.50` lower than target temperature `7.25`, ramp=`2.00` and PWM range is `0.10-1.00`, ramp factor=`1.38`, setting PWM to `0.92`\n", now / 1000.0);
+    TEST_ASSERT_EQUAL_STRING(expected, lines[0].c_str());
+    snprintf(expected, sizeof(expected), "%.3f I: PWMOutput[2] - temperature `8.00` reached target temperature `7.00`, setting PWM to 0\n", now / 1000.0);
+    TEST_ASSERT_EQUAL_STRING(expected, lines[1].c_str());
+}
+
+void test_levels_above_threshold_are_compiled_away() {
+    static_assert(!BinaryLog::enabled(BinaryLog::Format::PWMOutputTarget), "Trace formats are above the default threshold");
+    static_assert(BinaryLog::enabled(BinaryLog::Format::PWMOutputReached), "Info formats are below the default threshold");
+    int evaluated = 0;
+    APB_BINARY_LOG(PWMOutputTarget, evaluated++, 1.f, 2.f);
+    TEST_ASSERT_EQUAL(0, evaluated);
+    TEST_ASSERT_EQUAL(0, BinaryLog::Instance.size());
+}
+
+void test_ring_keeps_latest_records() {
+    // 8 bytes of header and 12 of arguments per record
+    const int records = BinaryLog::Instance.capacity() / 20 + 50;
+    for(int index = 0; index < records; index++) {
+        APB_BINARY_LOG(PWMOutputReached, index, 1.f, 0.f);
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(BinaryLog::Instance.capacity(), BinaryLog::Instance.size());
+    const auto bytes = download(false, 4'096);
+    BinaryLog::Header header;
+    memcpy(&header, bytes.data(), sizeof(header));
+    const auto lines = decode(bytes);
+    TEST_ASSERT_EQUAL(records, lines.size() + header.dropped);
+    const std::string last = "PWMOutput[" + std::to_string(records - 1) + "]";
+    TEST_ASSERT_TRUE(lines.back().find(last) != std::string::npos);
+    const std::string first = "PWMOutput[" + std::to_string(header.dropped) + "]";
+    TEST_ASSERT_TRUE(lines.front().find(first) != std::string::npos);
+}
+
+void test_download_chunk_sizes() {
+    for(int index = 0; index < 100; index++) {
+        APB_BINARY_LOG(PWMOutputReached, index, 1.f, 0.f);
+    }
+    const auto whole = download(false, 16'384);
+    TEST_ASSERT_EQUAL(sizeof(BinaryLog::Header) + 100 * 20, whole.size());
+    for(size_t chunkSize: {20, 27, 100, 1'436}) {
+        const auto chunked = download(false, chunkSize);
+        TEST_ASSERT_EQUAL(whole.size(), chunked.size());
+        TEST_ASSERT_EQUAL(0, memcmp(whole.data() + sizeof(BinaryLog::Header), chunked.data() + sizeof(BinaryLog::Header), whole.size() - sizeof(BinaryLog::Header)));
+    }
+    std::string lines;
+    for(const auto &line: decode(whole)) {
+        lines += line;
+    }
+    // Text chunks smaller than a line split it
+    for(size_t chunkSize: {20, 95, 1'436}) {
+        const auto text = download(true, chunkSize);
+        TEST_ASSERT_EQUAL_STRING(lines.c_str(), std::string(text.begin(), text.end()).c_str());
+    }
+}
+
+void test_chunks_smaller_than_a_record_are_retried() {
+    for(int index = 0; index < 20; index++) {
+        APB_BINARY_LOG(PWMOutputReached, index, 1.f, 0.f);
+    }
+    const auto whole = download(false, 16'384);
+    size_t retries = 0;
+    // 8 bytes hold neither the header nor a record
+    const auto chunked = download(false, {8, 30, 12, 50}, &retries);
+    TEST_ASSERT_EQUAL(whole.size(), chunked.size());
+    TEST_ASSERT_EQUAL(0, memcmp(whole.data() + sizeof(BinaryLog::Header), chunked.data() + sizeof(BinaryLog::Header), whole.size() - sizeof(BinaryLog::Header)));
+    TEST_ASSERT_TRUE(retries > 0);
+
+    BinaryLog::Serialiser serialiser{BinaryLog::Instance, false};
+    uint8_t chunk[8];
+    const size_t written = serialiser.write(chunk, sizeof(chunk), 0);
+    TEST_ASSERT_EQUAL(RESPONSE_TRY_AGAIN, written);
+}
+
+void test_rejects_other_formats() {
+    auto bytes = download(false, 1'024);
+    bytes[8] ^= 1;
+    TEST_ASSERT_FALSE(BinaryLog::decode(bytes.data(), bytes.size(), [](const char *) {}));
+    TEST_ASSERT_FALSE(BinaryLog::decode(bytes.data(), 10, [](const char *) {}));
+}
+
+int main(int argc, char **argv) {
+    BinaryLog::Instance.setup();
+    UNITY_BEGIN();
+    RUN_TEST(test_formats_arguments);
+    RUN_TEST(test_levels_above_threshold_are_compiled_away);
+    RUN_TEST(test_ring_keeps_latest_records);
+    RUN_TEST(test_download_chunk_sizes);
+    RUN_TEST(test_chunks_smaller_than_a_record_are_retried);
+    RUN_TEST(test_rejects_other_formats);
+    return UNITY_END();
+}
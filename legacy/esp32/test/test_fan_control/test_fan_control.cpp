@@ -0,0 +1,75 @@
+// `pio test -e native -f test_fan_control`
+#include <unity.h>
+#include "fan_control.h"
+
+using APB::FanCurve;
+using APB::FanStallDetector;
+
+namespace {
+const FanCurve::Parameters parameters{0.2, 30, 50, 3, 0.2, 0.8};
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_idle_when_cool_and_unloaded() {
+    FanCurve curve{parameters};
+    const float duty = curve.duty(20.f, 0);
+    TEST_ASSERT_EQUAL_FLOAT(0, duty);
+    TEST_ASSERT_FALSE(curve.running());
+}
+
+void test_temperature_ramp() {
+    FanCurve curve{parameters};
+    const float half = curve.duty(40.f, 0);
+    TEST_ASSERT_EQUAL_FLOAT(0.6, half);
+    const float full = curve.duty(60.f, 0);
+    TEST_ASSERT_EQUAL_FLOAT(1, full);
+}
+
+void test_load_ramp() {
+    FanCurve curve{parameters};
+    const float duty = curve.duty(20.f, 0.5);
+    TEST_ASSERT_EQUAL_FLOAT(0.6, duty);
+}
+
+void test_stops_below_the_hysteresis() {
+    FanCurve curve{parameters};
+    curve.duty(35.f, 0);
+    const float idling = curve.duty(28.f, 0);
+    TEST_ASSERT_EQUAL_FLOAT(0.2, idling);
+    const float stopped = curve.duty(26.f, 0);
+    TEST_ASSERT_EQUAL_FLOAT(0, stopped);
+}
+
+void test_full_duty_without_temperature() {
+    FanCurve curve{parameters};
+    const float duty = curve.duty({}, 0);
+    TEST_ASSERT_EQUAL_FLOAT(1, duty);
+}
+
+void test_stall_after_consecutive_slow_samples() {
+    FanStallDetector detector{0.3, 200, 3};
+    TEST_ASSERT_FALSE(detector.update(0.5, 0));
+    TEST_ASSERT_FALSE(detector.update(0.5, 0));
+    TEST_ASSERT_TRUE(detector.update(0.5, 0));
+    TEST_ASSERT_FALSE(detector.update(0.5, 1200));
+}
+
+void test_no_stall_while_stopped() {
+    FanStallDetector detector{0.3, 200, 1};
+    TEST_ASSERT_FALSE(detector.update(0, 0));
+    TEST_ASSERT_FALSE(detector.update(0.2, 0));
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_idle_when_cool_and_unloaded);
+    RUN_TEST(test_temperature_ramp);
+    RUN_TEST(test_load_ramp);
+    RUN_TEST(test_stops_below_the_hysteresis);
+    RUN_TEST(test_full_duty_without_temperature);
+    RUN_TEST(test_stall_after_consecutive_slow_samples);
+    RUN_TEST(test_no_stall_while_stopped);
+    return UNITY_END();
+}
@@ -0,0 +1,73 @@
+// Per subsystem heap accounting of raw, container and JSON allocations: `pio test -e native -f test_heap_accounting`
+#include <unity.h>
+#include <array>
+#include <list>
+#include "heap_accounting.h"
+
+using APB::HeapAccounting;
+using Subsystem = HeapAccounting::Subsystem;
+
+void setUp() {}
+void tearDown() {}
+
+void test_raw_allocations() {
+    const HeapAccounting::Usage before = HeapAccounting::usage(Subsystem::Responses);
+    void *pointer = HeapAccounting::allocate(Subsystem::Responses, 100);
+    TEST_ASSERT_NOT_NULL(pointer);
+    HeapAccounting::Usage usage = HeapAccounting::usage(Subsystem::Responses);
+    TEST_ASSERT_EQUAL_UINT32(before.bytes + 100, usage.bytes);
+    TEST_ASSERT_EQUAL_UINT32(before.allocations + 1, usage.allocations);
+    HeapAccounting::deallocate(Subsystem::Responses, pointer, 100);
+    usage = HeapAccounting::usage(Subsystem::Responses);
+    TEST_ASSERT_EQUAL_UINT32(before.bytes, usage.bytes);
+    TEST_ASSERT_TRUE(usage.peak >= before.bytes + 100);
+}
+
+void test_container_allocator() {
+    const HeapAccounting::Usage before = HeapAccounting::usage(Subsystem::History);
+    {
+        std::list<int, HeapAccounting::Allocator<int, Subsystem::History>> values;
+        for(int value = 0; value < 10; value++) {
+            values.push_back(value);
+        }
+        const HeapAccounting::Usage usage = HeapAccounting::usage(Subsystem::History);
+        TEST_ASSERT_TRUE(usage.bytes >= before.bytes + 10 * sizeof(int));
+        TEST_ASSERT_EQUAL_UINT32(before.allocations + 10, usage.allocations);
+    }
+    TEST_ASSERT_EQUAL_UINT32(before.bytes, HeapAccounting::usage(Subsystem::History).bytes);
+}
+
+void test_json_allocator() {
+    ArduinoJson::Allocator *allocator = HeapAccounting::json(Subsystem::Json);
+    const HeapAccounting::Usage before = HeapAccounting::usage(Subsystem::Json);
+    void *pointer = allocator->allocate(64);
+    TEST_ASSERT_NOT_NULL(pointer);
+    TEST_ASSERT_EQUAL_UINT32(before.bytes + 64, HeapAccounting::usage(Subsystem::Json).bytes);
+    pointer = allocator->reallocate(pointer, 256);
+    TEST_ASSERT_NOT_NULL(pointer);
+    HeapAccounting::Usage usage = HeapAccounting::usage(Subsystem::Json);
+    TEST_ASSERT_EQUAL_UINT32(before.bytes + 256, usage.bytes);
+    TEST_ASSERT_TRUE(usage.peak >= before.bytes + 256);
+    allocator->deallocate(pointer);
+    TEST_ASSERT_EQUAL_UINT32(before.bytes, HeapAccounting::usage(Subsystem::Json).bytes);
+    // Other subsystems are untouched
+    TEST_ASSERT_TRUE(HeapAccounting::json(Subsystem::Events) != allocator);
+}
+
+void test_shared_pointers() {
+    const HeapAccounting::Usage before = HeapAccounting::usage(Subsystem::Responses);
+    {
+        auto shared = HeapAccounting::makeShared<std::array<char, 200>>();
+        TEST_ASSERT_TRUE(HeapAccounting::usage(Subsystem::Responses).bytes >= before.bytes + 200);
+    }
+    TEST_ASSERT_EQUAL_UINT32(before.bytes, HeapAccounting::usage(Subsystem::Responses).bytes);
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_raw_allocations);
+    RUN_TEST(test_container_allocator);
+    RUN_TEST(test_json_allocator);
+    RUN_TEST(test_shared_pointers);
+    return UNITY_END();
+}
@@ -0,0 +1,77 @@
+// History entries and the chunked JSON serialiser: `pio test -e native -f test_history`
+#include <unity.h>
+#include <string>
+#include <native.h>
+#include "history.h"
+
+namespace {
+// Runs the serialiser like a chunked response, until it returns 0
+std::string serialise(size_t chunkSize) {
+    APB::History::JsonSerialiser serialiser{APB::History::Instance};
+    std::string json;
+    std::vector<uint8_t> buffer(chunkSize);
+    for(size_t index = 0; ;) {
+        const int written = serialiser.write(buffer.data(), buffer.size(), index);
+        if(written <= 0) {
+            return json;
+        }
+        json.append(reinterpret_cast<const char*>(buffer.data()), written);
+        index += written;
+    }
+}
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_populate() {
+    APB::History::Entry entry{42};
+    entry.setAmbient(APB::Ambient::Reading{12.5, 80});
+    entry.setPower(APB::PowerMonitor::Status{true, 0, 12.25, 1.5});
+    for(auto &pwmOutput: entry.pwmOutputs) {
+        pwmOutput.set({0, APB::PWMOutput::off, 0, std::nullopt});
+    }
+    JsonDocument doc;
+    entry.populate(doc.to<JsonObject>());
+    TEST_ASSERT_EQUAL(42, doc["uptime"].as<int>());
+    TEST_ASSERT_EQUAL_FLOAT(12.5, doc["ambientTemperature"].as<float>());
+    TEST_ASSERT_FLOAT_WITHIN(0.1, 9.1, doc["ambientDewpoint"].as<float>());
+    TEST_ASSERT_EQUAL_FLOAT(12.25, doc["busVoltage"].as<float>());
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 18.375, doc["power"].as<float>());
+    TEST_ASSERT_EQUAL(APB_PWM_OUTPUTS_TEMP_SENSORS, doc["pwmOutputs"].size());
+    TEST_ASSERT_TRUE(doc["pwmOutputs"][0]["temperature"].isNull());
+}
+
+void test_empty_history() {
+    JsonDocument doc;
+    TEST_ASSERT_FALSE(deserializeJson(doc, serialise(1024)));
+    TEST_ASSERT_EQUAL(0, doc["entries"].size());
+}
+
+void test_chunks_add_up_to_the_whole_document() {
+    for(int i = 0; i < 20; i++) {
+        Native::advance(1000);
+        APB::History::Instance.add();
+    }
+    const std::string whole = serialise(16 * 1024);
+    JsonDocument doc;
+    TEST_ASSERT_FALSE(deserializeJson(doc, whole));
+    TEST_ASSERT_EQUAL(20, doc["entries"].size());
+    TEST_ASSERT_EQUAL_STRING(whole.c_str(), serialise(512).c_str());
+    TEST_ASSERT_EQUAL_STRING(whole.c_str(), serialise(100).c_str());
+}
+
+void test_max_size() {
+    APB::History::Instance.setMaxSize(5);
+    APB::History::Instance.add();
+    TEST_ASSERT_EQUAL(5, APB::History::Instance.entries().size());
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_populate);
+    RUN_TEST(test_empty_history);
+    RUN_TEST(test_chunks_add_up_to_the_whole_document);
+    RUN_TEST(test_max_size);
+    return UNITY_END();
+}
@@ -0,0 +1,196 @@
+// I2C::Bus on a simulated bus: `pio test -e native -f test_i2c_bus`
+#include <unity.h>
+#include <map>
+#include <vector>
+#include "i2c_bus.h"
+
+using namespace APB::I2C;
+
+namespace {
+// Register based devices: a write sets the register pointer, a read returns the bytes from the register pointer on.
+class SimulatedBus : public Backend {
+public:
+    std::map<uint8_t, std::vector<uint8_t>> devices;
+    std::vector<std::pair<uint32_t, uint16_t>> configurations;
+    std::vector<uint8_t> transferred;
+    // Clock pulses a stuck device needs before releasing SDA, or -1 if it never does
+    int stuckClocks = 0;
+    int recoveries = 0;
+
+    void configure(uint32_t clock, uint16_t timeoutMs) override {
+        configurations.push_back({clock, timeoutMs});
+    }
+
+    Status transfer(const Device &device, const uint8_t *write, size_t writeLength, uint8_t *read, size_t readLength) override {
+        transferred.push_back(device.address);
+        if(stuckClocks != 0) {
+            return Status::BusError;
+        }
+        auto found = devices.find(device.address);
+        if(found == devices.end()) {
+            return Status::AddressNack;
+        }
+        if(writeLength > 0) {
+            pointer[device.address] = write[0];
+        }
+        const std::vector<uint8_t> &registers = found->second;
+        for(size_t i = 0; i < readLength; i++) {
+            const size_t index = pointer[device.address] + i;
+            if(index >= registers.size()) {
+                return Status::ShortRead;
+            }
+            read[i] = registers[index];
+        }
+        return Status::Ok;
+    }
+
+    bool recover() override {
+        recoveries++;
+        if(stuckClocks > 0 && stuckClocks <= 9) {
+            stuckClocks = 0;
+        }
+        return stuckClocks == 0;
+    }
+private:
+    std::map<uint8_t, uint8_t> pointer;
+};
+
+const Device sensor{"sensor", 0x44, 100'000, 20};
+const Device monitor{"monitor", 0x40, 400'000, 10};
+const Device missing{"missing", 0x50};
+
+SimulatedBus *simulated;
+Bus *bus;
+
+struct Result {
+    Status status = Status::QueueFull;
+    std::vector<uint8_t> data;
+    int calls = 0;
+    Callback callback() {
+        return [this](Status status, const uint8_t *data, size_t length) {
+            this->status = status;
+            this->data.assign(data, data + length);
+            calls++;
+        };
+    }
+};
+}
+
+void setUp() {
+    simulated = new SimulatedBus;
+    simulated->devices[sensor.address] = {0x10, 0x20, 0x30, 0x40, 0x50, 0x60};
+    simulated->devices[monitor.address] = {0xAA, 0xBB, 0xCC, 0xDD};
+    bus = new Bus(*simulated, 4);
+}
+
+void tearDown() {
+    delete bus;
+    delete simulated;
+}
+
+void test_transactions_run_in_order_and_deliver_data() {
+    Result first, second;
+    TEST_ASSERT_TRUE(bus->submit(sensor, {0x02}, 3, first.callback()));
+    TEST_ASSERT_TRUE(bus->submit(monitor, {0x01}, 2, second.callback()));
+    TEST_ASSERT_EQUAL(2, bus->queued());
+    TEST_ASSERT_EQUAL(0, first.calls);
+
+    TEST_ASSERT_TRUE(bus->process());
+    TEST_ASSERT_EQUAL(1, first.calls);
+    TEST_ASSERT_EQUAL(0, second.calls);
+    TEST_ASSERT_TRUE(bus->process());
+    TEST_ASSERT_FALSE(bus->process());
+
+    TEST_ASSERT_EQUAL(Status::Ok, first.status);
+    TEST_ASSERT_EQUAL(3, first.data.size());
+    TEST_ASSERT_EQUAL_HEX8(0x30, first.data[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x50, first.data[2]);
+    TEST_ASSERT_EQUAL(2, second.data.size());
+    TEST_ASSERT_EQUAL_HEX8(0xBB, second.data[0]);
+    TEST_ASSERT_EQUAL(2, bus->statistics().transactions);
+}
+
+void test_clock_and_timeout_are_configured_per_device() {
+    bus->submit(sensor, {0x00}, 1, nullptr);
+    bus->submit(sensor, {0x01}, 1, nullptr);
+    bus->submit(monitor, {0x00}, 1, nullptr);
+    bus->submit(sensor, {0x00}, 1, nullptr);
+    while(bus->process()) {}
+
+    TEST_ASSERT_EQUAL(3, simulated->configurations.size());
+    TEST_ASSERT_EQUAL(100'000, simulated->configurations[0].first);
+    TEST_ASSERT_EQUAL(20, simulated->configurations[0].second);
+    TEST_ASSERT_EQUAL(400'000, simulated->configurations[1].first);
+    TEST_ASSERT_EQUAL(10, simulated->configurations[1].second);
+    TEST_ASSERT_EQUAL(100'000, simulated->configurations[2].first);
+}
+
+void test_errors_are_reported_to_the_callback() {
+    Result nack, shortRead;
+    bus->submit(missing, {0x00}, 1, nack.callback());
+    bus->submit(monitor, {0x03}, 2, shortRead.callback());
+    while(bus->process()) {}
+
+    TEST_ASSERT_EQUAL(Status::AddressNack, nack.status);
+    TEST_ASSERT_EQUAL(0, nack.data.size());
+    TEST_ASSERT_EQUAL(Status::ShortRead, shortRead.status);
+    TEST_ASSERT_EQUAL(2, bus->statistics().errors);
+    TEST_ASSERT_EQUAL(0, simulated->recoveries);
+}
+
+void test_full_queue_rejects_transactions() {
+    Result dropped;
+    for(int i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(bus->submit(sensor, {0x00}, 1, nullptr));
+    }
+    TEST_ASSERT_FALSE(bus->submit(sensor, {0x00}, 1, dropped.callback()));
+    TEST_ASSERT_EQUAL(0, dropped.calls);
+    TEST_ASSERT_EQUAL(1, bus->statistics().dropped);
+    TEST_ASSERT_FALSE(bus->submit(sensor, {0x00}, MaxReadLength + 1, nullptr));
+}
+
+void test_on_submit_wakes_the_bus_task() {
+    int wakeups = 0;
+    bus->setOnSubmit([&wakeups]() { wakeups++; });
+    bus->submit(sensor, {}, 1, nullptr);
+    bus->submit(sensor, {}, 1, nullptr);
+    TEST_ASSERT_EQUAL(2, wakeups);
+}
+
+void test_stuck_sda_is_recovered() {
+    Result stuck, after;
+    simulated->stuckClocks = 5;
+    bus->submit(sensor, {0x00}, 2, stuck.callback());
+    bus->submit(sensor, {0x00}, 2, after.callback());
+    while(bus->process()) {}
+
+    TEST_ASSERT_EQUAL(Status::BusError, stuck.status);
+    TEST_ASSERT_EQUAL(Status::Ok, after.status);
+    TEST_ASSERT_EQUAL(1, simulated->recoveries);
+    TEST_ASSERT_EQUAL(1, bus->statistics().recoveries);
+    // The bus is reconfigured after recovery
+    TEST_ASSERT_EQUAL(2, simulated->configurations.size());
+}
+
+void test_failed_recovery_is_counted() {
+    simulated->stuckClocks = -1;
+    bus->submit(sensor, {0x00}, 2, nullptr);
+    bus->submit(sensor, {0x00}, 2, nullptr);
+    while(bus->process()) {}
+
+    TEST_ASSERT_EQUAL(2, simulated->recoveries);
+    TEST_ASSERT_EQUAL(2, bus->statistics().failedRecoveries);
+    TEST_ASSERT_EQUAL(0, bus->statistics().recoveries);
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_transactions_run_in_order_and_deliver_data);
+    RUN_TEST(test_clock_and_timeout_are_configured_per_device);
+    RUN_TEST(test_errors_are_reported_to_the_callback);
+    RUN_TEST(test_full_queue_rejects_transactions);
+    RUN_TEST(test_on_submit_wakes_the_bus_task);
+    RUN_TEST(test_stuck_sda_is_recovered);
+    RUN_TEST(test_failed_recovery_is_counted);
+    return UNITY_END();
+}
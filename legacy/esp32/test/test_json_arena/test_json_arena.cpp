@@ -0,0 +1,99 @@
+// Arena allocator for ArduinoJson documents, rewinding and falling back to the heap: `pio test -e native -f test_json_arena`
+#include <unity.h>
+#include <cstring>
+#include <string>
+#include <ArduinoJson.h>
+#include "json_arena.h"
+
+using APB::JsonArena;
+using APB::HeapAccounting;
+
+void setUp() {}
+void tearDown() {}
+
+void test_rewinds_when_released() {
+    JsonArena arena{HeapAccounting::Subsystem::Json, 1024};
+    void *first = arena.allocate(100);
+    void *second = arena.allocate(50);
+    TEST_ASSERT_NOT_NULL(first);
+    TEST_ASSERT_NOT_NULL(second);
+    TEST_ASSERT_TRUE(arena.used() >= 150);
+    arena.deallocate(first);
+    TEST_ASSERT_TRUE(arena.used() >= 150);
+    arena.deallocate(second);
+    TEST_ASSERT_EQUAL_UINT32(0, arena.used());
+    TEST_ASSERT_TRUE(arena.allocate(10) == first);
+}
+
+void test_last_block_resizes_in_place() {
+    JsonArena arena{HeapAccounting::Subsystem::Json, 1024};
+    auto *block = static_cast<char*>(arena.allocate(16));
+    memcpy(block, "0123456789abcdef", 16);
+    TEST_ASSERT_TRUE(arena.reallocate(block, 200) == block);
+    const size_t grown = arena.used();
+    TEST_ASSERT_TRUE(arena.reallocate(block, 8) == block);
+    TEST_ASSERT_TRUE(arena.used() < grown);
+    TEST_ASSERT_TRUE(memcmp(block, "01234567", 8) == 0);
+    // Not the last block anymore: moved, content kept
+    arena.allocate(8);
+    auto *moved = static_cast<char*>(arena.reallocate(block, 100));
+    TEST_ASSERT_TRUE(moved != block);
+    TEST_ASSERT_TRUE(memcmp(moved, "01234567", 8) == 0);
+}
+
+void test_overflows_to_the_heap() {
+    JsonArena arena{HeapAccounting::Subsystem::Json, 256};
+    const uint32_t overflows = JsonArena::statistics().overflows;
+    void *inArena = arena.allocate(100);
+    void *onHeap = arena.allocate(500);
+    TEST_ASSERT_NOT_NULL(onHeap);
+    TEST_ASSERT_EQUAL_UINT32(overflows + 1, JsonArena::statistics().overflows);
+    onHeap = arena.reallocate(onHeap, 1000);
+    TEST_ASSERT_NOT_NULL(onHeap);
+    arena.deallocate(onHeap);
+    arena.deallocate(inArena);
+    TEST_ASSERT_EQUAL_UINT32(0, arena.used());
+}
+
+void test_documents() {
+    JsonArena arena{HeapAccounting::Subsystem::Json, 4096};
+    {
+        JsonDocument document{&arena};
+        deserializeJson(document, R"([{"index":0,"mode":"dewpoint","dewpoint_offset":2.5,"name":"a long enough string"}])");
+        TEST_ASSERT_EQUAL_STRING("dewpoint", document[0]["mode"].as<const char*>());
+        std::string json;
+        serializeJson(document, json);
+        TEST_ASSERT_TRUE(json.find("a long enough string") != std::string::npos);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, arena.used());
+}
+
+void test_pool_leases() {
+    JsonArena::setup();
+    const JsonArena::Statistics before = JsonArena::statistics();
+    {
+        JsonArena::Lease first;
+        JsonArena::Lease second;
+        TEST_ASSERT_TRUE(static_cast<ArduinoJson::Allocator*>(first) != static_cast<ArduinoJson::Allocator*>(second));
+        TEST_ASSERT_TRUE(static_cast<ArduinoJson::Allocator*>(first) != HeapAccounting::json(HeapAccounting::Subsystem::Json));
+        // APB_JSON_ARENAS in use: served by the heap
+        JsonArena::Lease third;
+        TEST_ASSERT_TRUE(static_cast<ArduinoJson::Allocator*>(third) == HeapAccounting::json(HeapAccounting::Subsystem::Json));
+    }
+    JsonArena::Statistics after = JsonArena::statistics();
+    TEST_ASSERT_EQUAL_UINT32(before.leases + 3, after.leases);
+    TEST_ASSERT_EQUAL_UINT32(before.exhausted + 1, after.exhausted);
+    // Released: available again
+    JsonArena::Lease lease;
+    TEST_ASSERT_TRUE(static_cast<ArduinoJson::Allocator*>(lease) != HeapAccounting::json(HeapAccounting::Subsystem::Json));
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_rewinds_when_released);
+    RUN_TEST(test_last_block_resizes_in_place);
+    RUN_TEST(test_overflows_to_the_heap);
+    RUN_TEST(test_documents);
+    RUN_TEST(test_pool_leases);
+    return UNITY_END();
+}
@@ -0,0 +1,63 @@
+// `pio test -e native -f test_led_pattern`
+#include <unity.h>
+#include "led_pattern.h"
+
+using APB::LedPattern;
+
+namespace {
+void assertStep(const LedPattern &pattern, uint8_t index, bool on, uint32_t durationMs) {
+    TEST_ASSERT_EQUAL(on, pattern.steps[index].on);
+    TEST_ASSERT_EQUAL(durationMs, pattern.steps[index].durationMs);
+}
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_simple_blink() {
+    LedPattern pattern = LedPattern::blink(5, 5);
+    TEST_ASSERT_EQUAL(2, pattern.size);
+    TEST_ASSERT_TRUE(pattern.animated());
+    assertStep(pattern, 0, true, 500);
+    assertStep(pattern, 1, false, 500);
+}
+
+void test_repeats_with_pause() {
+    LedPattern pattern = LedPattern::blink(2, 2, 4, 2);
+    // The last off blink and the pause are merged
+    TEST_ASSERT_EQUAL(8, pattern.size);
+    assertStep(pattern, 0, true, 200);
+    assertStep(pattern, 5, false, 200);
+    assertStep(pattern, 7, false, 400);
+}
+
+void test_pause_in_on_state() {
+    LedPattern pattern = LedPattern::blink(1, 1, 2, 50, true);
+    TEST_ASSERT_EQUAL(5, pattern.size);
+    assertStep(pattern, 3, false, 100);
+    assertStep(pattern, 4, true, 5'000);
+}
+
+void test_steady_patterns_are_not_animated() {
+    TEST_ASSERT_FALSE(LedPattern::steady(true).animated());
+    TEST_ASSERT_FALSE(LedPattern::blink(3, 0).animated());
+    assertStep(LedPattern::blink(3, 0), 0, true, 0);
+    TEST_ASSERT_FALSE(LedPattern::blink(0, 0, 0).animated());
+    assertStep(LedPattern::blink(0, 0, 0), 0, false, 0);
+}
+
+void test_long_patterns_are_truncated() {
+    LedPattern pattern = LedPattern::blink(1, 1, 20);
+    TEST_ASSERT_EQUAL(LedPattern::MaxSteps, pattern.size);
+    assertStep(pattern, LedPattern::MaxSteps - 1, false, 100);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_simple_blink);
+    RUN_TEST(test_repeats_with_pause);
+    RUN_TEST(test_pause_in_on_state);
+    RUN_TEST(test_steady_patterns_are_not_animated);
+    RUN_TEST(test_long_patterns_are_truncated);
+    return UNITY_END();
+}
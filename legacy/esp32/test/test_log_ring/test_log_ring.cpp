@@ -0,0 +1,116 @@
+// Text log ring buffer with offsets, and level filtered reads: `pio test -e native -f test_log_ring`
+#include <unity.h>
+#include <string>
+#include <vector>
+#include <ArduinoLog.h>
+#include "log_ring.h"
+
+using APB::LogRing;
+
+namespace {
+std::string read(uint32_t since, int level, size_t chunkSize, uint32_t *next = nullptr, uint32_t *first = nullptr) {
+    LogRing::Reader reader{LogRing::Instance, since, level};
+    std::string text;
+    std::vector<uint8_t> chunk(chunkSize);
+    while(const size_t length = reader.read(chunk.data(), chunk.size())) {
+        text.append(chunk.begin(), chunk.begin() + length);
+    }
+    if(next) {
+        *next = reader.end();
+    }
+    if(first) {
+        *first = reader.first();
+    }
+    return text;
+}
+}
+
+void setUp() {
+    LogRing::Instance.setup();
+    Log.begin(LOG_LEVEL_VERBOSE, &LogRing::Instance, true);
+}
+
+void tearDown() {
+    Log.begin(LOG_LEVEL_SILENT, nullptr);
+}
+
+void test_reads_from_offset() {
+    Log.infoln("first %d", 1);
+    uint32_t next;
+    TEST_ASSERT_EQUAL_STRING("I: first 1\r\n", read(0, LOG_LEVEL_VERBOSE, 1'024, &next).c_str());
+    TEST_ASSERT_EQUAL(12, next);
+    TEST_ASSERT_EQUAL_STRING("", read(next, LOG_LEVEL_VERBOSE, 1'024).c_str());
+    Log.warningln("second");
+    TEST_ASSERT_EQUAL_STRING("W: second\r\n", read(next, LOG_LEVEL_VERBOSE, 1'024, &next).c_str());
+    TEST_ASSERT_EQUAL(23, next);
+}
+
+void test_incomplete_lines_are_not_read() {
+    Log.info("partial");
+    uint32_t next;
+    TEST_ASSERT_EQUAL_STRING("", read(0, LOG_LEVEL_VERBOSE, 1'024, &next).c_str());
+    TEST_ASSERT_EQUAL(0, next);
+    Log.infoln(" line");
+    TEST_ASSERT_EQUAL_STRING("I: partialI:  line\r\n", read(next, LOG_LEVEL_VERBOSE, 1'024).c_str());
+}
+
+void test_filters_levels() {
+    Log.errorln("error");
+    Log.infoln("info");
+    Log.traceln("trace");
+    Log.warningln("warning");
+    TEST_ASSERT_EQUAL_STRING("E: error\r\nW: warning\r\n", read(0, LogRing::parseLevel("warning"), 1'024).c_str());
+    TEST_ASSERT_EQUAL_STRING("E: error\r\nI: info\r\nW: warning\r\n", read(0, LogRing::parseLevel("4"), 7).c_str());
+    TEST_ASSERT_EQUAL(LOG_LEVEL_VERBOSE, LogRing::parseLevel("everything"));
+}
+
+void test_overwritten_lines_are_skipped() {
+    for(int line = 0; line < 2'000; line++) {
+        Log.infoln("line %d", line);
+    }
+    uint32_t first, next;
+    const std::string text = read(0, LOG_LEVEL_VERBOSE, 1'436, &next, &first);
+    TEST_ASSERT_LESS_OR_EQUAL(LogRing::Instance.capacity(), text.size());
+    TEST_ASSERT_EQUAL(next - first, text.size());
+    // Whole lines from the oldest kept to the last one
+    TEST_ASSERT_EQUAL('I', text.front());
+    TEST_ASSERT_TRUE(text.size() >= 14 && text.compare(text.size() - 14, 14, "I: line 1999\r\n") == 0);
+    // A reader behind the ring starts from the oldest line
+    TEST_ASSERT_EQUAL_STRING(text.c_str(), read(first - 100, LOG_LEVEL_VERBOSE, 512).c_str());
+    // Offsets from before a reboot are ahead of the ring
+    TEST_ASSERT_EQUAL_STRING(text.c_str(), read(next + 1'000, LOG_LEVEL_VERBOSE, 512).c_str());
+}
+
+void test_lines_longer_than_a_chunk() {
+    const std::string message(300, 'x');
+    Log.infoln("%s", message.c_str());
+    Log.infoln("short");
+    const std::string expected = "I: " + message + "\r\nI: short\r\n";
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), read(0, LOG_LEVEL_VERBOSE, 64).c_str());
+}
+
+void test_overwritten_partial_line_is_terminated() {
+    const std::string message(300, 'x');
+    Log.infoln("%s", message.c_str());
+    LogRing::Reader reader{LogRing::Instance, 0, LOG_LEVEL_VERBOSE};
+    std::vector<uint8_t> chunk(64);
+    std::string text(chunk.begin(), chunk.begin() + reader.read(chunk.data(), chunk.size()));
+    // The rest of the line is overwritten while streaming
+    for(int line = 0; line < 2'000; line++) {
+        Log.infoln("line %d", line);
+    }
+    text.append(chunk.begin(), chunk.begin() + reader.read(chunk.data(), chunk.size()));
+    TEST_ASSERT_EQUAL(65, text.size());
+    TEST_ASSERT_EQUAL('\n', text.back());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_reads_from_offset);
+    RUN_TEST(test_incomplete_lines_are_not_read);
+    RUN_TEST(test_filters_levels);
+    RUN_TEST(test_overwritten_lines_are_skipped);
+    RUN_TEST(test_lines_longer_than_a_chunk);
+    RUN_TEST(test_overwritten_partial_line_is_terminated);
+    return UNITY_END();
+}
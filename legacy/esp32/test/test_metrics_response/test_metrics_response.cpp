@@ -0,0 +1,140 @@
+// Prometheus writer, and the replay of a scrape over chunks: `pio test -e native -f test_metrics_response`
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "metricsresponse.h"
+
+using APB::MetricsResponse;
+using Labels = MetricsResponse::Labels;
+
+namespace {
+const float upperBounds[] = {0.001, 0.01, 0.1};
+const uint32_t bucketCounts[] = {3, 2, 0, 1};
+
+struct Scrape {
+    Labels fixedLabels;
+
+    Scrape() {
+        fixedLabels.add("source", "test");
+    }
+
+    void write(MetricsResponse &metrics) const {
+        metrics
+            .gauge("ambient", 8.5, Labels().unit("C").field("temperature"), "Ambient sensor")
+            .gauge("ambient", 80, Labels().unit("%").field("humidity"), nullptr, false)
+            .histogram("latency_seconds", upperBounds, bucketCounts, 3, 0.25, Labels().add("name", "ambient"))
+            .counter("i2c_transactions", 42);
+    }
+};
+
+// Runs the scrape like the /api/metrics chunked response: every chunk replays the whole sequence of calls, skipping
+// the records already sent. A chunk where not even one record fits is retried with the next size, as with RESPONSE_TRY_AGAIN.
+std::string scrape(const std::vector<size_t> &chunkSizes, size_t *retries = nullptr) {
+    Scrape scrape;
+    std::string text;
+    size_t recordsSent = 0;
+    for(size_t chunk = 0; ; chunk++) {
+        std::vector<uint8_t> buffer(chunkSizes[chunk % chunkSizes.size()]);
+        MetricsResponse metrics{buffer.data(), buffer.size(), scrape.fixedLabels, recordsSent};
+        scrape.write(metrics);
+        recordsSent = metrics.records();
+        if(metrics.written() == 0) {
+            if(!metrics.full()) {
+                return text;
+            }
+            if(retries) {
+                (*retries)++;
+            }
+            continue;
+        }
+        text.append(reinterpret_cast<const char*>(buffer.data()), metrics.written());
+    }
+}
+
+bool contains(const std::string &text, const std::string &part) {
+    return text.find(part) != std::string::npos;
+}
+
+size_t occurrences(const std::string &text, const std::string &part) {
+    size_t count = 0;
+    for(size_t position = text.find(part); position != std::string::npos; position = text.find(part, position + 1)) {
+        count++;
+    }
+    return count;
+}
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_headers() {
+    const std::string text = scrape({4096});
+    TEST_ASSERT_TRUE(contains(text,
+        "# HELP ambient Ambient sensor\n"
+        "# TYPE ambient gauge\n"
+        "ambient {source=\"test\",unit=\"C\",field=\"temperature\"} 8.500000\n"
+        "ambient {source=\"test\",unit=\"%\",field=\"humidity\"} 80.000000\n"));
+    TEST_ASSERT_EQUAL(1, occurrences(text, "# TYPE ambient "));
+    // Without help, only the TYPE header
+    TEST_ASSERT_TRUE(contains(text, "# TYPE i2c_transactions counter\ni2c_transactions {source=\"test\"} 42.000000\n"));
+    TEST_ASSERT_FALSE(contains(text, "# HELP i2c_transactions"));
+}
+
+void test_histogram_lines() {
+    const std::string text = scrape({4096});
+    TEST_ASSERT_TRUE(contains(text,
+        "# TYPE latency_seconds histogram\n"
+        "latency_seconds_bucket {source=\"test\",name=\"ambient\",le=\"0.001\"} 3\n"
+        "latency_seconds_bucket {source=\"test\",name=\"ambient\",le=\"0.01\"} 5\n"
+        "latency_seconds_bucket {source=\"test\",name=\"ambient\",le=\"0.1\"} 5\n"
+        "latency_seconds_bucket {source=\"test\",name=\"ambient\",le=\"+Inf\"} 6\n"
+        "latency_seconds_sum {source=\"test\",name=\"ambient\"} 0.250000\n"
+        "latency_seconds_count {source=\"test\",name=\"ambient\"} 6\n"));
+}
+
+void test_chunks_add_up_to_the_whole_scrape() {
+    const std::string expected = scrape({4096});
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), scrape({1436}).c_str());
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), scrape({130}).c_str());
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), scrape({200, 140, 333}).c_str());
+}
+
+void test_chunks_smaller_than_a_record_are_retried() {
+    const std::string expected = scrape({4096});
+    size_t retries = 0;
+    // The first record, with its headers, is longer than 90 bytes
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), scrape({90, 300, 40, 150}, &retries).c_str());
+    TEST_ASSERT_TRUE(retries > 0);
+}
+
+void test_record_larger_than_the_chunk_is_not_consumed() {
+    Scrape scrape;
+    uint8_t buffer[16];
+    MetricsResponse metrics{buffer, sizeof(buffer), scrape.fixedLabels};
+    scrape.write(metrics);
+    TEST_ASSERT_EQUAL(0, metrics.written());
+    TEST_ASSERT_TRUE(metrics.full());
+    TEST_ASSERT_EQUAL(0, metrics.records());
+}
+
+void test_truncated_record_is_dropped() {
+    const std::string help(METRICS_RECORD_SIZE, 'x');
+    const Labels fixedLabels;
+    uint8_t buffer[1024];
+    MetricsResponse metrics{buffer, sizeof(buffer), fixedLabels};
+    metrics.gauge("truncated", 1, {}, help.c_str()).gauge("uptime", 2);
+    const std::string text(reinterpret_cast<const char*>(buffer), metrics.written());
+    TEST_ASSERT_EQUAL_STRING("# TYPE uptime gauge\nuptime {} 2.000000\n", text.c_str());
+    TEST_ASSERT_EQUAL(2, metrics.records());
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_headers);
+    RUN_TEST(test_histogram_lines);
+    RUN_TEST(test_chunks_add_up_to_the_whole_scrape);
+    RUN_TEST(test_chunks_smaller_than_a_record_are_retried);
+    RUN_TEST(test_record_larger_than_the_chunk_is_not_consumed);
+    RUN_TEST(test_truncated_record_is_dropped);
+    return UNITY_END();
+}
@@ -0,0 +1,73 @@
+// PowerMonitor on a simulated INA219: `pio test -e native -f test_power_monitor`
+#include <unity.h>
+#include <native.h>
+#include <native_devices.h>
+#include "powermonitor.h"
+#include "i2c_wire.h"
+
+float lipoBatteryCharge(uint8_t cells, float voltage);
+
+namespace {
+Native::INA219Device ina219{APB_POWER_SHUNT_OHMS};
+Scheduler scheduler;
+size_t published = 0;
+
+void sample() {
+    Native::advance(APB_POWER_MONITOR_SAMPLING_MAX_MS);
+    scheduler.execute();
+}
+}
+
+void setUp() {
+    ina219.busVoltage = 12;
+    ina219.current = 0;
+    Native::attachI2CDevice(APB_INA1219_ADDRESS, &ina219);
+}
+
+void tearDown() {
+    Native::detachI2CDevice(APB_INA1219_ADDRESS);
+}
+
+void test_setup_initialises_the_sensor() {
+    APB::PowerMonitor::Instance.setup(scheduler);
+    TEST_ASSERT_TRUE(APB::PowerMonitor::Instance.status().initialised);
+}
+
+void test_sample_is_published() {
+    ina219.busVoltage = 12.2;
+    ina219.current = 1.5;
+    const size_t previous = published;
+    sample();
+    const auto status = APB::PowerMonitor::Instance.status();
+    TEST_ASSERT_EQUAL(previous + 1, published);
+    TEST_ASSERT_FLOAT_WITHIN(0.004, 12.2, status.busVoltage);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 1.5, status.current);
+    TEST_ASSERT_FLOAT_WITHIN(0.1, 18.3, status.power);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 0.06, status.shuntVoltage);
+}
+
+void test_read_errors_keep_the_previous_sample() {
+    ina219.current = 2;
+    sample();
+    Native::detachI2CDevice(APB_INA1219_ADDRESS);
+    ina219.current = 3;
+    sample();
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 2, APB::PowerMonitor::Instance.status().current);
+}
+
+void test_lipo_battery_charge() {
+    TEST_ASSERT_EQUAL_FLOAT(95, lipoBatteryCharge(3, 12.6));
+    TEST_ASSERT_EQUAL_FLOAT(50, lipoBatteryCharge(3, 11.53));
+    TEST_ASSERT_EQUAL_FLOAT(0, lipoBatteryCharge(3, 10));
+}
+
+int main(int, char **) {
+    APB::I2C::begin();
+    APB::PowerMonitor::Instance.samples.subscribe([](const APB::PowerMonitor::Status &) { published++; });
+    UNITY_BEGIN();
+    RUN_TEST(test_setup_initialises_the_sensor);
+    RUN_TEST(test_sample_is_published);
+    RUN_TEST(test_read_errors_keep_the_previous_sample);
+    RUN_TEST(test_lipo_battery_charge);
+    return UNITY_END();
+}
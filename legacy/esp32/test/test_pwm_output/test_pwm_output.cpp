@@ -0,0 +1,101 @@
+// PWMOutput control with a simulated thermistor: `pio test -e native -f test_pwm_output`
+#include <unity.h>
+#include <cmath>
+#include <native.h>
+#include "pwm_output.h"
+
+namespace {
+// First output of the S2 mini pinout
+constexpr uint8_t PWMPin = 5;
+constexpr uint8_t ThermistorPin = 1;
+Scheduler scheduler;
+
+APB::PWMOutput &output() {
+    return APB::PWMOutputs::Instance[0];
+}
+
+// ADC reading of the thermistor divider at `celsius`, inverse of the B parameter equation
+uint16_t thermistorADC(float celsius) {
+    const float resistance = APB_PWM_OUTPUT_TEMPERATURE_SENSOR_THERMISTOR_NOMINAL * std::exp(
+        APB_PWM_OUTPUT_TEMPERATURE_SENSOR_THERMISTOR_B_VALUE * (1 / (celsius + 273.15) - 1 / (APB_PWM_OUTPUT_TEMPERATURE_SENSOR_THERMISTOR_NOMINAL_TEMP + 273.15)));
+    return std::lround(4095 * resistance / (resistance + APB_PWM_OUTPUT_TEMPERATURE_SENSOR_THERMISTOR_REFERENCE));
+}
+
+void setTemperature(float celsius) {
+    Native::setAnalogRead(ThermistorPin, thermistorADC(celsius));
+}
+
+const char *setState(const char *json) {
+    JsonDocument doc;
+    deserializeJson(doc, json);
+    return output().setState(doc.as<JsonObject>());
+}
+
+void step() {
+    Native::advance(APB_PWM_OUTPUT_SAMPLING_MAX_MS);
+    scheduler.execute();
+}
+}
+
+void setUp() {
+    setTemperature(10);
+}
+
+void tearDown() {
+    setState(R"({"mode":"off"})");
+}
+
+void test_thermistor_temperature() {
+    setTemperature(-5);
+    step();
+    TEST_ASSERT_FLOAT_WITHIN(0.1, -5, output().temperature().value());
+}
+
+void test_fixed_duty() {
+    TEST_ASSERT_NULL(setState(R"({"mode":"fixed","max_duty":0.5})"));
+    TEST_ASSERT_EQUAL(APB::PWMOutput::fixed, output().mode());
+    TEST_ASSERT_EQUAL(127, Native::analogWriteValue(PWMPin));
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 0.5, output().duty());
+}
+
+void test_target_temperature_without_ramp() {
+    TEST_ASSERT_NULL(setState(R"({"mode":"target_temperature","target_temperature":15,"max_duty":0.8})"));
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 0.8, output().duty());
+    setTemperature(16);
+    step();
+    TEST_ASSERT_EQUAL(0, Native::analogWriteValue(PWMPin));
+}
+
+void test_target_temperature_ramp() {
+    // Halfway through the ramp, halfway between min and max duty
+    TEST_ASSERT_NULL(setState(R"({"mode":"target_temperature","target_temperature":12.5,"max_duty":1,"min_duty":0.2,"ramp_offset":5})"));
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 0.6, output().duty());
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 5, output().rampOffset().value());
+}
+
+void test_dewpoint_requires_ambient() {
+    TEST_ASSERT_NOT_NULL(setState(R"({"mode":"dewpoint","dewpoint_offset":5,"max_duty":1})"));
+    TEST_ASSERT_EQUAL(APB::PWMOutput::off, output().mode());
+}
+
+void test_lost_sensor_switches_off() {
+    setState(R"({"mode":"target_temperature","target_temperature":15,"max_duty":1})");
+    Native::setAnalogRead(ThermistorPin, 0);
+    step();
+    TEST_ASSERT_EQUAL(APB::PWMOutput::off, output().mode());
+    TEST_ASSERT_FALSE(output().temperature().has_value());
+    TEST_ASSERT_EQUAL(0, Native::analogWriteValue(PWMPin));
+}
+
+int main(int, char **) {
+    setTemperature(10);
+    output().setup(0, scheduler);
+    UNITY_BEGIN();
+    RUN_TEST(test_thermistor_temperature);
+    RUN_TEST(test_fixed_duty);
+    RUN_TEST(test_target_temperature_without_ramp);
+    RUN_TEST(test_target_temperature_ramp);
+    RUN_TEST(test_dewpoint_requires_ambient);
+    RUN_TEST(test_lost_sensor_switches_off);
+    return UNITY_END();
+}
@@ -0,0 +1,74 @@
+// Closed loop control quality on a simulated dew heater, see bench/thermal_simulation.h: `pio test -e native -f test_thermal_control`
+// Bounds are loose on purpose, catching control regressions rather than tuning changes; bench/native.sh thermal_sim prints the scores.
+#include <unity.h>
+#include "../../bench/thermal_simulation.h"
+
+using APB::Simulation::Result;
+
+namespace {
+Result run(const char *state, const Native::ThermalPlant::Parameters &plant = {}) {
+    static APB::Simulation::Simulator simulator;
+    return simulator.run({"", state, plant});
+}
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_unheated_lens_dews_up() {
+    const Result result = run(R"({"mode":"off"})");
+    TEST_ASSERT_GREATER_THAN_FLOAT(600, result.score.dewSeconds());
+    TEST_ASSERT_EQUAL_FLOAT(0, result.energyWattHours);
+}
+
+void test_target_temperature() {
+    const Result result = run(R"({"mode":"target_temperature","target_temperature":15,"max_duty":1})");
+    TEST_ASSERT_LESS_THAN_FLOAT(1, result.score.overshoot());
+    TEST_ASSERT_LESS_THAN_FLOAT(300, result.score.settlingSeconds());
+    TEST_ASSERT_LESS_THAN_FLOAT(0.5, result.score.rmsError());
+}
+
+void test_dewpoint_keeps_lens_dry() {
+    for(const char *state: {
+        R"({"mode":"dewpoint","dewpoint_offset":2,"max_duty":1})",
+        R"({"mode":"dewpoint","dewpoint_offset":2,"max_duty":1,"ramp_offset":2,"min_duty":0.1})",
+        R"({"mode":"dewpoint","dewpoint_offset":5,"max_duty":1,"ramp_offset":2})",
+    }) {
+        const Result result = run(state);
+        TEST_ASSERT_EQUAL_FLOAT_MESSAGE(0, result.score.dewSeconds(), state);
+        TEST_ASSERT_GREATER_THAN_FLOAT_MESSAGE(0, result.score.minDewMargin(), state);
+        TEST_ASSERT_LESS_THAN_FLOAT_MESSAGE(1, result.score.overshoot(), state);
+        TEST_ASSERT_LESS_THAN_FLOAT_MESSAGE(300, result.score.settlingSeconds(), state);
+    }
+}
+
+void test_dewpoint_in_wind() {
+    const Result result = run(R"({"mode":"dewpoint","dewpoint_offset":2,"max_duty":1,"ramp_offset":2})", {10, 30, 400, 5});
+    TEST_ASSERT_EQUAL_FLOAT(0, result.score.dewSeconds());
+    TEST_ASSERT_LESS_THAN_FLOAT(0.5, result.score.rmsError());
+}
+
+void test_ramp_reduces_overshoot_and_energy() {
+    const Result plain = run(R"({"mode":"dewpoint","dewpoint_offset":2,"max_duty":1})");
+    const Result ramp = run(R"({"mode":"dewpoint","dewpoint_offset":2,"max_duty":1,"ramp_offset":2})");
+    TEST_ASSERT_LESS_OR_EQUAL_FLOAT(plain.score.overshoot(), ramp.score.overshoot());
+    TEST_ASSERT_LESS_THAN_FLOAT(plain.energyWattHours, ramp.energyWattHours);
+}
+
+void test_dewpoint_uses_less_energy_than_fixed_duty() {
+    const Result fixed = run(R"({"mode":"fixed","max_duty":0.3})");
+    const Result dewpoint = run(R"({"mode":"dewpoint","dewpoint_offset":2,"max_duty":1})");
+    TEST_ASSERT_EQUAL_FLOAT(0, fixed.score.dewSeconds());
+    TEST_ASSERT_LESS_THAN_FLOAT(fixed.energyWattHours / 2, dewpoint.energyWattHours);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_unheated_lens_dews_up);
+    RUN_TEST(test_target_temperature);
+    RUN_TEST(test_dewpoint_keeps_lens_dry);
+    RUN_TEST(test_dewpoint_in_wind);
+    RUN_TEST(test_ramp_reduces_overshoot_and_energy);
+    RUN_TEST(test_dewpoint_uses_less_energy_than_fixed_duty);
+    return UNITY_END();
+}
@@ -0,0 +1,50 @@
+// `pio test -e native -f test_topic`
+#include <unity.h>
+#include <vector>
+#include "topic.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_every_subscriber_gets_each_sample_once() {
+    APB::Topic<int> topic;
+    std::vector<int> first, second;
+    topic.subscribe([&first](const int &sample) { first.push_back(sample); });
+    topic.subscribe([&second](const int &sample) { second.push_back(sample); });
+    topic.publish(1);
+    topic.publish(2);
+    TEST_ASSERT_EQUAL(2, topic.subscribersCount());
+    TEST_ASSERT_EQUAL(2, first.size());
+    TEST_ASSERT_EQUAL(2, second[1]);
+}
+
+void test_publish_without_subscribers() {
+    APB::Topic<int> topic;
+    topic.publish(1);
+    TEST_ASSERT_EQUAL(0, topic.subscribersCount());
+}
+
+void test_pipeline_stages() {
+    // sensor -> filter -> controller, each stage publishing to the next one
+    APB::Topic<float> raw;
+    APB::Topic<float> filtered;
+    float controlled = 0;
+    raw.subscribe([&filtered](const float &sample) {
+        if(sample > 0) {
+            filtered.publish(sample * 2);
+        }
+    });
+    filtered.subscribe([&controlled](const float &sample) { controlled = sample; });
+    raw.publish(-1);
+    TEST_ASSERT_EQUAL_FLOAT(0, controlled);
+    raw.publish(1.5);
+    TEST_ASSERT_EQUAL_FLOAT(3, controlled);
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_every_subscriber_gets_each_sample_once);
+    RUN_TEST(test_publish_without_subscribers);
+    RUN_TEST(test_pipeline_stages);
+    return UNITY_END();
+}
@@ -0,0 +1,182 @@
+// Control trace ring buffer, download format and host replay: `pio test -e native -f test_trace`
+#include <unity.h>
+#include <cmath>
+#include <ESPAsyncWebServer.h>
+#include "../../bench/trace_replay.h"
+
+using APB::Trace;
+using APB::Simulation::TraceFile;
+using APB::Simulation::TraceReplay;
+
+namespace {
+uint16_t thermistorADC(float celsius) {
+    const float resistance = APB_PWM_OUTPUT_TEMPERATURE_SENSOR_THERMISTOR_NOMINAL * std::exp(
+        APB_PWM_OUTPUT_TEMPERATURE_SENSOR_THERMISTOR_B_VALUE * (1 / (celsius + 273.15) - 1 / (APB_PWM_OUTPUT_TEMPERATURE_SENSOR_THERMISTOR_NOMINAL_TEMP + 273.15)));
+    return std::lround(4095 * resistance / (resistance + APB_PWM_OUTPUT_TEMPERATURE_SENSOR_THERMISTOR_REFERENCE));
+}
+
+// Downloads the trace like the chunked response, cycling through the chunk sizes. RESPONSE_TRY_AGAIN retries with the next size.
+std::vector<uint8_t> download(const std::vector<size_t> &chunkSizes, size_t *retries = nullptr) {
+    Trace::Serialiser serialiser{Trace::Instance};
+    std::vector<uint8_t> bytes;
+    for(size_t call = 0; ; call++) {
+        std::vector<uint8_t> chunk(chunkSizes[call % chunkSizes.size()]);
+        const size_t written = serialiser.write(chunk.data(), chunk.size(), bytes.size());
+        if(written == RESPONSE_TRY_AGAIN) {
+            if(retries) {
+                (*retries)++;
+            }
+            continue;
+        }
+        if(written == 0) {
+            return bytes;
+        }
+        bytes.insert(bytes.end(), chunk.begin(), chunk.begin() + written);
+    }
+}
+
+std::vector<uint8_t> download(size_t chunkSize) {
+    return download(std::vector<size_t>{chunkSize});
+}
+
+// Zeroes the download timestamp, the only difference between two downloads of the same trace
+std::vector<uint8_t> withoutTimestamp(std::vector<uint8_t> bytes) {
+    memset(bytes.data() + 8, 0, 4);
+    return bytes;
+}
+
+TraceReplay &replay() {
+    static TraceReplay replay{1};
+    return replay;
+}
+
+// A heater at 10°C targeting 15°C on output 0, whose thermistor wire breaks after a minute
+std::vector<Trace::Record> thermistorDropout() {
+    std::vector<Trace::Record> records;
+    records.push_back({1'000, Trace::Type::Ambient, 0, 0, {8, 85}});
+    records.push_back({1'000, Trace::Type::Thermistor, 0, thermistorADC(10), {10, NAN}});
+    records.push_back({1'000, Trace::Type::Output, 0, 0, {10, NAN}});
+    records.push_back({2'000, Trace::Type::Command, 0, APB::PWMOutput::target_temperature, {1, 0}});
+    records.push_back({2'000, Trace::Type::Setpoint, 0, 0, {15, 0}});
+    for(uint32_t timestamp = 3'000; timestamp < 60'000; timestamp += 1'000) {
+        records.push_back({timestamp, Trace::Type::Thermistor, 0, thermistorADC(10), {10, NAN}});
+        records.push_back({timestamp, Trace::Type::Output, 0, 255, {10, 15}});
+    }
+    for(uint32_t timestamp = 60'000; timestamp < 80'000; timestamp += 1'000) {
+        records.push_back({timestamp, Trace::Type::Thermistor, 0, 0, {-273, NAN}});
+        records.push_back({timestamp, Trace::Type::Output, 0, 0, {NAN, NAN}});
+    }
+    return records;
+}
+}
+
+void setUp() {
+    Trace::Instance.clear();
+}
+
+void tearDown() {}
+
+void test_ring_keeps_latest_records() {
+    for(uint16_t value = 0; value < Trace::Instance.capacity() + 10; value++) {
+        Trace::Instance.add(Trace::Type::Output, 1, value, 0, 0);
+    }
+    TEST_ASSERT_EQUAL(Trace::Instance.capacity(), Trace::Instance.size());
+    const auto file = TraceFile::parse(download(1436));
+    TEST_ASSERT_TRUE(file.has_value());
+    TEST_ASSERT_EQUAL(10, file->header.dropped);
+    TEST_ASSERT_EQUAL(Trace::Instance.capacity(), file->records.size());
+    TEST_ASSERT_EQUAL(10, file->records.front().value);
+    TEST_ASSERT_EQUAL(Trace::Instance.capacity() + 9, file->records.back().value);
+}
+
+void test_download_chunk_sizes() {
+    for(uint16_t value = 0; value < 100; value++) {
+        Trace::Instance.add(Trace::Type::Thermistor, 0, value, value, NAN);
+    }
+    const auto reference = download(4096);
+    TEST_ASSERT_EQUAL(sizeof(Trace::Header) + 100 * sizeof(Trace::Record), reference.size());
+    for(size_t chunkSize: {16, 100, 536}) {
+        TEST_ASSERT_TRUE(withoutTimestamp(download(chunkSize)) == withoutTimestamp(reference));
+    }
+}
+
+void test_chunks_smaller_than_a_record_are_retried() {
+    Trace::Instance.addCommand(1, APB::PWMOutput::dewpoint, 1, 0, 2, 0);
+    for(uint16_t value = 0; value < 20; value++) {
+        Trace::Instance.add(Trace::Type::Output, 1, value, 0, 0);
+    }
+    const auto reference = download(4096);
+    size_t retries = 0;
+    // 8 bytes hold neither the header nor a record
+    const auto bytes = download({8, 40, 15, 20}, &retries);
+    TEST_ASSERT_TRUE(withoutTimestamp(bytes) == withoutTimestamp(reference));
+    TEST_ASSERT_TRUE(retries > 0);
+
+    Trace::Serialiser serialiser{Trace::Instance};
+    uint8_t chunk[8];
+    const size_t written = serialiser.write(chunk, sizeof(chunk), 0);
+    TEST_ASSERT_EQUAL(RESPONSE_TRY_AGAIN, written);
+}
+
+void test_evicted_commands_are_kept() {
+    Trace::Instance.addCommand(2, APB::PWMOutput::dewpoint, 0.8, 0.1, 3, 2);
+    for(size_t record = 0; record < Trace::Instance.capacity(); record++) {
+        Trace::Instance.add(Trace::Type::Output, 2, 0, 0, 0);
+    }
+    const auto file = TraceFile::parse(download(1436));
+    TEST_ASSERT_EQUAL(Trace::Instance.capacity() + 2, file->records.size());
+    TEST_ASSERT_TRUE(Trace::Type::Command == file->records[0].type);
+    TEST_ASSERT_EQUAL(APB::PWMOutput::dewpoint, file->records[0].value);
+    TEST_ASSERT_TRUE(Trace::Type::Setpoint == file->records[1].type);
+    TEST_ASSERT_EQUAL_FLOAT(3, file->records[1].values[0]);
+}
+
+void test_rejects_other_formats() {
+    std::vector<uint8_t> bytes(64, 0);
+    TEST_ASSERT_FALSE(TraceFile::parse(bytes).has_value());
+}
+
+void test_replay_thermistor_dropout() {
+    const auto result = replay().run(thermistorDropout());
+    TEST_ASSERT_EQUAL(0, result.mismatches);
+    TEST_ASSERT_EQUAL(APB::PWMOutput::off, result.steps.back().replayedMode);
+    TEST_ASSERT_FALSE(result.steps.back().replayedTemperature.has_value());
+}
+
+void test_replay_reports_mismatches() {
+    auto records = thermistorDropout();
+    // The recorded output kept heating after the dropout
+    for(auto &record: records) {
+        if(record.type == Trace::Type::Output && record.timestamp >= 70'000) {
+            record.value = 255;
+        }
+    }
+    const auto result = replay().run(records);
+    TEST_ASSERT_EQUAL(10, result.mismatches);
+    TEST_ASSERT_EQUAL(70'000, *result.firstMismatch);
+}
+
+void test_replay_own_trace() {
+    replay().run(thermistorDropout());
+    // The replay ran the firmware, so it recorded its own trace: replaying it again gives the same control steps
+    const auto file = TraceFile::parse(download(1436));
+    TEST_ASSERT_GREATER_THAN(100, file->records.size());
+    const auto result = replay().run(file->records);
+    TEST_ASSERT_GREATER_THAN(50, result.steps.size());
+    TEST_ASSERT_EQUAL(0, result.mismatches);
+}
+
+int main(int argc, char **argv) {
+    Trace::Instance.setup();
+    replay();
+    UNITY_BEGIN();
+    RUN_TEST(test_ring_keeps_latest_records);
+    RUN_TEST(test_download_chunk_sizes);
+    RUN_TEST(test_chunks_smaller_than_a_record_are_retried);
+    RUN_TEST(test_evicted_commands_are_kept);
+    RUN_TEST(test_rejects_other_formats);
+    RUN_TEST(test_replay_thermistor_dropout);
+    RUN_TEST(test_replay_reports_mismatches);
+    RUN_TEST(test_replay_own_trace);
+    return UNITY_END();
+}
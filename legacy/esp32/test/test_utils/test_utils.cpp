@@ -0,0 +1,76 @@
+// OverflowPrint, spilling the output of a chunk into the next ones: `pio test -e native -f test_utils`
+#include <unity.h>
+#include <string>
+#include "utils.h"
+
+using APB::OverflowPrint;
+
+namespace {
+std::string text(const uint8_t *buffer, size_t length) {
+    return std::string(reinterpret_cast<const char*>(buffer), length);
+}
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_writes_fit_in_the_main_buffer() {
+    uint8_t buffer[8];
+    OverflowPrint print{buffer, sizeof(buffer), 4};
+    TEST_ASSERT_EQUAL(5, print.print("hello"));
+    TEST_ASSERT_EQUAL(0, print.overflow());
+    TEST_ASSERT_EQUAL_STRING("hello", text(buffer, 5).c_str());
+}
+
+void test_excess_goes_to_the_overflow_buffer() {
+    uint8_t buffer[4];
+    OverflowPrint print{buffer, sizeof(buffer), 8};
+    // Only the bytes written to the main buffer are counted
+    TEST_ASSERT_EQUAL(4, print.print("abcdefg"));
+    TEST_ASSERT_EQUAL(3, print.overflow());
+    TEST_ASSERT_EQUAL_STRING("abcd", text(buffer, 4).c_str());
+}
+
+void test_new_buffer_starts_with_the_overflow() {
+    uint8_t first[4];
+    OverflowPrint print{first, sizeof(first), 8};
+    print.print("abcdefg");
+    uint8_t second[8];
+    TEST_ASSERT_EQUAL(3, print.setNewBuffer(second, sizeof(second)));
+    TEST_ASSERT_EQUAL(0, print.overflow());
+    print.print("hi");
+    TEST_ASSERT_EQUAL_STRING("efghi", text(second, 5).c_str());
+}
+
+void test_overflow_larger_than_the_new_buffer_is_kept() {
+    uint8_t first[2];
+    OverflowPrint print{first, sizeof(first), 8};
+    print.print("abcdefgh");
+    uint8_t second[4];
+    TEST_ASSERT_EQUAL(4, print.setNewBuffer(second, sizeof(second)));
+    TEST_ASSERT_EQUAL_STRING("cdef", text(second, 4).c_str());
+    TEST_ASSERT_EQUAL(2, print.overflow());
+    uint8_t third[4];
+    TEST_ASSERT_EQUAL(2, print.setNewBuffer(third, sizeof(third)));
+    TEST_ASSERT_EQUAL_STRING("gh", text(third, 2).c_str());
+}
+
+void test_bytes_beyond_the_overflow_buffer_are_dropped() {
+    uint8_t buffer[2];
+    OverflowPrint print{buffer, sizeof(buffer), 2};
+    print.print("abcdef");
+    TEST_ASSERT_EQUAL(2, print.overflow());
+    uint8_t next[8];
+    TEST_ASSERT_EQUAL(2, print.setNewBuffer(next, sizeof(next)));
+    TEST_ASSERT_EQUAL_STRING("cd", text(next, 2).c_str());
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_writes_fit_in_the_main_buffer);
+    RUN_TEST(test_excess_goes_to_the_overflow_buffer);
+    RUN_TEST(test_new_buffer_starts_with_the_overflow);
+    RUN_TEST(test_overflow_larger_than_the_new_buffer_is_kept);
+    RUN_TEST(test_bytes_beyond_the_overflow_buffer_are_dropped);
+    return UNITY_END();
+}
@@ -11,11 +11,12 @@ import { Home } from './features/Home';
 import { Config } from './features/app/Config';
 import { System } from './features/app/System';
 import { selectWiFiAccessPointConfig } from './features/app/configSlice';
+import { mergeDelta } from './utils';
 
 const registerEventSource = dispatch => {
   const es = new EventSource('/api/events');
-  es.addEventListener('status', m => {
-    const data = JSON.parse(m.data);
+  let status = null;
+  const onStatus = data => {
     if(data.ambient) {
       dispatch(setAmbient(data.ambient));
     }
@@ -25,6 +26,21 @@ const registerEventSource = dispatch => {
     
     dispatch(setPower(data.power));
     dispatch(setUptime(data.app.uptime));
+  }
+  es.addEventListener('status', m => {
+    status = JSON.parse(m.data);
+    onStatus(status);
+  })
+  es.addEventListener('delta', m => {
+    if(status === null) {
+      return;
+    }
+    status = mergeDelta(status, JSON.parse(m.data));
+    onStatus(status);
+  })
+  // Sent on reconnection, with the history entries missed since the last received event
+  es.addEventListener('history', m => {
+    dispatch(getHistoryAsync.fulfilled(JSON.parse(m.data)));
   })
   return () => es.close()
 }
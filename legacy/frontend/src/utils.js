@@ -1,4 +1,17 @@
 export const historyEntryTimestamp = (uptime, entryUptime) => {
     const dateStarted = new Date().getTime() - (uptime* 1000);
     return dateStarted + entryUptime
-}
\ No newline at end of file
+}
+
+// Applies a `delta` status event to the last known status.
+// Arrays are sent as objects keyed by the element index, so only the changed elements are transmitted.
+export const mergeDelta = (target, delta) => {
+    if(target === null || typeof target !== 'object' || delta === null || typeof delta !== 'object') {
+        return delta;
+    }
+    const merged = Array.isArray(target) ? [...target] : {...target};
+    Object.keys(delta).forEach(key => {
+        merged[key] = mergeDelta(merged[key], delta[key]);
+    });
+    return merged;
+}